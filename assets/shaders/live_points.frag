@@ -0,0 +1,14 @@
+#version 330
+
+uniform sampler2D color_frame;
+
+in vec2 frame_coord;
+in vec4 point_color;
+
+out vec4 color;
+
+void main()
+{
+    // like the fixed function Preview: texture modulated by the tint
+    color = vec4(texture(color_frame, frame_coord).rgb * point_color.rgb, 1.0);
+}
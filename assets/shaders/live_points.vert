@@ -0,0 +1,23 @@
+#version 330
+
+in vec3 position;
+in vec2 tex_coord;  // in the color frame
+in vec4 color;      // RGBA8 tint, normalized; white when the points are not tinted
+
+// per view, one uniform buffer update (camera_block in preview.hpp)
+layout(std140) uniform Camera
+{
+    mat4 mvp;
+    float point_size;
+};
+
+out vec2 frame_coord;
+out vec4 point_color;
+
+void main()
+{
+    gl_Position = mvp * vec4(position, 1.0);
+    gl_PointSize = point_size;
+    frame_coord = tex_coord;
+    point_color = color;
+}
@@ -0,0 +1,10 @@
+#version 330
+
+in vec4 point_color;
+
+out vec4 color;
+
+void main()
+{
+    color = vec4(point_color.rgb, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 330
+
+in vec3 position;
+in vec4 color;      // RGBA8, normalized
+
+// per view, one uniform buffer update (camera_block in preview.hpp)
+layout(std140) uniform Camera
+{
+    mat4 mvp;
+    float point_size;
+};
+
+out vec4 point_color;
+
+void main()
+{
+    gl_Position = mvp * vec4(position, 1.0);
+    gl_PointSize = point_size;
+    point_color = color;
+}
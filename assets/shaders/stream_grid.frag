@@ -0,0 +1,14 @@
+#version 330
+
+uniform sampler2DArray frames;
+
+in vec3 uv;
+flat in float is_mono;
+
+out vec4 color;
+
+void main()
+{
+    vec4 c = texture(frames, uv);
+    color = is_mono > 0.5 ? vec4(c.rrr, 1.0) : vec4(c.rgb, 1.0);
+}
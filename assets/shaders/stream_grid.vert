@@ -0,0 +1,23 @@
+#version 330
+
+// unit quad corner, (0,0) top left to (1,1) bottom right
+in vec2 corner;
+
+// per instance: one tile of the grid
+in vec4 rect;       // x, y, w, h in pixels from the top left corner
+in vec2 uv_scale;   // part of the array layer covered by the frame
+in float layer;
+in float mono;
+
+uniform vec2 viewport;
+
+out vec3 uv;
+flat out float is_mono;
+
+void main()
+{
+    vec2 p = rect.xy + corner * rect.zw;
+    gl_Position = vec4(p.x / viewport.x * 2.0 - 1.0, 1.0 - p.y / viewport.y * 2.0, 0.0, 1.0);
+    uv = vec3(corner * uv_scale, layer);
+    is_mono = mono;
+}
@@ -0,0 +1,44 @@
+/**
+ * bench.hpp
+ * Tiny timing harness for the processing stages.
+ */
+
+#ifndef RSSCANNER_BENCH_H
+#define RSSCANNER_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+
+// Best wall time in seconds of `reps` runs of fn()
+template <class F>
+double bench_best(int reps, F fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < reps; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (s < best)
+            best = s;
+    }
+    return best;
+}
+
+// One result line: time per run and throughput over `bytes` of input
+inline void bench_report(const char* name, double seconds, double bytes)
+{
+    printf("%-40s %9.3f ms %9.2f GB/s\n", name, seconds * 1e3, bytes / seconds / 1e9);
+}
+
+// Benchmark groups, one per processing stage
+void bench_convert();
+void bench_colorizer();
+void bench_ipc();
+void bench_planes();
+void bench_outliers();
+void bench_kernels();
+void bench_align();
+void bench_kdtree();
+
+#endif /* end of include guard: RSSCANNER_BENCH_H */
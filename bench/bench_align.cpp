@@ -0,0 +1,85 @@
+/**
+ * bench_align.cpp
+ * Depth to color alignment of a 1280x720 frame to a 1920x1080 color frame:
+ * rgbd_aligner at every instruction set the CPU has, against a per pixel
+ * single threaded loop doing what rs2::align does on the CPU.
+ */
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/align.hpp"
+
+namespace
+{
+    // rs2::align: both corners of every depth pixel deprojected, moved to
+    // the color camera and projected, rounded to the nearest color pixels,
+    // and the rectangle between them filled with the nearest depth
+    void per_pixel_align(const uint16_t* depth, const depth_intrinsics& d, float scale,
+                         const depth_intrinsics& c, const camera_extrinsics& e, std::vector<float>& z)
+    {
+        z.assign(size_t(c.width) * c.height, 0.f);
+        const float* r = e.rotation;
+        for (int y = 0; y < d.height; y++)
+            for (int x = 0; x < d.width; x++)
+            {
+                float depth_m = depth[size_t(y) * d.width + x] * scale;
+                if (depth_m == 0.f)
+                    continue;
+                int u[2], v[2];
+                float zc = 0.f;
+                for (int k = 0; k < 2; k++)
+                {
+                    float px = (x - 0.5f + k - d.ppx) / d.fx * depth_m, py = (y - 0.5f + k - d.ppy) / d.fy * depth_m;
+                    float qx = r[0] * px + r[3] * py + r[6] * depth_m + e.translation[0];
+                    float qy = r[1] * px + r[4] * py + r[7] * depth_m + e.translation[1];
+                    float qz = r[2] * px + r[5] * py + r[8] * depth_m + e.translation[2];
+                    u[k] = int(qx / qz * c.fx + c.ppx + 0.5f);
+                    v[k] = int(qy / qz * c.fy + c.ppy + 0.5f);
+                    zc = qz;
+                }
+                if (u[0] < 0 || v[0] < 0 || u[1] >= c.width || v[1] >= c.height)
+                    continue;
+                for (int j = v[0]; j <= v[1]; j++)
+                    for (int i = u[0]; i <= u[1]; i++)
+                    {
+                        float& o = z[size_t(j) * c.width + i];
+                        o = o != 0.f ? (zc < o ? zc : o) : zc;
+                    }
+            }
+    }
+}
+
+void bench_align()
+{
+    const int w = 1280, h = 720, cw = 1920, ch = 1080;
+    const size_t n = size_t(w) * h, cn = size_t(cw) * ch;
+    std::vector<uint16_t> depth(n);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            depth[size_t(y) * w + x] = uint16_t(1500 + 300 * std::sin(x * 0.01) * std::cos(y * 0.0125));
+    std::vector<uint8_t> color(cn * 3, 128);
+    depth_intrinsics depth_intrin = { w, h, 640.f, 640.f, w * 0.5f, h * 0.5f };
+    depth_intrinsics color_intrin = { cw, ch, 1380.f, 1380.f, cw * 0.5f, ch * 0.5f };
+    camera_extrinsics e = { { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f }, { -0.015f, 0.f, 0.f } };
+
+    std::vector<float> z;
+    double s = bench_best(5, [&]() { per_pixel_align(depth.data(), depth_intrin, 0.001f, color_intrin, e, z); });
+    bench_report("align, per pixel (rs2::align)", s, double(n) * 2 + double(cn) * 3);
+
+    rgbd_aligner aligner;
+    rgbd_frame out;
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        s = bench_best(20, [&]()
+        {
+            aligner.align(depth.data(), w * 2, depth_intrin, 0.001f, color.data(), cw * 3, 3, color_intrin, e, out);
+        });
+        bench_report((std::string("align [") + simd_name(active_kernels().align_level) + "]").c_str(),
+                     s, double(n) * 2 + double(cn) * 3);
+    }
+    simd_force(simd_avx512);
+}
@@ -0,0 +1,32 @@
+/**
+ * bench_colorizer.cpp
+ * Depth colorization of a synthetic 1280x720 depth frame.
+ */
+#include <cstdint>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/colorizer.hpp"
+
+void bench_colorizer()
+{
+    const int w = 1280, h = 720;
+    std::vector<uint16_t> depth(w * h);
+    std::vector<uint8_t> rgba(w * h * 4);
+    // a tilted plane from 0.5 m to 3 m with a hole of missing data
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            bool hole = (x - w / 2) * (x - w / 2) + (y - h / 2) * (y - h / 2) < 100 * 100;
+            depth[y * w + x] = hole ? 0 : uint16_t(500 + (x + y) * 2500 / (w + h));
+        }
+
+    depth_colorizer colorizer;
+    const char* names[] = { "colorize linear", "colorize equalized" };
+    for (int eq = 0; eq < 2; eq++)
+    {
+        colorizer.equalize = eq != 0;
+        double s = bench_best(50, [&]() { colorizer.colorize(depth.data(), w, h, w * 2, rgba.data()); });
+        bench_report(names[eq], s, double(depth.size()) * 2);
+    }
+}
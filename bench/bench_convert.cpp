@@ -0,0 +1,54 @@
+/**
+ * bench_convert.cpp
+ * Pixel format converters at 1280x720, for every instruction set the CPU has.
+ */
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/convert.hpp"
+
+void bench_convert()
+{
+    const size_t pixels = 1280 * 720;
+    std::vector<uint8_t> src(pixels * 4);
+    std::vector<uint8_t> dst(pixels * 4);
+    std::vector<uint32_t> lut(65536);
+    uint32_t seed = 1;
+    for (auto& b : src)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        b = uint8_t(seed >> 24);
+    }
+    for (size_t i = 0; i < lut.size(); i++)
+        lut[i] = uint32_t(i * 2654435761u) | 0xFF000000u;
+    const uint16_t* depth = reinterpret_cast<const uint16_t*>(src.data());
+
+    struct kernel
+    {
+        const char* name;
+        void (*fn)(const uint8_t*, uint8_t*, size_t);
+        int bytes_per_pixel;
+    };
+    const kernel kernels[] = {
+        { "yuyv", yuyv_to_rgba8, 2 },
+        { "uyvy", uyvy_to_rgba8, 2 },
+        { "bgr8", bgr8_to_rgba8, 3 },
+        { "bgra8", bgra8_to_rgba8, 4 },
+    };
+
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        std::string suffix = std::string(" [") + simd_name(simd_active()) + "]";
+        for (const kernel& k : kernels)
+        {
+            double s = bench_best(20, [&]() { k.fn(src.data(), dst.data(), pixels); });
+            bench_report((k.name + suffix).c_str(), s, double(pixels) * k.bytes_per_pixel);
+        }
+        double s = bench_best(20, [&]() { z16_to_rgba8(depth, dst.data(), pixels, lut.data()); });
+        bench_report(("z16" + suffix).c_str(), s, double(pixels) * 2);
+    }
+    simd_force(simd_avx512);
+}
@@ -0,0 +1,73 @@
+/**
+ * bench_ipc.cpp
+ * Publishing a 640x480 point cloud with its color image to the shared
+ * memory ring while a reader thread consumes every frame it can.
+ */
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "ipc/cloud_ring.hpp"
+
+void bench_ipc()
+{
+    const int w = 640, h = 480;
+    const size_t n = size_t(w) * h;
+    std::vector<float> xyz(n * 3), uv(n * 2);
+    std::vector<uint8_t> color(n * 3, 128);
+    // a plane 1 m away with a quarter of the pixels missing depth
+    for (size_t i = 0; i < n; i++)
+    {
+        int x = int(i % w), y = int(i / w);
+        xyz[3 * i + 0] = (x - w / 2) / 600.f;
+        xyz[3 * i + 1] = (y - h / 2) / 600.f;
+        xyz[3 * i + 2] = (x + y) % 4 == 0 ? 0.f : 1.f;
+        uv[2 * i + 0] = float(x) / w;
+        uv[2 * i + 1] = float(y) / h;
+    }
+
+    cloud_publisher publisher("rsscanner_cloud_bench", n, color.size());
+    cloud_frame_info info = { 0, 0.0, uint32_t(w), uint32_t(h), uint32_t(w), uint32_t(h), 3, uint32_t(w * 3) };
+
+    // stand-in for a consumer process: touches every point of each new frame
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> frames_read(0), frames_torn(0);
+    std::thread consumer([&]()
+    {
+        cloud_reader reader("rsscanner_cloud_bench");
+        uint64_t next = 0;
+        float sink = 0.f;
+        while (!done.load())
+        {
+            cloud_view view;
+            if (!reader.acquire(view, next))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < view.slot->point_count; i++)
+                sink += view.xyz[3 * i + 2];
+            if (reader.still_valid(view))
+                frames_read++;
+            else
+                frames_torn++;
+            next = view.generation + 1;
+        }
+        volatile float keep = sink;
+        (void)keep;
+    });
+
+    double s = bench_best(100, [&]()
+    {
+        info.frame_number++;
+        publisher.publish(xyz.data(), uv.data(), n, color.data(), info);
+    });
+    done = true;
+    consumer.join();
+
+    bench_report("publish 640x480 + rgb8", s, double(n) * 20 + double(color.size()));
+    printf("  reader: %llu frames, %llu overwritten while reading\n",
+           (unsigned long long)frames_read.load(), (unsigned long long)frames_torn.load());
+}
@@ -0,0 +1,120 @@
+/**
+ * bench_kdtree.cpp
+ * Point picking on a 5M point accumulated cloud, a wavy surface 5 x 5 m
+ * with points scattered in front of it: building the kd-tree, picking
+ * rays through it against a scan of every point, and the neighbourhood
+ * queries at the picked points.
+ */
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/kdtree.hpp"
+
+namespace
+{
+    struct noise
+    {
+        uint32_t r = 2463534242u;
+        float next()
+        {
+            r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+            return float(r) / 4294967296.f;
+        }
+    };
+
+    // Rays from a camera 3 m in front of the surface, spread over its view
+    std::vector<float3> rays(size_t n)
+    {
+        noise rnd;
+        std::vector<float3> dirs(n);
+        for (auto& d : dirs)
+        {
+            float3 v = { 1.2f * rnd.next() - 0.6f, 1.2f * rnd.next() - 0.6f, 1.f };
+            d = v * (1.f / std::sqrt(dot(v, v)));
+        }
+        return dirs;
+    }
+
+    const float3 camera = { 0.f, 0.f, -2.f };
+    const float pick_radius = 0.004f, pick_slope = 0.001f;
+}
+
+void bench_kdtree()
+{
+    noise rnd;
+    const size_t n = 5000000;
+    std::vector<float3> cloud(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        float x = (rnd.next() - 0.5f) * 5.f, y = (rnd.next() - 0.5f) * 5.f;
+        float z = 1.f + 0.1f * std::sin(x * 6.f) * std::cos(y * 4.f);
+        if (rnd.next() < 0.02f)
+            z -= rnd.next();
+        cloud[i] = float3{ x, y, z };
+    }
+
+    kdtree tree;
+    double s = bench_best(3, [&]() { tree.build(cloud.data(), n); });
+    bench_report("build, 5M points", s, double(n) * sizeof(float3));
+
+    const std::vector<float3> dirs = rays(10000);
+    std::vector<kdtree::ray_hit> hits(dirs.size());
+    size_t picked = 0;
+    s = bench_best(5, [&]()
+    {
+        picked = 0;
+        for (size_t i = 0; i < dirs.size(); i++)
+            picked += tree.ray_nearest(camera, dirs[i], pick_radius, pick_slope, hits[i]);
+    });
+    bench_report("ray pick, 10k rays", s, double(n) * sizeof(float3));
+    printf("  %.2f us a pick, %d of %d rays hit\n", s * 1e6 / dirs.size(), int(picked), int(dirs.size()));
+
+    // what a pick costs without the tree: every point against the cone
+    const size_t scans = 10;
+    double scan = bench_best(3, [&]()
+    {
+        for (size_t r = 0; r < scans; r++)
+        {
+            float best = std::numeric_limits<float>::max();
+            for (const float3& p : cloud)
+            {
+                float3 v = p - camera;
+                float t = dot(v, dirs[r]);
+                float allow = pick_radius + pick_slope * t;
+                if (t >= 0.f && t < best && dot(v, v) - t * t <= allow * allow)
+                    best = t;
+            }
+            hits[r].t = best;
+        }
+    });
+    bench_report("ray scan, 10 rays", scan, double(n) * sizeof(float3) * scans);
+    printf("  %.2f ms a pick, %.0fx the tree\n", scan * 1e3 / scans, scan / scans / (s / dirs.size()));
+
+    // neighbourhoods of the picked points, as the measurement tools query them
+    size_t indices[8];
+    float dist2[8];
+    s = bench_best(5, [&]()
+    {
+        for (size_t i = 0; i < dirs.size(); i++)
+            tree.knn(hits[i].point, 8, indices, dist2);
+    });
+    bench_report("knn 8, 10k queries", s, double(n) * sizeof(float3));
+    printf("  %.2f us a query\n", s * 1e6 / dirs.size());
+    std::vector<size_t> found;
+    size_t total = 0;
+    s = bench_best(5, [&]()
+    {
+        total = 0;
+        for (size_t i = 0; i < dirs.size(); i++)
+        {
+            tree.radius_search(hits[i].point, 0.01f, found);
+            total += found.size();
+        }
+    });
+    bench_report("radius 1 cm, 10k queries", s, double(n) * sizeof(float3));
+    printf("  %.2f us a query, %.1f points found on average\n", s * 1e6 / dirs.size(),
+           double(total) / dirs.size());
+}
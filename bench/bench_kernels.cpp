@@ -0,0 +1,55 @@
+/**
+ * bench_kernels.cpp
+ * Point cloud kernels on a 1280x720 frame, for every instruction set the
+ * CPU has.
+ */
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/deproject.hpp"
+#include "processing/kernels.hpp"
+
+void bench_kernels()
+{
+    const int w = 1280, h = 720;
+    const size_t n = size_t(w) * h;
+    std::vector<uint16_t> depth(n);
+    std::vector<uint8_t> removed(n);
+    std::vector<float2> uv(n);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        depth[i] = (seed >> 24) < 25 ? 0 : uint16_t(500 + (seed >> 20) % 3000);   // 10% holes
+        removed[i] = (seed >> 8 & 255) < 25;
+        uv[i] = float2{ float(i % w) / w, float(i / w) / h };
+    }
+    depth_intrinsics intrin = { w, h, 1200.f, 1200.f, w * 0.5f, h * 0.5f };
+    std::vector<float3> points(n), out(n + 1);
+    std::vector<float2> out_uv(n + 1);
+    std::vector<uint32_t> colors(n, 0xff8080ffu), out_colors(n + 1);
+    deproject_depth(depth.data(), w * 2, intrin, 0.001f, points.data());
+
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        const cloud_kernels& k = active_kernels();
+        double s = bench_best(20, [&]() { deproject_depth(depth.data(), w * 2, intrin, 0.001f, points.data()); });
+        bench_report((std::string("deproject [") + simd_name(k.deproject_level) + "]").c_str(), s, double(n) * 14);
+        s = bench_best(20, [&]()
+        {
+            compact_points(points.data(), colors.data(), removed.data(), n, out.data(), out_colors.data());
+        });
+        bench_report((std::string("compact [") + simd_name(k.compact_level) + "]").c_str(), s, double(n) * 17);
+        s = bench_best(20, [&]()
+        {
+            k.gather_visible(points.data(), uv.data(), removed.data(), removed.data(), n, 1,
+                             out.data(), out_uv.data(), out_colors.data());
+        });
+        bench_report((std::string("gather, hidden and tinted [") + simd_name(k.gather_level) + "]").c_str(),
+                     s, double(n) * 22);
+    }
+    simd_force(simd_avx512);
+}
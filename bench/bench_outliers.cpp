@@ -0,0 +1,109 @@
+/**
+ * bench_outliers.cpp
+ * Outlier removal on synthetic clouds with injected noise: a 640x480 frame
+ * of a wavy surface with flying pixels pushed along their rays, and a 1M
+ * point accumulated cloud, 5 mm apart over 5 x 5 m of the same surface,
+ * with points scattered around it.
+ */
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/outliers.hpp"
+
+namespace
+{
+    struct noise
+    {
+        uint32_t r = 2463534242u;
+        float next()
+        {
+            r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+            return float(r) / 4294967296.f;
+        }
+    };
+
+    float surface(float x, float y)
+    {
+        return 1.f + 0.1f * std::sin(x * 6.f) * std::cos(y * 4.f);
+    }
+
+    // Time one filter and how many of the injected outliers it caught
+    void run(const char* name, const std::vector<float3>& points, const std::vector<uint8_t>& injected,
+             int width, int height, const outlier_options& opt, int reps)
+    {
+        std::vector<uint8_t> removed(points.size());
+        double s = bench_best(reps, [&]()
+        {
+            std::fill(removed.begin(), removed.end(), 0);
+            if (width)
+                remove_outliers_organized(points.data(), width, height, opt, removed.data());
+            else
+                remove_outliers(points.data(), points.size(), opt, removed.data());
+        });
+        size_t outliers = 0, caught = 0, wrong = 0;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            outliers += injected[i];
+            caught += injected[i] && removed[i];
+            wrong += !injected[i] && removed[i];
+        }
+        bench_report(name, s, double(points.size()) * sizeof(float3));
+        printf("  caught %.1f%% of %d outliers, removed %.2f%% of the other points\n",
+               100.0 * caught / std::max<size_t>(outliers, 1), int(outliers),
+               100.0 * wrong / std::max<size_t>(points.size() - outliers, 1));
+    }
+}
+
+void bench_outliers()
+{
+    noise rnd;
+
+    // one frame: 10% missing depth, 3% flying pixels
+    const int w = 640, h = 480;
+    std::vector<float3> frame(size_t(w) * h);
+    std::vector<uint8_t> frame_injected(frame.size());
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            size_t i = size_t(y) * w + x;
+            float u = (x - w / 2) / 600.f, v = (y - h / 2) / 600.f;
+            float z = surface(u, v) + (rnd.next() - 0.5f) * 0.002f;
+            float kind = rnd.next();
+            if (kind < 0.1f)
+                z = 0.f;
+            else if (kind < 0.13f)
+            {
+                z += 0.05f + rnd.next() * 0.5f;
+                frame_injected[i] = 1;
+            }
+            frame[i] = float3{ u * z, v * z, z };
+        }
+
+    outlier_options opt;
+    opt.filter = outlier_statistical;
+    run("statistical, 640x480 frame", frame, frame_injected, w, h, opt, 10);
+    opt.filter = outlier_radius;
+    run("radius, 640x480 frame", frame, frame_injected, w, h, opt, 10);
+
+    // accumulated: 1M points, 2% scattered up to 10 cm off the surface
+    const size_t n = 1 << 20;
+    std::vector<float3> cloud(n);
+    std::vector<uint8_t> cloud_injected(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        float x = (rnd.next() - 0.5f) * 5.f, y = (rnd.next() - 0.5f) * 5.f;
+        float z = surface(x, y) + (rnd.next() - 0.5f) * 0.002f;
+        if (rnd.next() < 0.02f)
+        {
+            z += (rnd.next() < 0.5f ? -1.f : 1.f) * (0.03f + rnd.next() * 0.07f);
+            cloud_injected[i] = 1;
+        }
+        cloud[i] = float3{ x, y, z };
+    }
+    opt.filter = outlier_statistical;
+    run("statistical, 1M accumulated", cloud, cloud_injected, 0, 0, opt, 3);
+    opt.filter = outlier_radius;
+    run("radius, 1M accumulated", cloud, cloud_injected, 0, 0, opt, 3);
+}
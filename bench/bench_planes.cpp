@@ -0,0 +1,49 @@
+/**
+ * bench_planes.cpp
+ * Plane segmentation of a synthetic 1M point scene: a floor, a table top
+ * and clutter, with sensor noise and a tenth of the points missing depth.
+ */
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "bench.hpp"
+#include "processing/planes.hpp"
+
+void bench_planes()
+{
+    const size_t n = 1 << 20;
+    std::vector<float3> points(n);
+    uint32_t r = 12345;
+    auto rnd = [&]()
+    {
+        r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+        return float(r) / 4294967296.f;
+    };
+    for (size_t i = 0; i < n; i++)
+    {
+        float u = rnd() * 2.f - 1.f, v = rnd() * 2.f + 0.5f, noise = (rnd() - 0.5f) * 0.006f;
+        float kind = rnd();
+        if (kind < 0.1f)
+            points[i] = float3{ 0.f, 0.f, 0.f };                       // no depth
+        else if (kind < 0.55f)
+            points[i] = float3{ u, 0.5f + noise, v };                    // floor
+        else if (kind < 0.8f)
+            points[i] = float3{ u * 0.4f, -0.1f + noise, 1.f + v * 0.3f };  // table top
+        else
+            points[i] = float3{ u * 0.5f, rnd() - 0.5f, 0.8f + rnd() };    // clutter
+    }
+
+    plane_options opt;
+    std::vector<plane> planes;
+    std::vector<uint8_t> labels;
+    plane_stats stats = {};
+    double s = bench_best(20, [&]() { segment_planes(points.data(), n, opt, planes, labels, &stats); });
+
+    bench_report("segment 1M points, 2 planes", s, double(n) * sizeof(float3));
+    printf("  sample %.2f ms, ransac %.2f ms (%d hypotheses), refine %.2f ms\n",
+           stats.sample_ms, stats.ransac_ms, int(stats.hypotheses), stats.refine_ms);
+    for (const plane& p : planes)
+        printf("  plane (%.3f, %.3f, %.3f) d %.3f: %.1f%% of the points\n",
+               p.normal.x, p.normal.y, p.normal.z, p.d, 100.0 * p.inliers / n);
+}
@@ -0,0 +1,49 @@
+/**
+ * main.cpp benchmark entry point
+ *
+ * usage: RealSenseScannerBench [group...]
+ * Runs every benchmark group, or only the named ones. RSSCANNER_SIMD caps
+ * the instruction set, see processing/simd.hpp.
+ */
+#include <cstring>
+
+#include "bench.hpp"
+#include "processing/kernels.hpp"
+
+struct bench_group
+{
+    const char* name;
+    void (*run)();
+};
+
+static const bench_group groups[] = {
+    { "convert", bench_convert },
+    { "colorizer", bench_colorizer },
+    { "ipc", bench_ipc },
+    { "planes", bench_planes },
+    { "outliers", bench_outliers },
+    { "kernels", bench_kernels },
+    { "align", bench_align },
+    { "kdtree", bench_kdtree },
+};
+
+int main(int argc, const char *argv[])
+{
+    const cloud_kernels& k = active_kernels();
+    printf("simd: %s of %s%s; kernels: deproject %s, compact %s, gather %s, align %s, motion %s, change %s\n",
+           simd_name(simd_active()), simd_name(simd_detect()), simd_overridden() ? " (RSSCANNER_SIMD)" : "",
+           simd_name(k.deproject_level), simd_name(k.compact_level), simd_name(k.gather_level),
+           simd_name(k.align_level), simd_name(k.motion_level), simd_name(k.change_level));
+    for (const bench_group& g : groups)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++)
+            selected = selected || strcmp(argv[i], g.name) == 0;
+        if (!selected)
+            continue;
+
+        printf("== %s\n", g.name);
+        g.run();
+    }
+    return 0;
+}
@@ -7,9 +7,16 @@
 
 #include <vector>
 #include <iostream>
-#include <thread>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
 
-#include "utils/glError.hpp"
+#include "graphic/GLState.hpp"
+#include "utils/glDebug.hpp"
+#include "utils/allocStats.hpp"
+#include "utils/frameArena.hpp"
+#include "utils/stopwatch.hpp"
+#include "processing/kernels.hpp"
 #include "RSScanner.hpp"
 
 using namespace std;
@@ -17,34 +24,35 @@ using namespace std;
 RSScanner::RSScanner():
     Application()
 {
+    // looking down on the cloud, along the camera axis, and free
+    views.add_view("Top view", 0.0, 90.0);
+    views.add_view("Front view", 0.0, 0.0);
+    views.add_view("Free view");
     init_pcview();  // init point cloud viewport
-    glCheckError(__FILE__, __LINE__);
 }
 
-void RSScanner::init_pcview()
+RSScanner::~RSScanner()
 {
-    // const auto CAPACITY = 5; // allow max latency of 5 frames
-    // queue = rs2::frame_queue(CAPACITY);
-
-    // std::thread t([&]() {
-    //     while (true)
-    //     {
-    //         rs2::depth_frame frame;
-    //         if (queue.poll_for_frame(&frame))
-    //         {
-    //             frame.get_data();
-    //             // Do processing on the frame
-    //         }
-    //     }
-    // });
-    // t.detach();
+    stop_collect();
+}
 
+void RSScanner::init_pcview()
+{
+    // frame processing runs on task_scheduler::shared(), see render_pointcloud()
     if (is_previewing)
     {
         start_preview();
     }
 }
 
+// Stream profiles the quality controller can fall back to, 0 = device default
+struct stream_profile_desc { int width, height, fps; };
+static const stream_profile_desc stream_profiles[] = {
+    { 0, 0, 0 },
+    { 640, 480, 30 },
+    { 424, 240, 30 },
+};
+
 void RSScanner::start_preview()
 {
     is_previewing = true;
@@ -55,7 +63,26 @@ void RSScanner::start_preview()
         device_ready = true;
         // update pipeline
         pipe = rs2::pipeline(ctx);
-        pipe.start();
+        const stream_profile_desc& p = stream_profiles[stream_profile];
+        if (p.width == 0)
+        {
+            pipe.start();
+            return;
+        }
+
+        rs2::config cfg;
+        cfg.enable_stream(RS2_STREAM_DEPTH, p.width, p.height, RS2_FORMAT_Z16, p.fps);
+        cfg.enable_stream(RS2_STREAM_COLOR, p.width, p.height, RS2_FORMAT_RGB8, p.fps);
+        if (cfg.can_resolve(pipe))
+        {
+            pipe.start(cfg);
+        }
+        else
+        {
+            // the camera has no such mode, keep running at the default one
+            stream_profile = 0;
+            pipe.start();
+        }
     } else {
         device_ready = false;
     }
@@ -68,7 +95,23 @@ void RSScanner::stop_preview()
     }
 }
 
-void RSScanner::render_pointcloud(float w, float h)
+static bool same_settings(const cloud_settings& a, const cloud_settings& b)
+{
+    const plane_options& pa = a.planes;
+    const plane_options& pb = b.planes;
+    const outlier_options& oa = a.outliers;
+    const outlier_options& ob = b.outliers;
+    return a.find_planes == b.find_planes && a.remove_planes == b.remove_planes &&
+           a.filter_outliers == b.filter_outliers && a.point_budget == b.point_budget &&
+           a.publish == b.publish && a.collecting == b.collecting && a.measuring == b.measuring &&
+           pa.threshold == pb.threshold && pa.max_planes == pb.max_planes && pa.min_fraction == pb.min_fraction &&
+           pa.confidence == pb.confidence && pa.max_hypotheses == pb.max_hypotheses &&
+           pa.sample_points == pb.sample_points && pa.seed == pb.seed &&
+           oa.filter == ob.filter && oa.k == ob.k && oa.std_ratio == ob.std_ratio && oa.radius == ob.radius &&
+           oa.min_neighbors == ob.min_neighbors && oa.window == ob.window;
+}
+
+void RSScanner::render_pointcloud()
 {
     if (!device_ready)
     {
@@ -76,38 +119,781 @@ void RSScanner::render_pointcloud(float w, float h)
         return;
     }
 
-    update_pc_state(pcv);
+    frame_timing timing;
+    stopwatch timer;
 
     // Wait for the next set of frames from the camera
-    auto frames = pipe.wait_for_frames();
-    auto depth = frames.get_depth_frame();
-    // Generate the pointcloud and texture mappings
-    points = pc.calculate(depth);
+    frames = pipe.wait_for_frames();
+    timing.capture_ms = timer.lap_ms();
+
+    frame_stamp& stamp = stamps[getFrameIndex() % 8];
+    stamp = frame_stamp();
+    stamp.frame = getFrameIndex();
+    double captured = system_time_ms(), sensor;
+    {
+        // hardware clock timestamps can't be compared with the host clock,
+        // fall back to the time the frame reached the host
+        auto ref = frames.get_depth_frame();
+        stamp_from_arrival = ref.get_frame_timestamp_domain() == RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+        if (!stamp_from_arrival)
+            sensor = ref.get_timestamp();
+        else if (ref.supports_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL))
+            sensor = (double)ref.get_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL);
+        else
+            sensor = captured;
+    }
+
+    rs2::frame depth = frames.get_depth_frame();
+    if (quality.settings().decimation > 1)
+        depth = decimate.process(depth);
     auto color = frames.get_color_frame();
     // For cameras that don't have RGB sensor, we'll map the pointcloud to infrared instead of color
     if (!color)
         color = frames.get_infrared_frame();
-    // Tell pointcloud object to map to this color frame
-    pc.map_to(color);
-    // Upload the color frame to OpenGL
-    pcv.tex.upload(color);
+
+    // while collecting, the keyframe gate looks at the raw depth first: a
+    // frame it turns down is not processed at all, unless it is shared, and
+    // the preview keeps the cloud and colors of the last keyframe, which the
+    // camera barely moved from
+    bool keyframe = !is_collecting || collect_frame(depth);
+    bool gated = !keyframe && !publish && points;
+    frames_gated += gated;
+    gate_saved_ms += gated ? cloud_ms : 0.0;
+
+    // a frame that changed nothing keeps the cloud of the last one, unless
+    // the settings it was processed with changed; shared and collected
+    // clouds carry the colors too
+    bool depth_changed = !gated, color_changed = !gated;
+    if (reuse_static && !gated)
+        detect_changes(depth, color, depth_changed, color_changed);
+    cloud_settings settings = current_cloud_settings();
+    bool process = !gated && (!points || depth_changed || (color_changed && (publish || is_collecting)) ||
+                              !same_settings(settings, processed_settings));
+    frames_seen++;
+    frames_reused += !process && !gated;
+
+    if (process)
+    {
+        stopwatch cloud_timer;
+        // Generate the pointcloud and texture mappings
+        points = pc.calculate(depth);
+        // Tell pointcloud object to map to this color frame
+        pc.map_to(color);
+        cloud_frame = depth.get_frame_number();
+        cloud_sensor = sensor;
+        cloud_captured = captured;
+        processed_settings = settings;
+
+        // the stages of the frame as a graph on the high priority lane: the
+        // picking index, sharing and collecting after the cleanup. They
+        // capture two pointers at most, which a std::function holds without
+        // allocating.
+        struct stage_frames
+        {
+            const rs2::frame& depth;
+            const rs2::video_frame& color;
+        } in = { depth, color };
+        stages.clear();
+        size_t cleaned = stages.add([this, &in]() { clean_points(points, in.depth); }, task_high);
+        if (publish)
+            stages.precede(cleaned, stages.add([this, &in]() { publish_cloud(in.depth, in.color); }, task_high));
+        if (is_collecting && keyframe)
+            stages.precede(cleaned, stages.add([this, &in]() { collect(in.color); }, task_high));
+        // Index the points the Preview shows for picking
+        if (measure.enabled)
+        {
+            size_t index = stages.add([this]() { update_measure_index(measure, points, removed_points()); }, task_high);
+            stages.precede(cleaned, index);
+        }
+        stages.run();
+        double ms = cloud_timer.elapsed_ms();
+        cloud_ms = cloud_ms ? cloud_ms * 0.9 + ms * 0.1 : ms;
+    }
+    // the latency is that of the frame the drawn cloud was calculated from,
+    // older than this one when the gate turned it down or it was reused
+    stamp.sensor = cloud_sensor;
+    stamp.captured = cloud_captured;
+    stamp.processed = system_time_ms();
+    // Upload the color frame to OpenGL, only its changed tiles when known;
+    // none of it for a frame the gate turned down
+    if (!reuse_static && !gated)
+        pcv.tex.upload(color);
+    else if (color_changed)
+    {
+        pcv.tex.upload_tiles(color, color_changes);
+        views.texture_changed();
+    }
+    stamp.uploaded = system_time_ms();
+    timing.process_ms = timer.lap_ms();
     
-    // Draw the pointcloud in texture context
-    draw_pointcloud(w, h, pcv, points);
-    ImVec2 pos = ImGui::GetCursorPos();
-    auto win_lt = ImGui::GetItemRectMin();  // window left top
-    auto rel_lt = ImGui::GetWindowContentRegionMin();  // content relative to window
-    auto rel_br = ImGui::GetWindowContentRegionMax();  // max pos of content relative to window
-
-    // Ask ImGui to draw it as an image:
-    // Under OpenGL the ImGUI image type is GLuint
-    // So make sure to use "(void *)tex" but not "&tex"
-    ImGui::GetWindowDrawList()->AddImage(
-        (void *)pcv.tex.get_gl_handle(),
-        ImVec2(win_lt.x + rel_br.x, win_lt.y + rel_br.y),
-        ImVec2(win_lt.x + rel_lt.x, win_lt.y + rel_lt.y),
-        ImVec2(0, 1),
-        ImVec2(1, 0));
+    // Upload the points once, for the Preview and the other views
+    views.upload(cloud_frame, points, pcv.point_budget, removed_points(),
+                 find_planes && !remove_planes && !point_labels.empty() ? point_labels.data() : nullptr);
+    // Draw the pointcloud into the Preview's target, as large as the window
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    avail = ImVec2(floorf(avail.x), floorf(avail.y));
+    views.render_preview(pcv, pcv.tex.get_gl_handle(), (int)avail.x, (int)avail.y);
+    timing.draw_ms = timer.lap_ms();
+    stamp.drawn = system_time_ms();
+
+    if (quality.update(timing))
+        apply_quality();
+
+    // Under OpenGL the ImGUI image type is GLuint, the target is bottom up
+    ImGui::Image((void *)(intptr_t)views.preview.target.getTexture(), avail, ImVec2(0, 1), ImVec2(1, 0));
+    update_pc_state(pcv);
+
+    if (measure.enabled)
+        update_measure(measure, pcv, ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
+}
+
+cloud_settings RSScanner::current_cloud_settings() const
+{
+    cloud_settings s;
+    s.find_planes = find_planes;
+    s.remove_planes = remove_planes;
+    s.filter_outliers = filter_outliers;
+    s.planes = plane_opts;
+    s.outliers = outlier_opts;
+    s.point_budget = pcv.point_budget;
+    s.publish = publish;
+    s.collecting = is_collecting;
+    s.measuring = measure.enabled;
+    return s;
+}
+
+void RSScanner::detect_changes(const rs2::frame& depth, const rs2::video_frame& color,
+                               bool& depth_changed, bool& color_changed)
+{
+    stopwatch timer;
+    rs2::video_frame image = depth.as<rs2::video_frame>();
+    float units = depth.as<rs2::depth_frame>().get_units();
+    size_t changed = depth_changes.update_depth(static_cast<const uint16_t*>(image.get_data()),
+                                                image.get_stride_in_bytes(), image.get_width(),
+                                                image.get_height(), change_depth_mm / 1000.f / units);
+    size_t tiles = depth_changes.count();
+    depth_changed = changed > 0;
+    if (color)
+    {
+        size_t c = color_changes.update(static_cast<const uint8_t*>(color.get_data()), color.get_stride_in_bytes(),
+                                        color.get_width(), color.get_height(), color.get_bytes_per_pixel(),
+                                        change_color);
+        changed += c;
+        tiles += color_changes.count();
+        color_changed = c > 0;
+    }
+    double ms = timer.elapsed_ms();
+    change_ms = change_ms ? change_ms * 0.9 + ms * 0.1 : ms;
+    double reused = tiles ? 1.0 - double(changed) / double(tiles) : 0.0;
+    tiles_reused += (reused - tiles_reused) * 0.1;
+}
+
+void RSScanner::render_static()
+{
+    if (ImGui::Checkbox("Reuse unchanged tiles", &reuse_static))
+    {
+        // the references fell behind what was processed meanwhile
+        depth_changes.reset();
+        color_changes.reset();
+    }
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Frames that change no depth tile keep the last cloud, without deprojection,\n"
+                          "cleanup, sharing or collection; only the changed color tiles are uploaded");
+    ImGui::PushItemWidth(120.f);
+    ImGui::SliderFloat("Depth change", &change_depth_mm, 0.5f, 50.f, "%.1f mm");
+    ImGui::SameLine();
+    ImGui::SliderFloat("Color change", &change_color, 1.f, 32.f, "%.1f");
+    ImGui::PopItemWidth();
+    if (!reuse_static)
+        return;
+    ImGui::Text("Tiles: %.0f%% reused (smoothed), depth %d of %d, color %d of %d changed",
+                tiles_reused * 100.0, int(depth_changes.changed_count()), int(depth_changes.count()),
+                int(color_changes.changed_count()), int(color_changes.count()));
+    ImGui::Text("Frames: %llu of %llu reused, detection %.2f ms (smoothed)", (unsigned long long)frames_reused,
+                (unsigned long long)frames_seen, change_ms);
+}
+
+void RSScanner::render_view(live_views::view& v)
+{
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    views.render(v, pcv.tex.get_gl_handle(), (int)avail.x, (int)avail.y);
+    ImGui::Image((void *)(intptr_t)v.target.getTexture(), avail, ImVec2(0, 1), ImVec2(1, 0));
+    update_pc_state(v.state);
+}
+
+void RSScanner::apply_quality()
+{
+    const quality_level& q = quality.settings();
+    decimate.set_option(RS2_OPTION_FILTER_MAGNITUDE, (float)q.decimation);
+    pcv.point_budget = q.point_budget;
+    pcv.point_size = q.point_size;
+    for (auto& v : views.views)
+        v->state.point_size = q.point_size;
+
+    if (q.stream_profile != stream_profile && device_ready)
+    {
+        stream_profile = q.stream_profile;
+        pipe.stop();
+        start_preview();
+        if (stream_profile != q.stream_profile)
+        {
+            // not tried again: back off to the nearest level above that can
+            // be applied, and apply its settings instead
+            quality.skip_profile(q.stream_profile);
+            int level = quality.level() - 1;
+            while (level > 0 && !quality.available(level))
+                level--;
+            quality.set_level(level, "stream profile not supported");
+            apply_quality();
+        }
+    }
+}
+
+void RSScanner::render_quality()
+{
+    int level = quality.level();
+    const quality_level& q = quality.settings();
+    const stream_profile_desc& p = stream_profiles[stream_profile];
+
+    ImGui::Checkbox("Adaptive quality", &quality.enabled);
+    ImGui::PushItemWidth(120.f);
+    ImGui::SliderFloat("Target ms", &quality.target_ms, 5.f, 66.f, "%.1f");
+    if (!quality.enabled && ImGui::SliderInt("Level", &level, 0, quality.level_count() - 1) &&
+        quality.available(level))
+    {
+        quality.set_level(level, "manual");
+        apply_quality();
+    }
+    ImGui::PopItemWidth();
+    ImGui::Text("Level %d: decimation %d, budget %d, point size %.0f",
+                quality.level(), q.decimation, int(q.point_budget), q.point_size);
+    if (p.width)
+        ImGui::Text("Streams: %dx%d @ %d FPS", p.width, p.height, p.fps);
+    else
+        ImGui::Text("Streams: device default");
+    ImGui::Text("Frame cost %.2f ms (smoothed)", quality.smoothed_ms());
+    for (const auto& line : quality.decisions())
+        ImGui::TextDisabled("%s", line.c_str());
+}
+
+void RSScanner::frameCompleted(unsigned long long frame, double swapTime, double doneTime)
+{
+    const frame_stamp& stamp = stamps[frame % 8];
+    if (stamp.frame != frame || stamp.drawn == 0)
+        return;  // no camera frame was drawn in that application frame
+
+    motion_to_photon.add(doneTime - stamp.sensor);
+    const double marks[7] = { stamp.sensor, stamp.captured, stamp.processed, stamp.uploaded,
+                              stamp.drawn, swapTime, doneTime };
+    for (int i = 0; i < 6; i++)
+        stage_ms[i] += (marks[i + 1] - marks[i] - stage_ms[i]) * 0.1;
+}
+
+void RSScanner::render_latency()
+{
+    const char* stages[6] = { stamp_from_arrival ? "arrival -> captured" : "sensor -> captured",
+                              "captured -> processed", "processed -> uploaded",
+                              "uploaded -> drawn", "drawn -> swapped", "swapped -> GPU done" };
+    ImGui::Text("%s to photon: last %.1f ms", stamp_from_arrival ? "Arrival" : "Motion",
+                motion_to_photon.last());
+    ImGui::Text("p50 %.1f ms  p99 %.1f ms  max %.1f ms", motion_to_photon.percentile(0.5),
+                motion_to_photon.percentile(0.99), motion_to_photon.max());
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "0 - %.0f ms", motion_to_photon.bin_width() * motion_to_photon.bin_count());
+    ImGui::PlotHistogram("##latency", motion_to_photon.bins(), (int)motion_to_photon.bin_count(),
+                         0, overlay, 0.f, FLT_MAX, ImVec2(0, 60));
+    for (int i = 0; i < 6; i++)
+        ImGui::Text("  %-22s %6.2f ms", stages[i], stage_ms[i]);
+}
+
+void RSScanner::render_streams()
+{
+    if (!frames)
+        return;
+
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    avail.y -= ImGui::GetTextLineHeightWithSpacing();  // leave room for the stats line
+    streams.render(frames, (int)avail.x, (int)avail.y);
+    ImGui::Image((void *)(intptr_t)streams.get_gl_handle(), avail, ImVec2(0, 1), ImVec2(1, 0));
+}
+
+void RSScanner::render_depth()
+{
+    if (!frames)
+        return;
+    auto depth = frames.get_depth_frame();
+    if (!depth)
+        return;
+
+    depth_colorizer& colorizer = depth_tex.colorizer;
+    int map = colorizer.map;
+    ImGui::PushItemWidth(150.f);
+    if (ImGui::BeginCombo("Colormap", colormap_name(colorizer.map)))
+    {
+        for (int i = 0; i < colormap_count; i++)
+            if (ImGui::Selectable(colormap_name(colormap(i)), i == map))
+                colorizer.map = colormap(i);
+        ImGui::EndCombo();
+    }
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Checkbox("Equalize", &colorizer.equalize);
+
+    depth_tex.upload(depth);
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    rect r = rect{ 0, 0, avail.x, avail.y }.adjust_ratio(
+        float2{ (float)depth_tex.get_width(), (float)depth_tex.get_height() });
+    ImGui::Image((void *)(intptr_t)depth_tex.get_gl_handle(), ImVec2(r.w, r.h));
+}
+
+void RSScanner::render_scan()
+{
+    ImGui::PushItemWidth(240.f);
+    ImGui::InputText("##path", scan_path, sizeof(scan_path));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Open"))
+    {
+        try
+        {
+            scan.open(scan_path);
+            scan_status.clear();
+        }
+        catch (const std::exception& e)
+        {
+            scan_status = e.what();
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save live cloud") && points)
+    {
+        try
+        {
+            auto color = frames.get_color_frame();
+            save_points(scan_path, points, color ? color : frames.get_infrared_frame(), removed_points());
+            scan_status = std::string("saved ") + scan_path;
+        }
+        catch (const std::exception& e)
+        {
+            scan_status = e.what();
+        }
+    }
+    if (!scan_status.empty())
+        ImGui::TextDisabled("%s", scan_status.c_str());
+
+    if (const cloud_file* f = scan.get_file())
+    {
+        int budget_mb = int(scan.memory_budget >> 20);
+        ImGui::PushItemWidth(120.f);
+        if (ImGui::SliderInt("Budget MB", &budget_mb, 64, 4096))
+            scan.memory_budget = size_t(budget_mb) << 20;
+        if (f->is_tree())
+        {
+            ImGui::SameLine();
+            ImGui::SliderFloat("Detail px", &scan.detail_px, 50.f, 1000.f, "%.0f");
+        }
+        ImGui::PopItemWidth();
+        ImGui::Text("%.1f M points in %d blocks%s; index %.2f ms, first points %.1f ms",
+                    f->points() / 1e6, int(f->block_count()), f->is_tree() ? " (tree)" : "",
+                    scan.open_ms(), scan.first_points_ms());
+        ImGui::Text("Resident %d blocks, %.1f M points, %.1f MB (+%.1f MB staged); loading %d",
+                    int(scan.resident_blocks()), scan.resident_points() / 1e6,
+                    scan.resident_bytes() / 1048576.0, scan.staged_bytes() / 1048576.0, int(scan.loading()));
+        ImGui::Text("Visible %d blocks, cache hit rate %.0f%%", int(scan.visible_blocks()), scan.hit_rate() * 100.f);
+    }
+
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    scan.render((int)avail.x, (int)avail.y);
+    ImGui::Image((void *)(intptr_t)scan.get_gl_handle(), avail, ImVec2(0, 1), ImVec2(1, 0));
+    update_pc_state(scan.view);
+}
+
+void RSScanner::start_collect()
+{
+    stop_collect();
+    integrated.clear();
+    integrated.set_memory_budget(size_t(memory_budget_mb) * 1024 * 1024);
+    keyframes.reset();
+    frames_gated = 0;
+    gate_saved_ms = 0;
+    // the merge task is the only writer, and it is not running
+    model.publish(nullptr);
+    model_renderer.clear();
+    is_collecting = true;
+}
+
+bool RSScanner::collect_frame(const rs2::frame& depth)
+{
+    if (!gate_keyframes)
+        return true;
+    stopwatch timer;
+    rs2::video_frame image = depth.as<rs2::video_frame>();
+    rs2_intrinsics i = image.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+    depth_intrinsics intrin = { i.width, i.height, i.fx, i.fy, i.ppx, i.ppy };
+    last_motion = keyframes.update(static_cast<const uint16_t*>(image.get_data()), image.get_stride_in_bytes(),
+                                   intrin, depth.as<rs2::depth_frame>().get_units());
+    double ms = timer.elapsed_ms();
+    gate_ms = gate_ms ? gate_ms * 0.9 + ms * 0.1 : ms;
+    return last_motion.keyframe;
+}
+
+void RSScanner::collect(const rs2::video_frame& color)
+{
+    // a cloud neither in the hand over nor read by the merge task is
+    // refilled, its mask keeping its storage: after the first frames,
+    // collecting one does not allocate
+    std::shared_ptr<captured_cloud> capture;
+    for (const auto& c : captures)
+        if (c.use_count() == 1)
+        {
+            // the merge task is done reading it
+            std::atomic_thread_fence(std::memory_order_acquire);
+            capture = c;
+            break;
+        }
+    if (!capture)
+    {
+        capture = std::make_shared<captured_cloud>();
+        captures.push_back(capture);
+    }
+    capture->points = points;
+    capture->color = color;
+    const uint8_t* removed = removed_points();
+    if (removed)
+        capture->removed.assign(removed, removed + points.size());
+    else
+        capture->removed.clear();
+    to_integrate.publish(std::move(capture));
+    // one merge task at a time, taking every frame published until it ends
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!integrating.exchange(true))
+        task_scheduler::shared().spawn([this]() { integrate(); }, integration, task_low);
+}
+
+void RSScanner::stop_collect()
+{
+    is_collecting = false;
+    task_scheduler::shared().wait(integration);
+    captures.clear();
+}
+
+void RSScanner::integrate()
+{
+    for (;;)
+    {
+        while (to_integrate.has_new())
+        {
+            stopwatch timer;
+            const captured_cloud& frame = *to_integrate.latest();
+            colored_points(frame.points, frame.color, merge_positions, merge_colors,
+                           frame.removed.empty() ? nullptr : frame.removed.data());
+            integrated.add(merge_positions.data(), merge_colors.data(), merge_positions.size());
+            model.publish(integrated.take_version(system_time_ms()));
+            integrate_us = uint64_t(timer.elapsed_ms() * 1000.0);
+        }
+        // a frame published before the flag is down is ours still
+        integrating = false;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!to_integrate.has_new() || integrating.exchange(true))
+            return;
+    }
+}
+
+void RSScanner::render_model()
+{
+    const std::shared_ptr<const scene>& s = model.latest();
+    if (!s)
+    {
+        ImGui::Text("Press Collect to accumulate a model");
+        return;
+    }
+    ImGui::Text("%.2f M points, version %llu, %.0f ms old", s->points / 1e6,
+                (unsigned long long)s->version, system_time_ms() - s->published_ms);
+    ImGui::SameLine();
+    if (ImGui::Button("Save"))
+        save_model();
+    if (!model_status.empty())
+        ImGui::TextDisabled("%s", model_status.c_str());
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    model_renderer.render(*s, (int)avail.x, (int)avail.y);
+    ImGui::Image((void *)(intptr_t)model_renderer.get_gl_handle(), avail, ImVec2(0, 1), ImVec2(1, 0));
+    update_pc_state(model_renderer.view);
+}
+
+void RSScanner::clean_points(const rs2::points& points, const rs2::frame& depth)
+{
+    // rs2::vertex is three packed floats, like float3
+    const float3* xyz = reinterpret_cast<const float3*>(points.get_vertices());
+    size_t n = points.size();
+    hidden_points.clear();
+    point_labels.clear();
+
+    if (find_planes)
+    {
+        stopwatch timer;
+        segment_planes(xyz, n, plane_opts, planes, point_labels, &plane_timing);
+        double ms = timer.elapsed_ms();
+        planes_ms = planes_ms ? planes_ms * 0.9 + ms * 0.1 : ms;
+        if (remove_planes)
+            hidden_points = point_labels;
+    }
+
+    if (filter_outliers)
+    {
+        stopwatch timer;
+        if (hidden_points.empty())
+            hidden_points.assign(n, 0);
+        // the cloud keeps the layout of the depth image it was computed from
+        rs2::video_frame image = depth.as<rs2::video_frame>();
+        if (image && size_t(image.get_width()) * image.get_height() == n)
+            outliers_found = remove_outliers_organized(xyz, image.get_width(), image.get_height(),
+                                                       outlier_opts, hidden_points.data());
+        else
+            outliers_found = remove_outliers(xyz, n, outlier_opts, hidden_points.data());
+        double ms = timer.elapsed_ms();
+        outliers_ms = outliers_ms ? outliers_ms * 0.9 + ms * 0.1 : ms;
+    }
+}
+
+const uint8_t* RSScanner::removed_points() const
+{
+    return hidden_points.empty() ? nullptr : hidden_points.data();
+}
+
+void RSScanner::render_planes()
+{
+    ImGui::Checkbox("Find planes", &find_planes);
+    ImGui::SameLine();
+    ImGui::Checkbox("Remove", &remove_planes);
+    float threshold_mm = plane_opts.threshold * 1000.f;
+    int max_planes = int(plane_opts.max_planes);
+    ImGui::PushItemWidth(120.f);
+    if (ImGui::SliderFloat("Distance mm", &threshold_mm, 2.f, 50.f, "%.0f"))
+        plane_opts.threshold = threshold_mm / 1000.f;
+    ImGui::SameLine();
+    if (ImGui::SliderInt("Planes", &max_planes, 1, 8))
+        plane_opts.max_planes = size_t(max_planes);
+    ImGui::PopItemWidth();
+    if (!find_planes)
+        return;
+    ImGui::Text("%.2f ms (smoothed): sample %.2f, RANSAC %.2f (%d hypotheses), refine %.2f",
+                planes_ms, plane_timing.sample_ms, plane_timing.ransac_ms,
+                int(plane_timing.hypotheses), plane_timing.refine_ms);
+    for (size_t i = 0; i < planes.size(); i++)
+        ImGui::Text("Plane %d: normal (%.2f, %.2f, %.2f), %.2f m away, %d points", int(i + 1),
+                    planes[i].normal.x, planes[i].normal.y, planes[i].normal.z,
+                    std::fabs(planes[i].d), int(planes[i].inliers));
+}
+
+void RSScanner::render_outliers()
+{
+    static const char* filters[] = { "Statistical", "Radius" };
+    ImGui::Checkbox("Remove outliers", &filter_outliers);
+    ImGui::SameLine();
+    int filter = outlier_opts.filter == outlier_radius ? 1 : 0;
+    ImGui::PushItemWidth(120.f);
+    if (ImGui::Combo("##filter", &filter, filters, 2))
+        outlier_opts.filter = filter ? outlier_radius : outlier_statistical;
+    if (outlier_opts.filter == outlier_statistical)
+    {
+        ImGui::SliderInt("Neighbours", &outlier_opts.k, 2, 24);
+        ImGui::SameLine();
+        ImGui::SliderFloat("Std ratio", &outlier_opts.std_ratio, 0.5f, 4.f, "%.1f");
+    }
+    else
+    {
+        float radius_mm = outlier_opts.radius * 1000.f;
+        if (ImGui::SliderFloat("Radius mm", &radius_mm, 2.f, 100.f, "%.0f"))
+            outlier_opts.radius = radius_mm / 1000.f;
+        ImGui::SameLine();
+        ImGui::SliderInt("Min neighbours", &outlier_opts.min_neighbors, 1, 24);
+    }
+    ImGui::SliderInt("Window", &outlier_opts.window, 1, 7);
+    ImGui::PopItemWidth();
+    if (filter_outliers)
+        ImGui::Text("%d outliers in the last frame, %.2f ms (smoothed)", int(outliers_found), outliers_ms);
+}
+
+void RSScanner::save_model()
+{
+    const std::shared_ptr<const scene>& s = model.latest();
+    if (!s)
+        return;
+    try
+    {
+        size_t removed = save_scene(scan_path, *s, filter_outliers ? &outlier_opts : nullptr);
+        model_status = std::string("saved ") + scan_path;
+        if (filter_outliers)
+            model_status += ", " + std::to_string(removed) + " outliers removed";
+    }
+    catch (const std::exception& e)
+    {
+        model_status = e.what();
+    }
+}
+
+namespace
+{
+    // Average and worst time spent on one side of a snapshot
+    void stall_text(const char* label, uint64_t total_ns, uint64_t calls, uint64_t max_ns)
+    {
+        ImGui::Text("%s: avg %.2f us, max %.1f us", label,
+                    total_ns / 1000.0 / std::max<uint64_t>(calls, 1), max_ns / 1000.0);
+    }
+}
+
+void RSScanner::render_accumulation()
+{
+    const snapshot_stats& in = to_integrate.get_stats();
+    const snapshot_stats& out = model.get_stats();
+    ImGui::Text("Integrating %.2f ms / frame, %llu of %llu frames",
+                integrate_us.load() / 1000.0, (unsigned long long)in.taken.load(),
+                (unsigned long long)in.published.load());
+    ImGui::Text("Versions: %llu published, %llu drawn",
+                (unsigned long long)out.published.load(), (unsigned long long)out.taken.load());
+    stall_text("Frame publish", in.publish_ns, in.published, in.publish_max_ns);
+    stall_text("Frame take", in.latest_ns, in.reads, in.latest_max_ns);
+    stall_text("Version publish", out.publish_ns, out.published, out.publish_max_ns);
+    stall_text("Version take", out.latest_ns, out.reads, out.latest_max_ns);
+
+    ImGui::Checkbox("Keyframes only", &gate_keyframes);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Skip the frames that barely moved since the last one collected. Unless\n"
+                          "the cloud is published, they are not processed either, and the preview\n"
+                          "shows the last frame collected meanwhile");
+    if (gate_keyframes)
+    {
+        keyframe_options& o = keyframes.options;
+        ImGui::SliderFloat("Max translation", &o.max_translation, 0.005f, 0.2f, "%.3f m");
+        ImGui::SliderFloat("Max rotation", &o.max_rotation, 0.5f, 10.f, "%.1f deg");
+        ImGui::SliderFloat("Min overlap", &o.min_overlap, 0.5f, 1.f, "%.2f");
+        ImGui::Text("Skipped %.0f%% of %llu frames, gate %.2f ms (smoothed)", keyframes.skipped() * 100.0,
+                    (unsigned long long)keyframes.frames(), gate_ms);
+        ImGui::Text("Not processed: %llu frames, about %.0f ms of CPU at %.2f ms a frame",
+                    (unsigned long long)frames_gated, gate_saved_ms, cloud_ms);
+        ImGui::Text("Last frame: %.2f deg, %.1f cm, %.0f%% overlap", last_motion.rotation,
+                    last_motion.translation * 100.f, last_motion.overlap * 100.f);
+    }
+
+    ImGui::SliderInt("Memory budget (MB)", &memory_budget_mb, 0, 4096);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("0 for unlimited. Applied at the next Collect: past it, parts of the model\n"
+                          "away from the camera go to a scratch file");
+    const std::shared_ptr<const scene>& s = model.latest();
+    if (s && s->memory.budget)
+    {
+        const accumulator_memory& m = s->memory;
+        ImGui::Text("Memory: %.1f MB resident, %.1f MB spilled, scratch file %.1f MB", m.resident_bytes / 1048576.0,
+                    m.spilled_bytes / 1048576.0, m.scratch_bytes / 1048576.0);
+        ImGui::Text("Spilled %d index blocks, %d chunks; %llu page-ins, %.3f ms avg, %.3f ms max",
+                    int(m.spilled_blocks), int(m.spilled_chunks), (unsigned long long)m.page_ins,
+                    m.page_in_ms, m.max_page_in_ms);
+    }
+}
+
+void RSScanner::render_profiler()
+{
+    alloc_frame_stats allocs = alloc_last_frame();
+    frame_arena& arena = frame_arena::frame();
+    ImGui::Text("Heap: %d allocs, %.1f KB / frame", int(allocs.count), allocs.bytes / 1024.f);
+    ImGui::Text("Frame arena: %.1f / %.1f KB (peak %.1f KB)",
+                arena.used() / 1024.f, arena.capacity() / 1024.f, arena.high_water() / 1024.f);
+    GLState::Counts calls = GLState::lastFrame();
+    ImGui::Text("GL state: %u calls, %u elided / frame", calls.issued, calls.elided);
+    gl_frame_stats gl = gl_last_frame();
+    bool counting = gl_counting();
+    if (ImGui::Checkbox("Count draws and uploads", &counting))
+        gl_set_counting(counting);
+    if (counting)
+        ImGui::Text("GL: %u draws, %.1f KB uploaded / frame", gl.draws, gl.upload_bytes / 1024.f);
+    ImGui::Text("Views: %u drawn, %u unchanged / frame, %.2f M points uploaded", views.drawn(), views.kept(),
+                views.points() / 1e6);
+    scheduler_stats tasks = task_scheduler::shared().stats();
+    double busy = 0.0;
+    for (double u : tasks.utilization)
+        busy += u;
+    ImGui::Text("Tasks: %u workers %.0f%% busy, %llu tasks, %llu steals", tasks.workers,
+                busy * 100.0 / std::max(tasks.workers, 1u), (unsigned long long)tasks.tasks,
+                (unsigned long long)tasks.steals);
+    if (ImGui::IsItemHovered())
+    {
+        std::string per_worker;
+        for (size_t i = 0; i < tasks.utilization.size(); i++)
+            per_worker += (i ? ", " : "") + std::to_string(int(tasks.utilization[i] * 100.0 + 0.5)) + "%";
+        ImGui::SetTooltip("Busy since the last frame: %s", per_worker.c_str());
+    }
+    const StartupTimes& startup = getStartupTimes();
+    ImGui::Text("Startup: first frame at %.0f ms, %s", startup.firstFrameMs, startup.fontCached ? "warm" : "cold");
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Window and GL %.0f ms, font atlas %.1f ms %s, %.1f ms of it waited for",
+                          startup.windowMs, startup.fontMs,
+                          startup.fontCached ? "from the cache" : "rasterized", startup.fontWaitMs);
+    if (!gl_debug_active())
+        ImGui::TextDisabled("GL debug output off");
+    else if (gl.errors || gl.warnings)
+        ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "GL debug: %u errors, %u warnings (see stderr)",
+                           gl.errors, gl.warnings);
+    else
+        ImGui::Text("GL debug: no errors");
+    const cloud_kernels& kernels = active_kernels();
+    ImGui::Text("SIMD: %s of %s%s", simd_name(simd_active()), simd_name(simd_detect()),
+                simd_overridden() ? " (RSSCANNER_SIMD)" : "");
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("deproject %s, compact %s, gather %s, align %s, motion %s, change %s",
+                          simd_name(kernels.deproject_level), simd_name(kernels.compact_level),
+                          simd_name(kernels.gather_level), simd_name(kernels.align_level),
+                          simd_name(kernels.motion_level), simd_name(kernels.change_level));
+}
+
+void RSScanner::publish_cloud(const rs2::video_frame& depth, const rs2::video_frame& color)
+{
+    stopwatch timer;
+    size_t color_bytes = color ? size_t(color.get_width()) * color.get_height() * color.get_bytes_per_pixel() : 0;
+    if (!publisher || publisher->max_points() < points.size() || publisher->max_color_bytes() < color_bytes)
+    {
+        // slots are fixed size, the segment is recreated (and readers have
+        // to reconnect) only when the streams grow past them
+        publisher.reset();
+        try
+        {
+            publisher.reset(new cloud_publisher(cloud_ring_default_name, points.size(), color_bytes));
+            publish_error.clear();
+        }
+        catch (const std::exception& e)
+        {
+            publish_error = e.what();
+            publish = false;
+            return;
+        }
+    }
+
+    cloud_frame_info info = {};
+    info.frame_number = depth.get_frame_number();
+    info.timestamp = depth.get_timestamp();
+    info.width = depth.get_width();
+    info.height = depth.get_height();
+    if (color)
+    {
+        info.color_width = color.get_width();
+        info.color_height = color.get_height();
+        info.color_bpp = color.get_bytes_per_pixel();
+        info.color_stride = color.get_stride_in_bytes();
+    }
+    publisher->publish(reinterpret_cast<const float*>(points.get_vertices()),
+                       reinterpret_cast<const float*>(points.get_texture_coordinates()),
+                       points.size(), color ? color.get_data() : nullptr, info);
+    publish_ms += (timer.elapsed_ms() - publish_ms) * 0.1;
+}
+
+void RSScanner::render_publishing()
+{
+    ImGui::Checkbox("Publish to shared memory", &publish);
+    if (!publish_error.empty())
+        ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%s", publish_error.c_str());
+    if (!publisher)
+        return;
+    ImGui::Text("%s: %llu frames, %.3f ms / frame", cloud_ring_default_name,
+                (unsigned long long)publisher->published(), publish_ms);
 }
 
 void RSScanner::loop()
@@ -130,6 +916,25 @@ void RSScanner::loop()
     ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
     ImGui::End();
 
+    ImGui::SetNextWindowPos(ImVec2(pos[0] + gut, pos[1] + gut + 50.f), ImGuiCond_Once);
+    ImGui::Begin("Profiler");
+    render_profiler();
+    if (ImGui::CollapsingHeader("Quality", ImGuiTreeNodeFlags_DefaultOpen))
+        render_quality();
+    if (ImGui::CollapsingHeader("Latency", ImGuiTreeNodeFlags_DefaultOpen))
+        render_latency();
+    if (ImGui::CollapsingHeader("Static scene", ImGuiTreeNodeFlags_DefaultOpen))
+        render_static();
+    if (ImGui::CollapsingHeader("Publishing"))
+        render_publishing();
+    if (ImGui::CollapsingHeader("Accumulation"))
+        render_accumulation();
+    if (ImGui::CollapsingHeader("Planes"))
+        render_planes();
+    if (ImGui::CollapsingHeader("Outliers"))
+        render_outliers();
+    ImGui::End();
+
     // Render ImGui controls
     auto size = ImGui::GetWindowSize();
     ImGui::SetNextWindowPos(ImVec2(pos[0] + size[0] + gut, pos[1] + gut), ImGuiCond_Always);
@@ -149,6 +954,37 @@ void RSScanner::loop()
             start_preview();
         }
     }
+    ImGui::Checkbox("Streams", &show_streams);
+    ImGui::SameLine();
+    ImGui::Checkbox("Depth", &show_depth);
+    ImGui::SameLine();
+    ImGui::Checkbox("Scan", &show_scan);
+    for (size_t i = 0; i < views.views.size(); i++)
+    {
+        if (i)
+            ImGui::SameLine();
+        ImGui::Checkbox(views.views[i]->name.c_str(), &views.views[i]->open);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Add view"))
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "View %u", ++views_added);
+        live_views::view& v = views.add_view(name);
+        v.state.point_size = pcv.point_size;
+        v.open = true;
+    }
+    if (is_collecting ? ImGui::Button("Stop collecting") : ImGui::Button("Collect"))
+    {
+        if (is_collecting)
+            stop_collect();
+        else
+            start_collect();
+        show_model = show_model || is_collecting;
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Model", &show_model);
+    draw_measure_panel(measure);
     ImGui::End();
 
     if (is_previewing) {
@@ -159,7 +995,57 @@ void RSScanner::loop()
         float h = 480.f;
         ImGui::SetNextWindowSize(ImVec2(w, h), ImGuiCond_Once);
         ImGui::Begin("Preview");
-        render_pointcloud(w, h);
+        render_pointcloud();
+        ImGui::End();
+    }
+
+    if (is_previewing) {
+        const live_views::view* closed = nullptr;
+        for (size_t i = 0; i < views.views.size(); i++)
+        {
+            live_views::view& v = *views.views[i];
+            if (!v.open)
+                continue;
+            ImGui::SetNextWindowSize(ImVec2(480.f, 360.f), ImGuiCond_Once);
+            // collapsed or clipped windows skip their draw
+            if (ImGui::Begin(v.name.c_str(), &v.open))
+                render_view(v);
+            ImGui::End();
+            // the views added from the panel go away with their window
+            if (!v.open && i >= default_views)
+                closed = &v;
+        }
+        if (closed)
+            views.remove_view(*closed);
+    }
+    views.end_frame();
+
+    if (is_previewing && show_streams) {
+        ImGui::SetNextWindowSize(ImVec2(640.f, 360.f), ImGuiCond_Once);
+        ImGui::Begin("Streams", &show_streams);
+        render_streams();
+        ImGui::Text("%d streams uploaded, %d unchanged", streams.uploads(), streams.skipped());
+        ImGui::End();
+    }
+
+    if (is_previewing && show_depth) {
+        ImGui::SetNextWindowSize(ImVec2(480.f, 320.f), ImGuiCond_Once);
+        ImGui::Begin("Depth", &show_depth);
+        render_depth();
+        ImGui::End();
+    }
+
+    if (show_model) {
+        ImGui::SetNextWindowSize(ImVec2(640.f, 480.f), ImGuiCond_Once);
+        ImGui::Begin("Model", &show_model);
+        render_model();
+        ImGui::End();
+    }
+
+    if (show_scan) {
+        ImGui::SetNextWindowSize(ImVec2(640.f, 480.f), ImGuiCond_Once);
+        ImGui::Begin("Scan", &show_scan);
+        render_scan();
         ImGui::End();
     }
 }
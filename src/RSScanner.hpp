@@ -8,8 +8,57 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
+#include <atomic>
+#include <memory>
+#include <string>
+
 #include "system/Application.hpp"
 #include "pointcloud/preview.hpp"
+#include "pointcloud/measure.hpp"
+#include "pointcloud/streams.hpp"
+#include "pointcloud/scan.hpp"
+#include "pointcloud/model.hpp"
+#include "pointcloud/views.hpp"
+#include "processing/accumulator.hpp"
+#include "processing/change.hpp"
+#include "processing/keyframe.hpp"
+#include "processing/snapshot.hpp"
+#include "processing/planes.hpp"
+#include "processing/outliers.hpp"
+#include "processing/quality.hpp"
+#include "processing/scheduler.hpp"
+#include "utils/latency.hpp"
+#include "ipc/cloud_ring.hpp"
+
+// Times (system clock, ms) one camera frame passed each stage of the app
+struct frame_stamp
+{
+    unsigned long long frame = ~0ull;  // application frame that drew it
+    double sensor = 0;     // sensor timestamp, or arrival time on the host
+    double captured = 0;   // wait_for_frames() returned
+    double processed = 0;  // point cloud calculated
+    double uploaded = 0;   // texture uploaded
+    double drawn = 0;      // draw calls submitted
+};
+
+// What the processed cloud depends on besides the frames: a change sends the
+// next frame through the stages even when the scene did not change
+struct cloud_settings
+{
+    bool find_planes = false, remove_planes = false, filter_outliers = false;
+    plane_options planes;
+    outlier_options outliers;
+    size_t point_budget = 0;
+    bool publish = false, collecting = false, measuring = false;
+};
+
+// Camera frame handed from the render loop to the merge task
+struct captured_cloud
+{
+    rs2::points points;
+    rs2::video_frame color;
+    std::vector<uint8_t> removed;  // per point, nonzero to leave out, may be empty
+};
 
 /// \class RSScanner
 //  Initialize the RealSense Scanner app
@@ -17,31 +66,135 @@ class RSScanner : public Application
 {
     public:
         RSScanner();
+        ~RSScanner();
 
     protected:
         virtual void loop();
+        virtual void frameCompleted(unsigned long long frame, double swapTime, double doneTime);
 
         // init point cloud view
         void init_pcview();
 
         void start_preview();
         void stop_preview();
-        void render_pointcloud(float w, float h);
+        void apply_quality();
+        void render_quality();
+        void render_latency();
+        void render_pointcloud();
+        void render_view(live_views::view& v);
+        void render_streams();
+        void render_depth();
+        void render_scan();
+        void render_profiler();
+        void detect_changes(const rs2::frame& depth, const rs2::video_frame& color,
+                            bool& depth_changed, bool& color_changed);
+        cloud_settings current_cloud_settings() const;
+        void render_static();
+        void publish_cloud(const rs2::video_frame& depth, const rs2::video_frame& color);
+        void render_publishing();
 
         void start_collect();
-        void collect();
+        bool collect_frame(const rs2::frame& depth);  // whether the keyframe gate lets the frame in
+        void collect(const rs2::video_frame& color);
         void stop_collect();
+        void integrate();
+        void render_model();
+        void render_accumulation();
+        void clean_points(const rs2::points& points, const rs2::frame& depth);
+        const uint8_t* removed_points() const;
+        void render_planes();
+        void render_outliers();
+        void save_model();
 
     private:
         float time = 0.f;
         bool is_previewing = true;   // live previewing the point cloud
         bool is_collecting = false;  // collecting the stream and output a model
         bool device_ready = false;   // check whether device is ready
+        bool show_streams = false;   // show all raw streams next to the point cloud
+        bool show_depth = false;     // show the colorized depth stream
+        bool show_scan = false;      // show the scan file viewer
+        bool show_model = false;     // show the accumulated model
 
         pcview_state pcv;  // point cloud view state
+        live_views views;  // upload of the live cloud, and extra cameras on it
+        static const size_t default_views = 3;  // top, front and free, kept when closed
+        unsigned views_added = 0;  // views added from the panel, for their names
+        measure_state measure;  // point picking and measurement overlay
+        stream_grid streams;  // tiled view of the raw streams
+        texture depth_tex;  // colorized depth stream
+        scan_view scan;  // point cloud file being viewed
+        char scan_path[256] = "scan.rsc";
+        std::string scan_status;  // result of the last open or save
+        rs2::frameset frames;  // last frames received from the pipeline
+        task_graph stages;  // of the frame, refilled every frame
+
+        quality_controller quality;  // adapts the settings below to the frame time
+        rs2::decimation_filter decimate;  // depth decimation, magnitude set by quality
+        int stream_profile = 0;  // camera profile the pipeline runs with
+
+        frame_stamp stamps[8];  // recent frames by application frame index
+        bool stamp_from_arrival = false;  // no host-comparable sensor clock
+        latency_histogram motion_to_photon;
+        double stage_ms[6] = {};  // smoothed time between consecutive stamps
+
+        bool publish = false;  // share each cloud with local processes
+        std::unique_ptr<cloud_publisher> publisher;
+        std::string publish_error;  // why the segment could not be created
+        double publish_ms = 0;  // smoothed cost of publishing a frame
+
+        // Accumulation runs in a low priority task. Frames go to it and model
+        // versions come back through snapshots, so neither side waits.
+        snapshot<captured_cloud> to_integrate;
+        std::vector<std::shared_ptr<captured_cloud>> captures;  // refilled by collect() once the merge task let go
+        snapshot<scene> model;
+        accumulator integrated;  // used by the merge task only
+        std::vector<float3> merge_positions;
+        std::vector<uint32_t> merge_colors;
+        task_counter integration;
+        std::atomic<bool> integrating{ false };  // a merge task is queued or running
+        std::atomic<uint64_t> integrate_us{ 0 };  // last frame merged into the model
+        int memory_budget_mb = 0;  // of the accumulator, 0 for unlimited; applied at the next Collect
+        bool gate_keyframes = true;  // collect only the frames that moved away from the last one collected
+        keyframe_gate keyframes;
+        frame_motion last_motion;
+        double gate_ms = 0;          // smoothed cost of gating a frame
+        uint64_t frames_gated = 0;   // turned down by the gate and not processed, since Collect
+        double gate_saved_ms = 0;    // the processing they would have cost, at cloud_ms each
+        scene_renderer model_renderer;
+
+        bool find_planes = false;    // segment the dominant planes of each frame
+        bool remove_planes = true;   // leave them out of display, export and the model, or only tint them
+        plane_options plane_opts;
+        std::vector<plane> planes;   // found in the last frame
+        std::vector<uint8_t> point_labels;  // plane of each point of the last frame, 0 for none
+        plane_stats plane_timing;
+        double planes_ms = 0;        // smoothed cost of segmenting a frame
+
+        bool filter_outliers = false;  // drop flying pixels from display, export and the model
+        outlier_options outlier_opts;
+        size_t outliers_found = 0;   // in the last frame
+        double outliers_ms = 0;      // smoothed cost of filtering a frame
+        std::vector<uint8_t> hidden_points;  // per point of the last frame, nonzero when removed
+        std::string model_status;    // result of the last model save
         rs2::pipeline pipe;  // RealSense pipeline, encapsulating the actual device and sensors
         rs2::pointcloud pc;  // for calculating pointclouds and texture mappings
         rs2::points points;   // last obtained points
+
+        // Frames whose tiles all match those last processed reuse the cloud,
+        // its stages and the color texture; changed color tiles alone are
+        // uploaded
+        bool reuse_static = true;
+        float change_depth_mm = 5.f;    // mean change of a depth tile that counts
+        float change_color = 6.f;       // of a color tile, per byte
+        tile_changes depth_changes, color_changes;
+        cloud_settings processed_settings;   // of `points`
+        unsigned long long cloud_frame = ~0ull;  // depth frame `points` was calculated from
+        double cloud_sensor = 0, cloud_captured = 0;  // its frame_stamp times
+        uint64_t frames_seen = 0, frames_reused = 0;
+        double cloud_ms = 0;  // smoothed cost of processing a frame into the cloud
+        double tiles_reused = 0;        // smoothed share of the depth and color tiles
+        double change_ms = 0;           // smoothed cost of detecting the changes
 };
 
 #endif /* end of include guard:RSSCANNER_HEAD */
@@ -0,0 +1,422 @@
+/**
+ * batch.cpp
+ */
+
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <librealsense2/rs.hpp>
+
+#include "pointcloud/model.hpp"
+#include "pointcloud/scan.hpp"
+#include "processing/accumulator.hpp"
+#include "processing/align.hpp"
+#include "processing/parallel.hpp"
+#include "utils/stopwatch.hpp"
+
+using namespace std;
+
+namespace
+{
+    /// \class bounded_queue
+    /// Hand over between pipeline stages. push() blocks while full, so a
+    /// fast stage cannot run ahead of a slow one and pile up frames.
+    template <class T>
+    class bounded_queue
+    {
+        public:
+            explicit bounded_queue(size_t capacity) : capacity(capacity) {}
+
+            void push(T item)
+            {
+                unique_lock<mutex> lock(m);
+                not_full.wait(lock, [&]() { return items.size() < capacity; });
+                items.push_back(std::move(item));
+                not_empty.notify_one();
+            }
+
+            // false once closed and drained
+            bool pop(T& item)
+            {
+                unique_lock<mutex> lock(m);
+                not_empty.wait(lock, [&]() { return !items.empty() || closed; });
+                if (items.empty())
+                    return false;
+                item = std::move(items.front());
+                items.pop_front();
+                not_full.notify_one();
+                return true;
+            }
+
+            void close()
+            {
+                lock_guard<mutex> lock(m);
+                closed = true;
+                not_empty.notify_all();
+            }
+
+        private:
+            mutex m;
+            condition_variable not_empty, not_full;
+            deque<T> items;
+            size_t capacity;
+            bool closed = false;
+    };
+
+    struct decoded_frame
+    {
+        uint64_t seq;
+        rs2::frameset frames;
+    };
+
+    struct processed_frame
+    {
+        uint64_t seq;
+        size_t input_points;
+        vector<float3> positions;
+        vector<uint32_t> colors;
+    };
+
+    // Busy time of one stage, summed over its threads
+    struct stage_time
+    {
+        atomic<uint64_t> us{ 0 };
+        atomic<uint64_t> items{ 0 };
+
+        void add(double ms)
+        {
+            us.fetch_add(uint64_t(ms * 1000.0));
+            items.fetch_add(1);
+        }
+
+        void print(const char* name, unsigned threads, double wall_ms) const
+        {
+            double ms = us.load() / 1000.0;
+            uint64_t n = items.load();
+            printf("  %-8s %9.1f ms busy, %7.2f ms / item, %3.0f%% of %u thread%s\n", name, ms,
+                   n ? ms / n : 0.0, wall_ms > 0 ? 100.0 * ms / (wall_ms * threads) : 0.0,
+                   threads, threads > 1 ? "s" : "");
+        }
+    };
+
+    depth_intrinsics intrinsics_of(const rs2::video_frame& frame)
+    {
+        rs2_intrinsics i = frame.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+        return depth_intrinsics{ i.width, i.height, i.fx, i.fy, i.ppx, i.ppy };
+    }
+}
+
+bool is_batch_command(int argc, const char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--batch") == 0)
+            return true;
+    return false;
+}
+
+const char* batch_usage()
+{
+    return "usage: RealSenseScanner --batch input.bag --out scan.ply|scan.rsc [options]\n"
+           "  --threads N        processing threads (default: one per core)\n"
+           "  --voxel M          accumulation voxel size in meters (default 0.005)\n"
+           "  --memory-budget MB keep the model within MB megabytes, the rest in a scratch file\n"
+           "  --decimate N       depth decimation factor (default 1)\n"
+           "  --align            register depth to the color camera, one point per color pixel\n"
+           "                     (needs an RGB8 or RGBA8 color stream)\n"
+           "  --planes N         remove up to N dominant planes\n"
+           "  --outliers KIND    remove outliers, KIND is radius or statistical\n";
+}
+
+bool parse_batch_command(int argc, const char* argv[], batch_options& options, string& error)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--align")
+        {
+            options.align = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg != "--batch" && arg != "--out" && arg != "--threads" && arg != "--voxel" &&
+            arg != "--memory-budget" && arg != "--decimate" && arg != "--planes" && arg != "--outliers")
+        {
+            error = "unknown argument " + arg;
+            return false;
+        }
+        if (!value)
+        {
+            error = arg + " needs a value";
+            return false;
+        }
+        i++;
+        if (arg == "--batch")
+            options.input = value;
+        else if (arg == "--out")
+            options.output = value;
+        else if (arg == "--threads")
+            options.threads = unsigned(max(0, atoi(value)));
+        else if (arg == "--voxel")
+            options.voxel = float(atof(value));
+        else if (arg == "--memory-budget")
+            options.memory_budget = size_t(max(0.0, atof(value)) * 1024 * 1024);
+        else if (arg == "--decimate")
+            options.decimation = max(1, atoi(value));
+        else if (arg == "--planes")
+        {
+            options.find_planes = atoi(value) > 0;
+            options.planes.max_planes = size_t(max(0, atoi(value)));
+        }
+        else if (strcmp(value, "radius") == 0 || strcmp(value, "statistical") == 0)
+        {
+            options.filter_outliers = true;
+            options.outliers.filter = strcmp(value, "radius") == 0 ? outlier_radius : outlier_statistical;
+        }
+        else
+        {
+            error = string("unknown outlier filter ") + value;
+            return false;
+        }
+    }
+    if (options.input.empty() || options.output.empty())
+    {
+        error = "--batch and --out are required";
+        return false;
+    }
+    if (!(options.voxel > 0.f))
+    {
+        error = "--voxel must be positive";
+        return false;
+    }
+    return true;
+}
+
+int run_batch(const batch_options& options)
+{
+    unsigned workers = options.threads ? options.threads : hardware_threads();
+    bounded_queue<decoded_frame> to_process(workers * 2);
+    bounded_queue<processed_frame> to_write(workers * 2);
+    stage_time decode_time, process_time, write_time;
+    atomic<bool> failed{ false };
+    string failure;
+    mutex failure_lock;
+    auto fail = [&](const exception& e)
+    {
+        lock_guard<mutex> lock(failure_lock);
+        if (!failed.exchange(true))
+            failure = e.what();
+    };
+
+    stopwatch wall;
+
+    // decode: replay the recording as fast as it is consumed
+    thread decoder([&]()
+    {
+        try
+        {
+            rs2::config cfg;
+            cfg.enable_device_from_file(options.input, false);
+            rs2::pipeline pipe;
+            rs2::pipeline_profile profile = pipe.start(cfg);
+            profile.get_device().as<rs2::playback>().set_real_time(false);
+            uint64_t seq = 0;
+            rs2::frameset frames;
+            stopwatch timer;
+            while (!failed && pipe.try_wait_for_frames(&frames, 1000))
+            {
+                frames.keep();  // held past the next wait by the workers
+                decode_time.add(timer.lap_ms());
+                to_process.push(decoded_frame{ seq++, frames });
+                timer.lap_ms();
+            }
+            pipe.stop();
+        }
+        catch (const exception& e)
+        {
+            fail(e);
+        }
+        to_process.close();
+    });
+
+    // process: deprojection, texture mapping and cleanup, one frame per worker
+    vector<thread> processors;
+    atomic<unsigned> running{ workers };
+    for (unsigned w = 0; w < workers; w++)
+        processors.emplace_back([&]()
+        {
+            rs2::pointcloud pc;
+            rs2::decimation_filter decimate;
+            rgbd_aligner aligner;
+            rgbd_frame rgbd;
+            vector<float3> aligned;
+            vector<uint32_t> aligned_colors;
+            vector<plane> planes;
+            vector<uint8_t> removed;
+            decoded_frame in;
+            try
+            {
+                if (options.decimation > 1)
+                    decimate.set_option(RS2_OPTION_FILTER_MAGNITUDE, float(options.decimation));
+                while (to_process.pop(in))
+                {
+                    stopwatch timer;
+                    processed_frame out;
+                    out.seq = in.seq;
+                    out.input_points = 0;
+                    rs2::frame depth = in.frames.get_depth_frame();
+                    if (depth)
+                    {
+                        if (options.decimation > 1)
+                            depth = decimate.process(depth);
+                        rs2::video_frame image = depth.as<rs2::video_frame>();
+                        rs2::video_frame color = in.frames.get_color_frame();
+                        rs2::points points;
+                        const float3* xyz;
+                        int width, height;
+                        if (options.align)
+                        {
+                            rs2_format format = color ? color.get_profile().format() : RS2_FORMAT_ANY;
+                            if (format != RS2_FORMAT_RGB8 && format != RS2_FORMAT_RGBA8)
+                                throw runtime_error("--align needs an RGB8 or RGBA8 color stream");
+                            rs2_extrinsics e = image.get_profile().get_extrinsics_to(color.get_profile());
+                            camera_extrinsics depth_to_color;
+                            memcpy(depth_to_color.rotation, e.rotation, sizeof(e.rotation));
+                            memcpy(depth_to_color.translation, e.translation, sizeof(e.translation));
+                            depth_intrinsics color_intrin = intrinsics_of(color);
+                            aligner.align(static_cast<const uint16_t*>(image.get_data()), image.get_stride_in_bytes(),
+                                          intrinsics_of(image), depth.as<rs2::depth_frame>().get_units(),
+                                          static_cast<const uint8_t*>(color.get_data()), color.get_stride_in_bytes(),
+                                          color.get_bytes_per_pixel(), color_intrin, depth_to_color, rgbd);
+                            aligned.resize(rgbd.pixels.size());
+                            aligned_colors.resize(rgbd.pixels.size());
+                            rgbd_points(rgbd, color_intrin, aligned.data(), aligned_colors.data());
+                            xyz = aligned.data();
+                            out.input_points = aligned.size();
+                            width = rgbd.width;
+                            height = rgbd.height;
+                        }
+                        else
+                        {
+                            if (!color)
+                                color = in.frames.get_infrared_frame();
+                            if (color)
+                                pc.map_to(color);
+                            points = pc.calculate(depth);
+                            xyz = reinterpret_cast<const float3*>(points.get_vertices());
+                            out.input_points = points.size();
+                            width = image.get_width();
+                            height = image.get_height();
+                        }
+
+                        removed.assign(out.input_points, 0);
+                        if (options.find_planes)
+                            segment_planes(xyz, out.input_points, options.planes, planes, removed);
+                        if (options.filter_outliers)
+                            remove_outliers_organized(xyz, width, height, options.outliers, removed.data());
+                        if (options.align)
+                        {
+                            out.positions.resize(aligned.size());
+                            out.colors.resize(aligned.size());
+                            size_t kept = compact_points(xyz, aligned_colors.data(), removed.data(), aligned.size(),
+                                                         out.positions.data(), out.colors.data());
+                            out.positions.resize(kept);
+                            out.colors.resize(kept);
+                        }
+                        else
+                            colored_points(points, color, out.positions, out.colors, removed.data());
+                    }
+                    in = decoded_frame();  // give the frames back to the decoder
+                    process_time.add(timer.elapsed_ms());
+                    to_write.push(std::move(out));
+                }
+            }
+            catch (const exception& e)
+            {
+                fail(e);
+                // keep draining, the decoder may be blocked on a full queue
+                while (to_process.pop(in))
+                    ;
+            }
+            if (--running == 0)
+                to_write.close();
+        });
+
+    // write: merge frames into the model in recording order
+    accumulator model(options.voxel);
+    model.set_memory_budget(options.memory_budget);
+    map<uint64_t, processed_frame> pending;
+    uint64_t next = 0;
+    size_t frames_in = 0, points_in = 0;
+    processed_frame out;
+    while (to_write.pop(out))
+    {
+        uint64_t seq = out.seq;
+        pending[seq] = std::move(out);
+        for (auto it = pending.begin(); it != pending.end() && it->first == next; it = pending.erase(it), next++)
+        {
+            stopwatch timer;
+            processed_frame& f = it->second;
+            model.add(f.positions.data(), f.colors.data(), f.positions.size());
+            frames_in++;
+            points_in += f.input_points;
+            write_time.add(timer.elapsed_ms());
+        }
+    }
+    decoder.join();
+    for (thread& t : processors)
+        t.join();
+    double process_ms = wall.elapsed_ms();
+
+    if (failed)
+    {
+        fprintf(stderr, "%s\n", failure.c_str());
+        return 1;
+    }
+
+    stopwatch save_timer;
+    try
+    {
+        // streamed chunk by chunk, spilled ones read back one at a time
+        shared_ptr<const scene> s = model.take_version(system_time_ms());
+        save_scene(options.output, *s, nullptr);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    double save_ms = save_timer.elapsed_ms();
+    double wall_ms = wall.elapsed_ms();
+
+    printf("%llu frames, %.1f M points in, %.2f M points written to %s\n",
+           (unsigned long long)frames_in, points_in / 1e6, model.points() / 1e6, options.output.c_str());
+    printf("%.2f s: %.1f frames/s, %.1f M points/s\n", wall_ms / 1000.0,
+           process_ms > 0 ? frames_in * 1000.0 / process_ms : 0.0,
+           process_ms > 0 ? points_in / 1000.0 / process_ms : 0.0);
+    decode_time.print("decode", 1, process_ms);
+    process_time.print("process", workers, process_ms);
+    write_time.print("merge", 1, process_ms);
+    printf("  %-8s %9.1f ms\n", "save", save_ms);
+    if (options.memory_budget)
+    {
+        accumulator_memory m = model.memory();
+        printf("memory: %.1f MB resident, %.1f MB spilled (%zu blocks, %zu chunks) in a %.1f MB file, "
+               "%llu page-ins of %.3f ms, at most %.3f ms\n",
+               m.resident_bytes / 1048576.0, m.spilled_bytes / 1048576.0, m.spilled_blocks, m.spilled_chunks,
+               m.scratch_bytes / 1048576.0,
+               (unsigned long long)m.page_ins, m.page_in_ms, m.max_page_in_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * batch.hpp
+ * Headless reprocessing of recordings, without a window or GL context.
+ */
+
+#ifndef RSSCANNER_BATCH_H
+#define RSSCANNER_BATCH_H
+
+#include <string>
+
+#include "processing/outliers.hpp"
+#include "processing/planes.hpp"
+
+struct batch_options
+{
+    std::string input;        // .bag recording
+    std::string output;       // .ply, or a point cloud file (.rsc)
+    unsigned threads = 0;     // processing threads, 0 = one per core
+    float voxel = 0.005f;     // accumulation voxel size, meters
+    size_t memory_budget = 0; // accumulation memory, bytes, 0 = unlimited
+    int decimation = 1;       // depth decimation factor
+    bool align = false;       // points from rgbd_aligner, one per color pixel
+    bool find_planes = false; // remove the dominant planes
+    plane_options planes;
+    bool filter_outliers = false;
+    outlier_options outliers;
+};
+
+// Whether the command line asks for batch mode (--batch)
+bool is_batch_command(int argc, const char* argv[]);
+
+// Parse the batch command line; false with `error` set on bad arguments
+bool parse_batch_command(int argc, const char* argv[], batch_options& options, std::string& error);
+
+// Usage text of batch mode
+const char* batch_usage();
+
+/// Replay `options.input` as fast as the cores allow: one thread decodes
+/// frames, `threads` workers deproject and clean them, and a writer merges
+/// them into the model in frame order, saved at the end. Prints throughput
+/// and the time spent in each stage. Returns the process exit code.
+int run_batch(const batch_options& options);
+
+#endif /* end of include guard: RSSCANNER_BATCH_H */
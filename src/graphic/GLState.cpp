@@ -0,0 +1,224 @@
+/**
+ * GLState.cpp
+ */
+
+#include "GLState.hpp"
+
+namespace
+{
+    const GLuint unknown = ~GLuint(0);
+    const int units = 16;
+
+    // targets whose bindings are shadowed, the others always reach GL
+    int textureSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        default: return -1;
+        }
+    }
+
+    int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        default: return -1;   // GL_ELEMENT_ARRAY_BUFFER is vertex array state
+        }
+    }
+
+    int capSlot(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_SCISSOR_TEST: return 3;
+        case GL_PROGRAM_POINT_SIZE: return 4;
+        default: return -1;
+        }
+    }
+
+    struct Shadow
+    {
+        GLuint program;
+        GLuint unit;                 // active texture unit, 0 based
+        GLuint textures[units][2];
+        GLuint vao;
+        GLuint buffers[2];
+        GLuint uniformBases[units];
+        GLuint caps[5];              // 0, 1 or unknown
+
+        void reset()
+        {
+            program = unit = vao = unknown;
+            for (auto& u : textures)
+                u[0] = u[1] = unknown;
+            buffers[0] = buffers[1] = unknown;
+            for (auto& b : uniformBases)
+                b = unknown;
+            for (auto& c : caps)
+                c = unknown;
+        }
+    };
+
+    Shadow shadow = []() { Shadow s; s.reset(); return s; }();
+    GLState::Counts current = { 0, 0 };
+    GLState::Counts last = { 0, 0 };
+
+    // Whether `slot` needs the call, updating it
+    bool change(GLuint& slot, GLuint value)
+    {
+        if (slot == value)
+        {
+            current.elided++;
+            return false;
+        }
+        slot = value;
+        current.issued++;
+        return true;
+    }
+
+    void setCap(GLenum cap, bool on)
+    {
+        int c = capSlot(cap);
+        if (c >= 0 && !change(shadow.caps[c], on ? 1 : 0))
+            return;
+        if (c < 0)
+            current.issued++;
+        if (on)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+}
+
+void GLState::useProgram(GLuint program)
+{
+    if (change(shadow.program, program))
+        glUseProgram(program);
+}
+
+void GLState::activeTexture(GLenum unit)
+{
+    if (change(shadow.unit, unit - GL_TEXTURE0))
+        glActiveTexture(unit);
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+    int t = textureSlot(target);
+    if (t >= 0 && shadow.unit < GLuint(units))
+    {
+        if (change(shadow.textures[shadow.unit][t], texture))
+            glBindTexture(target, texture);
+        return;
+    }
+    current.issued++;
+    glBindTexture(target, texture);
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+    if (change(shadow.vao, vao))
+        glBindVertexArray(vao);
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    int b = bufferSlot(target);
+    if (b >= 0 && !change(shadow.buffers[b], buffer))
+        return;
+    if (b < 0)
+        current.issued++;
+    glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    if (target == GL_UNIFORM_BUFFER && index < GLuint(units))
+    {
+        if (!change(shadow.uniformBases[index], buffer))
+            return;
+        shadow.buffers[1] = buffer;   // also the generic binding
+    }
+    else
+        current.issued++;
+    glBindBufferBase(target, index, buffer);
+}
+
+void GLState::enable(GLenum cap)
+{
+    setCap(cap, true);
+}
+
+void GLState::disable(GLenum cap)
+{
+    setCap(cap, false);
+}
+
+void GLState::deleteTexture(GLuint& texture)
+{
+    if (!texture)
+        return;
+    for (auto& u : shadow.textures)
+        for (auto& t : u)
+            if (t == texture)
+                t = 0;
+    glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
+void GLState::deleteBuffer(GLuint& buffer)
+{
+    if (!buffer)
+        return;
+    for (auto& b : shadow.buffers)
+        if (b == buffer)
+            b = 0;
+    for (auto& b : shadow.uniformBases)
+        if (b == buffer)
+            b = 0;
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void GLState::deleteVertexArray(GLuint& vao)
+{
+    if (!vao)
+        return;
+    if (shadow.vao == vao)
+        shadow.vao = 0;
+    glDeleteVertexArrays(1, &vao);
+    vao = 0;
+}
+
+void GLState::invalidate()
+{
+    shadow.reset();
+}
+
+void GLState::countIssued(unsigned calls)
+{
+    current.issued += calls;
+}
+
+void GLState::countElided(unsigned calls)
+{
+    current.elided += calls;
+}
+
+void GLState::endFrame()
+{
+    last = current;
+    current = Counts{ 0, 0 };
+}
+
+GLState::Counts GLState::lastFrame()
+{
+    return last;
+}
@@ -0,0 +1,56 @@
+/**
+ * GLState.hpp
+ */
+
+#ifndef GLSTATE_H7Q2M5XC
+#define GLSTATE_H7Q2M5XC
+
+#include <GL/glew.h>
+
+/// \class GLState
+/// Shadow copy of the GL state the renderers change. Binding a program, a
+/// texture, a vertex array or a buffer, or toggling a capability, only
+/// reaches GL when the value differs from the last one set through here.
+///
+/// Renderers set the state they depend on before drawing and do not restore
+/// it afterwards: the next one sets what it needs, and repeated values cost
+/// nothing. Code changing this state behind the tracker's back must call
+/// invalidate(); ImGui's backend restores what it changes and needs not.
+/// One context, used from the GL thread only.
+class GLState
+{
+    public:
+        static void useProgram(GLuint program);
+        static void activeTexture(GLenum unit);                  // GL_TEXTURE0 + i
+        static void bindTexture(GLenum target, GLuint texture);  // on the active unit
+        static void bindVertexArray(GLuint vao);
+        static void bindBuffer(GLenum target, GLuint buffer);
+        static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+        static void enable(GLenum cap);
+        static void disable(GLenum cap);
+
+        // Delete objects, dropping them from the shadowed bindings so a
+        // recycled name is bound again
+        static void deleteTexture(GLuint& texture);
+        static void deleteBuffer(GLuint& buffer);
+        static void deleteVertexArray(GLuint& vao);
+
+        // Forget every shadowed value, the next change of each is issued
+        static void invalidate();
+
+        // GL calls made, and skipped as redundant, by the tracker and by
+        // ShaderProgram / UniformBuffer
+        struct Counts
+        {
+            unsigned issued;
+            unsigned elided;
+        };
+        static void countIssued(unsigned calls = 1);
+        static void countElided(unsigned calls = 1);
+
+        // Close the frame: its counts become lastFrame() and start over
+        static void endFrame();
+        static Counts lastFrame();
+};
+
+#endif /* end of include guard: GLSTATE_H7Q2M5XC */
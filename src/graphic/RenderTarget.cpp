@@ -0,0 +1,86 @@
+/**
+ * RenderTarget.cpp
+ */
+
+#include "RenderTarget.hpp"
+
+#include "GLState.hpp"
+
+#include <stdexcept>
+
+RenderTarget::RenderTarget():
+    fbo(0),
+    color(0),
+    depth(0),
+    width(0),
+    height(0)
+{
+}
+
+RenderTarget::~RenderTarget()
+{
+    if (fbo)
+    {
+        glDeleteFramebuffers(1, &fbo);
+        GLState::deleteTexture(color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+}
+
+void RenderTarget::resize(int w, int h)
+{
+    if (w <= 0 || h <= 0 || (fbo && w == width && h == height))
+        return;
+    width = w;
+    height = h;
+
+    if (!fbo)
+    {
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &color);
+        glGenRenderbuffers(1, &depth);
+    }
+
+    GLState::bindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("[Error] Incomplete render target framebuffer");
+}
+
+void RenderTarget::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void RenderTarget::unbind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint RenderTarget::getTexture() const
+{
+    return color;
+}
+
+int RenderTarget::getWidth() const
+{
+    return width;
+}
+
+int RenderTarget::getHeight() const
+{
+    return height;
+}
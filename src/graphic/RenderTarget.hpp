@@ -0,0 +1,43 @@
+/**
+ * RenderTarget.hpp
+ */
+
+#ifndef RENDERTARGET_R5T8N2QK
+#define RENDERTARGET_R5T8N2QK
+
+#include <GL/glew.h>
+
+/// \class RenderTarget
+/// Offscreen framebuffer with a color texture and a depth buffer, used to
+/// draw GL content that ImGui then displays as an image.
+class RenderTarget
+{
+    public:
+        RenderTarget();
+        ~RenderTarget();
+
+        // (re)allocate the attachments if the size changed
+        void resize(int width, int height);
+
+        // draw into the target / back to the default framebuffer
+        void bind() const;
+        void unbind() const;
+
+        // color attachment, to be given to ImGui::Image
+        GLuint getTexture() const;
+
+        int getWidth() const;
+        int getHeight() const;
+
+    private:
+        RenderTarget(const RenderTarget&);
+        RenderTarget& operator=(const RenderTarget&);
+
+        GLuint fbo;
+        GLuint color;
+        GLuint depth;
+        int width;
+        int height;
+};
+
+#endif /* end of include guard: RENDERTARGET_R5T8N2QK */
@@ -7,10 +7,12 @@
  */
 
 #include "Shader.hpp"
+#include "GLState.hpp"
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -198,43 +200,67 @@ void ShaderProgram::setAttribute(const std::string& name, GLint size, GLsizei st
 
 void ShaderProgram::setUniform(const std::string& name,float x,float y,float z)
 {
-    glUniform3f(uniform(name), x, y, z);
+    setUniform(name, vec3(x, y, z));
+}
+void ShaderProgram::setUniform(const std::string& name, const vec2 & v)
+{
+    GLint loc = uniform(name);
+    if (changed(loc, &v, sizeof(v)))
+        glUniform2fv(loc, 1, value_ptr(v));
 }
 void ShaderProgram::setUniform(const std::string& name, const vec3 & v)
 {
-    glUniform3fv(uniform(name), 1, value_ptr(v));
+    GLint loc = uniform(name);
+    if (changed(loc, &v, sizeof(v)))
+        glUniform3fv(loc, 1, value_ptr(v));
 }
 void ShaderProgram::setUniform(const std::string& name, const dvec3 & v)
 {
-    glUniform3dv(uniform(name), 1, value_ptr(v));
+    GLint loc = uniform(name);
+    if (changed(loc, &v, sizeof(v)))
+        glUniform3dv(loc, 1, value_ptr(v));
 }
 void ShaderProgram::setUniform(const std::string& name, const vec4 & v)
 {
-    glUniform4fv(uniform(name), 1, value_ptr(v));
+    GLint loc = uniform(name);
+    if (changed(loc, &v, sizeof(v)))
+        glUniform4fv(loc, 1, value_ptr(v));
 }
 void ShaderProgram::setUniform(const std::string& name, const dvec4 & v)
 {
-    glUniform4dv(uniform(name), 1, value_ptr(v));
+    GLint loc = uniform(name);
+    if (changed(loc, &v, sizeof(v)))
+        glUniform4dv(loc, 1, value_ptr(v));
 }
 void ShaderProgram::setUniform(const std::string& name, const dmat4 & m)
 {
-    glUniformMatrix4dv(uniform(name), 1, GL_FALSE, value_ptr(m));
+    GLint loc = uniform(name);
+    if (changed(loc, &m, sizeof(m)))
+        glUniformMatrix4dv(loc, 1, GL_FALSE, value_ptr(m));
 }
 void ShaderProgram::setUniform(const std::string& name, const mat4 & m)
 {
-    glUniformMatrix4fv(uniform(name), 1, GL_FALSE, value_ptr(m));
+    GLint loc = uniform(name);
+    if (changed(loc, &m, sizeof(m)))
+        glUniformMatrix4fv(loc, 1, GL_FALSE, value_ptr(m));
 }
 void ShaderProgram::setUniform(const std::string& name, const mat3 & m)
 {
-    glUniformMatrix3fv(uniform(name), 1, GL_FALSE, value_ptr(m));
+    GLint loc = uniform(name);
+    if (changed(loc, &m, sizeof(m)))
+        glUniformMatrix3fv(loc, 1, GL_FALSE, value_ptr(m));
 }
 void ShaderProgram::setUniform(const std::string& name, float val )
 {
-    glUniform1f(uniform(name), val);
+    GLint loc = uniform(name);
+    if (changed(loc, &val, sizeof(val)))
+        glUniform1f(loc, val);
 }
 void ShaderProgram::setUniform(const std::string& name, int val )
 {
-    glUniform1i(uniform(name), val);
+    GLint loc = uniform(name);
+    if (changed(loc, &val, sizeof(val)))
+        glUniform1i(loc, val);
 }
 
 ShaderProgram::~ShaderProgram()
@@ -245,11 +271,35 @@ ShaderProgram::~ShaderProgram()
 
 void ShaderProgram::use() const
 {
-    glUseProgram(handle);
+    GLState::useProgram(handle);
 }
 void ShaderProgram::unuse() const
 {
-    glUseProgram(0);
+    GLState::useProgram(0);
+}
+
+void ShaderProgram::setUniformBlock(const std::string& name, GLuint binding)
+{
+    GLuint index = glGetUniformBlockIndex(handle, name.c_str());
+    if (index == GL_INVALID_INDEX)
+    {
+        cout<<"[Error] uniform block "<<name<<" doesn't exist in program"<<endl;
+        return;
+    }
+    glUniformBlockBinding(handle, index, binding);
+}
+
+bool ShaderProgram::changed(GLint location, const void* data, size_t bytes)
+{
+    std::string& last = values[location];
+    if (last.size() == bytes && memcmp(last.data(), data, bytes) == 0)
+    {
+        GLState::countElided();
+        return false;
+    }
+    last.assign(static_cast<const char*>(data), bytes);
+    GLState::countIssued();
+    return true;
 }
 
 GLuint ShaderProgram::getHandle() const
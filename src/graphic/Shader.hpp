@@ -49,7 +49,7 @@ class ShaderProgram
         // constructor
         ShaderProgram(std::initializer_list<Shader> shaderList);
 
-        // bind the program
+        // bind the program (through GLState, so binding it again is free)
         void use() const;
         void unuse() const;
 
@@ -74,8 +74,13 @@ class ShaderProgram
 
         void setAttribute(const std::string& name, GLint size, GLsizei stride, GLuint offset);
 
-        // affect uniform
+        // make the uniform block `name` read from the uniform buffer binding
+        // point `binding` (see UniformBuffer::bind)
+        void setUniformBlock(const std::string& name, GLuint binding);
+
+        // affect uniform, skipped when the value did not change
         void setUniform(const std::string& name, float x,float y,float z);
+        void setUniform(const std::string& name, const glm::vec2 & v);
         void setUniform(const std::string& name, const glm::vec3 & v);
         void setUniform(const std::string& name, const glm::dvec3 & v);
         void setUniform(const std::string& name, const glm::vec4 & v);
@@ -92,11 +97,15 @@ class ShaderProgram
 
         std::map<std::string, GLint> uniforms;
         std::map<std::string, GLint> attributes;
+        std::map<GLint, std::string> values;   // last value set per uniform location, as bytes
 
         // opengl id
         GLuint handle;
 
         void link();
+
+        // whether `bytes` at `data` differ from the last value set at `location`
+        bool changed(GLint location, const void* data, size_t bytes);
 };
 
 
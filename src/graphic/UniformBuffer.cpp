@@ -0,0 +1,53 @@
+/**
+ * UniformBuffer.cpp
+ */
+
+#include "UniformBuffer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "GLState.hpp"
+#include "utils/glDebug.hpp"
+
+UniformBuffer::UniformBuffer(GLsizeiptr size):
+    handle(0),
+    size(size)
+{
+    glGenBuffers(1, &handle);
+    if (!handle)
+        throw std::runtime_error("[Error] Impossible to create a uniform buffer");
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    GLState::deleteBuffer(handle);
+}
+
+void UniformBuffer::update(const void* data, GLsizeiptr bytes)
+{
+    if (bytes > size)
+        throw std::invalid_argument("[Error] Uniform buffer update larger than the buffer");
+    if (contents.size() == size_t(bytes) && memcmp(contents.data(), data, size_t(bytes)) == 0)
+    {
+        GLState::countElided();
+        return;
+    }
+    contents.assign(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + bytes);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes, data);
+    gl_count_upload(size_t(bytes));
+    GLState::countIssued();
+}
+
+void UniformBuffer::bind(GLuint binding) const
+{
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, binding, handle);
+}
+
+GLuint UniformBuffer::getHandle() const
+{
+    return handle;
+}
@@ -0,0 +1,42 @@
+/**
+ * UniformBuffer.hpp
+ */
+
+#ifndef UNIFORMBUFFER_W4N8T2RB
+#define UNIFORMBUFFER_W4N8T2RB
+
+#include <GL/glew.h>
+#include <vector>
+
+/// \class UniformBuffer
+/// Storage of a std140 uniform block, so that all the uniforms of a block
+/// change with one buffer update instead of one glUniform call each. The
+/// C++ struct given to update() must follow the std140 layout of the block:
+/// vec3 and vec4 members on 16 byte boundaries, mat4 as four vec4 columns,
+/// the whole block padded to 16 bytes.
+class UniformBuffer
+{
+    public:
+        // needs a current GL context
+        explicit UniformBuffer(GLsizeiptr size);
+        ~UniformBuffer();
+
+        // replace the contents, skipped when they did not change
+        void update(const void* data, GLsizeiptr size);
+
+        // attach to the binding point programs read the block from
+        // (see ShaderProgram::setUniformBlock)
+        void bind(GLuint binding) const;
+
+        GLuint getHandle() const;
+
+    private:
+        UniformBuffer(const UniformBuffer&);
+        UniformBuffer& operator=(const UniformBuffer&);
+
+        GLuint handle;
+        GLsizeiptr size;
+        std::vector<unsigned char> contents;   // last update, to skip repeated ones
+};
+
+#endif /* end of include guard: UNIFORMBUFFER_W4N8T2RB */
@@ -0,0 +1,297 @@
+/**
+ * cloud_ring.cpp
+ */
+
+#include "cloud_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    inline size_t align64(size_t n) { return (n + 63) & ~size_t(63); }
+
+    // byte offsets of the arrays inside a slot payload
+    inline size_t uv_offset(size_t max_points) { return align64(max_points * 3 * sizeof(float)); }
+    inline size_t color_offset(size_t max_points) { return uv_offset(max_points) + align64(max_points * 2 * sizeof(float)); }
+
+    inline size_t slot_stride(size_t max_points, size_t color_bytes)
+    {
+        return sizeof(slot_header) + color_offset(max_points) + align64(color_bytes);
+    }
+
+    // Slots are written once per lap of the ring, long evicted from the cache
+    // by the time they come around again: non temporal stores skip reading
+    // the destination lines in before overwriting them.
+    void stream_copy(void* dst, const void* src, size_t bytes)
+    {
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+#if defined(__SSE2__) || defined(_M_X64)
+        // align the destination, the source may be anywhere
+        size_t head = min(bytes, size_t(-reinterpret_cast<uintptr_t>(d) & 15));
+        memcpy(d, s, head);
+        size_t i = head;
+        for (; i + 64 <= bytes; i += 64)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 32));
+            __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(d + i), a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 16), b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 32), c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 48), e);
+        }
+        memcpy(d + i, s + i, bytes - i);
+#else
+        memcpy(d, s, bytes);
+#endif
+    }
+
+    // orders non temporal stores with the seq updates around them
+    inline void stream_fence()
+    {
+#if defined(__SSE2__) || defined(_M_X64)
+        _mm_sfence();
+#endif
+    }
+
+#ifdef _WIN32
+    string segment_name(const string& name) { return "Local\\" + name; }
+#else
+    string segment_name(const string& name) { return "/" + name; }
+#endif
+}
+
+cloud_publisher::cloud_publisher(const string& name, size_t max_points, size_t max_color_bytes, uint32_t slots)
+    : name(segment_name(name)), point_capacity(max_points), color_capacity(max_color_bytes)
+{
+    if (slots < 2 || max_points > UINT32_MAX)
+        throw runtime_error("cloud_publisher: invalid ring geometry");
+
+    size_t stride = slot_stride(max_points, max_color_bytes);
+    mapping_size = sizeof(ring_header) + stride * slots;
+
+#ifdef _WIN32
+    handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                DWORD(uint64_t(mapping_size) >> 32), DWORD(mapping_size & 0xffffffff),
+                                this->name.c_str());
+    if (!handle)
+        throw runtime_error("cloud_publisher: CreateFileMapping failed for " + this->name);
+    mapping = MapViewOfFile(handle, FILE_MAP_WRITE, 0, 0, mapping_size);
+    if (!mapping)
+    {
+        CloseHandle(handle);
+        throw runtime_error("cloud_publisher: MapViewOfFile failed for " + this->name);
+    }
+#else
+    // start from a fresh segment so readers of a previous run see the new geometry
+    shm_unlink(this->name.c_str());
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        throw runtime_error("cloud_publisher: shm_open failed for " + this->name);
+    if (ftruncate(fd, off_t(mapping_size)) != 0)
+    {
+        close(fd);
+        shm_unlink(this->name.c_str());
+        throw runtime_error("cloud_publisher: cannot size " + this->name);
+    }
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(this->name.c_str());
+        throw runtime_error("cloud_publisher: mmap failed for " + this->name);
+    }
+#endif
+
+    // slots are all zero (seq 0 = never written); publish the geometry last
+    header = new (mapping) ring_header();
+    header->version = cloud_ring_version;
+    header->slot_count = slots;
+    header->max_points = static_cast<uint32_t>(max_points);
+    header->slot_stride = stride;
+    header->color_bytes = max_color_bytes;
+    header->latest.store(0, memory_order_relaxed);
+    for (uint32_t i = 0; i < slots; i++)
+        new (static_cast<uint8_t*>(mapping) + sizeof(ring_header) + stride * i) slot_header();
+    atomic_thread_fence(memory_order_release);
+    header->magic = cloud_ring_magic;
+}
+
+cloud_publisher::~cloud_publisher()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(handle);
+#else
+    munmap(mapping, mapping_size);
+    shm_unlink(name.c_str());
+#endif
+}
+
+void cloud_publisher::publish(const float* xyz, const float* uv, size_t count,
+                              const void* color, const cloud_frame_info& info)
+{
+    uint64_t g = generation;
+    uint8_t* base = static_cast<uint8_t*>(mapping) + sizeof(ring_header) + header->slot_stride * (g % header->slot_count);
+    slot_header* slot = reinterpret_cast<slot_header*>(base);
+    float* out_xyz = reinterpret_cast<float*>(base + sizeof(slot_header));
+    float* out_uv = reinterpret_cast<float*>(base + sizeof(slot_header) + uv_offset(point_capacity));
+    uint8_t* out_color = base + sizeof(slot_header) + color_offset(point_capacity);
+
+    // odd: readers holding the previous frame of this slot see it invalidated.
+    // The release fence orders ordinary stores only; the non temporal ones
+    // below could become visible before it without the sfence.
+    slot->seq.store(2 * g + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    stream_fence();
+
+    size_t n = min(count, point_capacity);
+    stream_copy(out_xyz, xyz, n * 3 * sizeof(float));
+    if (uv)
+        stream_copy(out_uv, uv, n * 2 * sizeof(float));
+
+    size_t row = size_t(info.color_width) * info.color_bpp;
+    bool has_color = color && row * info.color_height <= color_capacity;
+    if (has_color)
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(color);
+        size_t stride = info.color_stride ? info.color_stride : row;
+        if (stride == row)
+            stream_copy(out_color, src, row * info.color_height);
+        else
+            for (uint32_t y = 0; y < info.color_height; y++)
+                stream_copy(out_color + row * y, src + stride * y, row);
+    }
+    stream_fence();
+
+    slot->generation = g;
+    slot->frame_number = info.frame_number;
+    slot->timestamp = info.timestamp;
+    slot->point_count = static_cast<uint32_t>(n);
+    slot->width = n == size_t(info.width) * info.height ? info.width : 0;
+    slot->height = n == size_t(info.width) * info.height ? info.height : 0;
+    slot->has_uv = uv != nullptr;
+    slot->color_width = has_color ? info.color_width : 0;
+    slot->color_height = has_color ? info.color_height : 0;
+    slot->color_bpp = has_color ? info.color_bpp : 0;
+
+    slot->seq.store(2 * g + 2, memory_order_release);
+    header->latest.store(g + 1, memory_order_release);
+    generation = g + 1;
+}
+
+cloud_reader::cloud_reader(const string& name)
+{
+    string full = segment_name(name);
+#ifdef _WIN32
+    handle = OpenFileMappingA(FILE_MAP_READ, FALSE, full.c_str());
+    if (!handle)
+        throw runtime_error("cloud_reader: no publisher on " + full);
+    mapping = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping)
+    {
+        CloseHandle(handle);
+        throw runtime_error("cloud_reader: MapViewOfFile failed for " + full);
+    }
+    MEMORY_BASIC_INFORMATION mbi;
+    VirtualQuery(mapping, &mbi, sizeof(mbi));
+    mapping_size = mbi.RegionSize;
+#else
+    int fd = shm_open(full.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw runtime_error("cloud_reader: no publisher on " + full);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ring_header))
+    {
+        close(fd);
+        throw runtime_error("cloud_reader: " + full + " is not a point cloud ring");
+    }
+    mapping_size = size_t(st.st_size);
+    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw runtime_error("cloud_reader: mmap failed for " + full);
+#endif
+
+    header = static_cast<const ring_header*>(mapping);
+    atomic_thread_fence(memory_order_acquire);
+    if (header->magic != cloud_ring_magic || header->version != cloud_ring_version ||
+        sizeof(ring_header) + header->slot_stride * header->slot_count > mapping_size)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(handle);
+#else
+        munmap(const_cast<void*>(mapping), mapping_size);
+#endif
+        throw runtime_error("cloud_reader: " + full + " has an unknown layout");
+    }
+}
+
+cloud_reader::~cloud_reader()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(handle);
+#else
+    munmap(const_cast<void*>(mapping), mapping_size);
+#endif
+}
+
+const slot_header* cloud_reader::slot_at(uint64_t g) const
+{
+    const uint8_t* base = static_cast<const uint8_t*>(mapping) + sizeof(ring_header);
+    return reinterpret_cast<const slot_header*>(base + header->slot_stride * (g % header->slot_count));
+}
+
+bool cloud_reader::acquire(cloud_view& view, uint64_t from) const
+{
+    // the latest frame may be overwritten between reading `latest` and the
+    // slot if we got descheduled for a whole lap; retry with the newer one
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+        uint64_t latest = header->latest.load(memory_order_acquire);
+        if (latest == 0 || latest - 1 < from)
+            return false;
+        uint64_t g = latest - 1;
+        const slot_header* slot = slot_at(g);
+        if (slot->seq.load(memory_order_acquire) != 2 * g + 2)
+            continue;
+
+        size_t max_points = header->max_points;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(slot + 1);
+        view.generation = g;
+        view.slot = slot;
+        view.xyz = reinterpret_cast<const float*>(data);
+        view.uv = reinterpret_cast<const float*>(data + uv_offset(max_points));
+        view.color = data + color_offset(max_points);
+        return true;
+    }
+    return false;
+}
+
+bool cloud_reader::still_valid(const cloud_view& view) const
+{
+    atomic_thread_fence(memory_order_acquire);
+    return view.slot->seq.load(memory_order_relaxed) == 2 * view.generation + 2;
+}
@@ -0,0 +1,153 @@
+/**
+ * cloud_ring.hpp
+ * Shared memory ring of point cloud frames: RSScanner publishes, local
+ * consumer processes map it read-only.
+ *
+ * Layout of the segment:
+ *   ring_header | slot 0 | slot 1 | ... | slot N-1
+ * each slot being a slot_header followed by its payload:
+ *   xyz (3 floats per point) | uv (2 floats per point) | color image
+ * with every array starting on a 64 byte boundary.
+ *
+ * Frames are numbered by a generation counter and frame g lives in slot
+ * g % N. Every slot is a seqlock: its `seq` is odd while the publisher
+ * writes it and 2 * g + 2 once frame g is complete, so a reader can check
+ * that the slot still holds the frame it started reading. The publisher
+ * never waits for readers; a reader slower than N frames just sees its
+ * frame invalidated and moves on to the latest one.
+ */
+
+#ifndef RSSCANNER_IPC_CLOUD_RING_H
+#define RSSCANNER_IPC_CLOUD_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+static const uint32_t cloud_ring_magic = 0x52534352;  // "RSCR"
+static const uint32_t cloud_ring_version = 1;
+
+// name of the segment RSScanner publishes to
+static const char* const cloud_ring_default_name = "rsscanner_cloud";
+
+struct ring_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t max_points;       // capacity of the xyz and uv arrays
+    uint64_t slot_stride;      // bytes from one slot header to the next
+    uint64_t color_bytes;      // capacity of the color image
+    std::atomic<uint64_t> latest;  // generation + 1 of the last complete frame, 0 = none
+    char padding[64 - 40];
+};
+static_assert(sizeof(ring_header) == 64, "ring_header is part of the shared layout");
+
+struct slot_header
+{
+    std::atomic<uint64_t> seq;
+    uint64_t generation;
+    uint64_t frame_number;     // camera frame number
+    double timestamp;          // camera timestamp, ms
+    uint32_t point_count;
+    uint32_t width;            // grid of an organized cloud, 0 if it is not
+    uint32_t height;
+    uint32_t has_uv;
+    uint32_t color_width;
+    uint32_t color_height;
+    uint32_t color_bpp;        // bytes per color pixel, 0 = no color image
+    char padding[64 - 60];
+};
+static_assert(sizeof(slot_header) == 64, "slot_header is part of the shared layout");
+
+// Description of one published frame, besides the point arrays
+struct cloud_frame_info
+{
+    uint64_t frame_number;
+    double timestamp;
+    uint32_t width;            // depth image size if the points are one per pixel
+    uint32_t height;
+    uint32_t color_width;
+    uint32_t color_height;
+    uint32_t color_bpp;
+    uint32_t color_stride;     // bytes between color rows in the source
+};
+
+/// \class cloud_publisher
+/// Creates the segment and writes frames into it. Only one publisher per name.
+class cloud_publisher
+{
+    public:
+        cloud_publisher(const std::string& name, size_t max_points, size_t max_color_bytes,
+                        uint32_t slots = 4);
+        ~cloud_publisher();
+
+        // Publish `count` points of `xyz` (3 floats each) as they are, pixels
+        // without depth included (z = 0) so an organized cloud keeps its grid,
+        // with their texture coordinates `uv` (2 floats each, may be null) and
+        // the color image (may be null). Points beyond the slot capacity are dropped.
+        void publish(const float* xyz, const float* uv, size_t count,
+                     const void* color, const cloud_frame_info& info);
+
+        uint64_t published() const { return generation; }
+        size_t max_points() const { return point_capacity; }
+        size_t max_color_bytes() const { return color_capacity; }
+
+    private:
+        cloud_publisher(const cloud_publisher&);
+        cloud_publisher& operator=(const cloud_publisher&);
+
+        std::string name;
+        void* mapping = nullptr;
+        size_t mapping_size = 0;
+        ring_header* header = nullptr;
+        size_t point_capacity = 0;
+        size_t color_capacity = 0;
+        uint64_t generation = 0;
+#ifdef _WIN32
+        void* handle = nullptr;
+#endif
+};
+
+// A frame as seen by a reader, pointing straight into the shared memory
+struct cloud_view
+{
+    uint64_t generation;
+    const slot_header* slot;
+    const float* xyz;          // point_count * 3, z = 0 where there was no depth
+    const float* uv;           // point_count * 2, if slot->has_uv
+    const uint8_t* color;      // color_width * color_height * color_bpp
+};
+
+/// \class cloud_reader
+/// Maps an existing segment read-only. Reading never blocks the publisher:
+/// use the view, then check still_valid() before trusting what was read.
+class cloud_reader
+{
+    public:
+        explicit cloud_reader(const std::string& name = cloud_ring_default_name);
+        ~cloud_reader();
+
+        // Latest complete frame with a generation of at least `from`, false if
+        // there is none yet. Pass the last generation read + 1 to wait for new ones.
+        bool acquire(cloud_view& view, uint64_t from = 0) const;
+
+        // True if the frame of `view` was not overwritten since acquire()
+        bool still_valid(const cloud_view& view) const;
+
+    private:
+        cloud_reader(const cloud_reader&);
+        cloud_reader& operator=(const cloud_reader&);
+
+        const void* mapping = nullptr;
+        size_t mapping_size = 0;
+        const ring_header* header = nullptr;
+#ifdef _WIN32
+        void* handle = nullptr;
+#endif
+
+        const slot_header* slot_at(uint64_t generation) const;
+};
+
+#endif /* end of include guard: RSSCANNER_IPC_CLOUD_RING_H */
@@ -1,10 +1,27 @@
 /**
  * main.cpp application entry point
  */
+#include <cstdio>
+#include <string>
+
 #include "RSScanner.hpp"
+#include "batch.hpp"
 
 int main(int argc, const char *argv[])
 {
+    // batch mode never opens a window nor creates a GL context
+    if (is_batch_command(argc, argv))
+    {
+        batch_options options;
+        std::string error;
+        if (!parse_batch_command(argc, argv, options, error))
+        {
+            fprintf(stderr, "%s\n%s", error.c_str(), batch_usage());
+            return 1;
+        }
+        return run_batch(options);
+    }
+
     RSScanner app;
     app.run();
     return 0;
@@ -0,0 +1,151 @@
+/**
+ * measure.cpp
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_MEASURE
+#define RSSCANNER_POINTCLOUD_MEASURE
+
+#include "measure.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+#include "utils/stopwatch.hpp"
+
+namespace
+{
+    // Project a cloud point to window coordinates, false if it is behind the camera
+    bool project(const glm::mat4& mvp, const float3& p, ImVec2 view_min, ImVec2 view_max, ImVec2& out)
+    {
+        glm::vec4 clip = mvp * glm::vec4(p.x, p.y, p.z, 1.f);
+        if (clip.w <= 0.f)
+            return false;
+        out.x = view_min.x + (clip.x / clip.w * 0.5f + 0.5f) * (view_max.x - view_min.x);
+        out.y = view_min.y + (0.5f - clip.y / clip.w * 0.5f) * (view_max.y - view_min.y);
+        return true;
+    }
+
+    float distance(const float3& a, const float3& b)
+    {
+        float3 d = a - b;
+        return std::sqrt(dot(d, d));
+    }
+}
+
+extern void update_measure_index(measure_state& ms, const rs2::points& points, const uint8_t* removed)
+{
+    stopwatch timer;
+
+    ms.cloud.clear();
+    if (points)
+    {
+        auto vertices = points.get_vertices();
+        ms.cloud.reserve(points.size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            if (vertices[i].z && !(removed && removed[i]))
+                ms.cloud.push_back(float3{ vertices[i].x, vertices[i].y, vertices[i].z });
+        }
+    }
+    ms.index.build(ms.cloud.data(), ms.cloud.size());
+
+    ms.build_ms = timer.elapsed_ms();
+}
+
+extern void update_measure(measure_state& ms, const pcview_state& pc_state,
+                           ImVec2 view_min, ImVec2 view_max)
+{
+    float w = view_max.x - view_min.x;
+    float h = view_max.y - view_min.y;
+    if (w <= 0 || h <= 0)
+        return;
+
+    glm::mat4 proj = pc_projection(w, h);
+    glm::mat4 mvp = proj * pc_view(pc_state);
+
+    // cast the mouse ray into the cloud
+    ms.hover_valid = false;
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    bool inside = mouse.x >= view_min.x && mouse.x < view_max.x &&
+                  mouse.y >= view_min.y && mouse.y < view_max.y;
+    if (inside && !ms.index.empty())
+    {
+        stopwatch timer;
+
+        float nx = (mouse.x - view_min.x) / w * 2.f - 1.f;
+        float ny = 1.f - (mouse.y - view_min.y) / h * 2.f;
+        glm::mat4 inv = glm::inverse(mvp);
+        glm::vec4 near_p = inv * glm::vec4(nx, ny, -1.f, 1.f);
+        glm::vec4 far_p = inv * glm::vec4(nx, ny, 1.f, 1.f);
+        glm::vec3 o = glm::vec3(near_p) / near_p.w;
+        glm::vec3 d = glm::normalize(glm::vec3(far_p) / far_p.w - o);
+
+        // the cone opens by pick_px pixels per unit of distance
+        float slope = ms.pick_px * 2.f / (proj[1][1] * h);
+        kdtree::ray_hit hit;
+        if (ms.index.ray_nearest(float3{ o.x, o.y, o.z }, float3{ d.x, d.y, d.z }, 0.f, slope, hit))
+        {
+            ms.hover_valid = true;
+            ms.hover = hit.point;
+        }
+        ms.pick_ms = timer.elapsed_ms();
+
+        if (ms.hover_valid && ImGui::IsMouseClicked(1))
+        {
+            if (ms.picks.size() >= 2)
+                ms.picks.clear();
+            ms.picks.push_back(ms.hover);
+        }
+    }
+
+    // overlay
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const ImU32 pick_color = IM_COL32(255, 200, 0, 255);
+    const ImU32 hover_color = IM_COL32(0, 255, 255, 255);
+    ImVec2 screen[2];
+    size_t visible = 0;
+    for (size_t i = 0; i < ms.picks.size(); i++)
+    {
+        if (project(mvp, ms.picks[i], view_min, view_max, screen[i]))
+        {
+            draw_list->AddCircleFilled(screen[i], 4.f, pick_color);
+            visible++;
+        }
+    }
+    if (ms.picks.size() == 2 && visible == 2)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "%.1f mm", distance(ms.picks[0], ms.picks[1]) * 1000.f);
+        draw_list->AddLine(screen[0], screen[1], pick_color, 2.f);
+        draw_list->AddText(ImVec2((screen[0].x + screen[1].x) * 0.5f + 6.f,
+                                  (screen[0].y + screen[1].y) * 0.5f), pick_color, label);
+    }
+    ImVec2 hover_screen;
+    if (ms.hover_valid && project(mvp, ms.hover, view_min, view_max, hover_screen))
+    {
+        char label[64];
+        snprintf(label, sizeof(label), "(%.3f, %.3f, %.3f)", ms.hover.x, ms.hover.y, ms.hover.z);
+        draw_list->AddCircle(hover_screen, 6.f, hover_color);
+        draw_list->AddText(ImVec2(hover_screen.x + 8.f, hover_screen.y - 18.f), hover_color, label);
+    }
+}
+
+extern void draw_measure_panel(measure_state& ms)
+{
+    ImGui::Checkbox("Measure", &ms.enabled);
+    if (!ms.enabled)
+        return;
+
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+        ms.picks.clear();
+    ImGui::Text("Right click to pick points");
+    for (size_t i = 0; i < ms.picks.size(); i++)
+        ImGui::Text("P%d: %.3f, %.3f, %.3f m", int(i + 1), ms.picks[i].x, ms.picks[i].y, ms.picks[i].z);
+    if (ms.picks.size() == 2)
+        ImGui::Text("Distance: %.1f mm", distance(ms.picks[0], ms.picks[1]) * 1000.f);
+    ImGui::Text("Index: %d points, build %.2f ms, pick %.3f ms",
+                int(ms.index.size()), ms.build_ms, ms.pick_ms);
+}
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_MEASURE */
@@ -0,0 +1,42 @@
+/**
+ * measure.hpp
+ * Point picking and distance measurement on the point cloud view.
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_MEASURE_H
+#define RSSCANNER_POINTCLOUD_MEASURE_H
+
+#include <vector>
+
+#include "preview.hpp"
+#include "processing/kdtree.hpp"
+
+// Struct for the measurement overlay drawn over the point cloud view
+struct measure_state {
+    bool enabled = false;
+    float pick_px = 4.f;         // picking tolerance around the cursor, in pixels
+
+    std::vector<float3> cloud;   // valid vertices the index was built from
+    kdtree index;
+
+    bool hover_valid = false;    // point under the cursor
+    float3 hover;
+    std::vector<float3> picks;   // up to two picked points
+
+    double build_ms = 0.0;
+    double pick_ms = 0.0;
+};
+
+// Rebuild the spatial index over the vertices of `points` that have depth,
+// leaving out those with a nonzero `removed` entry (may be null)
+extern void update_measure_index(measure_state& ms, const rs2::points& points, const uint8_t* removed);
+
+// Pick the point under the cursor (right click to place a marker)
+// and draw the overlay inside the view rectangle [view_min, view_max]
+extern void update_measure(measure_state& ms, const pcview_state& pc_state,
+                           ImVec2 view_min, ImVec2 view_max);
+
+// Controls and readout of the measurement tool
+extern void draw_measure_panel(measure_state& ms);
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_MEASURE_H */
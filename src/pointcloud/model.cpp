@@ -0,0 +1,211 @@
+/**
+ * model.cpp
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_MODEL
+#define RSSCANNER_POINTCLOUD_MODEL
+
+#include "model.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "graphic/GLState.hpp"
+#include "graphic/Shader.hpp"
+#include "graphic/UniformBuffer.hpp"
+#include "utils/glDebug.hpp"
+#include "processing/cloud_file.hpp"
+#include "processing/ply.hpp"
+
+scene_renderer::scene_renderer()
+{
+    view.yaw = view.pitch = 0.0;
+}
+
+scene_renderer::~scene_renderer()
+{
+    clear();
+    GLState::deleteVertexArray(vao);
+}
+
+void scene_renderer::init_gl()
+{
+    program.reset(new ShaderProgram({
+        Shader("assets/shaders/scan_points.vert", GL_VERTEX_SHADER),
+        Shader("assets/shaders/scan_points.frag", GL_FRAGMENT_SHADER)
+    }));
+    program->setUniformBlock("Camera", camera_binding);
+    camera.reset(new UniformBuffer(sizeof(camera_block)));
+    glGenVertexArrays(1, &vao);
+}
+
+void scene_renderer::clear()
+{
+    for (auto& b : buffers)
+        GLState::deleteBuffer(b.buffer);
+    buffers.clear();
+}
+
+void scene_renderer::upload(const scene_chunk& chunk)
+{
+    if (chunk.id >= buffers.size())
+        buffers.resize(chunk.id + 1);
+    chunk_buffer& b = buffers[chunk.id];
+    size_t n = chunk.positions.size();
+    if (n == b.count)
+        return;
+
+    // positions in [0, capacity), colors after them
+    size_t first = b.count;
+    if (n > b.capacity || n < b.count)
+    {
+        // grown past the buffer, or a chunk of another model: start over
+        if (!b.buffer)
+            glGenBuffers(1, &b.buffer);
+        b.capacity = std::max(n, b.capacity * 2);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, b.buffer);
+        glBufferData(GL_ARRAY_BUFFER, b.capacity * (sizeof(float3) + sizeof(uint32_t)), nullptr, GL_DYNAMIC_DRAW);
+        first = 0;
+    }
+    GLState::bindBuffer(GL_ARRAY_BUFFER, b.buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(float3), (n - first) * sizeof(float3),
+                    chunk.positions.data() + first);
+    glBufferSubData(GL_ARRAY_BUFFER, b.capacity * sizeof(float3) + first * sizeof(uint32_t),
+                    (n - first) * sizeof(uint32_t), chunk.colors.data() + first);
+    gl_count_upload((n - first) * (sizeof(float3) + sizeof(uint32_t)));
+    b.count = n;
+}
+
+void scene_renderer::render(const scene& s, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    if (!program)
+        init_gl();
+
+    // chunks the accumulator spilled are read back only if they are not on
+    // the GPU yet, a few per frame
+    unsigned page_ins = 0;
+    for (const auto& chunk : s.chunks)
+    {
+        if (chunk->id < buffers.size() && buffers[chunk->id].count == chunk->size())
+            continue;
+        if (chunk->spilled && page_ins++ >= max_page_ins)
+            continue;
+        upload(*page_in(chunk));
+    }
+
+    target.resize(width, height);
+    target.bind();
+    glClearColor(153.f / 255, 153.f / 255, 153.f / 255, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    camera_block cam = {};
+    cam.mvp = pc_projection((float)width, (float)height) * pc_view(view) * pc_fit(s.lo, s.hi);
+    cam.point_size = view.point_size * width / 640.f;
+    camera->update(&cam, sizeof(cam));
+    camera->bind(camera_binding);
+
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_PROGRAM_POINT_SIZE);
+    program->use();
+    GLState::bindVertexArray(vao);
+    for (const auto& chunk : s.chunks)
+    {
+        if (chunk->id >= buffers.size() || !buffers[chunk->id].count)
+            continue;
+        const chunk_buffer& b = buffers[chunk->id];
+        GLState::bindBuffer(GL_ARRAY_BUFFER, b.buffer);
+        program->setAttribute("position", 3, 0, 0);
+        program->setAttribute("color", 4, 0, GLuint(b.capacity * sizeof(float3)), GL_TRUE, GL_UNSIGNED_BYTE);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)std::min(b.count, chunk->size()));
+    }
+    gl_count_draw(unsigned(s.chunks.size()));
+    target.unbind();
+}
+
+extern size_t save_scene(const std::string& path, const scene& s, const outlier_options* cleanup)
+{
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".ply") == 0)
+    {
+        // the header holds the count, known only without the cleanup
+        if (cleanup)
+            throw std::runtime_error("outliers are only removed when saving to a point cloud file");
+        ply_writer writer(path, s.points);
+        for (const auto& spilled : s.chunks)
+        {
+            std::shared_ptr<const scene_chunk> chunk = page_in(spilled);
+            writer.append(chunk->positions.data(), chunk->colors.data(), chunk->positions.size());
+        }
+        writer.finish();
+        return 0;
+    }
+
+    cloud_file_writer writer(path, cloud_colors);
+    if (!cleanup)
+    {
+        // one chunk in memory at a time
+        for (const auto& spilled : s.chunks)
+        {
+            std::shared_ptr<const scene_chunk> chunk = page_in(spilled);
+            writer.append(chunk->positions.data(), chunk->colors.data(), nullptr, chunk->positions.size());
+        }
+        writer.finish();
+        return 0;
+    }
+
+    // The points of a chunk are judged against the chunk and the ones added
+    // just before and after it, which scanned about the same surfaces: a
+    // window of three chunks is in memory, each read back once
+    const size_t n = s.chunks.size();
+    const float margin = 2.f * cleanup->radius;
+    std::vector<std::shared_ptr<const scene_chunk>> window(3);
+    std::vector<float3> positions;
+    std::vector<uint32_t> colors;
+    std::vector<uint8_t> outlier;
+    size_t removed = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        window[0] = i ? window[1] : nullptr;
+        window[1] = i ? window[2] : page_in(s.chunks[0]);
+        window[2] = i + 1 < n ? page_in(s.chunks[i + 1]) : nullptr;
+        const scene_chunk& chunk = *window[1];
+        size_t own = chunk.positions.size();
+        if (!own)
+            continue;
+
+        // the chunk, then the points of its neighbours close enough to count
+        positions.assign(chunk.positions.begin(), chunk.positions.end());
+        float3 lo = chunk.positions[0], hi = lo;
+        for (const float3& p : chunk.positions)
+        {
+            lo.x = std::min(lo.x, p.x); hi.x = std::max(hi.x, p.x);
+            lo.y = std::min(lo.y, p.y); hi.y = std::max(hi.y, p.y);
+            lo.z = std::min(lo.z, p.z); hi.z = std::max(hi.z, p.z);
+        }
+        for (int side = 0; side < 3; side += 2)
+            if (window[side])
+                for (const float3& p : window[side]->positions)
+                    if (p.x >= lo.x - margin && p.x <= hi.x + margin && p.y >= lo.y - margin &&
+                        p.y <= hi.y + margin && p.z >= lo.z - margin && p.z <= hi.z + margin)
+                        positions.push_back(p);
+
+        colors.resize(own);
+        outlier.assign(positions.size(), 0);
+        remove_outliers(positions.data(), positions.size(), *cleanup, outlier.data());
+        size_t kept = 0;
+        for (size_t k = 0; k < own; k++)
+            if (!outlier[k])
+            {
+                positions[kept] = chunk.positions[k];
+                colors[kept] = chunk.colors[k];
+                kept++;
+            }
+        removed += own - kept;
+        writer.append(positions.data(), colors.data(), nullptr, kept);
+    }
+    writer.finish();
+    return removed;
+}
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_MODEL */
@@ -0,0 +1,66 @@
+/**
+ * model.hpp
+ * Display of the accumulated model.
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_MODEL_H
+#define RSSCANNER_POINTCLOUD_MODEL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "preview.hpp"
+#include "graphic/RenderTarget.hpp"
+#include "processing/accumulator.hpp"
+#include "processing/outliers.hpp"
+
+class ShaderProgram;
+class UniformBuffer;
+
+/// \class scene_renderer
+/// Draws versions of the accumulated model. GPU buffers are kept per chunk
+/// across versions: a chunk that grew since the last version only has its
+/// new points uploaded, and full chunks are never uploaded again.
+class scene_renderer
+{
+public:
+    scene_renderer();
+    ~scene_renderer();
+
+    void render(const scene& s, int width, int height);
+
+    // Drop every buffer, for a new model
+    void clear();
+
+    GLuint get_gl_handle() const { return target.getTexture(); }
+
+    pcview_state view;   // camera around the model
+
+private:
+    struct chunk_buffer
+    {
+        GLuint buffer = 0;
+        size_t count = 0;      // points uploaded
+        size_t capacity = 0;   // points the buffer can hold
+    };
+
+    std::vector<chunk_buffer> buffers;   // by chunk id
+    static const unsigned max_page_ins = 4;   // spilled chunks read back per frame
+    RenderTarget target;
+    std::unique_ptr<ShaderProgram> program;
+    std::unique_ptr<UniformBuffer> camera;
+    GLuint vao = 0;
+
+    void init_gl();
+    void upload(const scene_chunk& chunk);
+};
+
+// Write a version of the model to a cloud file, without the outliers found
+// by `cleanup` when it is not null. Chunks are streamed to the file: spilled
+// ones are read back a few at a time, and each is cleaned against its
+// neighbours in accumulation order. Returns the number of points removed.
+// A path ending in .ply is written as PLY instead, without cleanup.
+extern size_t save_scene(const std::string& path, const scene& s, const outlier_options* cleanup);
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_MODEL_H */
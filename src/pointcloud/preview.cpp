@@ -9,64 +9,26 @@
 
 #include "preview.hpp"
 
-
-// Handles all the OpenGL calls needed to display the point cloud
-extern void draw_pointcloud(float width, float height, pcview_state& pc_state, rs2::points& points)
+extern glm::mat4 pc_projection(float width, float height)
 {
-    if (!points)
-        return;
-
-    // OpenGL commands that prep screen for the pointcloud
-    glPopMatrix();
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
-
-    glClearColor(153.f / 255, 153.f / 255, 153.f / 255, 1);
-    glClear(GL_DEPTH_BUFFER_BIT);
-
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glm::perspective(glm::radians(60.f), width/height, 0.1f, 100.0f);
-
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, -1, 0));
-
-    glTranslatef(0, 0, +0.5f + pc_state.offset_y*0.05f);
-    glRotated(pc_state.pitch, 1, 0, 0);
-    glRotated(pc_state.yaw, 0, 1, 0);
-    glTranslatef(0, 0, -0.5f);
-
-    glPointSize(width / 640);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, pc_state.tex.get_gl_handle());
-    float tex_border_color[] = { 0.8f, 0.8f, 0.8f, 0.8f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, tex_border_color);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, 0x812F); // GL_CLAMP_TO_EDGE
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, 0x812F); // GL_CLAMP_TO_EDGE
-    glBegin(GL_POINTS);
-
+    return glm::perspective(glm::radians(60.f), width / height, 0.1f, 100.0f);
+}
 
-    /* this segment actually prints the pointcloud */
-    auto vertices = points.get_vertices();              // get vertices
-    auto tex_coords = points.get_texture_coordinates(); // and texture coordinates
-    for (int i = 0; i < points.size(); i++)
-    {
-        if (vertices[i].z)
-        {
-            // upload the point and texture coordinates only for points we have depth data for
-            glVertex3fv(vertices[i]);
-            glTexCoord2fv(tex_coords[i]);
-        }
-    }
+extern glm::mat4 pc_view(const pcview_state& pc_state)
+{
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, -1, 0));
+    view = glm::translate(view, glm::vec3(0, 0, +0.5f + pc_state.offset_y * 0.05f));
+    view = glm::rotate(view, glm::radians((float)pc_state.pitch), glm::vec3(1, 0, 0));
+    view = glm::rotate(view, glm::radians((float)pc_state.yaw), glm::vec3(0, 1, 0));
+    return glm::translate(view, glm::vec3(0, 0, -0.5f));
+}
 
-    // OpenGL cleanup
-    glEnd();
-    glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glPopAttrib();
-    glPushMatrix();
+extern glm::mat4 pc_fit(float3 lo, float3 hi)
+{
+    float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+    glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 0.5f));
+    model = glm::scale(model, glm::vec3(extent > 0.f ? 1.f / extent : 1.f));
+    return glm::translate(model, glm::vec3(-(lo.x + hi.x) / 2, -(lo.y + hi.y) / 2, -(lo.z + hi.z) / 2));
 }
 
 // Update state for point cloud view
@@ -11,7 +11,10 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <vector>
 
+#include "graphic/GLState.hpp" // GLEW, ahead of GLFW's gl.h
+#include "utils/glDebug.hpp"
 #include <GLFW/glfw3.h>
 
 #include <glm/mat4x4.hpp> // glm::mat4
@@ -21,12 +24,10 @@
 
 #include "imgui.h"
 
-//////////////////////////////
-// Basic Data Types         //
-//////////////////////////////
-
-struct float3 { float x, y, z; };
-struct float2 { float x, y; };
+#include "processing/types.hpp"
+#include "processing/change.hpp"
+#include "processing/convert.hpp"
+#include "processing/colorizer.hpp"
 
 struct rect
 {
@@ -48,57 +49,82 @@ struct rect
     }
 };
 
-////////////////////////
-// Image display code //
-////////////////////////
-class texture
+// Whether `format` goes through convert_to_rgba() before upload
+inline bool needs_conversion(rs2_format format)
 {
-public:
-    void render(const rs2::frameset& frames, int window_width, int window_height)
+    switch (format)
     {
-        std::vector<rs2::video_frame> supported_frames;
-        for (auto f : frames)
-        {
-            if (can_render(f))
-                supported_frames.push_back(f);
-        }
-        if (supported_frames.empty())
-            return;
-
-        std::sort(supported_frames.begin(), supported_frames.end(), [](rs2::frame first, rs2::frame second)
-            { return first.get_profile().stream_type() < second.get_profile().stream_type();  });
-
-        auto image_grid = calc_grid(float2{ (float)window_width, (float)window_height }, supported_frames);
-
-        int image_index = 0;
-        for (auto f : supported_frames)
-        {
-            upload(f);
-            show(image_grid.at(image_index));
-            image_index++;
-        }
+    case RS2_FORMAT_YUYV:
+    case RS2_FORMAT_UYVY:
+    case RS2_FORMAT_BGR8:
+    case RS2_FORMAT_BGRA8:
+    case RS2_FORMAT_Z16:
+        return true;
+    default:
+        return false;
     }
+}
 
-    void render(const rs2::video_frame& frame, const rect& r)
+// Convert a frame in one of the needs_conversion() formats to packed RGBA8.
+// Depth goes through `colorizer`.
+inline void convert_to_rgba(const rs2::video_frame& frame, std::vector<uint8_t>& rgba, depth_colorizer& colorizer)
+{
+    int w = frame.get_width();
+    int h = frame.get_height();
+    int stride = frame.get_stride_in_bytes();
+    rgba.resize(size_t(w) * h * 4);
+
+    auto src = static_cast<const uint8_t*>(frame.get_data());
+    auto format = frame.get_profile().format();
+    if (format == RS2_FORMAT_Z16)
+    {
+        colorizer.colorize(reinterpret_cast<const uint16_t*>(src), w, h, stride, rgba.data());
+        return;
+    }
+    for (int y = 0; y < h; y++)
     {
-        upload(frame);
-        show(r.adjust_ratio({ float(width), float(height) }));
+        const uint8_t* row = src + size_t(y) * stride;
+        uint8_t* out = rgba.data() + size_t(y) * w * 4;
+        switch (format)
+        {
+        case RS2_FORMAT_YUYV: yuyv_to_rgba8(row, out, w); break;
+        case RS2_FORMAT_UYVY: uyvy_to_rgba8(row, out, w); break;
+        case RS2_FORMAT_BGR8: bgr8_to_rgba8(row, out, w); break;
+        case RS2_FORMAT_BGRA8: bgra8_to_rgba8(row, out, w); break;
+        default:
+            throw std::runtime_error("The requested format is not supported by this demo!");
+        }
     }
+}
 
+////////////////////////
+// Image display code //
+////////////////////////
+class texture
+{
+public:
     void upload(const rs2::video_frame& frame)
     {
         if (!frame) return;
 
-        if (!gl_handle)
+        bool created = !gl_handle;
+        if (created)
             glGenTextures(1, &gl_handle);
-        GLenum err = glGetError();
 
-        auto format = frame.get_profile().format();
+        format = frame.get_profile().format();
         width = frame.get_width();
         height = frame.get_height();
         stream = frame.get_profile().stream_type();
 
-        glBindTexture(GL_TEXTURE_2D, gl_handle);
+        GLState::bindTexture(GL_TEXTURE_2D, gl_handle);
+        if (created)
+        {
+            // sampling state belongs to the texture object, set once
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
 
         switch (format)
         {
@@ -109,113 +135,90 @@ public:
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame.get_data());
             break;
         case RS2_FORMAT_Y8:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, frame.get_data());
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, frame.get_data());
             break;
         default:
-            throw std::runtime_error("The requested format is not supported by this demo!");
+            if (!needs_conversion(format))
+                throw std::runtime_error("The requested format is not supported by this demo!");
+            convert_to_rgba(frame, rgba, colorizer);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+            break;
         }
+        gl_count_upload(needs_conversion(format) ? rgba.size() : size_t(frame.get_data_size()));
+
+        // core profiles have no luminance format: gray frames are stored in
+        // the red channel and read back through all three
+        GLint swizzle[] = { GL_RED, format == RS2_FORMAT_Y8 ? GL_RED : GL_GREEN,
+                            format == RS2_FORMAT_Y8 ? GL_RED : GL_BLUE, GL_ALPHA };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    GLuint get_gl_handle() { return gl_handle; }
-
-    void show(const rect& r) const
+    // Upload only the tiles `changes` found changed in `frame`, each run of
+    // them along a tile row as one sub-image. Falls back to upload() unless
+    // the texture holds a frame of the same size and format, sent as is.
+    void upload_tiles(const rs2::video_frame& frame, const tile_changes& changes)
     {
-        if (!gl_handle)
+        if (!frame) return;
+        rs2_format f = frame.get_profile().format();
+        if (!gl_handle || f != format || needs_conversion(f) || frame.get_width() != width ||
+            frame.get_height() != height || changes.count() == 0)
+        {
+            upload(frame);
             return;
+        }
 
-        glBindTexture(GL_TEXTURE_2D, gl_handle);
-        glEnable(GL_TEXTURE_2D);
-        glBegin(GL_QUAD_STRIP);
-        glTexCoord2f(0.f, 1.f); glVertex2f(r.x, r.y + r.h);
-        glTexCoord2f(0.f, 0.f); glVertex2f(r.x, r.y);
-        glTexCoord2f(1.f, 1.f); glVertex2f(r.x + r.w, r.y + r.h);
-        glTexCoord2f(1.f, 0.f); glVertex2f(r.x + r.w, r.y);
-        glEnd();
-        glDisable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        //  draw_text((int)r.x + 15, (int)r.y + 20, rs2_stream_to_string(stream));
-        // ImGui::Text(rs2_stream_to_string(stream), (int)r.x + 15, (int)r.y + 20);
+        GLenum layout = f == RS2_FORMAT_RGBA8 ? GL_RGBA : f == RS2_FORMAT_Y8 ? GL_RED : GL_RGB;
+        int bpp = frame.get_bytes_per_pixel();
+        int stride = frame.get_stride_in_bytes();
+        auto data = static_cast<const uint8_t*>(frame.get_data());
+        GLState::bindTexture(GL_TEXTURE_2D, gl_handle);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / bpp);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t bytes = 0;
+        int tile = changes.tile();
+        for (int r = 0; r < changes.rows(); r++)
+            for (int c = 0; c < changes.cols(); c++)
+            {
+                if (!changes.changed(c, r))
+                    continue;
+                int first = c;
+                while (c + 1 < changes.cols() && changes.changed(c + 1, r))
+                    c++;
+                int x0 = first * tile, x1 = std::min(width, (c + 1) * tile);
+                int y0 = changes.row_begin(r), y1 = changes.row_end(r);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0, layout, GL_UNSIGNED_BYTE,
+                                data + size_t(y0) * stride + size_t(x0) * bpp);
+                bytes += size_t(x1 - x0) * (y1 - y0) * bpp;
+            }
+        gl_count_upload(bytes);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     }
 
+    GLuint get_gl_handle() { return gl_handle; }
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+
+    // palette and equalization used for depth frames
+    depth_colorizer colorizer;
+
 private:
     GLuint gl_handle = 0;
     int width = 0;
     int height = 0;
     rs2_stream stream = RS2_STREAM_ANY;
-
-    bool can_render(const rs2::frame& f) const
-    {
-        auto format = f.get_profile().format();
-        switch (format)
-        {
-        case RS2_FORMAT_RGB8:
-        case RS2_FORMAT_RGBA8:
-        case RS2_FORMAT_Y8:
-            return true;
-        default:
-            return false;
-        }
-    }
-
-    rect calc_grid(float2 window, size_t streams)
-    {
-        if (window.x <= 0 || window.y <= 0 || streams <= 0)
-            throw std::runtime_error("invalid window configuration request, failed to calculate window grid");
-        float ratio = window.x / window.y;
-        auto x = sqrt(ratio * (float)streams);
-        auto y = (float)streams / x;
-        auto w = round(x);
-        auto h = round(y);
-        if (w == 0 || h == 0)
-            throw std::runtime_error("invalid window configuration request, failed to calculate window grid");
-        while (w*h > streams)
-            h > w ? h-- : w--;
-        while (w*h < streams)
-            h > w ? w++ : h++;
-        auto new_w = round(window.x / w);
-        auto new_h = round(window.y / h);
-        return rect{ w, h, new_w, new_h}; //column count, line count, cell width cell height
-    }
-
-    std::vector<rect> calc_grid(float2 window, std::vector<rs2::video_frame>& frames)
-    {
-        auto grid = calc_grid(window, frames.size());
-
-        int index = 0;
-        std::vector<rect> rv;
-        int curr_line = -1;
-        for (auto f  : frames)
-        {
-            auto mod = index % (int)grid.x;
-            auto fw = (float)frames[index].get_width();
-            auto fh = (float)frames[index].get_height();
-
-            float cell_x_postion = (float)(mod * grid.w);
-            if (mod == 0) curr_line++;
-            float cell_y_position = curr_line * grid.h;
-
-            auto r = rect{ cell_x_postion, cell_y_position, grid.w, grid.h };
-            rv.push_back(r.adjust_ratio(float2{ fw, fh }));
-            index++;
-        }
-
-        return rv;
-    }
+    rs2_format format = RS2_FORMAT_ANY;
+    std::vector<uint8_t> rgba;       // converted frame, kept to reuse its storage
 };
 
 
 // Struct for managing rotation of pointcloud view
 struct pcview_state {
     pcview_state() : yaw(15.0), pitch(15.0), last_x(0.0), last_y(0.0),
-        ml(false), offset_x(2.f), offset_y(2.f), tex() {}
+        ml(false), offset_x(2.f), offset_y(2.f), point_size(1.f), point_budget(0), tex() {}
     double yaw;
     double pitch;
     double last_x;
@@ -223,12 +226,28 @@ struct pcview_state {
     bool ml;
     float offset_x;
     float offset_y;
+    float point_size;     // in pixels at a 640 wide view
+    size_t point_budget;  // max points drawn, 0 draws all
     texture tex;
 };
 
 
-// Handles all the OpenGL calls needed to display the point cloud
-extern void draw_pointcloud(float width, float height, pcview_state& pc_state, rs2::points& points);
+// std140 mirror of the Camera uniform block of scan_points.vert, which the
+// point renderers bind at camera_binding
+struct camera_block
+{
+    glm::mat4 mvp;
+    float point_size;
+    float padding[3];
+};
+const unsigned camera_binding = 0;
+
+// Camera matrices of the point cloud view, shared by drawing and picking
+extern glm::mat4 pc_projection(float width, float height);
+extern glm::mat4 pc_view(const pcview_state& pc_state);
+
+// Model matrix fitting the box [lo, hi] in the unit cube the view rotates about
+extern glm::mat4 pc_fit(float3 lo, float3 hi);
 
 // Update state for point cloud view
 extern void update_pc_state(pcview_state& pc_state);
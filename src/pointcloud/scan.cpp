@@ -0,0 +1,311 @@
+/**
+ * scan.cpp
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_SCAN
+#define RSSCANNER_POINTCLOUD_SCAN
+
+#include "scan.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "graphic/GLState.hpp"
+#include "graphic/Shader.hpp"
+#include "graphic/UniformBuffer.hpp"
+#include "utils/glDebug.hpp"
+#include "utils/stopwatch.hpp"
+
+namespace
+{
+    // False if the box is entirely outside one of the clip planes
+    bool box_visible(const glm::mat4& mvp, const float3& lo, const float3& hi)
+    {
+        int outside[6] = {};
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec4 p = mvp * glm::vec4(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z, 1.f);
+            outside[0] += p.x < -p.w;
+            outside[1] += p.x > p.w;
+            outside[2] += p.y < -p.w;
+            outside[3] += p.y > p.w;
+            outside[4] += p.z < -p.w;
+            outside[5] += p.z > p.w;
+        }
+        for (int i = 0; i < 6; i++)
+            if (outside[i] == 8)
+                return false;
+        return true;
+    }
+
+    inline uint32_t pack_rgba(uint8_t r, uint8_t g, uint8_t b)
+    {
+        const uint8_t px[4] = { r, g, b, 255 };
+        uint32_t c;
+        memcpy(&c, px, sizeof(c));
+        return c;
+    }
+}
+
+scan_view::scan_view()
+{
+    view.yaw = view.pitch = 0.0;
+}
+
+scan_view::~scan_view()
+{
+    close();
+    GLState::deleteVertexArray(vao);
+}
+
+void scan_view::init_gl()
+{
+    program.reset(new ShaderProgram({
+        Shader("assets/shaders/scan_points.vert", GL_VERTEX_SHADER),
+        Shader("assets/shaders/scan_points.frag", GL_FRAGMENT_SHADER)
+    }));
+    program->setUniformBlock("Camera", camera_binding);
+    camera.reset(new UniformBuffer(sizeof(camera_block)));
+    glGenVertexArrays(1, &vao);
+}
+
+void scan_view::open(const std::string& path)
+{
+    stopwatch timer;
+    std::unique_ptr<cloud_file> f(new cloud_file(path));
+    close();
+    file = std::move(f);
+    nodes.assign(file->block_count(), node());
+    loader.reset(new node_loader(*file));
+    index_ms = timer.elapsed_ms();
+    opened_at = system_time_ms() - index_ms;
+}
+
+void scan_view::close()
+{
+    // the loader threads read the file, stop them first
+    loader.reset();
+    for (uint32_t b : lru)
+        GLState::deleteBuffer(nodes[b].buffer);
+    lru.clear();
+    nodes.clear();
+    file.reset();
+    gpu_bytes = gpu_points = 0;
+    hits = 0.f;
+    first_ms = -1;
+}
+
+void scan_view::evict(uint32_t block)
+{
+    node& n = nodes[block];
+    GLState::deleteBuffer(n.buffer);
+    gpu_bytes -= n.bytes;
+    gpu_points -= file->block(block).count;
+    lru.erase(n.lru_pos);
+}
+
+void scan_view::select(const glm::mat4& model_view, const glm::mat4& mvp, int height)
+{
+    visible.clear();
+    stack.clear();
+    if (file->is_tree())
+        stack.push_back(0);
+    else
+        for (size_t b = file->block_count(); b-- > 0;)
+            stack.push_back(static_cast<uint32_t>(b));
+
+    // radius on screen of a block's bounding sphere, for the 60 degree field of view
+    float focal = height * 0.5f / std::tan(glm::radians(30.f));
+    float scale = glm::length(glm::vec3(model_view[0]));
+    while (!stack.empty())
+    {
+        uint32_t b = stack.back();
+        stack.pop_back();
+        const cloud_block& k = file->block(b);
+        if ((!k.count && !k.child_count) || !box_visible(mvp, k.lo, k.hi))
+            continue;
+
+        glm::vec3 lo(k.lo.x, k.lo.y, k.lo.z), hi(k.hi.x, k.hi.y, k.hi.z);
+        float radius = glm::length(hi - lo) * 0.5f * scale;
+        float dist = -(model_view * glm::vec4((lo + hi) * 0.5f, 1.f)).z;
+        float px = dist > radius ? radius / dist * focal : 1e9f;
+        if (k.count)
+            visible.push_back(candidate{ b, px });
+        if (k.child_count && px > detail_px)
+            for (uint32_t c = 0; c < k.child_count; c++)
+                stack.push_back(k.first_child + c);
+    }
+
+    // largest on screen first, for loading as well as for drawing
+    std::sort(visible.begin(), visible.end(),
+        [](const candidate& l, const candidate& r) { return l.px > r.px; });
+
+    // ask for the missing blocks that fit in the budget next to the ones
+    // already resident, so that loads are not thrown away on arrival
+    bool colors = (file->columns() & cloud_colors) != 0;
+    size_t point_bytes = sizeof(float3) + (colors ? sizeof(uint32_t) : 0);
+    size_t needed = 0;
+    size_t resident = 0;
+    wanted.clear();
+    for (const candidate& v : visible)
+    {
+        node& n = nodes[v.block];
+        n.drawn = frame;
+        needed += file->block(v.block).count * point_bytes;
+        if (n.buffer)
+        {
+            resident++;
+            lru.splice(lru.end(), lru, n.lru_pos);
+        }
+        else if (needed <= memory_budget)
+            wanted.push_back(v.block);
+    }
+    loader->request(wanted);
+    float rate = visible.empty() ? 1.f : float(resident) / visible.size();
+    hits += (rate - hits) * 0.1f;
+}
+
+void scan_view::upload_blocks()
+{
+    stopwatch timer;
+    uint32_t b;
+    while (timer.elapsed_ms() < upload_budget_ms && loader->poll(b, staging))
+    {
+        node& n = nodes[b];
+        if (n.buffer)
+            continue;
+        // make room, never evicting what this frame draws
+        while (gpu_bytes + staging.size() > memory_budget && !lru.empty() && nodes[lru.front()].drawn != frame)
+            evict(lru.front());
+        if (gpu_bytes + staging.size() > memory_budget)
+            continue;  // dropped, it is asked for again once it fits
+
+        glGenBuffers(1, &n.buffer);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, n.buffer);
+        glBufferData(GL_ARRAY_BUFFER, staging.size(), staging.data(), GL_STATIC_DRAW);
+        gl_count_upload(staging.size());
+        n.bytes = staging.size();
+        n.lru_pos = lru.insert(lru.end(), b);
+        gpu_bytes += n.bytes;
+        gpu_points += file->block(b).count;
+    }
+}
+
+void scan_view::render(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    if (!program)
+        init_gl();
+
+    target.resize(width, height);
+    target.bind();
+    glClearColor(153.f / 255, 153.f / 255, 153.f / 255, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!file)
+    {
+        target.unbind();
+        return;
+    }
+    frame++;
+
+    glm::mat4 model_view = pc_view(view) * pc_fit(file->lower(), file->upper());
+    camera_block cam = {};
+    cam.mvp = pc_projection((float)width, (float)height) * model_view;
+    cam.point_size = view.point_size * width / 640.f;
+
+    select(model_view, cam.mvp, height);
+    upload_blocks();
+    camera->update(&cam, sizeof(cam));
+    camera->bind(camera_binding);
+
+    bool colors = (file->columns() & cloud_colors) != 0;
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_PROGRAM_POINT_SIZE);
+    program->use();
+    GLState::bindVertexArray(vao);
+    GLint color_loc = program->attribute("color");
+    if (!colors)
+    {
+        // without a color column every point gets the same constant color
+        glDisableVertexAttribArray(color_loc);
+        glVertexAttrib4f(color_loc, 0.8f, 0.8f, 0.8f, 1.f);
+    }
+    size_t drawn = 0;
+    for (const candidate& v : visible)
+    {
+        const node& n = nodes[v.block];
+        if (!n.buffer)
+            continue;
+        const cloud_block& b = file->block(v.block);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, n.buffer);
+        program->setAttribute("position", 3, 0, 0);
+        if (colors)
+            program->setAttribute("color", 4, 0, GLuint(b.count * sizeof(float3)), GL_TRUE, GL_UNSIGNED_BYTE);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)b.count);
+        drawn++;
+    }
+    gl_count_draw(unsigned(drawn));
+    target.unbind();
+
+    if (first_ms < 0 && drawn > 0)
+        first_ms = system_time_ms() - opened_at;
+}
+
+extern void colored_points(const rs2::points& points, const rs2::video_frame& color,
+                           std::vector<float3>& positions, std::vector<uint32_t>& colors,
+                           const uint8_t* removed)
+{
+    const rs2::vertex* vertices = points.get_vertices();
+    const rs2::texture_coordinate* uv = points.get_texture_coordinates();
+
+    int w = 0, h = 0, stride = 0;
+    rs2_format format = RS2_FORMAT_ANY;
+    const uint8_t* pixels = nullptr;
+    if (color)
+    {
+        w = color.get_width();
+        h = color.get_height();
+        stride = color.get_stride_in_bytes();
+        format = color.get_profile().format();
+        pixels = static_cast<const uint8_t*>(color.get_data());
+    }
+
+    positions.clear();
+    colors.clear();
+    positions.reserve(points.size());
+    colors.reserve(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (!vertices[i].z || (removed && removed[i]))
+            continue;
+        positions.push_back(float3{ vertices[i].x, vertices[i].y, vertices[i].z });
+
+        int x = std::min(std::max(int(uv[i].u * w), 0), w - 1);
+        int y = std::min(std::max(int(uv[i].v * h), 0), h - 1);
+        const uint8_t* px = pixels ? pixels + size_t(y) * stride : nullptr;
+        switch (px ? format : RS2_FORMAT_ANY)
+        {
+        case RS2_FORMAT_RGB8:  px += x * 3; colors.push_back(pack_rgba(px[0], px[1], px[2])); break;
+        case RS2_FORMAT_BGR8:  px += x * 3; colors.push_back(pack_rgba(px[2], px[1], px[0])); break;
+        case RS2_FORMAT_RGBA8: px += x * 4; colors.push_back(pack_rgba(px[0], px[1], px[2])); break;
+        case RS2_FORMAT_BGRA8: px += x * 4; colors.push_back(pack_rgba(px[2], px[1], px[0])); break;
+        case RS2_FORMAT_Y8:    px += x;     colors.push_back(pack_rgba(px[0], px[0], px[0])); break;
+        default:               colors.push_back(pack_rgba(204, 204, 204)); break;
+        }
+    }
+}
+
+extern void save_points(const std::string& path, const rs2::points& points, const rs2::video_frame& color,
+                        const uint8_t* removed)
+{
+    std::vector<float3> p;
+    std::vector<uint32_t> c;
+    colored_points(points, color, p, c, removed);
+    cloud_file_writer writer(path, cloud_colors);
+    writer.append(p.data(), c.data(), nullptr, p.size());
+    writer.finish();
+}
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_SCAN */
@@ -0,0 +1,117 @@
+/**
+ * scan.hpp
+ * Viewer of point cloud files, and saving the live cloud to one.
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_SCAN_H
+#define RSSCANNER_POINTCLOUD_SCAN_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "preview.hpp"
+#include "graphic/RenderTarget.hpp"
+#include "processing/cloud_file.hpp"
+#include "processing/node_loader.hpp"
+
+class ShaderProgram;
+class UniformBuffer;
+
+/// \class scan_view
+/// Out of core viewer of a cloud_file: the file stays mapped, and only the
+/// blocks the camera needs are read (by node_loader threads) and kept on the
+/// GPU, within `memory_budget` bytes, evicting the least recently drawn.
+/// Every frame the visible blocks are ranked by their size on screen; in a
+/// partitioned file (cloud_file::is_tree()) the tree is refined only below
+/// nodes larger than `detail_px`, so far away parts load coarse samples.
+/// Opening only reads the file index, and the frame never waits for I/O:
+/// missing blocks are drawn as soon as they arrive.
+class scan_view
+{
+public:
+    scan_view();
+    ~scan_view();
+
+    // Replace the current file, throws std::runtime_error if it can't be read
+    void open(const std::string& path);
+    void close();
+    bool is_open() const { return file != nullptr; }
+
+    // Pick blocks, upload the loaded ones, draw into a width x height target
+    void render(int width, int height);
+
+    GLuint get_gl_handle() const { return target.getTexture(); }
+
+    pcview_state view;                      // camera around the scan
+    size_t memory_budget = size_t(512) << 20;  // bytes of blocks kept on the GPU
+    float detail_px = 200.f;                // refine tree nodes larger than this on screen
+    double upload_budget_ms = 4.0;          // block uploads per frame
+
+    const cloud_file* get_file() const { return file.get(); }
+    size_t resident_blocks() const { return lru.size(); }
+    size_t resident_bytes() const { return gpu_bytes; }
+    size_t resident_points() const { return gpu_points; }
+    size_t staged_bytes() const { return loader ? loader->ready_bytes() : 0; }
+    size_t loading() const { return loader ? loader->queued() + loader->in_flight() : 0; }
+    size_t visible_blocks() const { return visible.size(); }
+    float hit_rate() const { return hits; }  // visible blocks that were resident, smoothed
+    double open_ms() const { return index_ms; }          // opening and reading the index
+    double first_points_ms() const { return first_ms; }  // open() to the first draw with points, -1 before
+
+private:
+    struct node
+    {
+        GLuint buffer = 0;
+        size_t bytes = 0;
+        unsigned long long drawn = 0;        // last frame it was visible
+        std::list<uint32_t>::iterator lru_pos;  // valid while buffer != 0
+    };
+    struct candidate
+    {
+        uint32_t block;
+        float px;   // radius on screen
+    };
+
+    std::unique_ptr<cloud_file> file;
+    std::unique_ptr<node_loader> loader;
+    std::vector<node> nodes;
+    std::list<uint32_t> lru;        // resident blocks, least recently drawn first
+    size_t gpu_bytes = 0;
+    size_t gpu_points = 0;
+    unsigned long long frame = 0;
+    float hits = 0.f;
+    double index_ms = 0;
+    double first_ms = -1;
+    double opened_at = 0;
+
+    // per frame scratch, kept for its storage
+    std::vector<candidate> visible;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> wanted;
+    std::vector<uint8_t> staging;
+
+    RenderTarget target;
+    std::unique_ptr<ShaderProgram> program;
+    std::unique_ptr<UniformBuffer> camera;
+    GLuint vao = 0;
+
+    void init_gl();
+    void select(const glm::mat4& model_view, const glm::mat4& mvp, int height);
+    void upload_blocks();
+    void evict(uint32_t block);
+};
+
+// The points of `points` that have depth, with their colors sampled from
+// `color` through the texture coordinates (RGBA8, bytes in r, g, b, a order).
+// Points with a nonzero entry in `removed` are left out.
+extern void colored_points(const rs2::points& points, const rs2::video_frame& color,
+                           std::vector<float3>& positions, std::vector<uint32_t>& colors,
+                           const uint8_t* removed = nullptr);
+
+// Write colored_points() to a cloud file
+extern void save_points(const std::string& path, const rs2::points& points, const rs2::video_frame& color,
+                        const uint8_t* removed = nullptr);
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_SCAN_H */
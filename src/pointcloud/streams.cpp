@@ -0,0 +1,310 @@
+/**
+ * streams.cpp
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_STREAMS
+#define RSSCANNER_POINTCLOUD_STREAMS
+
+#include "streams.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "graphic/GLState.hpp"
+#include "graphic/Shader.hpp"
+#include "utils/glDebug.hpp"
+
+namespace
+{
+    // per instance attributes of the grid shader
+    struct tile
+    {
+        float rect[4];
+        float uv_scale[2];
+        float layer;
+        float mono;
+    };
+}
+
+stream_grid::stream_grid()
+{
+}
+
+stream_grid::~stream_grid()
+{
+    GLState::deleteVertexArray(vao);
+    GLState::deleteBuffer(quad_vbo);
+    GLState::deleteBuffer(instance_vbo);
+    GLState::deleteTexture(frames_array);
+}
+
+void stream_grid::init_gl()
+{
+    program.reset(new ShaderProgram({
+        Shader("assets/shaders/stream_grid.vert", GL_VERTEX_SHADER),
+        Shader("assets/shaders/stream_grid.frag", GL_FRAGMENT_SHADER)
+    }));
+
+    const float corners[] = { 0.f, 0.f, 0.f, 1.f, 1.f, 0.f, 1.f, 1.f };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &quad_vbo);
+    glGenBuffers(1, &instance_vbo);
+
+    GLState::bindVertexArray(vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, quad_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    program->setAttribute("corner", 2, 0, 0);
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    program->setAttribute("rect", 4, sizeof(tile), offsetof(tile, rect));
+    program->setAttribute("uv_scale", 2, sizeof(tile), offsetof(tile, uv_scale));
+    program->setAttribute("layer", 1, sizeof(tile), offsetof(tile, layer));
+    program->setAttribute("mono", 1, sizeof(tile), offsetof(tile, mono));
+    glVertexAttribDivisor(program->attribute("rect"), 1);
+    glVertexAttribDivisor(program->attribute("uv_scale"), 1);
+    glVertexAttribDivisor(program->attribute("layer"), 1);
+    glVertexAttribDivisor(program->attribute("mono"), 1);
+
+    glGenTextures(1, &frames_array);
+}
+
+void stream_grid::render(const rs2::frameset& frames, int width, int height)
+{
+    frame_vector<rs2::video_frame> supported_frames;
+    for (auto f : frames)
+    {
+        if (can_render(f))
+            supported_frames.push_back(f);
+    }
+    if (supported_frames.empty() || width <= 0 || height <= 0)
+        return;
+
+    std::sort(supported_frames.begin(), supported_frames.end(), [](rs2::frame first, rs2::frame second)
+        { return first.get_profile().stream_type() < second.get_profile().stream_type();  });
+
+    if (!program)
+        init_gl();
+
+    // every stream keeps its own layer, sized for the largest frame
+    int max_w = layer_width, max_h = layer_height;
+    for (auto& f : supported_frames)
+    {
+        max_w = std::max(max_w, f.get_width());
+        max_h = std::max(max_h, f.get_height());
+    }
+    // the streams seen before keep their layers, new ones take those of
+    // the streams gone
+    for (auto& s : slots)
+        s.used = false;
+    frame_vector<int> layers;
+    layers.reserve(supported_frames.size());
+    for (auto& f : supported_frames)
+        layers.push_back(find_slot(f));
+    for (size_t i = 0; i < supported_frames.size(); i++)
+        if (layers[i] < 0)
+            layers[i] = free_slot(supported_frames[i]);
+    reserve_layers((int)slots.size(), max_w, max_h);
+
+    last_uploads = last_skipped = 0;
+    for (size_t i = 0; i < supported_frames.size(); i++)
+    {
+        auto& f = supported_frames[i];
+        slot& s = slots[layers[i]];
+        int id = f.get_profile().unique_id();
+        if (s.unique_id == id && s.frame_number == f.get_frame_number() && s.width == f.get_width() &&
+            s.height == f.get_height())
+        {
+            last_skipped++;
+            continue;
+        }
+        upload(f, layers[i]);
+        s.unique_id = id;
+        s.frame_number = f.get_frame_number();
+        s.width = f.get_width();
+        s.height = f.get_height();
+        s.mono = f.get_profile().format() == RS2_FORMAT_Y8;
+        last_uploads++;
+    }
+
+    // one instance per tile of the grid
+    auto image_grid = calc_grid(float2{ (float)width, (float)height }, supported_frames);
+    frame_vector<tile> tiles(supported_frames.size());
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        const rect& r = image_grid[i];
+        const slot& s = slots[layers[i]];
+        tile t = { { r.x, r.y, r.w, r.h },
+                   { float(s.width) / layer_width, float(s.height) / layer_height },
+                   float(layers[i]), s.mono ? 1.f : 0.f };
+        tiles[i] = t;
+    }
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    if (tiles.size() > instance_capacity)
+    {
+        instance_capacity = tiles.size();
+        glBufferData(GL_ARRAY_BUFFER, instance_capacity * sizeof(tile), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, tiles.size() * sizeof(tile), tiles.data());
+    gl_count_upload(tiles.size() * sizeof(tile));
+
+    target.resize(width, height);
+    target.bind();
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    GLState::disable(GL_DEPTH_TEST);
+
+    program->use();
+    program->setUniform("viewport", glm::vec2(width, height));
+    program->setUniform("frames", 0);
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, frames_array);
+    GLState::bindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)tiles.size());
+    gl_count_draw();
+
+    target.unbind();
+}
+
+int stream_grid::find_slot(const rs2::video_frame& frame)
+{
+    rs2::stream_profile profile = frame.get_profile();
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        slot& s = slots[i];
+        if (!s.used && s.stream == profile.stream_type() && s.index == profile.stream_index())
+        {
+            s.used = true;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int stream_grid::free_slot(const rs2::video_frame& frame)
+{
+    rs2::stream_profile profile = frame.get_profile();
+    slot s = { profile.stream_type(), profile.stream_index(), -1, ~0ull, 0, 0, false, true };
+    for (size_t i = 0; i < slots.size(); i++)
+        if (!slots[i].used)
+        {
+            slots[i] = s;
+            return (int)i;
+        }
+    slots.push_back(s);
+    return (int)slots.size() - 1;
+}
+
+void stream_grid::reserve_layers(int count, int width, int height)
+{
+    if (count <= layer_count && width <= layer_width && height <= layer_height)
+        return;
+
+    // reallocating the array drops its content, every layer is uploaded again
+    layer_count = std::max(count, layer_count);
+    layer_width = width;
+    layer_height = height;
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, frames_array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layer_width, layer_height, layer_count,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    for (auto& s : slots)
+        s.frame_number = ~0ull;
+}
+
+void stream_grid::upload(const rs2::video_frame& frame, int layer)
+{
+    GLenum format;
+    int bpp;
+    const void* data = frame.get_data();
+    int row_length = 0;
+    switch (frame.get_profile().format())
+    {
+    case RS2_FORMAT_RGB8:  format = GL_RGB;  bpp = 3; break;
+    case RS2_FORMAT_RGBA8: format = GL_RGBA; bpp = 4; break;
+    case RS2_FORMAT_Y8:    format = GL_RED;  bpp = 1; break;
+    default:
+        convert_to_rgba(frame, rgba, colorizer);
+        data = rgba.data();
+        format = GL_RGBA;
+        bpp = 0;
+        break;
+    }
+    if (bpp)
+        row_length = frame.get_stride_in_bytes() / bpp;
+
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, frames_array);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, frame.get_width(), frame.get_height(), 1,
+                    format, GL_UNSIGNED_BYTE, data);
+    gl_count_upload(bpp ? size_t(frame.get_stride_in_bytes()) * frame.get_height() : rgba.size());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+bool stream_grid::can_render(const rs2::frame& f)
+{
+    auto format = f.get_profile().format();
+    switch (format)
+    {
+    case RS2_FORMAT_RGB8:
+    case RS2_FORMAT_RGBA8:
+    case RS2_FORMAT_Y8:
+        return true;
+    default:
+        return needs_conversion(format);
+    }
+}
+
+rect stream_grid::calc_grid(float2 window, size_t streams)
+{
+    if (window.x <= 0 || window.y <= 0 || streams <= 0)
+        throw std::runtime_error("invalid window configuration request, failed to calculate window grid");
+    float ratio = window.x / window.y;
+    auto x = sqrt(ratio * (float)streams);
+    auto y = (float)streams / x;
+    auto w = round(x);
+    auto h = round(y);
+    if (w == 0 || h == 0)
+        throw std::runtime_error("invalid window configuration request, failed to calculate window grid");
+    while (w*h > streams)
+        h > w ? h-- : w--;
+    while (w*h < streams)
+        h > w ? w++ : h++;
+    auto new_w = round(window.x / w);
+    auto new_h = round(window.y / h);
+    return rect{ w, h, new_w, new_h}; //column count, line count, cell width cell height
+}
+
+frame_vector<rect> stream_grid::calc_grid(float2 window, frame_vector<rs2::video_frame>& frames)
+{
+    auto grid = calc_grid(window, frames.size());
+
+    int index = 0;
+    frame_vector<rect> rv;
+    rv.reserve(frames.size());
+    int curr_line = -1;
+    for (auto& f  : frames)
+    {
+        auto mod = index % (int)grid.x;
+        auto fw = (float)f.get_width();
+        auto fh = (float)f.get_height();
+
+        float cell_x_postion = (float)(mod * grid.w);
+        if (mod == 0) curr_line++;
+        float cell_y_position = curr_line * grid.h;
+
+        auto r = rect{ cell_x_postion, cell_y_position, grid.w, grid.h };
+        rv.push_back(r.adjust_ratio(float2{ fw, fh }));
+        index++;
+    }
+
+    return rv;
+}
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_STREAMS */
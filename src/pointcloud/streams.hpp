@@ -0,0 +1,76 @@
+/**
+ * streams.hpp
+ * Tiled display of every video stream of a frameset.
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_STREAMS_H
+#define RSSCANNER_POINTCLOUD_STREAMS_H
+
+#include <memory>
+#include <vector>
+
+#include "preview.hpp"
+#include "graphic/RenderTarget.hpp"
+#include "utils/frameArena.hpp"
+
+class ShaderProgram;
+
+/// \class stream_grid
+/// All streams are uploaded into the layers of one texture array and the
+/// whole grid is drawn with a single instanced draw call, one instance per
+/// tile. A stream whose frame number did not change keeps its layer as is.
+/// Layers belong to a stream type and index, and the layers of the streams
+/// missing from a frameset are handed to new ones, so that restarting the
+/// pipeline with other profiles does not grow the array.
+class stream_grid
+{
+public:
+    stream_grid();
+    ~stream_grid();
+
+    // Draw the renderable frames of `frames` tiled over a width x height target
+    void render(const rs2::frameset& frames, int width, int height);
+
+    GLuint get_gl_handle() const { return target.getTexture(); }
+
+    int uploads() const { return last_uploads; }   // layers updated by the last render()
+    int skipped() const { return last_skipped; }   // streams whose frame did not change
+
+private:
+    struct slot
+    {
+        rs2_stream stream;                // stream the layer belongs to
+        int index;
+        int unique_id;                    // profile of the frame it holds
+        unsigned long long frame_number;
+        int width, height;
+        bool mono;
+        bool used;                        // by the frameset being drawn
+    };
+
+    RenderTarget target;
+    std::unique_ptr<ShaderProgram> program;
+    GLuint frames_array = 0;
+    GLuint vao = 0;
+    GLuint quad_vbo = 0;
+    GLuint instance_vbo = 0;
+    size_t instance_capacity = 0;
+    int layer_width = 0, layer_height = 0, layer_count = 0;
+    std::vector<slot> slots;
+    int last_uploads = 0;
+    int last_skipped = 0;
+    std::vector<uint8_t> rgba;       // conversion scratch, kept across frames
+    depth_colorizer colorizer;
+
+    void init_gl();
+    int find_slot(const rs2::video_frame& frame);
+    int free_slot(const rs2::video_frame& frame);
+    void reserve_layers(int count, int width, int height);
+    void upload(const rs2::video_frame& frame, int layer);
+
+    static bool can_render(const rs2::frame& f);
+    static rect calc_grid(float2 window, size_t streams);
+    static frame_vector<rect> calc_grid(float2 window, frame_vector<rs2::video_frame>& frames);
+};
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_STREAMS_H */
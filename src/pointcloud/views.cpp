@@ -0,0 +1,175 @@
+/**
+ * views.cpp
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_VIEWS
+#define RSSCANNER_POINTCLOUD_VIEWS
+
+#include "views.hpp"
+
+#include <algorithm>
+
+#include "graphic/GLState.hpp"
+#include "graphic/Shader.hpp"
+#include "graphic/UniformBuffer.hpp"
+#include "utils/glDebug.hpp"
+#include "processing/kernels.hpp"
+
+live_views::live_views()
+{
+}
+
+live_views::~live_views()
+{
+    GLState::deleteBuffer(buffer);
+    GLState::deleteVertexArray(vao);
+}
+
+live_views::view& live_views::add_view(const std::string& name, double yaw, double pitch)
+{
+    views.emplace_back(new view());
+    view& v = *views.back();
+    v.name = name;
+    v.state.yaw = yaw;
+    v.state.pitch = pitch;
+    return v;
+}
+
+void live_views::remove_view(const view& v)
+{
+    views.erase(std::remove_if(views.begin(), views.end(),
+                               [&](const std::unique_ptr<view>& p) { return p.get() == &v; }),
+                views.end());
+}
+
+void live_views::init_gl()
+{
+    program.reset(new ShaderProgram({
+        Shader("assets/shaders/live_points.vert", GL_VERTEX_SHADER),
+        Shader("assets/shaders/live_points.frag", GL_FRAGMENT_SHADER)
+    }));
+    program->setUniformBlock("Camera", camera_binding);
+    camera.reset(new UniformBuffer(sizeof(camera_block)));
+    glGenVertexArrays(1, &vao);
+}
+
+void live_views::upload(unsigned long long frame_number, const rs2::points& points, size_t point_budget,
+                        const uint8_t* hidden, const uint8_t* tinted)
+{
+    if (frame_number == frame)
+        return;
+    frame = frame_number;
+    count = 0;
+    if (!points)
+        return;
+
+    // thin the cloud evenly to stay within the point budget
+    size_t n = points.size();
+    size_t step = 1;
+    if (point_budget > 0)
+        step = std::max<size_t>(1, (n + point_budget - 1) / point_budget);
+    // only the points we have depth data for, gathered by the widest kernel the CPU runs
+    size_t room = n / step + 1;
+    vertices.resize(room);
+    tex_coords.resize(room);
+    if (tinted)
+        colors.resize(room);
+    count = active_kernels().gather_visible(reinterpret_cast<const float3*>(points.get_vertices()),
+                                            reinterpret_cast<const float2*>(points.get_texture_coordinates()),
+                                            hidden, tinted, n, step, vertices.data(), tex_coords.data(),
+                                            tinted ? colors.data() : nullptr);
+    has_colors = tinted != nullptr;
+
+    // positions in [0, capacity), texture coordinates and tint colors after
+    // them; the buffer is orphaned, the views of the last frame may still
+    // be drawing from it
+    if (!buffer)
+        glGenBuffers(1, &buffer);
+    if (count > capacity)
+        capacity = std::max(count, capacity * 2);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * (sizeof(float3) + sizeof(float2) + sizeof(uint32_t)), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(float3), vertices.data());
+    glBufferSubData(GL_ARRAY_BUFFER, capacity * sizeof(float3), count * sizeof(float2), tex_coords.data());
+    if (has_colors)
+        glBufferSubData(GL_ARRAY_BUFFER, capacity * (sizeof(float3) + sizeof(float2)), count * sizeof(uint32_t),
+                        colors.data());
+    gl_count_upload(count * (sizeof(float3) + sizeof(float2) + (has_colors ? sizeof(uint32_t) : 0)));
+}
+
+bool live_views::render(canvas& v, const pcview_state& state, GLuint texture, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    glm::mat4 mvp = pc_projection((float)width, (float)height) * pc_view(state);
+    float point_size = state.point_size * width / 640.f;
+    if (v.drawn_frame == frame && v.target.getWidth() == width && v.target.getHeight() == height &&
+        v.drawn_mvp == mvp && v.drawn_point_size == point_size)
+    {
+        frame_kept++;
+        return false;
+    }
+    if (!program)
+        init_gl();
+
+    v.target.resize(width, height);
+    v.target.bind();
+    glClearColor(153.f / 255, 153.f / 255, 153.f / 255, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (count)
+    {
+        camera_block cam = {};
+        cam.mvp = mvp;
+        cam.point_size = point_size;
+        camera->update(&cam, sizeof(cam));
+        camera->bind(camera_binding);
+
+        GLState::enable(GL_DEPTH_TEST);
+        GLState::enable(GL_PROGRAM_POINT_SIZE);
+        program->use();
+        program->setUniform("color_frame", 0);
+        GLState::activeTexture(GL_TEXTURE0);
+        GLState::bindTexture(GL_TEXTURE_2D, texture);
+        GLState::bindVertexArray(vao);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+        program->setAttribute("position", 3, 0, 0);
+        program->setAttribute("tex_coord", 2, 0, GLuint(capacity * sizeof(float3)));
+        if (has_colors)
+            program->setAttribute("color", 4, 0, GLuint(capacity * (sizeof(float3) + sizeof(float2))),
+                                  GL_TRUE, GL_UNSIGNED_BYTE);
+        else
+        {
+            // untinted: the attribute's current value, white
+            GLint color = program->attribute("color");
+            glDisableVertexAttribArray(color);
+            glVertexAttrib4f(color, 1.f, 1.f, 1.f, 1.f);
+        }
+        glDrawArrays(GL_POINTS, 0, GLsizei(count));
+        gl_count_draw();
+    }
+    v.target.unbind();
+
+    v.drawn_frame = frame;
+    v.drawn_mvp = mvp;
+    v.drawn_point_size = point_size;
+    frame_drawn++;
+    return true;
+}
+
+void live_views::texture_changed()
+{
+    preview.drawn_frame = ~0ull;
+    for (auto& v : views)
+        v->drawn_frame = ~0ull;
+}
+
+void live_views::end_frame()
+{
+    last_drawn = frame_drawn;
+    last_kept = frame_kept;
+    frame_drawn = frame_kept = 0;
+}
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_VIEWS */
@@ -0,0 +1,108 @@
+/**
+ * views.hpp
+ * Several cameras on the live point cloud, sharing one upload.
+ */
+
+#ifndef RSSCANNER_POINTCLOUD_VIEWS_H
+#define RSSCANNER_POINTCLOUD_VIEWS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "preview.hpp"
+#include "graphic/RenderTarget.hpp"
+
+class ShaderProgram;
+class UniformBuffer;
+
+/// \class live_views
+/// The points of the live cloud the Preview shows, gathered and uploaded
+/// once per camera frame into one vertex buffer, and the views drawing it:
+/// the Preview itself (render_preview()) and any number of extra cameras,
+/// each with its own pcview_state and render target. A view costs one
+/// uniform update and one draw call, and is only redrawn when it is shown
+/// and the cloud, its camera or its size changed since its last draw.
+class live_views
+{
+public:
+    // A render target and the image it holds
+    struct canvas
+    {
+        RenderTarget target;
+        unsigned long long drawn_frame = ~0ull;
+        glm::mat4 drawn_mvp;
+        float drawn_point_size = 0.f;
+    };
+
+    struct view : canvas
+    {
+        std::string name;
+        pcview_state state;
+        bool open = false;
+    };
+
+    live_views();
+    ~live_views();
+
+    // A new view named `name` on the cloud, closed, looking from
+    // `yaw`, `pitch`; it stays valid until remove_view()
+    view& add_view(const std::string& name, double yaw = 15.0, double pitch = 15.0);
+    void remove_view(const view& v);
+
+    // Gather the points of camera frame `frame` with depth, thinned to
+    // `point_budget` (0 for all), without the nonzero `hidden` entries and
+    // with the nonzero `tinted` ones in green; both may be null. A frame
+    // already uploaded is skipped.
+    void upload(unsigned long long frame, const rs2::points& points, size_t point_budget,
+                const uint8_t* hidden, const uint8_t* tinted);
+
+    // Draw the uploaded points into the target of `v`, textured with the
+    // color frame `texture`. False when the target already held this image.
+    bool render(view& v, GLuint texture, int width, int height)
+    {
+        return render(v, v.state, texture, width, height);
+    }
+
+    // The same for the Preview, whose camera is `state`, into preview
+    bool render_preview(const pcview_state& state, GLuint texture, int width, int height)
+    {
+        return render(preview, state, texture, width, height);
+    }
+
+    size_t points() const { return count; }
+
+    // The color texture changed under the same points: every view is
+    // redrawn at its next render()
+    void texture_changed();
+
+    canvas preview;  // target of the Preview window
+    std::vector<std::unique_ptr<view>> views;
+
+    // views drawn and kept unchanged since the last end_frame()
+    void end_frame();
+    unsigned drawn() const { return last_drawn; }
+    unsigned kept() const { return last_kept; }
+
+private:
+    GLuint buffer = 0;
+    size_t capacity = 0;       // points the buffer holds
+    size_t count = 0;          // points uploaded
+    bool has_colors = false;   // a tint color per point after the texture coordinates
+    unsigned long long frame = ~0ull;   // camera frame uploaded
+
+    std::unique_ptr<ShaderProgram> program;
+    std::unique_ptr<UniformBuffer> camera;
+    GLuint vao = 0;
+    unsigned frame_drawn = 0, frame_kept = 0, last_drawn = 0, last_kept = 0;
+
+    // gathered points, kept for their storage
+    std::vector<float3> vertices;
+    std::vector<float2> tex_coords;
+    std::vector<uint32_t> colors;
+
+    void init_gl();
+    bool render(canvas& c, const pcview_state& state, GLuint texture, int width, int height);
+};
+
+#endif /* end of include guard: RSSCANNER_POINTCLOUD_VIEWS_H */
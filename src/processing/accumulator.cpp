@@ -0,0 +1,289 @@
+/**
+ * accumulator.cpp
+ */
+
+#include "accumulator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "spill.hpp"
+
+using namespace std;
+
+namespace
+{
+    // Index blocks are 32^3 voxels, 512 words of occupancy bits
+    const int block_shift = 5;
+    const size_t block_words = size_t(1) << (3 * block_shift) >> 6;
+    const size_t block_bytes = block_words * sizeof(uint64_t);
+
+    // Rough memory of a hash map entry, resident or not
+    const size_t entry_bytes = 64;
+
+    // 21 bits per axis, centered so that negative coordinates work
+    inline uint64_t voxel_coord(float v, float inv)
+    {
+        const int64_t bias = int64_t(1) << 20;
+        return uint64_t(int64_t(floor(v * inv)) + bias) & 0x1fffff;
+    }
+
+    inline bool overlaps(const float3& alo, const float3& ahi, const float3& blo, const float3& bhi)
+    {
+        return alo.x <= bhi.x && blo.x <= ahi.x && alo.y <= bhi.y && blo.y <= ahi.y &&
+               alo.z <= bhi.z && blo.z <= ahi.z;
+    }
+
+    inline void grow(float3& lo, float3& hi, const float3& p)
+    {
+        lo.x = min(lo.x, p.x); hi.x = max(hi.x, p.x);
+        lo.y = min(lo.y, p.y); hi.y = max(hi.y, p.y);
+        lo.z = min(lo.z, p.z); hi.z = max(hi.z, p.z);
+    }
+}
+
+shared_ptr<const scene_chunk> page_in(const shared_ptr<const scene_chunk>& chunk)
+{
+    if (!chunk->spilled)
+        return chunk;
+    vector<uint8_t> record;
+    chunk->file->read(chunk->offset, chunk->bytes, record);
+    shared_ptr<scene_chunk> c = make_shared<scene_chunk>();
+    c->id = chunk->id;
+    c->positions.resize(chunk->spilled);
+    c->colors.resize(chunk->spilled);
+    decode_points(record.data(), record.size(), chunk->spilled, c->positions.data(), c->colors.data());
+    return c;
+}
+
+accumulator::accumulator(float voxel_size, size_t chunk_points)
+    : voxel_size(voxel_size), chunk_points(max<size_t>(chunk_points, 1))
+{
+    clear();
+}
+
+void accumulator::clear()
+{
+    count = 0;
+    adds = 0;
+    lo = float3{ 0.f, 0.f, 0.f };
+    hi = lo;
+    view_lo = view_hi = lo;
+    blocks.clear();
+    full.clear();
+    bounds.clear();
+    open.reset(new scene_chunk());
+    open->id = 0;
+    spill.reset();   // versions still reading it keep it open
+    size_t keep = budget;
+    stats = accumulator_memory();
+    stats.budget = keep;
+}
+
+void accumulator::set_memory_budget(size_t bytes, const string& path)
+{
+    budget = bytes;
+    stats.budget = bytes;
+    scratch_path = path;   // for the next scratch file, an open one stays
+}
+
+accumulator_memory accumulator::memory() const
+{
+    accumulator_memory m = stats;
+    m.scratch_bytes = spill ? size_t(spill->size()) : 0;
+    m.resident_bytes += blocks.size() * entry_bytes + open->positions.capacity() * sizeof(float3) +
+                        open->colors.capacity() * sizeof(uint32_t);
+    return m;
+}
+
+accumulator::index_block& accumulator::touch(uint64_t key)
+{
+    index_block& b = blocks[key];
+    b.touched = adds;
+    if (!b.bits)
+    {
+        b.bits.reset(new uint64_t[block_words]());
+        if (b.bytes)
+        {
+            auto start = chrono::steady_clock::now();
+            spill->read(b.offset, b.bytes, record);
+            decode_voxels(record.data(), record.size(), b.bits.get(), block_words);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            stats.page_ins++;
+            stats.page_in_ms += (ms - stats.page_in_ms) / double(stats.page_ins);
+            stats.max_page_in_ms = max(stats.max_page_in_ms, ms);
+            stats.spilled_blocks--;
+        }
+        stats.resident_bytes += block_bytes;
+    }
+    return b;
+}
+
+void accumulator::add(const float3* positions, const uint32_t* colors, size_t n)
+{
+    float inv = 1.f / voxel_size;
+    adds++;
+    index_block* block = nullptr;
+    uint64_t block_key = ~uint64_t(0);
+    const uint64_t local_mask = (uint64_t(1) << block_shift) - 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        const float3& p = positions[i];
+        if (i == 0)
+            view_lo = view_hi = p;
+        grow(view_lo, view_hi, p);
+
+        uint64_t x = voxel_coord(p.x, inv), y = voxel_coord(p.y, inv), z = voxel_coord(p.z, inv);
+        uint64_t key = (x >> block_shift) | (y >> block_shift) << 16 | (z >> block_shift) << 32;
+        if (key != block_key)
+        {
+            // consecutive points of a frame are mostly in the same block
+            block = &touch(key);
+            block_key = key;
+        }
+        uint64_t bit = (x & local_mask) | (y & local_mask) << block_shift | (z & local_mask) << (2 * block_shift);
+        uint64_t& word = block->bits[bit >> 6];
+        uint64_t mask = uint64_t(1) << (bit & 63);
+        if (word & mask)
+            continue;
+        word |= mask;
+        block->dirty = true;
+
+        if (count == 0)
+            lo = hi = p;
+        grow(lo, hi, p);
+        if (open->positions.empty())
+            open_lo = open_hi = p;
+        grow(open_lo, open_hi, p);
+        open->positions.push_back(p);
+        open->colors.push_back(colors ? colors[i] : 0xffccccccu);
+        count++;
+
+        if (open->positions.size() == chunk_points)
+        {
+            uint32_t id = open->id;
+            stats.resident_bytes += chunk_points * (sizeof(float3) + sizeof(uint32_t));
+            full.push_back(shared_ptr<const scene_chunk>(open.release()));
+            bounds.push_back(chunk_bounds{ open_lo, open_hi, adds });
+            open.reset(new scene_chunk());
+            open->id = id + 1;
+            open->positions.reserve(chunk_points);
+            open->colors.reserve(chunk_points);
+        }
+    }
+    if (budget && memory().resident_bytes > budget)
+        evict();
+}
+
+void accumulator::spill_block(index_block& b)
+{
+    if (b.dirty || !b.bytes)
+    {
+        encode_voxels(b.bits.get(), block_words, record);
+        stats.spilled_bytes -= b.bytes;
+        if (record.size() <= b.capacity)
+            spill->rewrite(b.offset, record);
+        else
+        {
+            // with room to grow by a quarter, so that a block filling up
+            // moves a few times at most; the old copy is left behind
+            b.capacity = min(record.size() + record.size() / 4 + 16, 1 + block_bytes);
+            b.offset = spill->append(record, b.capacity);
+        }
+        b.bytes = record.size();
+        b.dirty = false;
+        stats.spilled_bytes += b.bytes;
+    }
+    b.bits.reset();
+    stats.resident_bytes -= block_bytes;
+    stats.spilled_blocks++;
+}
+
+void accumulator::spill_chunk(size_t i)
+{
+    const scene_chunk& c = *full[i];
+    encode_points(c.positions.data(), c.colors.data(), c.positions.size(), record);
+    shared_ptr<scene_chunk> stub = make_shared<scene_chunk>();
+    stub->id = c.id;
+    stub->spilled = c.positions.size();
+    stub->file = spill;
+    stub->offset = spill->append(record);
+    stub->bytes = record.size();
+    stats.spilled_bytes += stub->bytes;
+    stats.resident_bytes -= stub->spilled * (sizeof(float3) + sizeof(uint32_t));
+    stats.spilled_chunks++;
+    full[i] = stub;   // versions holding the points keep them until they go
+}
+
+void accumulator::evict()
+{
+    if (!spill)
+        spill = make_shared<spill_file>(scratch_path);
+
+    // out of the region of the last add() first, then least recently used;
+    // the blocks that add() touched are never candidates
+    struct victim
+    {
+        bool in_view;
+        uint64_t touched;
+        index_block* block;
+        size_t chunk;
+    };
+    vector<victim> victims;
+    const float block_size = voxel_size * float(1 << block_shift);
+    const float bias = float(int64_t(1) << 20) * voxel_size;
+    for (auto& entry : blocks)
+    {
+        index_block& b = entry.second;
+        if (!b.bits || b.touched == adds)
+            continue;
+        float3 blo = float3{ float(entry.first & 0xffff) * block_size - bias,
+                             float(entry.first >> 16 & 0xffff) * block_size - bias,
+                             float(entry.first >> 32 & 0xffff) * block_size - bias };
+        float3 bhi = blo + float3{ block_size, block_size, block_size };
+        victims.push_back(victim{ overlaps(blo, bhi, view_lo, view_hi), b.touched, &b, 0 });
+    }
+    for (size_t i = 0; i < full.size(); i++)
+    {
+        if (full[i]->spilled)
+            continue;
+        chunk_bounds& c = bounds[i];
+        bool in_view = overlaps(c.lo, c.hi, view_lo, view_hi);
+        if (in_view)
+            c.touched = adds;
+        victims.push_back(victim{ in_view, c.touched, nullptr, i });
+    }
+    sort(victims.begin(), victims.end(), [](const victim& a, const victim& b)
+    {
+        return a.in_view != b.in_view ? b.in_view : a.touched < b.touched;
+    });
+
+    // down to 7/8 of the budget, so that this does not run at every add()
+    size_t target = budget - budget / 8;
+    for (const victim& v : victims)
+    {
+        if (memory().resident_bytes <= target)
+            break;
+        if (v.block)
+            spill_block(*v.block);
+        else
+            spill_chunk(v.chunk);
+    }
+}
+
+shared_ptr<const scene> accumulator::take_version(double now_ms)
+{
+    shared_ptr<scene> s = make_shared<scene>();
+    s->version = ++version;
+    s->published_ms = now_ms;
+    s->points = count;
+    s->lo = lo;
+    s->hi = hi;
+    s->chunks.reserve(full.size() + 1);
+    s->chunks = full;
+    if (!open->positions.empty())
+        s->chunks.push_back(make_shared<const scene_chunk>(*open));
+    s->memory = memory();
+    return s;
+}
@@ -0,0 +1,142 @@
+/**
+ * accumulator.hpp
+ * Merges successive point clouds into one model, published as immutable versions.
+ */
+
+#ifndef RSSCANNER_PROCESSING_ACCUMULATOR_H
+#define RSSCANNER_PROCESSING_ACCUMULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "types.hpp"
+
+class spill_file;
+
+// A run of model points. Chunks only grow, and are never modified once
+// published: a version holds a copy of the chunk being filled.
+struct scene_chunk
+{
+    uint32_t id;                     // position in the model, stable across versions
+    std::vector<float3> positions;
+    std::vector<uint32_t> colors;    // RGBA8, bytes in r, g, b, a order
+
+    // A chunk paged out to the scratch file has no positions and colors,
+    // page_in() reads them back
+    size_t spilled = 0;              // its points
+    std::shared_ptr<spill_file> file;
+    uint64_t offset = 0;
+    size_t bytes = 0;
+
+    size_t size() const { return spilled ? spilled : positions.size(); }
+};
+
+// The chunk itself, or a copy of it read back from the scratch file if it
+// was spilled. Throws std::runtime_error when the file can't be read.
+std::shared_ptr<const scene_chunk> page_in(const std::shared_ptr<const scene_chunk>& chunk);
+
+// Memory use of an accumulator, see accumulator::set_memory_budget()
+struct accumulator_memory
+{
+    size_t budget;            // bytes, 0 for no limit
+    size_t resident_bytes;    // voxel index and points in memory, approximately
+    size_t spilled_bytes;     // of the records in the scratch file
+    size_t scratch_bytes;     // size of that file, with the room and the stale copies around them
+    size_t spilled_blocks;    // voxel index blocks paged out
+    size_t spilled_chunks;
+    uint64_t page_ins;        // voxel index blocks read back
+    double page_in_ms;        // average time of one
+    double max_page_in_ms;
+};
+
+// One complete version of the model
+struct scene
+{
+    uint64_t version;
+    double published_ms;             // system clock, see system_time_ms()
+    size_t points;
+    float3 lo, hi;
+    std::vector<std::shared_ptr<const scene_chunk>> chunks;
+    accumulator_memory memory;       // of the accumulator when it was taken
+};
+
+/// \class accumulator
+/// Keeps one point per occupied voxel of `voxel_size`, the first one seen.
+/// Not thread safe: one integrating thread adds points and takes versions,
+/// which it then hands to readers (see snapshot).
+///
+/// The occupied voxels are bitmaps of blocks of 32^3 voxels. With a memory
+/// budget, the coldest index blocks and full chunks, the ones outside the
+/// region the last add() covered and least recently used, are compressed
+/// into a scratch file whenever the budget is exceeded. An index block is
+/// read back as soon as a point falls in it again; chunks stay out, and are
+/// read back by whoever needs their points (page_in()). What the current
+/// frames touch is never spilled, so accumulating within the resident
+/// region runs at full speed.
+class accumulator
+{
+    public:
+        explicit accumulator(float voxel_size = 0.005f, size_t chunk_points = 65536);
+
+        // Merge `n` points; `colors` may be null
+        void add(const float3* positions, const uint32_t* colors, size_t n);
+
+        // Immutable view of everything added so far. Full chunks are shared
+        // with the previous versions, only the partial last one is copied.
+        std::shared_ptr<const scene> take_version(double now_ms);
+
+        size_t points() const { return count; }
+        void clear();
+
+        // Keep the index and the points under about `bytes` of memory, 0 for
+        // no limit, spilling to a file at `scratch_path` (a temporary file
+        // when empty). Takes effect at the next add().
+        void set_memory_budget(size_t bytes, const std::string& scratch_path = std::string());
+        accumulator_memory memory() const;
+
+    private:
+        struct index_block
+        {
+            std::unique_ptr<uint64_t[]> bits;   // null while spilled
+            uint64_t touched = 0;               // last add() that looked a voxel up
+            uint64_t offset = 0;                // copy in the scratch file, if bytes
+            size_t bytes = 0;
+            size_t capacity = 0;                // room for it there
+            bool dirty = true;                  // changed since that copy
+        };
+        struct chunk_bounds
+        {
+            float3 lo, hi;
+            uint64_t touched;                   // last add() whose region it was in
+        };
+
+        float voxel_size;
+        size_t chunk_points;
+        size_t count = 0;
+        uint64_t version = 0;
+        uint64_t adds = 0;
+        float3 lo, hi;
+        float3 view_lo, view_hi;               // region of the last add()
+        std::unordered_map<uint64_t, index_block> blocks;
+        std::vector<std::shared_ptr<const scene_chunk>> full;
+        std::vector<chunk_bounds> bounds;      // of the full chunks
+        std::unique_ptr<scene_chunk> open;
+        float3 open_lo, open_hi;
+
+        size_t budget = 0;
+        std::string scratch_path;
+        std::shared_ptr<spill_file> spill;
+        accumulator_memory stats;
+        std::vector<uint8_t> record;           // encoding scratch
+
+        index_block& touch(uint64_t key);
+        void evict();
+        void spill_block(index_block& b);
+        void spill_chunk(size_t i);
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_ACCUMULATOR_H */
@@ -0,0 +1,185 @@
+/**
+ * align.cpp
+ */
+
+#include "align.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace
+{
+    // Rows of the color image filled by one task
+    const int band_rows = 16;
+
+    // Neighbor pixels at slightly different depths project to footprints
+    // with thin cracks between them, which would leave random holes in a
+    // noisy surface; a quarter pixel more on each side closes them
+    const float footprint_grow = 0.25f;
+
+    inline uint32_t pack_rgba(const uint8_t* px, int bpp)
+    {
+        uint32_t c;
+        memcpy(&c, px, 4);   // the caller keeps the fourth byte of RGB8 in bounds
+        return bpp == 4 ? c : (c & 0x00ffffffu) | 0xff000000u;
+    }
+}
+
+void rgbd_aligner::build(const setup& s)
+{
+    current = s;
+    built = true;
+    const depth_intrinsics& d = s.depth;
+    const float* r = s.extrinsics.rotation;
+
+    // corner (cx, cy) of a depth pixel: R * ((cx - ppx) / fx, (cy - ppy) / fy, 1),
+    // the first term per column, the two others per row
+    columns.resize(size_t(d.width) * 6);
+    for (int x = 0; x < d.width; x++)
+        for (int edge = 0; edge < 2; edge++)
+        {
+            float a = (x - 0.5f + edge - d.ppx) / d.fx;
+            for (int k = 0; k < 3; k++)
+                columns[size_t(edge * 3 + k) * d.width + x] = a * r[k];
+        }
+    rows.resize(size_t(d.height) * 6);
+    for (int y = 0; y < d.height; y++)
+        for (int edge = 0; edge < 2; edge++)
+        {
+            float b = (y - 0.5f + edge - d.ppy) / d.fy;
+            for (int k = 0; k < 3; k++)
+                rows[size_t(y) * 6 + edge * 3 + k] = b * r[3 + k] + r[6 + k];
+        }
+
+    for (int k = 0; k < 6; k++)
+        tables.column[k] = columns.data() + size_t(k) * d.width;
+    tables.row = rows.data();
+    for (int k = 0; k < 3; k++)
+        tables.translation[k] = s.extrinsics.translation[k];
+    tables.fx = s.color.fx;
+    tables.fy = s.color.fy;
+    tables.ppx = s.color.ppx;
+    tables.ppy = s.color.ppy;
+    tables.width = s.color.width;
+    tables.height = s.color.height;
+    tables.grow = footprint_grow;
+
+    row_lo.resize(size_t(d.height));
+    row_hi.resize(size_t(d.height));
+}
+
+void rgbd_aligner::align(const uint16_t* depth, int depth_stride, const depth_intrinsics& depth_intrin,
+                         float depth_scale, const uint8_t* color, int color_stride, int color_bpp,
+                         const depth_intrinsics& color_intrin, const camera_extrinsics& depth_to_color,
+                         rgbd_frame& out)
+{
+    setup s = { depth_intrin, color_intrin, depth_to_color };
+    if (!built || memcmp(&s, &current, sizeof(s)) != 0)
+        build(s);
+
+    const int dw = depth_intrin.width, dh = depth_intrin.height;
+    const int cw = color_intrin.width, ch = color_intrin.height;
+    out.width = cw;
+    out.height = ch;
+    out.pixels.resize(size_t(cw) * ch);
+    if (dw <= 0 || dh <= 0 || cw <= 0 || ch <= 0)
+        return;
+
+    const size_t bands = size_t(ch + band_rows - 1) / band_rows;
+    rects.resize(size_t(dh) * 4 * dw);
+    depths.resize(size_t(dh) * dw);
+    auto align_row = active_kernels().align_row;
+    const uint8_t* depth_bytes = reinterpret_cast<const uint8_t*>(depth);
+
+    // every depth row projected once, and the color rows it reaches
+    parallel_for(0, size_t(dh), 8, [&](size_t b, size_t e)
+    {
+        for (size_t y = b; y < e; y++)
+        {
+            int32_t* u0 = rects.data() + y * 4 * dw;
+            int32_t* v0 = u0 + dw;
+            int32_t* v1 = u0 + 3 * dw;
+            align_row(reinterpret_cast<const uint16_t*>(depth_bytes + y * depth_stride), dw, depth_scale,
+                      tables, int(y), u0, v0, u0 + 2 * dw, v1, depths.data() + y * dw);
+            int lo = ch, hi = -1;
+            for (int x = 0; x < dw; x++)
+                if (u0[x] >= 0)
+                {
+                    lo = min(lo, v0[x]);
+                    hi = max(hi, v1[x]);
+                }
+            row_lo[y] = lo;
+            row_hi[y] = hi;
+        }
+    });
+
+    // each band of color rows from the depth rows reaching it, nearest depth first
+    rgbd_pixel* pixels = out.pixels.data();
+    parallel_blocks(size_t(ch), bands, [&](size_t, size_t b, size_t e)
+    {
+        const int first = int(b), last = int(e) - 1;
+        for (int v = first; v <= last; v++)
+        {
+            const uint8_t* src = color + size_t(v) * color_stride;
+            rgbd_pixel* dst = pixels + size_t(v) * cw;
+            int x = 0;
+            for (; x + 1 < cw; x++)
+                dst[x] = rgbd_pixel{ pack_rgba(src + x * color_bpp, color_bpp), 0.f };
+            uint8_t px[4] = { 0, 0, 0, 0 };   // the last pixel may end the buffer
+            memcpy(px, src + x * color_bpp, size_t(color_bpp));
+            dst[x] = rgbd_pixel{ pack_rgba(px, color_bpp), 0.f };
+        }
+
+        for (int y = 0; y < dh; y++)
+        {
+            if (row_hi[y] < first || row_lo[y] > last)
+                continue;
+            const int32_t* u0 = rects.data() + size_t(y) * 4 * dw;
+            const int32_t* v0 = u0 + dw;
+            const int32_t* u1 = v0 + dw;
+            const int32_t* v1 = u1 + dw;
+            const float* z = depths.data() + size_t(y) * dw;
+            for (int x = 0; x < dw; x++)
+            {
+                if (u0[x] < 0 || v1[x] < first || v0[x] > last)
+                    continue;
+                float d = z[x];
+                int vb = max(v0[x], first), ve = min(v1[x], last);
+                for (int v = vb; v <= ve; v++)
+                {
+                    rgbd_pixel* row = pixels + size_t(v) * cw;
+                    for (int u = u0[x]; u <= u1[x]; u++)
+                        if (row[u].z == 0.f || d < row[u].z)
+                            row[u].z = d;
+                }
+            }
+        }
+    });
+}
+
+void rgbd_points(const rgbd_frame& frame, const depth_intrinsics& color_intrin, float3* points, uint32_t* colors)
+{
+    const float inv_fx = 1.f / color_intrin.fx, inv_fy = 1.f / color_intrin.fy;
+    const int w = frame.width;
+    parallel_for(0, size_t(frame.height), 32, [&](size_t b, size_t e)
+    {
+        for (size_t y = b; y < e; y++)
+        {
+            const rgbd_pixel* src = frame.pixels.data() + y * w;
+            float3* dst = points + y * w;
+            float v = (float(y) - color_intrin.ppy) * inv_fy;
+            for (int x = 0; x < w; x++)
+            {
+                float z = src[x].z;
+                dst[x] = float3{ (float(x) - color_intrin.ppx) * inv_fx * z, v * z, z };
+            }
+            if (colors)
+                for (int x = 0; x < w; x++)
+                    colors[y * w + x] = src[x].color;
+        }
+    });
+}
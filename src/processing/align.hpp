@@ -0,0 +1,87 @@
+/**
+ * align.hpp
+ * Registration of depth frames to the color camera: RGB-D frames.
+ */
+
+#ifndef RSSCANNER_PROCESSING_ALIGN_H
+#define RSSCANNER_PROCESSING_ALIGN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "deproject.hpp"
+#include "kernels.hpp"
+
+// Rigid transform between two cameras, laid out like rs2_extrinsics
+struct camera_extrinsics
+{
+    float rotation[9];      // column major
+    float translation[3];   // meters
+};
+
+// One pixel of a registered frame, color and depth side by side for the
+// stages reading both
+struct rgbd_pixel
+{
+    uint32_t color;   // RGBA8, bytes in r, g, b, a order
+    float z;          // meters along the color camera axis, 0 without depth
+};
+
+struct rgbd_frame
+{
+    int width = 0, height = 0;        // of the color image
+    std::vector<rgbd_pixel> pixels;   // row major, width * height
+};
+
+/// \class rgbd_aligner
+/// Depth to color alignment. Every depth pixel is projected into the color
+/// camera with its footprint, and sets the depth of the color pixels whose
+/// centers it covers (grown by a quarter pixel against cracks); where several
+/// land on the same pixel the nearest one wins, so surfaces hidden from the
+/// color camera do not show through.
+///
+/// The rays are precomputed per column and per row, the projection runs in
+/// the align_row kernel of the widest instruction set, once per depth row,
+/// and the color image is split in bands of rows, each filled by one thread
+/// from the footprints of the depth rows that reach it. Lens distortion is
+/// not modeled.
+class rgbd_aligner
+{
+public:
+    /// Register a Z16 frame (rows `depth_stride` bytes apart) to an RGB8 or
+    /// RGBA8 color frame (`color_bpp` 3 or 4, rows `color_stride` bytes
+    /// apart), into `out` at the color resolution. Tables are rebuilt when
+    /// the intrinsics or the extrinsics change.
+    void align(const uint16_t* depth, int depth_stride, const depth_intrinsics& depth_intrin, float depth_scale,
+               const uint8_t* color, int color_stride, int color_bpp, const depth_intrinsics& color_intrin,
+               const camera_extrinsics& depth_to_color, rgbd_frame& out);
+
+private:
+    struct setup
+    {
+        depth_intrinsics depth, color;
+        camera_extrinsics extrinsics;
+    };
+
+    setup current = {};
+    bool built = false;
+    std::vector<float> columns;   // 6 arrays of depth width floats, see align_tables
+    std::vector<float> rows;      // 6 floats per depth row
+    align_tables tables = {};
+
+    // color rows each depth row reaches, empty when lo > hi
+    std::vector<int> row_lo, row_hi;
+
+    // projected footprints of every depth row: u0, v0, u1, v1 arrays, and z
+    std::vector<int32_t> rects;
+    std::vector<float> depths;
+
+    void build(const setup& s);
+};
+
+/// Points of a registered frame in the color camera, one per pixel
+/// ((0, 0, 0) without depth), with their colors when `colors` is not null
+void rgbd_points(const rgbd_frame& frame, const depth_intrinsics& color_intrin, float3* points, uint32_t* colors);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_ALIGN_H */
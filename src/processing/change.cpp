@@ -0,0 +1,94 @@
+/**
+ * change.cpp
+ */
+
+#include "change.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "kernels.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+void tile_changes::reset()
+{
+    has_reference = false;
+    tiles_seen = tiles_reused = 0;
+}
+
+size_t tile_changes::update(const uint8_t* image, int stride, int width, int height, int bytes_per_pixel,
+                            float threshold)
+{
+    return compare(image, stride, width, height, bytes_per_pixel, false, threshold);
+}
+
+size_t tile_changes::update_depth(const uint16_t* depth, int stride, int width, int height, float threshold)
+{
+    return compare(reinterpret_cast<const uint8_t*>(depth), stride, width, height, 2, true, threshold);
+}
+
+size_t tile_changes::compare(const uint8_t* image, int stride, int width, int height, int bytes_per_pixel,
+                             bool wide, float threshold)
+{
+    size_t row_bytes = size_t(width) * bytes_per_pixel;
+    if (!has_reference || width != image_width || height != image_height || bytes_per_pixel != pixel_bytes)
+    {
+        image_width = width;
+        image_height = height;
+        pixel_bytes = bytes_per_pixel;
+        tile_cols = (width + tile_size - 1) / tile_size;
+        tile_rows = (height + tile_size - 1) / tile_size;
+        reference.resize(row_bytes * height);
+        for (int y = 0; y < height; y++)
+            memcpy(&reference[size_t(y) * row_bytes], image + size_t(y) * stride, row_bytes);
+        flags.assign(size_t(tile_cols) * tile_rows, 1);
+        has_reference = true;
+        changed_tiles = flags.size();
+        tiles_seen += flags.size();
+        return changed_tiles;
+    }
+
+    const cloud_kernels& k = active_kernels();
+    sums.assign(flags.size(), 0u);
+    // a value of a Z16 image is one sample, a byte of the others
+    int samples_per_pixel = wide ? 1 : bytes_per_pixel;
+    parallel_for(0, size_t(tile_rows), 1, [&](size_t b, size_t e)
+    {
+        for (size_t r = b; r < e; r++)
+        {
+            uint32_t* sum = &sums[r * tile_cols];
+            int y0 = row_begin(int(r)), y1 = row_end(int(r));
+            for (int y = y0; y < y1; y++)
+            {
+                const uint8_t* row = image + size_t(y) * stride;
+                const uint8_t* ref = &reference[size_t(y) * row_bytes];
+                if (wide)
+                    k.tile_sad16(reinterpret_cast<const uint16_t*>(ref), reinterpret_cast<const uint16_t*>(row),
+                                 width, tile_size, sum);
+                else
+                    k.tile_sad8(ref, row, int(row_bytes), tile_size * bytes_per_pixel, sum);
+            }
+
+            // the tiles that changed become the reference
+            for (int c = 0; c < tile_cols; c++)
+            {
+                int x0 = c * tile_size, x1 = min(width, x0 + tile_size);
+                double samples = double(x1 - x0) * (y1 - y0) * samples_per_pixel;
+                bool changed = double(sum[c]) > threshold * samples;
+                flags[r * tile_cols + c] = changed;
+                if (!changed)
+                    continue;
+                size_t offset = size_t(x0) * bytes_per_pixel, bytes = size_t(x1 - x0) * bytes_per_pixel;
+                for (int y = y0; y < y1; y++)
+                    memcpy(&reference[size_t(y) * row_bytes + offset], image + size_t(y) * stride + offset, bytes);
+            }
+        }
+    });
+
+    changed_tiles = size_t(count_if(flags.begin(), flags.end(), [](uint8_t f) { return f != 0; }));
+    tiles_seen += flags.size();
+    tiles_reused += flags.size() - changed_tiles;
+    return changed_tiles;
+}
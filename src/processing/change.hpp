@@ -0,0 +1,71 @@
+/**
+ * change.hpp
+ * Per tile change detection between consecutive camera images.
+ */
+
+#ifndef RSSCANNER_PROCESSING_CHANGE_H
+#define RSSCANNER_PROCESSING_CHANGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// \class tile_changes
+/// Splits an image into square tiles and tells which ones changed since
+/// the image last seen: a tile changed when the mean absolute difference
+/// of its samples (bytes, or Z16 values) to the reference passes a
+/// threshold. Only the tiles found changed are copied into the reference,
+/// so a slow drift still adds up to a change, and whatever was last
+/// processed of a tile is never further than the threshold from it.
+///
+/// The sums of absolute differences run in the change kernels of the
+/// widest instruction set, over the tile rows in parallel.
+class tile_changes
+{
+public:
+    // `tile` pixels on a side, at most 64 for the per tile sums to fit
+    explicit tile_changes(int tile = 32) : tile_size(tile) {}
+
+    /// Compare an image of `width` x `height` pixels of `bytes_per_pixel`
+    /// bytes, rows `stride` bytes apart, with the reference. `threshold` is
+    /// the mean difference per byte, 0 to 255. Returns the number of tiles
+    /// changed: all of them on the first image, after reset() or when the
+    /// size or the pixel format changed.
+    size_t update(const uint8_t* image, int stride, int width, int height, int bytes_per_pixel, float threshold);
+
+    /// The same for a Z16 depth image, `threshold` in depth units
+    size_t update_depth(const uint16_t* depth, int stride, int width, int height, float threshold);
+
+    // The next image is all changed
+    void reset();
+
+    int tile() const { return tile_size; }
+    int cols() const { return tile_cols; }
+    int rows() const { return tile_rows; }
+    bool changed(int col, int row) const { return flags[size_t(row) * tile_cols + col] != 0; }
+    size_t changed_count() const { return changed_tiles; }
+    size_t count() const { return flags.size(); }
+
+    // Pixel rows [y0, y1) of tile row `row`
+    int row_begin(int row) const { return row * tile_size; }
+    int row_end(int row) const { return row + 1 < tile_rows ? (row + 1) * tile_size : image_height; }
+
+    // share of the tiles compared since reset() that were unchanged
+    double reused() const { return tiles_seen ? double(tiles_reused) / double(tiles_seen) : 0.0; }
+
+private:
+    int tile_size;
+    int tile_cols = 0, tile_rows = 0;
+    int image_width = 0, image_height = 0, pixel_bytes = 0;
+    bool has_reference = false;
+    std::vector<uint8_t> reference;   // tightly packed rows
+    std::vector<uint32_t> sums;       // per tile
+    std::vector<uint8_t> flags;       // per tile, nonzero when changed
+    size_t changed_tiles = 0;
+    uint64_t tiles_seen = 0, tiles_reused = 0;
+
+    size_t compare(const uint8_t* image, int stride, int width, int height, int bytes_per_pixel,
+                   bool wide, float threshold);
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_CHANGE_H */
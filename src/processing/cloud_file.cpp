@@ -0,0 +1,293 @@
+/**
+ * cloud_file.cpp
+ */
+
+#include "cloud_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "mapped_file.hpp"
+
+using namespace std;
+
+namespace
+{
+    const char file_magic[8] = { 'R', 'S', 'C', 'L', 'O', 'U', 'D', 0 };
+    const uint32_t file_version = 2;
+    const size_t column_size[3] = { sizeof(float3), sizeof(uint32_t), sizeof(float3) };
+
+    struct file_header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t columns;
+        uint32_t block_points;
+        char padding[64 - 20];
+    };
+
+    struct file_footer
+    {
+        uint64_t index_offset;
+        uint64_t block_count;
+        uint64_t points;
+        float3 lo, hi;
+        uint32_t columns;
+        uint32_t version;
+        char magic[8];
+    };
+
+    static_assert(sizeof(file_header) == 64, "file_header is part of the file format");
+    static_assert(sizeof(file_footer) == 64, "file_footer is part of the file format");
+    static_assert(sizeof(cloud_block) == 64, "cloud_block is part of the file format");
+
+    inline void grow(float3& lo, float3& hi, const float3& p)
+    {
+        lo.x = min(lo.x, p.x); hi.x = max(hi.x, p.x);
+        lo.y = min(lo.y, p.y); hi.y = max(hi.y, p.y);
+        lo.z = min(lo.z, p.z); hi.z = max(hi.z, p.z);
+    }
+}
+
+cloud_file_writer::cloud_file_writer(const string& path, uint32_t columns, uint32_t block_points)
+    : path(path), columns((columns | cloud_positions) & ~uint32_t(cloud_tree)), block_points(max(block_points, 1u))
+{
+    out = fopen(path.c_str(), "wb");
+    if (!out)
+        throw runtime_error("cannot create " + path);
+
+    file_header h = {};
+    memcpy(h.magic, file_magic, sizeof(h.magic));
+    h.version = file_version;
+    h.columns = this->columns;
+    h.block_points = this->block_points;
+    write(&h, sizeof(h));
+
+    positions.reserve(this->block_points);
+    if (this->columns & cloud_colors)
+        colors.reserve(this->block_points);
+    if (this->columns & cloud_normals)
+        normals.reserve(this->block_points);
+}
+
+cloud_file_writer::~cloud_file_writer()
+{
+    if (!out)
+        return;
+    try
+    {
+        finish();
+    }
+    catch (const runtime_error&)
+    {
+        // the file stays incomplete, its missing footer makes readers reject it
+    }
+}
+
+void cloud_file_writer::append(const float3* p, const uint32_t* c, const float3* nrm, size_t n)
+{
+    while (n > 0)
+    {
+        size_t take = min<size_t>(n, block_points - positions.size());
+        positions.insert(positions.end(), p, p + take);
+        if (columns & cloud_colors)
+        {
+            if (c)
+                colors.insert(colors.end(), c, c + take);
+            else
+                colors.resize(colors.size() + take, 0u);
+        }
+        if (columns & cloud_normals)
+        {
+            if (nrm)
+                normals.insert(normals.end(), nrm, nrm + take);
+            else
+                normals.resize(normals.size() + take, float3{ 0.f, 0.f, 0.f });
+        }
+        p += take;
+        c = c ? c + take : c;
+        nrm = nrm ? nrm + take : nrm;
+        n -= take;
+        if (positions.size() == block_points)
+            flush_block();
+    }
+}
+
+void cloud_file_writer::flush_block()
+{
+    cloud_block b = {};
+    b.count = static_cast<uint32_t>(positions.size());
+    if (b.count)
+        b.lo = b.hi = positions[0];
+    for (const float3& p : positions)
+        grow(b.lo, b.hi, p);
+
+    const void* data[3] = { positions.data(), colors.data(), normals.data() };
+    for (int c = 0; c < 3; c++)
+    {
+        if (!(columns & (1u << c)))
+            continue;
+        b.offset[c] = offset;
+        write(data[c], b.count * column_size[c]);
+        pad();
+    }
+    blocks.push_back(b);
+    total += b.count;
+
+    positions.clear();
+    colors.clear();
+    normals.clear();
+}
+
+void cloud_file_writer::set_node(size_t i, float3 lo, float3 hi, uint32_t depth,
+                                 uint32_t first_child, uint32_t child_count)
+{
+    cloud_block& b = blocks.at(i);
+    b.lo = lo;
+    b.hi = hi;
+    b.depth = depth;
+    b.first_child = first_child;
+    b.child_count = child_count;
+    tree = true;
+}
+
+void cloud_file_writer::finish()
+{
+    if (!out)
+        return;
+    if (!positions.empty())
+        flush_block();
+
+    file_footer f = {};
+    f.index_offset = offset;
+    f.block_count = blocks.size();
+    f.points = total;
+    bool first = true;
+    for (const cloud_block& b : blocks)
+    {
+        // empty blocks have no bounds, unless they are tree cells
+        if (!b.count && !tree)
+            continue;
+        if (first)
+        {
+            f.lo = b.lo;
+            f.hi = b.hi;
+            first = false;
+        }
+        grow(f.lo, f.hi, b.lo);
+        grow(f.lo, f.hi, b.hi);
+    }
+    f.columns = columns | (tree ? uint32_t(cloud_tree) : 0u);
+    f.version = file_version;
+    memcpy(f.magic, file_magic, sizeof(f.magic));
+
+    write(blocks.data(), blocks.size() * sizeof(cloud_block));
+    pad();
+    write(&f, sizeof(f));
+
+    bool ok = fclose(out) == 0;
+    out = nullptr;
+    if (!ok)
+        throw runtime_error("cannot write " + path);
+}
+
+void cloud_file_writer::write(const void* data, size_t bytes)
+{
+    if (bytes && fwrite(data, 1, bytes, out) != bytes)
+    {
+        fclose(out);
+        out = nullptr;
+        throw runtime_error("cannot write " + path);
+    }
+    offset += bytes;
+}
+
+void cloud_file_writer::pad()
+{
+    static const char zeros[64] = {};
+    write(zeros, size_t(-offset & 63));
+}
+
+cloud_file::cloud_file(const string& path)
+    : file(new mapped_file(path))
+{
+    const uint8_t* data = file->data();
+    size_t size = file->size();
+    file_footer f;
+    if (size < sizeof(file_header) + sizeof(f))
+        throw runtime_error(path + " is not a point cloud file");
+    memcpy(&f, data + size - sizeof(f), sizeof(f));
+    if (memcmp(f.magic, file_magic, sizeof(f.magic)) != 0 || memcmp(data, file_magic, sizeof(f.magic)) != 0)
+        throw runtime_error(path + " is not a point cloud file or was not completely written");
+    if (f.version != file_version)
+        throw runtime_error(path + " was written by another version, convert it again");
+    if (f.index_offset % 8 != 0 || f.index_offset > size - sizeof(f) ||
+        f.block_count > (size - sizeof(f) - f.index_offset) / sizeof(cloud_block))
+        throw runtime_error(path + " has a corrupt index");
+    if (!(f.columns & cloud_positions))
+        throw runtime_error(path + " has no positions");
+
+    column_mask = f.columns;
+    total = f.points;
+    lo = f.lo;
+    hi = f.hi;
+    blocks = reinterpret_cast<const cloud_block*>(data + f.index_offset);
+    nblocks = size_t(f.block_count);
+    // every column before the index, without overflowing on made up offsets or counts
+    for (size_t i = 0; i < nblocks; i++)
+        for (int c = 0; c < 3; c++)
+            if ((column_mask & (1u << c)) && (blocks[i].offset[c] > f.index_offset ||
+                blocks[i].count > (f.index_offset - blocks[i].offset[c]) / column_size[c]))
+                throw runtime_error(path + " has a corrupt index");
+    for (size_t i = 0; i < nblocks && is_tree(); i++)
+        if (blocks[i].child_count && (blocks[i].first_child <= i ||
+            uint64_t(blocks[i].first_child) + blocks[i].child_count > nblocks))
+            throw runtime_error(path + " has a corrupt tree");
+}
+
+cloud_file::~cloud_file()
+{
+}
+
+const void* cloud_file::column(size_t i, int c) const
+{
+    if (!(column_mask & (1u << c)))
+        return nullptr;
+    return file->data() + blocks[i].offset[c];
+}
+
+const float3* cloud_file::positions(size_t i) const
+{
+    return static_cast<const float3*>(column(i, 0));
+}
+
+const uint32_t* cloud_file::colors(size_t i) const
+{
+    return static_cast<const uint32_t*>(column(i, 1));
+}
+
+const float3* cloud_file::normals(size_t i) const
+{
+    return static_cast<const float3*>(column(i, 2));
+}
+
+void cloud_file::query(float3 qlo, float3 qhi, vector<uint32_t>& out) const
+{
+    out.clear();
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        const cloud_block& b = blocks[i];
+        if (b.lo.x <= qhi.x && b.hi.x >= qlo.x &&
+            b.lo.y <= qhi.y && b.hi.y >= qlo.y &&
+            b.lo.z <= qhi.z && b.hi.z >= qlo.z)
+            out.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+void cloud_file::prefetch(size_t i, uint32_t mask) const
+{
+    for (int c = 0; c < 3; c++)
+        if (mask & column_mask & (1u << c))
+            file->prefetch(size_t(blocks[i].offset[c]), blocks[i].count * column_size[c]);
+}
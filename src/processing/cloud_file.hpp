@@ -0,0 +1,142 @@
+/**
+ * cloud_file.hpp
+ * Columnar point cloud files, split into blocks that can be read on their own.
+ *
+ * Layout:
+ *   header | block 0 columns | block 1 columns | ... | block index | footer
+ * A block holds up to `block_points` points, stored as one array per column
+ * (positions, colors, normals) starting on 64 byte boundaries. The index
+ * gives for every block its point count, bounding box and column offsets,
+ * and the fixed size footer at the very end of the file locates the index.
+ * Files are written front to back in one pass, and a reader only touches
+ * the footer, the index and the columns of the blocks it asks for.
+ *
+ * Blocks may also form a tree (see partition_cloud()), rooted at block 0:
+ * each block then covers a cell of space, its children are contiguous in
+ * the index, and inner blocks hold a thinned out sample of their subtree so
+ * that drawing a tree prefix gives a coarse version of the whole cloud.
+ */
+
+#ifndef RSSCANNER_PROCESSING_CLOUD_FILE_H
+#define RSSCANNER_PROCESSING_CLOUD_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+class mapped_file;
+
+enum cloud_column
+{
+    cloud_positions = 1,  // float3
+    cloud_colors = 2,     // RGBA8, bytes in r, g, b, a order
+    cloud_normals = 4,    // float3
+    cloud_tree = 8        // not a column: the blocks form a tree
+};
+
+struct cloud_block
+{
+    uint64_t offset[3];   // file offset of each column, 0 if absent
+    uint32_t count;
+    uint32_t first_child; // index of the first child block, if child_count
+    uint32_t child_count;
+    uint32_t depth;       // in the tree, 0 for the root and untied blocks
+    float3 lo, hi;        // bounds of the positions, of the cell in a tree
+};
+
+/// \class cloud_file_writer
+/// Streams points out to a file, one block at a time.
+class cloud_file_writer
+{
+    public:
+        // `columns` is a mask of cloud_column, positions are always stored.
+        // Throws std::runtime_error on I/O errors, here and in every call below.
+        cloud_file_writer(const std::string& path, uint32_t columns, uint32_t block_points = 65536);
+        ~cloud_file_writer();
+
+        // Append `n` points; `colors` and `normals` are ignored for absent
+        // columns and may be null for the others, which then store zeros
+        void append(const float3* positions, const uint32_t* colors, const float3* normals, size_t n);
+
+        // Write the pending block, the index and the footer and close the file.
+        // Called by the destructor if needed, where errors can't be reported.
+        void finish();
+
+        // Start a new block even if the current one is not full, or empty,
+        // to keep points that are far apart in space out of the same block
+        void flush_block();
+
+        // Make the written block `i` a tree node covering [lo, hi]
+        void set_node(size_t i, float3 lo, float3 hi, uint32_t depth,
+                      uint32_t first_child, uint32_t child_count);
+
+        size_t block_count() const { return blocks.size(); }
+
+        uint64_t points() const { return total; }
+
+    private:
+        cloud_file_writer(const cloud_file_writer&);
+        cloud_file_writer& operator=(const cloud_file_writer&);
+
+        std::string path;
+        FILE* out = nullptr;
+        uint32_t columns;
+        uint32_t block_points;
+        bool tree = false;
+        uint64_t offset = 0;
+        uint64_t total = 0;
+        std::vector<float3> positions;
+        std::vector<uint32_t> colors;
+        std::vector<float3> normals;
+        std::vector<cloud_block> blocks;
+
+        void write(const void* data, size_t bytes);
+        void pad();
+};
+
+/// \class cloud_file
+/// Reads a file written by cloud_file_writer through a memory mapping.
+/// Column pointers stay valid for the lifetime of the object.
+class cloud_file
+{
+    public:
+        // maps the file and reads its index, throws std::runtime_error
+        explicit cloud_file(const std::string& path);
+        ~cloud_file();
+
+        uint32_t columns() const { return column_mask; }
+        bool is_tree() const { return (column_mask & cloud_tree) != 0; }
+        uint64_t points() const { return total; }
+        float3 lower() const { return lo; }
+        float3 upper() const { return hi; }
+
+        size_t block_count() const { return nblocks; }
+        const cloud_block& block(size_t i) const { return blocks[i]; }
+
+        // column arrays of block i, null if the file has no such column
+        const float3* positions(size_t i) const;
+        const uint32_t* colors(size_t i) const;
+        const float3* normals(size_t i) const;
+
+        // Blocks whose bounds intersect the box [qlo, qhi]
+        void query(float3 qlo, float3 qhi, std::vector<uint32_t>& out) const;
+
+        // Ask the OS to read the given columns of block i ahead of use
+        void prefetch(size_t i, uint32_t columns) const;
+
+    private:
+        std::unique_ptr<mapped_file> file;
+        uint32_t column_mask = 0;
+        uint64_t total = 0;
+        float3 lo, hi;
+        const cloud_block* blocks = nullptr;  // the index, inside the mapping
+        size_t nblocks = 0;
+
+        const void* column(size_t i, int c) const;
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_CLOUD_FILE_H */
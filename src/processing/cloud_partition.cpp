@@ -0,0 +1,249 @@
+/**
+ * cloud_partition.cpp
+ */
+
+#include "cloud_partition.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    struct tree_node
+    {
+        int level;
+        uint32_t x, y, z;        // cell at its level
+        uint64_t subtree;        // input points inside the cell
+        double keep;             // chance that a point reaching the node stays in it
+        uint32_t first_child;
+        uint32_t child_count;
+    };
+
+    // Uniform number in [0, 1) from a point index, so that sampling is repeatable
+    // across the passes over the input
+    inline double hash01(uint64_t i)
+    {
+        uint64_t z = i + 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        z ^= z >> 31;
+        return double(z >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    inline size_t cell_index(int level, uint32_t x, uint32_t y, uint32_t z)
+    {
+        return x + (size_t(y) << level) + (size_t(z) << (2 * level));
+    }
+
+    class octree
+    {
+        public:
+            octree(const cloud_file& in, const partition_options& options);
+
+            // node holding input point `index` at `p`
+            uint32_t assign(const float3& p, uint64_t index) const;
+
+            vector<tree_node> nodes;
+            float3 origin;
+            float size;              // side of the root cube
+            int depth;
+
+        private:
+            vector<vector<int32_t>> node_of;    // node id per cell, per level
+            inline void finest_cell(const float3& p, uint32_t& x, uint32_t& y, uint32_t& z) const;
+    };
+
+    octree::octree(const cloud_file& in, const partition_options& options)
+        : depth(max(0, min(options.max_depth, 8)))
+    {
+        // cubic cells around the bounds
+        float3 lo = in.lower(), hi = in.upper();
+        size = max(hi.x - lo.x, max(hi.y - lo.y, hi.z - lo.z));
+        size = size > 0.f ? size * 1.0001f : 1.f;
+        origin = lo;
+
+        // points per cell at every level
+        vector<vector<uint32_t>> counts(depth + 1);
+        for (int l = 0; l <= depth; l++)
+            counts[l].assign(size_t(1) << (3 * l), 0);
+        for (size_t b = 0; b < in.block_count(); b++)
+        {
+            const float3* p = in.positions(b);
+            for (uint32_t i = 0; i < in.block(b).count; i++)
+            {
+                uint32_t x, y, z;
+                finest_cell(p[i], x, y, z);
+                counts[depth][cell_index(depth, x, y, z)]++;
+            }
+        }
+        for (int l = depth - 1; l >= 0; l--)
+        {
+            uint32_t n = 1u << l;
+            for (uint32_t z = 0; z < n; z++)
+                for (uint32_t y = 0; y < n; y++)
+                    for (uint32_t x = 0; x < n; x++)
+                    {
+                        uint32_t sum = 0;
+                        for (int c = 0; c < 8; c++)
+                            sum += counts[l + 1][cell_index(l + 1, 2 * x + (c & 1), 2 * y + ((c >> 1) & 1), 2 * z + (c >> 2))];
+                        counts[l][cell_index(l, x, y, z)] = sum;
+                    }
+        }
+
+        // breadth first, so that the children of a node are contiguous;
+        // `arrive` is the expected number of points reaching each node
+        node_of.resize(depth + 1);
+        for (int l = 0; l <= depth; l++)
+            node_of[l].assign(counts[l].size(), -1);
+        vector<double> arrive;
+        nodes.push_back(tree_node{ 0, 0, 0, 0, counts[0][0], 1.0, 0, 0 });
+        arrive.push_back(double(counts[0][0]));
+        node_of[0][0] = 0;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            // copies: push_back below may reallocate
+            tree_node n = nodes[i];
+            double reaching = arrive[i];
+            if (n.level == depth || reaching <= options.node_points)
+                continue;  // leaf, keeps everything that reaches it
+
+            n.keep = options.node_points / reaching;
+            n.first_child = static_cast<uint32_t>(nodes.size());
+            int l = n.level + 1;
+            for (int c = 0; c < 8; c++)
+            {
+                uint32_t x = 2 * n.x + (c & 1), y = 2 * n.y + ((c >> 1) & 1), z = 2 * n.z + (c >> 2);
+                uint64_t count = counts[l][cell_index(l, x, y, z)];
+                if (!count)
+                    continue;
+                node_of[l][cell_index(l, x, y, z)] = static_cast<int32_t>(nodes.size());
+                nodes.push_back(tree_node{ l, x, y, z, count, 1.0, 0, 0 });
+                arrive.push_back(count * (reaching / n.subtree) * (1.0 - n.keep));
+            }
+            n.child_count = static_cast<uint32_t>(nodes.size()) - n.first_child;
+            nodes[i] = n;
+        }
+    }
+
+    inline void octree::finest_cell(const float3& p, uint32_t& x, uint32_t& y, uint32_t& z) const
+    {
+        float cells = float(1u << depth);
+        int last = (1 << depth) - 1;
+        x = uint32_t(min(max(int((p.x - origin.x) / size * cells), 0), last));
+        y = uint32_t(min(max(int((p.y - origin.y) / size * cells), 0), last));
+        z = uint32_t(min(max(int((p.z - origin.z) / size * cells), 0), last));
+    }
+
+    uint32_t octree::assign(const float3& p, uint64_t index) const
+    {
+        uint32_t x, y, z;
+        finest_cell(p, x, y, z);
+        double h = hash01(index);
+        uint32_t id = 0;
+        for (;;)
+        {
+            const tree_node& n = nodes[id];
+            if (!n.child_count || h < n.keep)
+                return id;
+            // reuse the rest of the random number for the levels below
+            h = (h - n.keep) / (1.0 - n.keep);
+            int l = n.level + 1;
+            int shift = depth - l;
+            id = static_cast<uint32_t>(node_of[l][cell_index(l, x >> shift, y >> shift, z >> shift)]);
+        }
+    }
+}
+
+size_t partition_cloud(const cloud_file& in, const string& path, const partition_options& options)
+{
+    octree tree(in, options);
+    const vector<tree_node>& nodes = tree.nodes;
+    uint32_t columns = in.columns() & (cloud_positions | cloud_colors | cloud_normals);
+    bool colors = (columns & cloud_colors) != 0;
+    bool normals = (columns & cloud_normals) != 0;
+
+    vector<uint64_t> count(nodes.size(), 0);
+    {
+        uint64_t index = 0;
+        for (size_t b = 0; b < in.block_count(); b++)
+        {
+            const float3* p = in.positions(b);
+            for (uint32_t i = 0; i < in.block(b).count; i++, index++)
+                count[tree.assign(p[i], index)]++;
+        }
+    }
+    uint64_t largest = *max_element(count.begin(), count.end());
+    if (largest > UINT32_MAX)
+        throw runtime_error("partition_cloud: increase max_depth, a leaf holds too many points");
+
+    size_t point_bytes = sizeof(float3) + (colors ? sizeof(uint32_t) : 0) + (normals ? sizeof(float3) : 0);
+    cloud_file_writer writer(path, columns, static_cast<uint32_t>(max<uint64_t>(largest, 1)));
+
+    // gather a group of consecutive nodes per pass and write them out in order
+    for (size_t first = 0; first < nodes.size();)
+    {
+        size_t last = first + 1;
+        uint64_t bytes = count[first] * point_bytes;
+        while (last < nodes.size() && bytes + count[last] * point_bytes <= options.memory_budget)
+            bytes += count[last++] * point_bytes;
+
+        vector<vector<float3>> group_positions(last - first), group_normals(last - first);
+        vector<vector<uint32_t>> group_colors(last - first);
+        for (size_t n = first; n < last; n++)
+        {
+            group_positions[n - first].reserve(count[n]);
+            if (colors)
+                group_colors[n - first].reserve(count[n]);
+            if (normals)
+                group_normals[n - first].reserve(count[n]);
+        }
+
+        uint64_t index = 0;
+        for (size_t b = 0; b < in.block_count(); b++)
+        {
+            const float3* p = in.positions(b);
+            const uint32_t* c = in.colors(b);
+            const float3* nrm = in.normals(b);
+            for (uint32_t i = 0; i < in.block(b).count; i++, index++)
+            {
+                uint32_t n = tree.assign(p[i], index);
+                if (n < first || n >= last)
+                    continue;
+                group_positions[n - first].push_back(p[i]);
+                if (colors)
+                    group_colors[n - first].push_back(c[i]);
+                if (normals)
+                    group_normals[n - first].push_back(nrm[i]);
+            }
+        }
+
+        for (size_t n = first; n < last; n++)
+        {
+            size_t k = n - first;
+            writer.append(group_positions[k].data(), group_colors[k].data(), group_normals[k].data(),
+                          group_positions[k].size());
+            // append() already closed the block if the node filled it
+            if (group_positions[k].size() < largest || largest == 0)
+                writer.flush_block();
+            // free the group as it is written
+            vector<float3>().swap(group_positions[k]);
+            vector<uint32_t>().swap(group_colors[k]);
+            vector<float3>().swap(group_normals[k]);
+        }
+        first = last;
+    }
+
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+        const tree_node& t = nodes[n];
+        float cell = tree.size / float(1u << t.level);
+        float3 lo = { tree.origin.x + t.x * cell, tree.origin.y + t.y * cell, tree.origin.z + t.z * cell };
+        float3 hi = { lo.x + cell, lo.y + cell, lo.z + cell };
+        writer.set_node(n, lo, hi, uint32_t(t.level), t.first_child, t.child_count);
+    }
+    writer.finish();
+    return nodes.size();
+}
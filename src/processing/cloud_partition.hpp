@@ -0,0 +1,34 @@
+/**
+ * cloud_partition.hpp
+ * Spatial partitioning of point cloud files into a tree of nodes.
+ */
+
+#ifndef RSSCANNER_PROCESSING_CLOUD_PARTITION_H
+#define RSSCANNER_PROCESSING_CLOUD_PARTITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "cloud_file.hpp"
+
+struct partition_options
+{
+    partition_options() : node_points(65536), max_depth(7), memory_budget(size_t(1) << 30) {}
+
+    uint32_t node_points;   // target points per node
+    int max_depth;          // the finest cells split the bounds 2^max_depth times per axis, at most 8
+    size_t memory_budget;   // bytes of points held in memory at once
+};
+
+// Rewrite `in` into `path` as an octree of blocks (see cloud_file.hpp).
+// A cell with more than node_points points becomes an inner node keeping a
+// random sample of about node_points of them, the rest going down to its
+// children; leaves at max_depth may exceed node_points in very dense areas.
+// `in` is read once to count the cells, then once per group of nodes that
+// fits `memory_budget`, so clouds larger than memory can be converted.
+// Returns the number of nodes, throws std::runtime_error on I/O errors.
+size_t partition_cloud(const cloud_file& in, const std::string& path,
+                       const partition_options& options = partition_options());
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_CLOUD_PARTITION_H */
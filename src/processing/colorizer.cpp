@@ -0,0 +1,159 @@
+/**
+ * colorizer.cpp
+ */
+
+#include "colorizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "convert.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace
+{
+    const size_t bins = 65536;
+
+    // control points of each palette, evenly spaced over [0, 1]
+    const uint8_t jet[][3] = {
+        { 0, 0, 128 }, { 0, 0, 255 }, { 0, 255, 255 }, { 255, 255, 0 }, { 255, 0, 0 }, { 128, 0, 0 } };
+    const uint8_t classic[][3] = {
+        { 0, 0, 255 }, { 0, 255, 255 }, { 255, 255, 0 }, { 255, 0, 0 } };
+    const uint8_t gray[][3] = {
+        { 255, 255, 255 }, { 0, 0, 0 } };
+    const uint8_t inverse_gray[][3] = {
+        { 0, 0, 0 }, { 255, 255, 255 } };
+
+    inline uint32_t pack_rgba(float r, float g, float b)
+    {
+        uint8_t c[4] = { uint8_t(r + 0.5f), uint8_t(g + 0.5f), uint8_t(b + 0.5f), 255 };
+        uint32_t v;
+        memcpy(&v, c, 4);
+        return v;
+    }
+
+    const uint32_t no_depth = pack_rgba(0, 0, 0);
+}
+
+const char* colormap_name(colormap map)
+{
+    switch (map)
+    {
+    case colormap_jet: return "Jet";
+    case colormap_classic: return "Classic";
+    case colormap_gray: return "White to black";
+    case colormap_inverse_gray: return "Black to white";
+    default: return "";
+    }
+}
+
+void depth_colorizer::build_palette()
+{
+    const uint8_t (*points)[3];
+    size_t count;
+    switch (map)
+    {
+    case colormap_classic: points = classic; count = sizeof(classic) / 3; break;
+    case colormap_gray: points = gray; count = sizeof(gray) / 3; break;
+    case colormap_inverse_gray: points = inverse_gray; count = sizeof(inverse_gray) / 3; break;
+    default: points = jet; count = sizeof(jet) / 3; break;
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        float t = i / 255.f * (count - 1);
+        size_t k = min<size_t>(size_t(t), count - 2);
+        float f = t - k;
+        palette[i] = pack_rgba(points[k][0] + (points[k + 1][0] - points[k][0]) * f,
+                               points[k][1] + (points[k + 1][1] - points[k][1]) * f,
+                               points[k][2] + (points[k + 1][2] - points[k][2]) * f);
+    }
+}
+
+void depth_colorizer::build_histogram(const uint16_t* depth, int width, int height, int stride)
+{
+    // rows are split over the workers, each filling its own partial histogram
+    size_t workers = min<size_t>(hardware_threads(), max(1, height / 64));
+    partials.assign(workers * bins, 0);
+    histogram.resize(bins);
+
+    parallel_for(0, workers, 1, [&](size_t wb, size_t we)
+    {
+        for (size_t w = wb; w < we; w++)
+        {
+            uint32_t* hist = &partials[w * bins];
+            int y0 = int(height * w / workers), y1 = int(height * (w + 1) / workers);
+            for (int y = y0; y < y1; y++)
+            {
+                const uint16_t* row = reinterpret_cast<const uint16_t*>(
+                    reinterpret_cast<const uint8_t*>(depth) + size_t(y) * stride);
+                for (int x = 0; x < width; x++)
+                    hist[row[x]]++;
+            }
+        }
+    });
+
+    // merge the partials, then accumulate into a cumulative histogram
+    copy(partials.begin(), partials.begin() + bins, histogram.begin());
+    for (size_t w = 1; w < workers; w++)
+    {
+        const uint32_t* hist = &partials[w * bins];
+        for (size_t i = 0; i < bins; i++)
+            histogram[i] += hist[i];
+    }
+    histogram[0] = 0;  // no depth data
+    for (size_t i = 1; i < bins; i++)
+        histogram[i] += histogram[i - 1];
+}
+
+void depth_colorizer::colorize(const uint16_t* depth, int width, int height, int stride, uint8_t* rgba)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (lut_map != map)
+    {
+        build_palette();
+        lut_equalized = false;
+        lut_max = 0;
+    }
+    lut.resize(bins);
+
+    if (equalize)
+    {
+        build_histogram(depth, width, height, stride);
+        float scale = 255.f / max<uint32_t>(histogram[bins - 1], 1);
+        lut[0] = no_depth;
+        for (size_t i = 1; i < bins; i++)
+            lut[i] = palette[min(int(histogram[i] * scale), 255)];
+        lut_equalized = true;
+    }
+    else if (lut_equalized || lut_min != min_depth || lut_max != max_depth || lut_map != map)
+    {
+        uint16_t lo = min_depth, hi = max(uint16_t(min_depth + 1), max_depth);
+        lut[0] = no_depth;
+        for (size_t i = 1; i < bins; i++)
+        {
+            size_t d = min<size_t>(max<size_t>(i, lo), hi);
+            lut[i] = palette[(d - lo) * 255 / (hi - lo)];
+        }
+        lut_equalized = false;
+        lut_min = min_depth;
+        lut_max = max_depth;
+    }
+    lut_map = map;
+
+    if (stride == width * 2)
+    {
+        z16_to_rgba8(depth, rgba, size_t(width) * height, lut.data());
+        return;
+    }
+    for (int y = 0; y < height; y++)
+    {
+        const uint16_t* row = reinterpret_cast<const uint16_t*>(
+            reinterpret_cast<const uint8_t*>(depth) + size_t(y) * stride);
+        z16_to_rgba8(row, rgba + size_t(y) * width * 4, width, lut.data());
+    }
+}
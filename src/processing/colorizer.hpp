@@ -0,0 +1,57 @@
+/**
+ * colorizer.hpp
+ * Depth (Z16) to RGBA8 colorization with selectable palettes and
+ * optional histogram equalization.
+ */
+
+#ifndef RSSCANNER_PROCESSING_COLORIZER_H
+#define RSSCANNER_PROCESSING_COLORIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum colormap
+{
+    colormap_jet = 0,
+    colormap_classic,   // blue - cyan - yellow - red ramp
+    colormap_gray,
+    colormap_inverse_gray,
+    colormap_count
+};
+
+const char* colormap_name(colormap map);
+
+/// \class depth_colorizer
+/// Colors go through a palette indexed by the raw depth value, built either
+/// linearly over [min_depth, max_depth] or from the cumulative histogram of
+/// the frame (equalized). The palette lookup uses the vectorized
+/// z16_to_rgba8 converter; the histogram is built from per-thread partial
+/// histograms merged at the end.
+class depth_colorizer
+{
+    public:
+        colormap map = colormap_jet;
+        bool equalize = true;
+        uint16_t min_depth = 300;    // linear range in raw depth units
+        uint16_t max_depth = 4000;
+
+        // Colorize a width x height depth image whose rows are `stride` bytes apart
+        void colorize(const uint16_t* depth, int width, int height, int stride, uint8_t* rgba);
+
+    private:
+        std::vector<uint32_t> lut;        // raw depth -> RGBA8
+        std::vector<uint32_t> histogram;  // merged, 65536 bins
+        std::vector<uint32_t> partials;   // one 65536 bin histogram per worker
+        uint32_t palette[256];
+
+        // parameters the linear lut was built with, to skip rebuilding it
+        int lut_map = -1;
+        uint16_t lut_min = 0, lut_max = 0;
+        bool lut_equalized = false;
+
+        void build_palette();
+        void build_histogram(const uint16_t* depth, int width, int height, int stride);
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_COLORIZER_H */
@@ -0,0 +1,359 @@
+/**
+ * convert.cpp
+ */
+
+#include "convert.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RS_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and clang only emit vector instructions inside functions that ask for them
+#if defined(__GNUC__)
+#define RS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RS_TARGET(isa)
+#endif
+
+using namespace std;
+
+namespace
+{
+    inline uint8_t clamp8(int v)
+    {
+        return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+
+    // BT.601 limited range, the same coefficients librealsense uses
+    inline void yuv_pixel(int y, int u, int v, uint8_t* dst)
+    {
+        int c = y - 16, d = u - 128, e = v - 128;
+        dst[0] = clamp8((298 * c + 409 * e + 128) >> 8);
+        dst[1] = clamp8((298 * c - 100 * d - 208 * e + 128) >> 8);
+        dst[2] = clamp8((298 * c + 516 * d + 128) >> 8);
+        dst[3] = 255;
+    }
+
+    // byte offsets of Y0, U, Y1, V inside one 4 byte macro pixel
+    struct yuv_order { int y0, u, y1, v; };
+    const yuv_order yuyv_order = { 0, 1, 2, 3 };
+    const yuv_order uyvy_order = { 1, 0, 3, 2 };
+
+    void yuv_scalar(const uint8_t* src, uint8_t* dst, size_t pixels, yuv_order o)
+    {
+        for (size_t i = 0; i + 1 < pixels; i += 2, src += 4, dst += 8)
+        {
+            yuv_pixel(src[o.y0], src[o.u], src[o.v], dst);
+            yuv_pixel(src[o.y1], src[o.u], src[o.v], dst + 4);
+        }
+    }
+
+    void swizzle3_scalar(const uint8_t* src, uint8_t* dst, size_t pixels, bool swap_rb)
+    {
+        for (size_t i = 0; i < pixels; i++, src += 3, dst += 4)
+        {
+            dst[0] = swap_rb ? src[2] : src[0];
+            dst[1] = src[1];
+            dst[2] = swap_rb ? src[0] : src[2];
+            dst[3] = 255;
+        }
+    }
+
+    void bgra_scalar(const uint8_t* src, uint8_t* dst, size_t pixels)
+    {
+        for (size_t i = 0; i < pixels; i++, src += 4, dst += 4)
+        {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = src[3];
+        }
+    }
+
+    void z16_scalar(const uint16_t* src, uint8_t* dst, size_t pixels, const uint32_t* lut)
+    {
+        for (size_t i = 0; i < pixels; i++)
+            memcpy(dst + 4 * i, &lut[src[i]], 4);
+    }
+
+#ifdef RS_CONVERT_X86
+    // pshufb masks pulling Y, U and V of 8 pixels into 16 bit lanes
+    inline void yuv_masks(yuv_order o, __m128i& my, __m128i& mu, __m128i& mv)
+    {
+        char y[16], u[16], v[16];
+        for (int p = 0; p < 8; p++)
+        {
+            int macro = (p / 2) * 4;
+            y[2 * p] = (char)(macro + (p % 2 ? o.y1 : o.y0));
+            u[2 * p] = (char)(macro + o.u);
+            v[2 * p] = (char)(macro + o.v);
+            y[2 * p + 1] = u[2 * p + 1] = v[2 * p + 1] = (char)0x80;
+        }
+        my = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y));
+        mu = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u));
+        mv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v));
+    }
+
+    // 8 pixels of 16 bit c, d, e to 8 RGBA8 pixels in (lo, hi)
+    RS_TARGET("ssse3")
+    inline void yuv_math_128(__m128i c, __m128i d, __m128i e, __m128i& lo, __m128i& hi)
+    {
+        const __m128i k_r = _mm_setr_epi16(298, 409, 298, 409, 298, 409, 298, 409);
+        const __m128i k_g1 = _mm_setr_epi16(298, -208, 298, -208, 298, -208, 298, -208);
+        const __m128i k_g2 = _mm_setr_epi16(-100, 0, -100, 0, -100, 0, -100, 0);
+        const __m128i k_b = _mm_setr_epi16(298, 516, 298, 516, 298, 516, 298, 516);
+        const __m128i round = _mm_set1_epi32(128);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i ce_lo = _mm_unpacklo_epi16(c, e), ce_hi = _mm_unpackhi_epi16(c, e);
+        __m128i cd_lo = _mm_unpacklo_epi16(c, d), cd_hi = _mm_unpackhi_epi16(c, d);
+        __m128i d0_lo = _mm_unpacklo_epi16(d, zero), d0_hi = _mm_unpackhi_epi16(d, zero);
+
+        __m128i r = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce_lo, k_r), round), 8),
+            _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce_hi, k_r), round), 8));
+        __m128i g = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(ce_lo, k_g1), _mm_madd_epi16(d0_lo, k_g2)), round), 8),
+            _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(ce_hi, k_g1), _mm_madd_epi16(d0_hi, k_g2)), round), 8));
+        __m128i b = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd_lo, k_b), round), 8),
+            _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd_hi, k_b), round), 8));
+
+        // saturate to bytes, then interleave to RGBA
+        __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+        __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_set1_epi8((char)0xFF));
+        lo = _mm_unpacklo_epi16(rg, ba);
+        hi = _mm_unpackhi_epi16(rg, ba);
+    }
+
+    RS_TARGET("ssse3")
+    void yuv_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels, yuv_order o)
+    {
+        __m128i my, mu, mv;
+        yuv_masks(o, my, mu, mv);
+        const __m128i k16 = _mm_set1_epi16(16), k128 = _mm_set1_epi16(128);
+
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8, src += 16, dst += 32)
+        {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            __m128i c = _mm_sub_epi16(_mm_shuffle_epi8(in, my), k16);
+            __m128i d = _mm_sub_epi16(_mm_shuffle_epi8(in, mu), k128);
+            __m128i e = _mm_sub_epi16(_mm_shuffle_epi8(in, mv), k128);
+            __m128i lo, hi;
+            yuv_math_128(c, d, e, lo, hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), hi);
+        }
+        yuv_scalar(src, dst, pixels - i, o);
+    }
+
+    RS_TARGET("avx2")
+    void yuv_avx2(const uint8_t* src, uint8_t* dst, size_t pixels, yuv_order o)
+    {
+        __m128i my128, mu128, mv128;
+        yuv_masks(o, my128, mu128, mv128);
+        // every 128 bit lane holds 8 complete pixels, so the in-lane math of the
+        // SSSE3 path applies unchanged to both halves
+        const __m256i my = _mm256_broadcastsi128_si256(my128);
+        const __m256i mu = _mm256_broadcastsi128_si256(mu128);
+        const __m256i mv = _mm256_broadcastsi128_si256(mv128);
+        const __m256i k16 = _mm256_set1_epi16(16), k128 = _mm256_set1_epi16(128);
+        const __m256i k_r = _mm256_setr_epi16(298, 409, 298, 409, 298, 409, 298, 409, 298, 409, 298, 409, 298, 409, 298, 409);
+        const __m256i k_g1 = _mm256_setr_epi16(298, -208, 298, -208, 298, -208, 298, -208, 298, -208, 298, -208, 298, -208, 298, -208);
+        const __m256i k_g2 = _mm256_setr_epi16(-100, 0, -100, 0, -100, 0, -100, 0, -100, 0, -100, 0, -100, 0, -100, 0);
+        const __m256i k_b = _mm256_setr_epi16(298, 516, 298, 516, 298, 516, 298, 516, 298, 516, 298, 516, 298, 516, 298, 516);
+        const __m256i round = _mm256_set1_epi32(128);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i alpha = _mm256_set1_epi8((char)0xFF);
+
+        size_t i = 0;
+        for (; i + 16 <= pixels; i += 16, src += 32, dst += 64)
+        {
+            __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            __m256i c = _mm256_sub_epi16(_mm256_shuffle_epi8(in, my), k16);
+            __m256i d = _mm256_sub_epi16(_mm256_shuffle_epi8(in, mu), k128);
+            __m256i e = _mm256_sub_epi16(_mm256_shuffle_epi8(in, mv), k128);
+
+            __m256i ce_lo = _mm256_unpacklo_epi16(c, e), ce_hi = _mm256_unpackhi_epi16(c, e);
+            __m256i cd_lo = _mm256_unpacklo_epi16(c, d), cd_hi = _mm256_unpackhi_epi16(c, d);
+            __m256i d0_lo = _mm256_unpacklo_epi16(d, zero), d0_hi = _mm256_unpackhi_epi16(d, zero);
+
+            __m256i r = _mm256_packs_epi32(
+                _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ce_lo, k_r), round), 8),
+                _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ce_hi, k_r), round), 8));
+            __m256i g = _mm256_packs_epi32(
+                _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(ce_lo, k_g1), _mm256_madd_epi16(d0_lo, k_g2)), round), 8),
+                _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(ce_hi, k_g1), _mm256_madd_epi16(d0_hi, k_g2)), round), 8));
+            __m256i b = _mm256_packs_epi32(
+                _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(cd_lo, k_b), round), 8),
+                _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(cd_hi, k_b), round), 8));
+
+            __m256i rg = _mm256_unpacklo_epi8(_mm256_packus_epi16(r, r), _mm256_packus_epi16(g, g));
+            __m256i ba = _mm256_unpacklo_epi8(_mm256_packus_epi16(b, b), alpha);
+            __m256i lo = _mm256_unpacklo_epi16(rg, ba);  // pixels 0-3 | 8-11
+            __m256i hi = _mm256_unpackhi_epi16(rg, ba);  // pixels 4-7 | 12-15
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        yuv_scalar(src, dst, pixels - i, o);
+    }
+
+    // 3 byte pixels: four pixels per shuffle, reading 4 bytes past the 12 used,
+    // so the loops stop one pixel group early
+    RS_TARGET("ssse3")
+    void swizzle3_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels, bool swap_rb)
+    {
+        const __m128i mask = swap_rb
+            ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+            : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+        size_t i = 0;
+        for (; i + 6 <= pixels; i += 4, src += 12, dst += 16)
+        {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(_mm_shuffle_epi8(in, mask), alpha));
+        }
+        swizzle3_scalar(src, dst, pixels - i, swap_rb);
+    }
+
+    RS_TARGET("avx2")
+    void swizzle3_avx2(const uint8_t* src, uint8_t* dst, size_t pixels, bool swap_rb)
+    {
+        const __m128i mask128 = swap_rb
+            ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+            : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i mask = _mm256_broadcastsi128_si256(mask128);
+        const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+        size_t i = 0;
+        for (; i + 10 <= pixels; i += 8, src += 24, dst += 32)
+        {
+            __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(_mm256_shuffle_epi8(in, mask), alpha));
+        }
+        swizzle3_scalar(src, dst, pixels - i, swap_rb);
+    }
+
+    RS_TARGET("ssse3")
+    void bgra_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 4 <= pixels; i += 4, src += 16, dst += 16)
+        {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(in, mask));
+        }
+        bgra_scalar(src, dst, pixels - i);
+    }
+
+    RS_TARGET("avx2")
+    void bgra_avx2(const uint8_t* src, uint8_t* dst, size_t pixels)
+    {
+        const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                              2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8, src += 32, dst += 32)
+        {
+            __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_shuffle_epi8(in, mask));
+        }
+        bgra_scalar(src, dst, pixels - i);
+    }
+
+    RS_TARGET("avx2")
+    void z16_avx2(const uint16_t* src, uint8_t* dst, size_t pixels, const uint32_t* lut)
+    {
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8)
+        {
+            __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+            __m256i rgba = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), idx, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), rgba);
+        }
+        z16_scalar(src + i, dst + 4 * i, pixels - i, lut);
+    }
+#endif
+}
+
+static void yuv_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels, yuv_order o)
+{
+#ifdef RS_CONVERT_X86
+    switch (simd_active())
+    {
+    case simd_avx512:
+    case simd_avx2: yuv_avx2(src, dst, pixels, o); return;
+    case simd_sse42: yuv_ssse3(src, dst, pixels, o); return;
+    default: break;
+    }
+#endif
+    yuv_scalar(src, dst, pixels, o);
+}
+
+void yuyv_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    yuv_to_rgba8(src, dst, pixels, yuyv_order);
+}
+
+void uyvy_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    yuv_to_rgba8(src, dst, pixels, uyvy_order);
+}
+
+static void swizzle3_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels, bool swap_rb)
+{
+#ifdef RS_CONVERT_X86
+    switch (simd_active())
+    {
+    case simd_avx512:
+    case simd_avx2: swizzle3_avx2(src, dst, pixels, swap_rb); return;
+    case simd_sse42: swizzle3_ssse3(src, dst, pixels, swap_rb); return;
+    default: break;
+    }
+#endif
+    swizzle3_scalar(src, dst, pixels, swap_rb);
+}
+
+void bgr8_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    swizzle3_to_rgba8(src, dst, pixels, true);
+}
+
+void rgb8_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    swizzle3_to_rgba8(src, dst, pixels, false);
+}
+
+void bgra8_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+#ifdef RS_CONVERT_X86
+    switch (simd_active())
+    {
+    case simd_avx512:
+    case simd_avx2: bgra_avx2(src, dst, pixels); return;
+    case simd_sse42: bgra_ssse3(src, dst, pixels); return;
+    default: break;
+    }
+#endif
+    bgra_scalar(src, dst, pixels);
+}
+
+void z16_to_rgba8(const uint16_t* src, uint8_t* dst, size_t pixels, const uint32_t* lut)
+{
+#ifdef RS_CONVERT_X86
+    if (simd_active() >= simd_avx2)
+    {
+        z16_avx2(src, dst, pixels, lut);
+        return;
+    }
+#endif
+    z16_scalar(src, dst, pixels, lut);
+}
@@ -0,0 +1,27 @@
+/**
+ * convert.hpp
+ * Pixel format converters turning camera formats into RGBA8 for upload.
+ * They have SSSE3 and AVX2 paths, used from the sse4.2 and avx2 simd levels.
+ */
+
+#ifndef RSSCANNER_PROCESSING_CONVERT_H
+#define RSSCANNER_PROCESSING_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+// All converters write `pixels` RGBA8 pixels to `dst`. Packed YUV formats
+// hold two pixels per 4 bytes, so `pixels` must be even for them.
+void yuyv_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels);
+void uyvy_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels);
+void bgr8_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels);
+void bgra8_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels);
+void rgb8_to_rgba8(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// Depth to color through a palette indexed by the raw 16 bit depth value
+// (65536 RGBA8 entries, see depth_colorizer)
+void z16_to_rgba8(const uint16_t* src, uint8_t* dst, size_t pixels, const uint32_t* lut);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_CONVERT_H */
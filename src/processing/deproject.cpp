@@ -0,0 +1,61 @@
+/**
+ * deproject.cpp
+ */
+
+#include "deproject.hpp"
+
+#include <vector>
+
+#include "kernels.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+void deproject_depth(const uint16_t* depth, int stride, const depth_intrinsics& intrin,
+                     float depth_scale, float3* points)
+{
+    vector<float> column(size_t(intrin.width));
+    for (int x = 0; x < intrin.width; x++)
+        column[x] = (x - intrin.ppx) / intrin.fx;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(depth);
+    const float* columns = column.data();
+    float ppy = intrin.ppy, inv_fy = 1.f / intrin.fy;
+    int width = intrin.width;
+    auto deproject_rows = active_kernels().deproject_rows;
+    parallel_for(0, size_t(intrin.height), 32, [=](size_t b, size_t e)
+    {
+        deproject_rows(bytes, stride, width, int(b), int(e), columns, ppy, inv_fy, depth_scale, points);
+    });
+}
+
+size_t compact_points(const float3* points, const uint32_t* colors, const uint8_t* removed, size_t n,
+                      float3* out, uint32_t* out_colors)
+{
+    // count per block, then each block copies to its own offset
+    const size_t blocks = min<size_t>(64, (n + 16383) / 16384);
+    if (blocks == 0)
+        return 0;
+    const cloud_kernels& k = active_kernels();
+    vector<size_t> offsets(blocks + 1, 0);
+    parallel_blocks(n, blocks, [&](size_t block, size_t b, size_t e)
+    {
+        offsets[block + 1] = k.count_kept(points, removed, b, e);
+    });
+    for (size_t block = 0; block < blocks; block++)
+        offsets[block + 1] += offsets[block];
+
+    parallel_blocks(n, blocks, [&](size_t block, size_t b, size_t e)
+    {
+        if (offsets[block + 1] == offsets[block])
+            return;
+        // the unconditional store writes one slot past the block's points
+        // after its last kept one, into the next block's range: stop there
+        size_t end = e;
+        while (!((points[end - 1].z != 0.f) && (!removed || removed[end - 1] == 0)))
+            end--;
+        k.copy_kept(points, colors, removed, b, end, out + offsets[block],
+                    out_colors ? out_colors + offsets[block] : nullptr);
+    });
+    return offsets[blocks];
+}
@@ -0,0 +1,35 @@
+/**
+ * deproject.hpp
+ * Depth image to point cloud, and compaction of the points kept.
+ */
+
+#ifndef RSSCANNER_PROCESSING_DEPROJECT_H
+#define RSSCANNER_PROCESSING_DEPROJECT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "types.hpp"
+
+// Pinhole intrinsics of a depth stream without distortion, in pixels
+struct depth_intrinsics
+{
+    int width, height;
+    float fx, fy;     // focal lengths
+    float ppx, ppy;   // principal point
+};
+
+/// One point per pixel of a Z16 image, like rs2::pointcloud: pixel (x, y)
+/// at raw depth d becomes ((x - ppx) / fx * z, (y - ppy) / fy * z, z) with
+/// z = d * depth_scale. Pixels without depth give (0, 0, 0). Rows are
+/// `stride` bytes apart in `depth`.
+void deproject_depth(const uint16_t* depth, int stride, const depth_intrinsics& intrin,
+                     float depth_scale, float3* points);
+
+/// Copy the points with depth (z != 0) whose `removed` entry is zero, in
+/// order, to `out`, and their colors to `out_colors`. `removed`, `colors`
+/// and `out_colors` may be null. Returns the number of points copied.
+size_t compact_points(const float3* points, const uint32_t* colors, const uint8_t* removed, size_t n,
+                      float3* out, uint32_t* out_colors);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_DEPROJECT_H */
@@ -0,0 +1,350 @@
+/**
+ * kdtree.cpp
+ */
+
+#include "kdtree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace
+{
+    inline float axis(const float3& p, int d) { return d == 0 ? p.x : (d == 1 ? p.y : p.z); }
+    inline float& axis(float3& p, int d) { return d == 0 ? p.x : (d == 1 ? p.y : p.z); }
+
+    inline float dist2(const float3& a, const float3& b)
+    {
+        float3 d = a - b;
+        return dot(d, d);
+    }
+
+    struct node
+    {
+        size_t b, e;
+        float3 lo, hi;
+    };
+
+    // Parameter range [t0, t1] where the ray is inside the box, false if it misses
+    inline bool clip_ray(const float3& o, const float3& inv, const float3& lo, const float3& hi,
+                         float& t0, float& t1)
+    {
+        t0 = 0.f;
+        t1 = numeric_limits<float>::max();
+        for (int d = 0; d < 3; d++)
+        {
+            float ta = (axis(lo, d) - axis(o, d)) * axis(inv, d);
+            float tb = (axis(hi, d) - axis(o, d)) * axis(inv, d);
+            if (ta > tb) swap(ta, tb);
+            t0 = max(t0, ta);
+            t1 = min(t1, tb);
+            if (t0 > t1) return false;
+        }
+        return true;
+    }
+
+    // ids are 32 bit, so the tree is never deeper than this
+    const int max_stack = 64;
+}
+
+void kdtree::clear()
+{
+    items.clear();
+    dims.clear();
+}
+
+void kdtree::build(const float3* points, size_t n)
+{
+    items.resize(n);
+    dims.assign(n, 0);
+    if (n == 0)
+        return;
+
+    lo = hi = points[0];
+    for (size_t i = 0; i < n; i++)
+    {
+        const float3& p = points[i];
+        items[i].p = p;
+        items[i].id = static_cast<uint32_t>(i);
+        lo.x = min(lo.x, p.x); hi.x = max(hi.x, p.x);
+        lo.y = min(lo.y, p.y); hi.y = max(hi.y, p.y);
+        lo.z = min(lo.z, p.z); hi.z = max(hi.z, p.z);
+    }
+
+    // every spawn level doubles the number of tasks; a few per thread let
+    // the threads done with a small subtree steal the rest of a large one
+    int spawn_depth = 0;
+    while ((1u << spawn_depth) < 4 * hardware_threads())
+        spawn_depth++;
+    build_range(0, n, lo, hi, spawn_depth);
+}
+
+void kdtree::build_range(size_t b, size_t e, float3 blo, float3 bhi, int spawn_depth)
+{
+    if (e - b <= leaf_size)
+        return;
+
+    // split along the widest side of the cell
+    float3 ext = bhi - blo;
+    int d = 0;
+    if (ext.y > axis(ext, d)) d = 1;
+    if (ext.z > axis(ext, d)) d = 2;
+
+    size_t m = b + (e - b) / 2;
+    nth_element(items.begin() + b, items.begin() + m, items.begin() + e,
+        [d](const item& l, const item& r) { return axis(l.p, d) < axis(r.p, d); });
+    dims[m] = static_cast<uint8_t>(d);
+
+    float split = axis(items[m].p, d);
+    float3 left_hi = bhi; axis(left_hi, d) = split;
+    float3 right_lo = blo; axis(right_lo, d) = split;
+
+    if (spawn_depth > 0)
+    {
+        parallel_invoke(
+            [=]() { build_range(b, m, blo, left_hi, spawn_depth - 1); },
+            [=]() { build_range(m + 1, e, right_lo, bhi, spawn_depth - 1); });
+    }
+    else
+    {
+        build_range(b, m, blo, left_hi, 0);
+        build_range(m + 1, e, right_lo, bhi, 0);
+    }
+}
+
+bool kdtree::ray_nearest(float3 origin, float3 dir, float radius, float slope, ray_hit& hit) const
+{
+    if (items.empty())
+        return false;
+
+    const float inf = numeric_limits<float>::max();
+    float3 inv = { dir.x != 0.f ? 1.f / dir.x : inf,
+                   dir.y != 0.f ? 1.f / dir.y : inf,
+                   dir.z != 0.f ? 1.f / dir.z : inf };
+    float best_t = inf;
+    size_t best = 0;
+
+    node stack[max_stack];
+    int top = 0;
+    stack[top++] = node{ 0, items.size(), lo, hi };
+    while (top > 0)
+    {
+        node n = stack[--top];
+
+        // farthest the box reaches along the ray bounds the cone radius inside it
+        float3 c = (n.lo + n.hi) * 0.5f;
+        float3 h = (n.hi - n.lo) * 0.5f;
+        float t_far = dot(c - origin, dir) + h.x * fabs(dir.x) + h.y * fabs(dir.y) + h.z * fabs(dir.z);
+        if (t_far < 0.f)
+            continue;
+        float grow = radius + slope * t_far;
+        float3 g = { grow, grow, grow };
+        float t0, t1;
+        if (!clip_ray(origin, inv, n.lo - g, n.hi + g, t0, t1) || t0 > best_t)
+            continue;
+
+        if (n.e - n.b <= leaf_size)
+        {
+            for (size_t i = n.b; i < n.e; i++)
+            {
+                float3 v = items[i].p - origin;
+                float t = dot(v, dir);
+                if (t < 0.f || t >= best_t)
+                    continue;
+                float allow = radius + slope * t;
+                if (dot(v, v) - t * t <= allow * allow)
+                {
+                    best_t = t;
+                    best = i;
+                }
+            }
+            continue;
+        }
+
+        size_t m = n.b + (n.e - n.b) / 2;
+        int d = dims[m];
+        float split = axis(items[m].p, d);
+        {
+            float3 v = items[m].p - origin;
+            float t = dot(v, dir);
+            float allow = radius + slope * t;
+            if (t >= 0.f && t < best_t && dot(v, v) - t * t <= allow * allow)
+            {
+                best_t = t;
+                best = m;
+            }
+        }
+
+        node left = { n.b, m, n.lo, n.hi };
+        node right = { m + 1, n.e, n.lo, n.hi };
+        axis(left.hi, d) = split;
+        axis(right.lo, d) = split;
+        // visit the half containing the origin first so best_t shrinks early
+        if (axis(origin, d) < split)
+        {
+            stack[top++] = right;
+            stack[top++] = left;
+        }
+        else
+        {
+            stack[top++] = left;
+            stack[top++] = right;
+        }
+    }
+
+    if (best_t == inf)
+        return false;
+    hit.index = items[best].id;
+    hit.point = items[best].p;
+    hit.t = best_t;
+    return true;
+}
+
+void kdtree::radius_search(float3 q, float r, vector<size_t>& out) const
+{
+    out.clear();
+    if (items.empty())
+        return;
+
+    float r2 = r * r;
+    size_t stack[max_stack][2];
+    int top = 0;
+    stack[top][0] = 0; stack[top][1] = items.size(); top++;
+    while (top > 0)
+    {
+        --top;
+        size_t b = stack[top][0], e = stack[top][1];
+        if (e - b <= leaf_size)
+        {
+            for (size_t i = b; i < e; i++)
+                if (dist2(items[i].p, q) <= r2)
+                    out.push_back(items[i].id);
+            continue;
+        }
+
+        size_t m = b + (e - b) / 2;
+        if (dist2(items[m].p, q) <= r2)
+            out.push_back(items[m].id);
+        float diff = axis(q, dims[m]) - axis(items[m].p, dims[m]);
+        if (diff <= r)
+        {
+            stack[top][0] = b; stack[top][1] = m; top++;
+        }
+        if (diff >= -r)
+        {
+            stack[top][0] = m + 1; stack[top][1] = e; top++;
+        }
+    }
+}
+
+size_t kdtree::knn(float3 q, size_t k, size_t* indices, float* dist2_out) const
+{
+    if (items.empty() || k == 0)
+        return 0;
+
+    // max-heap of the current best k, kept in the output arrays so the query
+    // does not allocate; indices hold tree positions until the end. Without
+    // an array for them, the distances go to a scratch of the thread that
+    // only grows.
+    thread_local vector<float> scratch;
+    if (!dist2_out)
+    {
+        if (scratch.size() < k)
+            scratch.resize(k);
+        dist2_out = scratch.data();
+    }
+    size_t count = 0;
+    auto offer = [&](size_t i)
+    {
+        float d2 = dist2(items[i].p, q);
+        size_t c;
+        if (count < k)
+        {
+            // sift up from the new leaf
+            c = count++;
+            while (c > 0 && dist2_out[(c - 1) / 2] < d2)
+            {
+                dist2_out[c] = dist2_out[(c - 1) / 2];
+                indices[c] = indices[(c - 1) / 2];
+                c = (c - 1) / 2;
+            }
+        }
+        else if (d2 < dist2_out[0])
+        {
+            // replace the root and sift down
+            c = 0;
+            for (;;)
+            {
+                size_t child = 2 * c + 1;
+                if (child >= count)
+                    break;
+                if (child + 1 < count && dist2_out[child + 1] > dist2_out[child])
+                    child++;
+                if (dist2_out[child] <= d2)
+                    break;
+                dist2_out[c] = dist2_out[child];
+                indices[c] = indices[child];
+                c = child;
+            }
+        }
+        else
+            return;
+        dist2_out[c] = d2;
+        indices[c] = i;
+    };
+    auto bound = [&]() { return count < k ? numeric_limits<float>::max() : dist2_out[0]; };
+
+    // stack entries carry the squared distance to the splitting plane they were pushed across
+    struct entry { size_t b, e; float plane2; };
+    entry stack[max_stack];
+    int top = 0;
+    stack[top++] = entry{ 0, items.size(), 0.f };
+    while (top > 0)
+    {
+        entry n = stack[--top];
+        if (n.plane2 > bound())
+            continue;
+        if (n.e - n.b <= leaf_size)
+        {
+            for (size_t i = n.b; i < n.e; i++)
+                offer(i);
+            continue;
+        }
+
+        size_t m = n.b + (n.e - n.b) / 2;
+        offer(m);
+        float diff = axis(q, dims[m]) - axis(items[m].p, dims[m]);
+        entry near_side = diff < 0.f ? entry{ n.b, m, n.plane2 } : entry{ m + 1, n.e, n.plane2 };
+        entry far_side = diff < 0.f ? entry{ m + 1, n.e, diff * diff } : entry{ n.b, m, diff * diff };
+        stack[top++] = far_side;
+        stack[top++] = near_side;
+    }
+
+    // heap to ascending order, then tree positions to original indices
+    for (size_t end = count; end > 1; end--)
+    {
+        swap(dist2_out[0], dist2_out[end - 1]);
+        swap(indices[0], indices[end - 1]);
+        size_t c = 0;
+        for (;;)
+        {
+            size_t child = 2 * c + 1;
+            if (child >= end - 1)
+                break;
+            if (child + 1 < end - 1 && dist2_out[child + 1] > dist2_out[child])
+                child++;
+            if (dist2_out[child] <= dist2_out[c])
+                break;
+            swap(dist2_out[c], dist2_out[child]);
+            swap(indices[c], indices[child]);
+            c = child;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+        indices[i] = items[indices[i]].id;
+    return count;
+}
@@ -0,0 +1,67 @@
+/**
+ * kdtree.hpp
+ * Implicit-layout kd-tree over a point cloud, used for point picking,
+ * measurement and neighbourhood queries.
+ */
+
+#ifndef RSSCANNER_PROCESSING_KDTREE_H
+#define RSSCANNER_PROCESSING_KDTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+/// \class kdtree
+/// Points are stored in tree order in one contiguous array: the node covering
+/// [b, e) keeps its splitting point at the middle index m = b + (e - b) / 2,
+/// its children cover [b, m) and [m + 1, e). No node objects are allocated,
+/// so the whole tree is one flat array plus the split dimensions.
+class kdtree
+{
+    public:
+        struct ray_hit
+        {
+            size_t index;  // index into the array given to build()
+            float3 point;
+            float t;       // distance along the ray
+        };
+
+        // (Re)build the tree over `n` points, splitting the top levels across threads
+        void build(const float3* points, size_t n);
+        void clear();
+
+        size_t size() const { return items.size(); }
+        bool empty() const { return items.empty(); }
+
+        // Closest point to `origin` lying inside the cone around the ray
+        // whose radius is `radius + t * slope` at distance t. `dir` must be normalized.
+        bool ray_nearest(float3 origin, float3 dir, float radius, float slope, ray_hit& hit) const;
+
+        // Indices of all points within `r` of `q`
+        void radius_search(float3 q, float r, std::vector<size_t>& out) const;
+
+        // The `k` nearest neighbours of `q` and, if `dist2` is not null, their
+        // squared distances, sorted by distance. Both arrays hold `k` entries.
+        // Returns the number of neighbours found (<= k).
+        size_t knn(float3 q, size_t k, size_t* indices, float* dist2) const;
+
+    private:
+        static const size_t leaf_size = 16;
+
+        struct item
+        {
+            float3 p;
+            uint32_t id;  // original index of the point
+        };
+
+        std::vector<item> items;     // points in tree order
+        std::vector<uint8_t> dims;   // split dimension of the node whose middle is i
+        float3 lo = { 0, 0, 0 };     // root bounds
+        float3 hi = { 0, 0, 0 };
+
+        void build_range(size_t b, size_t e, float3 blo, float3 bhi, int spawn_depth);
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_KDTREE_H */
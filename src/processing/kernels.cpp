@@ -0,0 +1,78 @@
+/**
+ * kernels.cpp
+ */
+
+#include "kernels.hpp"
+
+namespace
+{
+    // Each kernel from the widest table `level` can run that has it. The
+    // baseline table has them all, and also serves the scalar level.
+    cloud_kernels select(simd_level level)
+    {
+        const cloud_kernels* tables[] = {
+            level >= simd_avx512 ? cloud_kernels_avx512() : nullptr,
+            level >= simd_avx2 ? cloud_kernels_avx2() : nullptr,
+            level >= simd_sse42 ? cloud_kernels_sse42() : nullptr,
+            cloud_kernels_sse2()
+        };
+        cloud_kernels k = *tables[3];
+        for (int t = 2; t >= 0; t--)
+        {
+            const cloud_kernels* table = tables[t];
+            if (!table)
+                continue;
+            if (table->deproject_rows)
+            {
+                k.deproject_rows = table->deproject_rows;
+                k.deproject_level = table->deproject_level;
+            }
+            if (table->count_kept && table->copy_kept)
+            {
+                k.count_kept = table->count_kept;
+                k.copy_kept = table->copy_kept;
+                k.compact_level = table->compact_level;
+            }
+            if (table->gather_visible)
+            {
+                k.gather_visible = table->gather_visible;
+                k.gather_level = table->gather_level;
+            }
+            if (table->align_row)
+            {
+                k.align_row = table->align_row;
+                k.align_level = table->align_level;
+            }
+            if (table->depth_column_sums && table->depth_compare)
+            {
+                k.depth_column_sums = table->depth_column_sums;
+                k.depth_compare = table->depth_compare;
+                k.motion_level = table->motion_level;
+            }
+            if (table->tile_sad8 && table->tile_sad16)
+            {
+                k.tile_sad8 = table->tile_sad8;
+                k.tile_sad16 = table->tile_sad16;
+                k.change_level = table->change_level;
+            }
+        }
+        return k;
+    }
+
+    struct kernel_tables
+    {
+        cloud_kernels by_level[simd_level_count];
+
+        kernel_tables()
+        {
+            for (int level = 0; level < simd_level_count; level++)
+                by_level[level] = select(simd_level(level));
+        }
+    };
+}
+
+const cloud_kernels& active_kernels()
+{
+    static const kernel_tables tables;
+    return tables.by_level[simd_active()];
+}
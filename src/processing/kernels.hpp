@@ -0,0 +1,100 @@
+/**
+ * kernels.hpp
+ * Point cloud inner loops, compiled once per instruction set.
+ *
+ * kernels_impl.hpp holds the loops; kernels_sse2.cpp, kernels_sse42.cpp,
+ * kernels_avx2.cpp and kernels_avx512.cpp each compile it with their own
+ * code generation flags (set in CMakeLists.txt). Every kernel is picked
+ * from the best table the CPU can run that has it, once per simd level.
+ */
+
+#ifndef RSSCANNER_PROCESSING_KERNELS_H
+#define RSSCANNER_PROCESSING_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+#include "types.hpp"
+
+// Depth to color mapping split into per column and per row terms (built by
+// rgbd_aligner): the ray through depth pixel corner (cx, cy), rotated into the
+// color camera, is column[cx] + row[cy]
+struct align_tables
+{
+    const float* column[6];   // per column: x, y, z of the left, then the right pixel edge
+    const float* row;         // per row: x, y, z of the top, then the bottom pixel edge
+    float translation[3];     // depth to color, meters
+    float fx, fy, ppx, ppy;   // color intrinsics
+    int width, height;        // color image
+    float grow;               // color pixels added to each side of a footprint
+};
+
+// Cells of two rows of a depth pyramid level, compared (see depth_compare)
+struct depth_match
+{
+    int64_t both = 0;     // with depth in both rows
+    int64_t either = 0;   // with depth in at least one
+    int64_t agree = 0;    // with depth in both, within the tolerance
+    int64_t delta = 0;    // sum of b - a over the cells with depth in both, depth units
+    int64_t distance = 0; // sum of |b - a| over them
+};
+
+struct cloud_kernels
+{
+    // Rows [y0, y1) of a Z16 image to points: x = column[x] * z, y = (y - ppy) * inv_fy * z
+    void (*deproject_rows)(const uint8_t* depth, int stride, int width, int y0, int y1,
+                           const float* column, float ppy, float inv_fy, float scale, float3* points);
+
+    // Points in [b, e) with depth and no `removed` entry (which may be null)
+    size_t (*count_kept)(const float3* points, const uint8_t* removed, size_t b, size_t e);
+
+    // Copy them to `out`, and their colors (0xffcccccc without `colors`) to
+    // `out_colors` when not null. The slot after the last copied point may
+    // be written too, unless e - 1 is itself kept.
+    void (*copy_kept)(const float3* points, const uint32_t* colors, const uint8_t* removed,
+                      size_t b, size_t e, float3* out, uint32_t* out_colors);
+
+    // Every `step`th point with depth and not hidden (`hidden` may be null),
+    // with its texture coordinates, and when `tinted` is not null a color
+    // per point: green for the tinted ones, white for the others. `out*`
+    // hold at least n / step + 1 entries. Returns the number gathered.
+    size_t (*gather_visible)(const float3* points, const float2* uv, const uint8_t* hidden,
+                             const uint8_t* tinted, size_t n, size_t step,
+                             float3* out, float2* out_uv, uint32_t* out_colors);
+
+    // Pixels of Z16 row `y` to the color pixels whose centers their footprint
+    // (grown by t.grow) covers, [u0, u1] x [v0, v1], and their depth along the color camera
+    // axis. u0 is -1 for pixels without depth or covering no color pixel.
+    void (*align_row)(const uint16_t* depth, int width, float scale, const align_tables& t, int y,
+                      int32_t* u0, int32_t* v0, int32_t* u1, int32_t* v1, float* z);
+
+    // Add Z16 row `row` to per column sums of its depth and of its pixels
+    // with depth, to average them over the cells of a pyramid level
+    void (*depth_column_sums)(const uint16_t* row, int width, uint32_t* sum, uint32_t* count);
+
+    // Compare `n` cells of two pyramid level rows into `m` (added to it):
+    // b agrees with a when |b - a| <= a * tolerance / 256
+    void (*depth_compare)(const uint16_t* a, const uint16_t* b, int n, int tolerance, depth_match& m);
+
+    // Add the sum of |b - a| over each `tile` bytes of a row of `n` bytes to
+    // sums[0], sums[1], ..., the last span being shorter when `tile` does
+    // not divide `n` (change detection, see tile_changes)
+    void (*tile_sad8)(const uint8_t* a, const uint8_t* b, int n, int tile, uint32_t* sums);
+    // The same over Z16 values, `n` and `tile` counted in values
+    void (*tile_sad16)(const uint16_t* a, const uint16_t* b, int n, int tile, uint32_t* sums);
+
+    // level each kernel above was compiled for
+    simd_level deproject_level, compact_level, gather_level, align_level, motion_level, change_level;
+};
+
+// Kernels for simd_active()
+const cloud_kernels& active_kernels();
+
+// Per instruction set tables, null when the build or the architecture has none
+const cloud_kernels* cloud_kernels_sse2();
+const cloud_kernels* cloud_kernels_sse42();
+const cloud_kernels* cloud_kernels_avx2();
+const cloud_kernels* cloud_kernels_avx512();
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_KERNELS_H */
@@ -0,0 +1,32 @@
+/**
+ * kernels_avx2.cpp
+ * Kernels compiled for AVX2 (-mavx2, see CMakeLists.txt).
+ */
+
+#include "kernels.hpp"
+
+#if defined(__AVX2__)
+
+namespace
+{
+#include "kernels_impl.hpp"
+}
+
+const cloud_kernels* cloud_kernels_avx2()
+{
+    static const cloud_kernels kernels = {
+        deproject_rows, count_kept, copy_kept, gather_visible, align_row,
+        depth_column_sums, depth_compare, tile_sad8, tile_sad16,
+        simd_avx2, simd_avx2, simd_avx2, simd_avx2, simd_avx2, simd_avx2
+    };
+    return &kernels;
+}
+
+#else
+
+const cloud_kernels* cloud_kernels_avx2()
+{
+    return nullptr;
+}
+
+#endif
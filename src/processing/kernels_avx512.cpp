@@ -0,0 +1,75 @@
+/**
+ * kernels_avx512.cpp
+ * Kernels compiled for AVX-512 (-mavx512f -mavx512bw -mavx512dq -mavx512vl
+ * -mbmi2 -mpopcnt, see CMakeLists.txt), with compaction through compress
+ * stores.
+ */
+
+#include "kernels.hpp"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VL__) && \
+    (defined(__x86_64__) || defined(_M_X64)) && (defined(__BMI2__) || defined(_MSC_VER))
+
+#include <immintrin.h>
+
+namespace
+{
+#include "kernels_impl.hpp"
+
+    // 16 points per iteration: the keep mask of the points, spread to their
+    // 48 floats, drives three compress stores of the coordinates
+    void copy_kept_compress(const float3* points, const uint32_t* colors, const uint8_t* removed,
+                            size_t b, size_t e, float3* out, uint32_t* out_colors)
+    {
+        // z of the 16 points: lanes 0-9 from the first two registers, then 10-15 from the third
+        const __m512i z_low = _mm512_setr_epi32(2, 5, 8, 11, 14, 17, 20, 23, 26, 29, 0, 0, 0, 0, 0, 0);
+        const __m512i z_high = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 19, 22, 25, 28, 31);
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512i gray = _mm512_set1_epi32(int(0xffccccccu));
+        size_t i = b, j = 0;
+        for (; i + 16 <= e; i += 16)
+        {
+            const float* p = &points[i].x;
+            __m512 p0 = _mm512_loadu_ps(p), p1 = _mm512_loadu_ps(p + 16), p2 = _mm512_loadu_ps(p + 32);
+            __m512 z = _mm512_permutex2var_ps(_mm512_permutex2var_ps(p0, z_low, p1), z_high, p2);
+            __mmask16 keep = _mm512_cmp_ps_mask(z, zero, _CMP_NEQ_UQ);
+            if (removed)
+                keep &= _mm_cmpeq_epi8_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(removed + i)),
+                                            _mm_setzero_si128());
+
+            uint64_t floats = _pdep_u64(keep, 0x249249249249ull) * 7;
+            float* dst = &out[j].x;
+            __mmask16 m0 = __mmask16(floats), m1 = __mmask16(floats >> 16), m2 = __mmask16(floats >> 32);
+            _mm512_mask_compressstoreu_ps(dst, m0, p0);
+            dst += _mm_popcnt_u32(m0);
+            _mm512_mask_compressstoreu_ps(dst, m1, p1);
+            dst += _mm_popcnt_u32(m1);
+            _mm512_mask_compressstoreu_ps(dst, m2, p2);
+
+            if (out_colors)
+                _mm512_mask_compressstoreu_epi32(out_colors + j, keep,
+                    colors ? _mm512_loadu_si512(colors + i) : gray);
+            j += _mm_popcnt_u32(keep);
+        }
+        copy_kept(points, colors, removed, i, e, out + j, out_colors ? out_colors + j : nullptr);
+    }
+}
+
+const cloud_kernels* cloud_kernels_avx512()
+{
+    static const cloud_kernels kernels = {
+        deproject_rows, count_kept, copy_kept_compress, gather_visible, align_row,
+        depth_column_sums, depth_compare, tile_sad8, tile_sad16,
+        simd_avx512, simd_avx512, simd_avx512, simd_avx512, simd_avx512, simd_avx512
+    };
+    return &kernels;
+}
+
+#else
+
+const cloud_kernels* cloud_kernels_avx512()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * kernels_impl.hpp
+ * Bodies of the point cloud kernels, see kernels.hpp.
+ *
+ * Included inside an anonymous namespace by each kernels_<isa>.cpp, so
+ * every copy is local to its translation unit. Nothing here may call an
+ * inline function or template defined elsewhere (std::, types.hpp
+ * operators): the linker keeps one copy of those for the whole program,
+ * which could then be the AVX-512 one called from baseline code.
+ */
+
+void deproject_rows(const uint8_t* depth, int stride, int width, int y0, int y1,
+                    const float* column, float ppy, float inv_fy, float scale, float3* points)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        const uint16_t* row = reinterpret_cast<const uint16_t*>(depth + size_t(y) * stride);
+        float* out = &points[size_t(y) * width].x;
+        float v = (y - ppy) * inv_fy;
+        for (int x = 0; x < width; x++)
+        {
+            float z = row[x] * scale;
+            out[3 * x] = column[x] * z;
+            out[3 * x + 1] = v * z;
+            out[3 * x + 2] = z;
+        }
+    }
+}
+
+size_t count_kept(const float3* points, const uint8_t* removed, size_t b, size_t e)
+{
+    size_t kept = 0;
+    if (removed)
+        for (size_t i = b; i < e; i++)
+            kept += (points[i].z != 0.f) & (removed[i] == 0);
+    else
+        for (size_t i = b; i < e; i++)
+            kept += points[i].z != 0.f;
+    return kept;
+}
+
+void copy_kept(const float3* points, const uint32_t* colors, const uint8_t* removed, size_t b, size_t e,
+               float3* out, uint32_t* out_colors)
+{
+    size_t j = 0;
+    for (size_t i = b; i < e; i++)
+    {
+        // written unconditionally, the cursor only moves past kept points
+        out[j] = points[i];
+        if (out_colors)
+            out_colors[j] = colors ? colors[i] : 0xffccccccu;
+        j += (points[i].z != 0.f) & (!removed || removed[i] == 0);
+    }
+}
+
+template <bool has_hidden, bool has_tint>
+size_t gather(const float3* points, const float2* uv, const uint8_t* hidden, const uint8_t* tinted,
+              size_t n, size_t step, float3* out, float2* out_uv, uint32_t* out_colors)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < n; i += step)
+    {
+        out[j] = points[i];
+        out_uv[j] = uv[i];
+        if (has_tint)
+            out_colors[j] = tinted[i] ? 0xff66ff66u : 0xffffffffu;
+        j += has_hidden ? (points[i].z != 0.f) & (hidden[i] == 0) : points[i].z != 0.f;
+    }
+    return j;
+}
+
+size_t gather_visible(const float3* points, const float2* uv, const uint8_t* hidden, const uint8_t* tinted,
+                      size_t n, size_t step, float3* out, float2* out_uv, uint32_t* out_colors)
+{
+    if (hidden && tinted)
+        return gather<true, true>(points, uv, hidden, tinted, n, step, out, out_uv, out_colors);
+    if (hidden)
+        return gather<true, false>(points, uv, hidden, tinted, n, step, out, out_uv, out_colors);
+    if (tinted)
+        return gather<false, true>(points, uv, hidden, tinted, n, step, out, out_uv, out_colors);
+    return gather<false, false>(points, uv, hidden, tinted, n, step, out, out_uv, out_colors);
+}
+
+// First integer >= v, v clamped to [0, limit] (NaN goes to 0)
+inline int clamped_ceil(float v, float limit)
+{
+    v = v >= 0.f ? v : 0.f;
+    v = v <= limit ? v : limit;
+    int i = int(v);
+    return i + (float(i) < v);
+}
+
+// `c ? a : b` with masks: both sides are always computed, so the compiler
+// cannot sink their conversions into branches and the loop if-converts
+inline int pick(bool c, int a, int b)
+{
+    int m = -int(c);
+    return (a & m) | (b & ~m);
+}
+
+void align_row(const uint16_t* depth, int width, float scale, const align_tables& t, int y,
+               int32_t* __restrict u0, int32_t* __restrict v0, int32_t* __restrict u1,
+               int32_t* __restrict v1, float* __restrict z)
+{
+    const float* r = t.row + 6 * size_t(y);
+    const float* cx0 = t.column[0];
+    const float* cy0 = t.column[1];
+    const float* cz0 = t.column[2];
+    const float* cx1 = t.column[3];
+    const float* cy1 = t.column[4];
+    const float* cz1 = t.column[5];
+    const float rx0 = r[0], ry0 = r[1], rz0 = r[2], rx1 = r[3], ry1 = r[4], rz1 = r[5];
+    const float tx = t.translation[0], ty = t.translation[1], tz = t.translation[2];
+    const float fx = t.fx, fy = t.fy, ppx = t.ppx, ppy = t.ppy, grow = t.grow;
+    const float cw = float(t.width), ch = float(t.height);
+    for (int x = 0; x < width; x++)
+    {
+        // top left and bottom right corners of the pixel, in the color camera
+        float d = depth[x] * scale;
+        float x0 = d * (cx0[x] + rx0) + tx;
+        float y0 = d * (cy0[x] + ry0) + ty;
+        float z0 = d * (cz0[x] + rz0) + tz;
+        float x1 = d * (cx1[x] + rx1) + tx;
+        float y1 = d * (cy1[x] + ry1) + ty;
+        float z1 = d * (cz1[x] + rz1) + tz;
+        float a = x0 / z0 * fx + ppx, b = y0 / z0 * fy + ppy;
+        float c = x1 / z1 * fx + ppx, e = y1 / z1 * fy + ppy;
+
+        // pixel centers (integer coordinates) inside the footprint, grown and
+        // clamped to the image: every edge is rounded before the corners are
+        // ordered
+        int a0 = clamped_ceil(a - grow, cw), a1 = clamped_ceil(a + grow, cw);
+        int c0 = clamped_ceil(c - grow, cw), c1 = clamped_ceil(c + grow, cw);
+        int b0 = clamped_ceil(b - grow, ch), b1 = clamped_ceil(b + grow, ch);
+        int e0 = clamped_ceil(e - grow, ch), e1 = clamped_ceil(e + grow, ch);
+        bool left = a < c, top = b < e;
+        int first_u = pick(left, a0, c0), last_u = pick(left, c1, a1) - 1;
+        int first_v = pick(top, b0, e0), last_v = pick(top, e1, b1) - 1;
+        bool covers = (d > 0.f) & (z0 > 0.f) & (z1 > 0.f) & (first_u <= last_u) & (first_v <= last_v);
+        u0[x] = pick(covers, first_u, -1);
+        v0[x] = first_v;
+        u1[x] = last_u;
+        v1[x] = last_v;
+        z[x] = (z0 + z1) * 0.5f;   // z is affine along the ray, the middle is the center
+    }
+}
+
+
+void depth_column_sums(const uint16_t* row, int width, uint32_t* __restrict sum, uint32_t* __restrict count)
+{
+    for (int x = 0; x < width; x++)
+    {
+        sum[x] += row[x];
+        count[x] += row[x] != 0;
+    }
+}
+
+void depth_compare(const uint16_t* a, const uint16_t* b, int n, int tolerance, depth_match& m)
+{
+    // 32 bit counters for the vector loop, a row has a few hundred cells
+    int32_t both = 0, either = 0, agree = 0, delta = 0, distance = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int32_t da = a[i], db = b[i];
+        int32_t valid = (da != 0) & (db != 0);
+        int32_t d = db - da;
+        int32_t magnitude = d < 0 ? -d : d;
+        both += valid;
+        either += (da | db) != 0;
+        agree += valid & (magnitude * 256 <= da * tolerance);
+        delta += pick(valid != 0, d, 0);
+        distance += pick(valid != 0, magnitude, 0);
+    }
+    m.both += both;
+    m.either += either;
+    m.agree += agree;
+    m.delta += delta;
+    m.distance += distance;
+}
+
+void tile_sad8(const uint8_t* a, const uint8_t* b, int n, int tile, uint32_t* sums)
+{
+    for (int t = 0; t * tile < n; t++)
+    {
+        int b0 = t * tile, e = b0 + tile < n ? b0 + tile : n;
+        uint32_t sad = 0;
+        for (int i = b0; i < e; i++)
+        {
+            int d = int(b[i]) - int(a[i]);
+            sad += uint32_t(d < 0 ? -d : d);
+        }
+        sums[t] += sad;
+    }
+}
+
+void tile_sad16(const uint16_t* a, const uint16_t* b, int n, int tile, uint32_t* sums)
+{
+    for (int t = 0; t * tile < n; t++)
+    {
+        int b0 = t * tile, e = b0 + tile < n ? b0 + tile : n;
+        uint32_t sad = 0;
+        for (int i = b0; i < e; i++)
+        {
+            int32_t d = int32_t(b[i]) - int32_t(a[i]);
+            sad += uint32_t(d < 0 ? -d : d);
+        }
+        sums[t] += sad;
+    }
+}
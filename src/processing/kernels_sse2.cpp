@@ -0,0 +1,26 @@
+/**
+ * kernels_sse2.cpp
+ * Baseline kernels: SSE2 on x86-64, plain code on other architectures.
+ */
+
+#include "kernels.hpp"
+
+namespace
+{
+#include "kernels_impl.hpp"
+}
+
+const cloud_kernels* cloud_kernels_sse2()
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    const simd_level level = simd_sse2;
+#else
+    const simd_level level = simd_scalar;
+#endif
+    static const cloud_kernels kernels = {
+        deproject_rows, count_kept, copy_kept, gather_visible, align_row,
+        depth_column_sums, depth_compare, tile_sad8, tile_sad16,
+        level, level, level, level, level, level
+    };
+    return &kernels;
+}
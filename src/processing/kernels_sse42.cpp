@@ -0,0 +1,32 @@
+/**
+ * kernels_sse42.cpp
+ * Kernels compiled for SSE4.2 (-msse4.2, see CMakeLists.txt).
+ */
+
+#include "kernels.hpp"
+
+#if defined(__SSE4_2__)
+
+namespace
+{
+#include "kernels_impl.hpp"
+}
+
+const cloud_kernels* cloud_kernels_sse42()
+{
+    static const cloud_kernels kernels = {
+        deproject_rows, count_kept, copy_kept, gather_visible, align_row,
+        depth_column_sums, depth_compare, tile_sad8, tile_sad16,
+        simd_sse42, simd_sse42, simd_sse42, simd_sse42, simd_sse42, simd_sse42
+    };
+    return &kernels;
+}
+
+#else
+
+const cloud_kernels* cloud_kernels_sse42()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * keyframe.cpp
+ */
+
+#include "keyframe.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "kernels.hpp"
+
+using namespace std;
+
+namespace
+{
+    // Shifts tried each way, in cells
+    const int max_shift = 4;
+
+    // Cells agree within 2% of their depth (5 / 256)
+    const int tolerance = 5;
+
+    const float degrees = 180.f / 3.14159265f;
+}
+
+void keyframe_gate::reset()
+{
+    has_key = false;
+    frame_count = keyframe_count = 0;
+}
+
+void keyframe_gate::reduce(const uint16_t* depth, int stride)
+{
+    const cloud_kernels& k = active_kernels();
+    int width = cols * cell;
+    level.resize(size_t(cols) * rows);
+    sums.resize(size_t(width));
+    counts.resize(size_t(width));
+    for (int r = 0; r < rows; r++)
+    {
+        fill(sums.begin(), sums.end(), 0u);
+        fill(counts.begin(), counts.end(), 0u);
+        for (int y = r * cell; y < (r + 1) * cell; y++)
+            k.depth_column_sums(reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(depth) +
+                                                                  size_t(y) * stride),
+                                width, sums.data(), counts.data());
+        // the mean of the pixels with depth, when they are at least half the cell
+        uint16_t* out = &level[size_t(r) * cols];
+        for (int c = 0; c < cols; c++)
+        {
+            uint32_t sum = 0, count = 0;
+            for (int x = c * cell; x < (c + 1) * cell; x++)
+            {
+                sum += sums[x];
+                count += counts[x];
+            }
+            out[c] = count * 2 >= uint32_t(cell * cell) ? uint16_t(sum / count) : 0;
+        }
+    }
+}
+
+frame_motion keyframe_gate::update(const uint16_t* depth, int stride, const depth_intrinsics& intrin,
+                                   float depth_scale)
+{
+    frame_motion motion;
+    frame_count++;
+
+    // about three cells to the rotation threshold
+    float threshold = max(options.max_rotation, 0.1f) / degrees;
+    int size = max(2, min(16, int(threshold * min(intrin.fx, intrin.fy) / 3.f)));
+    if (!has_key || size != cell || intrin.width / size != cols || intrin.height / size != rows)
+    {
+        // first frame, or another resolution
+        cell = size;
+        cols = intrin.width / cell;
+        rows = intrin.height / cell;
+        reduce(depth, stride);
+        key.swap(level);
+        has_key = true;
+        keyframe_count++;
+        motion.keyframe = true;
+        return motion;
+    }
+    reduce(depth, stride);
+
+    // the shift where the frame is nearest to the keyframe, in mean depth
+    // difference: it stays meaningful when the camera moved closer
+    const cloud_kernels& k = active_kernels();
+    int64_t key_cells = count_if(key.begin(), key.end(), [](uint16_t d) { return d != 0; });
+    depth_match best;
+    double best_distance = 0.0;
+    int best_dx = 0, best_dy = 0;
+    for (int dy = -max_shift; dy <= max_shift; dy++)
+        for (int dx = -max_shift; dx <= max_shift; dx++)
+        {
+            int n = cols - abs(dx);
+            if (n <= 0 || abs(dy) >= rows)
+                continue;
+            depth_match m;
+            for (int y = max(0, -dy); y < min(rows, rows - dy); y++)
+                k.depth_compare(&key[size_t(y) * cols + max(0, -dx)], &level[size_t(y + dy) * cols + max(0, dx)],
+                                n, tolerance, m);
+            if (!m.both)
+                continue;
+            // ties go to the smaller shift
+            double distance = double(m.distance) / double(m.both);
+            if (!best.both || distance < best_distance ||
+                (distance == best_distance && abs(dx) + abs(dy) < abs(best_dx) + abs(best_dy)))
+            {
+                best = m;
+                best_distance = distance;
+                best_dx = dx;
+                best_dy = dy;
+            }
+        }
+
+    float ax = atan(best_dx * cell / intrin.fx), ay = atan(best_dy * cell / intrin.fy);
+    motion.rotation = sqrt(ax * ax + ay * ay) * degrees;
+    motion.translation = best.both ? float(double(best.delta) / double(best.both)) * depth_scale : 0.f;
+    if (key_cells)
+        motion.overlap = float(double(best.agree) / double(key_cells));
+    else
+        motion.overlap = any_of(level.begin(), level.end(), [](uint16_t d) { return d != 0; }) ? 0.f : 1.f;
+
+    motion.keyframe = motion.rotation > options.max_rotation || fabs(motion.translation) > options.max_translation ||
+                      motion.overlap < options.min_overlap;
+    if (motion.keyframe)
+    {
+        key.swap(level);
+        keyframe_count++;
+    }
+    return motion;
+}
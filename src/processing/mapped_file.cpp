@@ -0,0 +1,103 @@
+/**
+ * mapped_file.cpp
+ */
+
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const string& path)
+{
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw runtime_error("cannot open " + path);
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    length = size_t(size.QuadPart);
+    if (length == 0)
+    {
+        CloseHandle(file);
+        throw runtime_error(path + " is empty");
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!bytes)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw runtime_error("cannot map " + path);
+    }
+}
+
+mapped_file::~mapped_file()
+{
+    UnmapViewOfFile(bytes);
+    CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+void mapped_file::prefetch(size_t offset, size_t count) const
+{
+    if (offset >= length)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(bytes) + offset;
+    range.NumberOfBytes = min(count, length - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+mapped_file::mapped_file(const string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        throw runtime_error(path + " is empty");
+    }
+    length = size_t(st.st_size);
+    void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw runtime_error("cannot map " + path);
+    bytes = static_cast<const uint8_t*>(p);
+}
+
+mapped_file::~mapped_file()
+{
+    munmap(const_cast<uint8_t*>(bytes), length);
+}
+
+void mapped_file::prefetch(size_t offset, size_t count) const
+{
+    if (offset >= length)
+        return;
+    // madvise wants a page aligned start
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    size_t start = offset / page * page;
+    size_t end = offset + count < length ? offset + count : length;
+    madvise(const_cast<uint8_t*>(bytes) + start, end - start, MADV_WILLNEED);
+}
+
+#endif
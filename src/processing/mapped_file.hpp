@@ -0,0 +1,43 @@
+/**
+ * mapped_file.hpp
+ * Read-only memory mapping of a file.
+ */
+
+#ifndef RSSCANNER_PROCESSING_MAPPED_FILE_H
+#define RSSCANNER_PROCESSING_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// \class mapped_file
+/// Maps a whole file read-only. Nothing is read up front: pages come in from
+/// disk (or the page cache) the first time they are touched, so only the
+/// parts of the file actually used cost I/O.
+class mapped_file
+{
+    public:
+        // throws std::runtime_error if the file can't be opened or mapped
+        explicit mapped_file(const std::string& path);
+        ~mapped_file();
+
+        const uint8_t* data() const { return bytes; }
+        size_t size() const { return length; }
+
+        // Hint that [offset, offset + count) will be read soon, so the OS can
+        // start reading it in the background
+        void prefetch(size_t offset, size_t count) const;
+
+    private:
+        mapped_file(const mapped_file&);
+        mapped_file& operator=(const mapped_file&);
+
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+#endif
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_MAPPED_FILE_H */
@@ -0,0 +1,97 @@
+/**
+ * node_loader.cpp
+ */
+
+#include "node_loader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+node_loader::node_loader(const cloud_file& file, unsigned threads)
+    : file(file), busy(file.block_count(), 0), reading(0)
+{
+    for (unsigned i = 0; i < max(threads, 1u); i++)
+        workers.emplace_back([this]() { work(); });
+}
+
+node_loader::~node_loader()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers)
+        t.join();
+}
+
+void node_loader::request(const vector<uint32_t>& blocks)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        queue.assign(blocks.begin(), blocks.end());
+    }
+    if (!blocks.empty())
+        wake.notify_all();
+}
+
+bool node_loader::poll(uint32_t& block, vector<uint8_t>& data)
+{
+    lock_guard<mutex> guard(lock);
+    if (done.empty())
+        return false;
+    block = done.back().first;
+    data.swap(done.back().second);
+    busy[block] = 0;
+    done_bytes -= data.size();
+    done.pop_back();
+    return true;
+}
+
+size_t node_loader::queued() const
+{
+    lock_guard<mutex> guard(lock);
+    return queue.size();
+}
+
+size_t node_loader::ready_bytes() const
+{
+    lock_guard<mutex> guard(lock);
+    return done_bytes;
+}
+
+void node_loader::work()
+{
+    bool colors = (file.columns() & cloud_colors) != 0;
+    for (;;)
+    {
+        uint32_t block;
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [this]() { return stop || !queue.empty(); });
+            if (stop)
+                return;
+            block = queue.front();
+            queue.pop_front();
+            if (busy[block])
+                continue;
+            busy[block] = 1;
+            reading++;
+        }
+
+        // touching the mapping is what reads the file
+        const cloud_block& b = file.block(block);
+        size_t position_bytes = b.count * sizeof(float3);
+        vector<uint8_t> data(position_bytes + (colors ? b.count * sizeof(uint32_t) : 0));
+        memcpy(data.data(), file.positions(block), position_bytes);
+        if (colors)
+            memcpy(data.data() + position_bytes, file.colors(block), b.count * sizeof(uint32_t));
+
+        lock_guard<mutex> guard(lock);
+        done_bytes += data.size();
+        done.push_back(make_pair(block, std::move(data)));
+        reading--;
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * node_loader.hpp
+ * Background reading of cloud file blocks.
+ */
+
+#ifndef RSSCANNER_PROCESSING_NODE_LOADER_H
+#define RSSCANNER_PROCESSING_NODE_LOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cloud_file.hpp"
+
+/// \class node_loader
+/// Worker threads copying blocks of a mapped cloud_file into memory, so the
+/// page faults reading them from disk never happen on the caller's thread.
+/// The caller says every frame which blocks it wants, most wanted first,
+/// and collects the finished ones without waiting.
+class node_loader
+{
+    public:
+        node_loader(const cloud_file& file, unsigned threads = 2);
+        ~node_loader();
+
+        // Replace the queue of blocks to read. Blocks already being read
+        // are finished and delivered even if they are not asked for anymore,
+        // and are not read again until they have been polled.
+        void request(const std::vector<uint32_t>& blocks);
+
+        // Take a finished block: its positions followed by its colors, if
+        // the file has them. False if none is ready.
+        bool poll(uint32_t& block, std::vector<uint8_t>& data);
+
+        // blocks waiting in the queue and being read
+        size_t queued() const;
+        size_t in_flight() const { return reading.load(); }
+
+        // bytes of finished blocks not polled yet
+        size_t ready_bytes() const;
+
+    private:
+        node_loader(const node_loader&);
+        node_loader& operator=(const node_loader&);
+
+        const cloud_file& file;
+        std::vector<std::thread> workers;
+        mutable std::mutex lock;
+        std::condition_variable wake;
+        std::deque<uint32_t> queue;
+        std::vector<std::pair<uint32_t, std::vector<uint8_t>>> done;
+        std::vector<uint8_t> busy;   // per block: being read or waiting to be polled
+        size_t done_bytes = 0;
+        std::atomic<size_t> reading;
+        bool stop = false;
+
+        void work();
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_NODE_LOADER_H */
@@ -0,0 +1,365 @@
+/**
+ * outliers.cpp
+ */
+
+#include "outliers.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace
+{
+    const size_t pass_blocks = 64;
+    const int max_k = 32;
+    const int max_window = 2 * 7 + 1;   // organized search window, in pixels
+
+    inline float dist2(const float3& a, const float3& b)
+    {
+        float3 d = a - b;
+        return dot(d, d);
+    }
+
+    // The k smallest squared distances offered. Unsorted: a closer one
+    // replaces the current worst, found again by a branch free scan.
+    struct nearest
+    {
+        float d2[max_k];
+        int count = 0;
+        int k;
+        int worst = 0;
+
+        explicit nearest(int k) : k(k) {}
+
+        float reach() const { return count == k ? d2[worst] : numeric_limits<float>::max(); }
+
+        void offer(float d)
+        {
+            if (count < k)
+            {
+                d2[count] = d;
+                worst = d > d2[worst] ? count : worst;
+                count++;
+                return;
+            }
+            if (d >= d2[worst])
+                return;
+            d2[worst] = d;
+            for (int i = 0; i < k; i++)
+                worst = d2[i] > d2[worst] ? i : worst;
+        }
+
+        // mean distance, the missing neighbours counted as `missing` away
+        float mean(float missing) const
+        {
+            float sum = 0.f;
+            for (int i = 0; i < count; i++)
+                sum += sqrt(d2[i]);
+            return (sum + missing * (k - count)) / k;
+        }
+    };
+
+    // Mean distance from pixel (x, y) to its k nearest neighbours in the
+    // window. The window is small: gather it all, then select the k nearest.
+    float window_mean_distance(const float3* points, int width, int x, int y,
+                               int x0, int x1, int y0, int y1, int k)
+    {
+        const float3 p = points[size_t(y) * width + x];
+        float d2[max_window * max_window];
+        int n = 0;
+        for (int ny = y0; ny <= y1; ny++)
+        {
+            const float3* row = points + size_t(ny) * width;
+            for (int nx = x0; nx <= x1; nx++)
+            {
+                d2[n] = dist2(p, row[nx]);
+                n += (row[nx].z != 0.f) & ((nx != x) | (ny != y));
+            }
+        }
+        // an isolated pixel counts as far as the window reaches at its depth
+        if (!n)
+            return p.z;
+        int found = min(n, k);
+        if (n > k)
+            nth_element(d2, d2 + k - 1, d2 + n);
+        float sum = 0.f, farthest = 0.f;
+        for (int i = 0; i < found; i++)
+        {
+            float d = sqrt(d2[i]);
+            sum += d;
+            farthest = max(farthest, d);
+        }
+        return (sum + 2.f * farthest * (k - found)) / k;
+    }
+
+    // Statistical filter on per-point mean neighbour distances (NaN for
+    // points without depth): flag the ones beyond mean + ratio * stddev
+    size_t flag_statistical(const vector<float>& mean_dist, float ratio, uint8_t* removed)
+    {
+        size_t n = mean_dist.size();
+        double sum[pass_blocks], sum2[pass_blocks];
+        size_t count[pass_blocks];
+        parallel_blocks(n, pass_blocks, [&](size_t blk, size_t b, size_t e)
+        {
+            double s = 0, s2 = 0;
+            size_t c = 0;
+            for (size_t i = b; i < e; i++)
+            {
+                float d = mean_dist[i];
+                if (d != d)
+                    continue;
+                s += d;
+                s2 += double(d) * d;
+                c++;
+            }
+            sum[blk] = s;
+            sum2[blk] = s2;
+            count[blk] = c;
+        });
+        double s = 0, s2 = 0;
+        size_t c = 0;
+        for (size_t blk = 0; blk < pass_blocks; blk++)
+        {
+            s += sum[blk];
+            s2 += sum2[blk];
+            c += count[blk];
+        }
+        if (!c)
+            return 0;
+        double mean = s / c;
+        float limit = float(mean + ratio * sqrt(max(0.0, s2 / c - mean * mean)));
+
+        size_t flagged[pass_blocks];
+        parallel_blocks(n, pass_blocks, [&](size_t blk, size_t b, size_t e)
+        {
+            size_t f = 0;
+            for (size_t i = b; i < e; i++)
+                if (mean_dist[i] > limit)
+                {
+                    removed[i] = 1;
+                    f++;
+                }
+            flagged[blk] = f;
+        });
+        size_t total = 0;
+        for (size_t f : flagged)
+            total += f;
+        return total;
+    }
+
+    // Points bucketed by hashed cell, copied in bucket order so that the
+    // points of a cell are read together. Bricks of 4x4x4 cells are hashed
+    // to 64 consecutive buckets, so most neighbouring cells are close in memory.
+    struct spatial_hash
+    {
+        float cell;
+        uint32_t mask;
+        vector<uint32_t> start;    // first entry of each bucket, plus one past the end
+        vector<uint32_t> entries;  // point indices
+        vector<float3> sorted;     // the point of each entry
+
+        static uint32_t bucket_of(int x, int y, int z, uint32_t mask)
+        {
+            // offset binary keeps the order of negative cells when shifting
+            uint32_t ux = uint32_t(x) ^ 0x80000000u, uy = uint32_t(y) ^ 0x80000000u, uz = uint32_t(z) ^ 0x80000000u;
+            uint32_t brick = (ux >> 2) * 73856093u ^ (uy >> 2) * 19349663u ^ (uz >> 2) * 83492791u;
+            return ((brick << 6) | (ux & 3) | (uy & 3) << 2 | (uz & 3) << 4) & mask;
+        }
+
+        int coord(float v) const { return int(floor(v / cell)); }
+
+        void build(const float3* points, size_t n, float cell_size)
+        {
+            cell = cell_size;
+            size_t buckets = 64;
+            while (buckets < n)
+                buckets <<= 1;
+            mask = uint32_t(buckets - 1);
+
+            vector<uint32_t> key(n);
+            parallel_for(0, n, 16384, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    const float3& p = points[i];
+                    key[i] = p.z != 0.f ? bucket_of(coord(p.x), coord(p.y), coord(p.z), mask) : ~0u;
+                }
+            });
+            start.assign(buckets + 1, 0);
+            for (size_t i = 0; i < n; i++)
+                if (key[i] != ~0u)
+                    start[key[i] + 1]++;
+            for (size_t b = 0; b < buckets; b++)
+                start[b + 1] += start[b];
+            entries.resize(start[buckets]);
+            sorted.resize(start[buckets]);
+            vector<uint32_t> fill(start.begin(), start.end() - 1);
+            for (size_t i = 0; i < n; i++)
+                if (key[i] != ~0u)
+                {
+                    uint32_t e = fill[key[i]]++;
+                    entries[e] = uint32_t(i);
+                    sorted[e] = points[i];
+                }
+        }
+
+        // fn(e) for every entry in the 27 cells around p, each bucket visited
+        // once, until fn returns false. Cells further than reach() (squared)
+        // from p are skipped; the own cell goes first, it holds the nearest points.
+        template <class R, class F>
+        void around(const float3& p, R reach, F fn) const
+        {
+            int c[3] = { coord(p.x), coord(p.y), coord(p.z) };
+            float v[3] = { p.x, p.y, p.z };
+            // squared distance from p to the lower and upper face of its cell, per axis
+            float below[3], above[3];
+            for (int a = 0; a < 3; a++)
+            {
+                float lo = v[a] - c[a] * cell, hi = (c[a] + 1) * cell - v[a];
+                below[a] = lo * lo;
+                above[a] = hi * hi;
+            }
+            uint32_t seen[27];
+            int nseen = 0;
+            for (int i = 13; i < 13 + 27; i++)
+            {
+                int o[3] = { i % 27 % 3 - 1, i % 27 / 3 % 3 - 1, i % 27 / 9 - 1 };
+                float gap = 0.f;
+                for (int a = 0; a < 3; a++)
+                    gap += o[a] < 0 ? below[a] : (o[a] > 0 ? above[a] : 0.f);
+                if (gap > reach())
+                    continue;
+                uint32_t b = bucket_of(c[0] + o[0], c[1] + o[1], c[2] + o[2], mask);
+                if (find(seen, seen + nseen, b) != seen + nseen)
+                    continue;
+                seen[nseen++] = b;
+                for (uint32_t e = start[b]; e < start[b + 1]; e++)
+                    if (!fn(e))
+                        return;
+            }
+        }
+    };
+}
+
+size_t remove_outliers_organized(const float3* points, int width, int height,
+                                 const outlier_options& opt, uint8_t* removed)
+{
+    if (opt.filter == outlier_none || width <= 0 || height <= 0)
+        return 0;
+    size_t n = size_t(width) * height;
+    int r = min(max(1, opt.window), max_window / 2);
+    int k = min(max(1, opt.k), max_k);
+    float radius2 = opt.radius * opt.radius;
+    float nan = numeric_limits<float>::quiet_NaN();
+
+    vector<float> mean_dist;
+    if (opt.filter == outlier_statistical)
+        mean_dist.assign(n, nan);
+    size_t flagged[pass_blocks] = {};
+
+    // blocks of rows; each point only reads its neighbours
+    parallel_blocks(size_t(height), pass_blocks, [&](size_t blk, size_t row_b, size_t row_e)
+    {
+        for (int y = int(row_b); y < int(row_e); y++)
+            for (int x = 0; x < width; x++)
+            {
+                size_t i = size_t(y) * width + x;
+                const float3& p = points[i];
+                if (p.z == 0.f)
+                    continue;
+                int y0 = max(0, y - r), y1 = min(height - 1, y + r);
+                int x0 = max(0, x - r), x1 = min(width - 1, x + r);
+                if (opt.filter == outlier_statistical)
+                {
+                    mean_dist[i] = window_mean_distance(points, width, x, y, x0, x1, y0, y1, k);
+                }
+                else
+                {
+                    int count = 0;
+                    for (int ny = y0; ny <= y1 && count < opt.min_neighbors; ny++)
+                        for (int nx = x0; nx <= x1; nx++)
+                        {
+                            const float3& q = points[size_t(ny) * width + nx];
+                            count += q.z != 0.f && (nx != x || ny != y) && dist2(p, q) <= radius2;
+                        }
+                    if (count < opt.min_neighbors)
+                    {
+                        removed[i] = 1;
+                        flagged[blk]++;
+                    }
+                }
+            }
+    });
+
+    if (opt.filter == outlier_statistical)
+        return flag_statistical(mean_dist, opt.std_ratio, removed);
+    size_t total = 0;
+    for (size_t f : flagged)
+        total += f;
+    return total;
+}
+
+size_t remove_outliers(const float3* points, size_t n, const outlier_options& opt, uint8_t* removed)
+{
+    if (opt.filter == outlier_none || n == 0 || !(opt.radius > 0.f))
+        return 0;
+    int k = min(max(1, opt.k), max_k);
+    float radius2 = opt.radius * opt.radius;
+    float nan = numeric_limits<float>::quiet_NaN();
+
+    spatial_hash grid;
+    grid.build(points, n, opt.radius);
+
+    vector<float> mean_dist;
+    if (opt.filter == outlier_statistical)
+        mean_dist.assign(n, nan);
+    size_t flagged[pass_blocks] = {};
+
+    // queries in bucket order, the points of a cell share the neighbouring buckets
+    const vector<float3>& sorted = grid.sorted;
+    parallel_blocks(sorted.size(), pass_blocks, [&](size_t blk, size_t b, size_t e)
+    {
+        for (size_t self = b; self < e; self++)
+        {
+            const float3 p = sorted[self];
+            size_t i = grid.entries[self];
+            if (opt.filter == outlier_statistical)
+            {
+                nearest near(k);
+                grid.around(p, [&]() { return near.reach(); }, [&](uint32_t j)
+                {
+                    if (j != self)
+                        near.offer(dist2(p, sorted[j]));
+                    return true;
+                });
+                mean_dist[i] = near.mean(2.f * opt.radius);
+            }
+            else
+            {
+                int count = 0;
+                grid.around(p, [&]() { return radius2; }, [&](uint32_t j)
+                {
+                    count += j != self && dist2(p, sorted[j]) <= radius2;
+                    return count < opt.min_neighbors;
+                });
+                if (count < opt.min_neighbors)
+                {
+                    removed[i] = 1;
+                    flagged[blk]++;
+                }
+            }
+        }
+    });
+
+    if (opt.filter == outlier_statistical)
+        return flag_statistical(mean_dist, opt.std_ratio, removed);
+    size_t total = 0;
+    for (size_t f : flagged)
+        total += f;
+    return total;
+}
@@ -0,0 +1,45 @@
+/**
+ * outliers.hpp
+ * Statistical and radius outlier removal, for the flying pixels found at
+ * depth edges.
+ */
+
+#ifndef RSSCANNER_PROCESSING_OUTLIERS_H
+#define RSSCANNER_PROCESSING_OUTLIERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "types.hpp"
+
+enum outlier_filter
+{
+    outlier_none = 0,
+    outlier_statistical,   // mean distance to the k nearest neighbours far above the cloud's average
+    outlier_radius         // too few neighbours within a radius
+};
+
+struct outlier_options
+{
+    outlier_filter filter = outlier_radius;
+    int k = 8;                  // neighbours averaged by the statistical filter
+    float std_ratio = 1.5f;     // statistical: remove beyond mean + std_ratio * standard deviation
+    float radius = 0.02f;       // radius filter, and the cell size of the spatial hash
+    int min_neighbors = 4;      // radius filter
+    int window = 2;             // organized clouds: neighbours are searched (2 * window + 1)^2 pixels around, up to 7
+};
+
+/// Flag the outliers of an organized cloud, one point per pixel of a
+/// `width` x `height` image, points without depth having z == 0. Neighbours
+/// are the pixels around each point. Sets removed[i] to 1 for each outlier
+/// and leaves the other entries untouched. Returns the number flagged.
+size_t remove_outliers_organized(const float3* points, int width, int height,
+                                 const outlier_options& opt, uint8_t* removed);
+
+/// Same for a cloud without an image layout, such as an accumulated one.
+/// Neighbours are looked up in a spatial hash of `opt.radius` cells, so the
+/// statistical filter only sees neighbours closer than one cell: missing
+/// ones count as two cells away.
+size_t remove_outliers(const float3* points, size_t n, const outlier_options& opt, uint8_t* removed);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_OUTLIERS_H */
@@ -0,0 +1,68 @@
+/**
+ * parallel.hpp
+ * Fork/join helpers for the CPU processing stages, on the shared
+ * task_scheduler.
+ */
+
+#ifndef RSSCANNER_PROCESSING_PARALLEL_H
+#define RSSCANNER_PROCESSING_PARALLEL_H
+
+#include <cstddef>
+#include <exception>
+#include <thread>
+
+#include "scheduler.hpp"
+
+// Threads the processing stages run on: the shared scheduler's workers and
+// the thread waiting on them
+inline unsigned hardware_threads()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Run fn(begin, end) over [begin, end) split into pieces of at least
+// `grain` indices, on the shared task_scheduler. The calling thread works
+// on the pieces too.
+template <class F>
+void parallel_for(size_t begin, size_t end, size_t grain, F fn)
+{
+    task_scheduler::shared().parallel_for(begin, end, grain, [&fn](size_t b, size_t e) { fn(b, e); });
+}
+
+// Split [0, n) in `blocks` fixed blocks and run fn(block, begin, end) over
+// them in parallel. The split does not depend on the thread count, so
+// per-block results reduced in block order are reproducible.
+template <class F>
+void parallel_blocks(size_t n, size_t blocks, F fn)
+{
+    parallel_for(0, blocks, 1, [&](size_t b, size_t e)
+    {
+        for (size_t k = b; k < e; k++)
+            fn(k, n * k / blocks, n * (k + 1) / blocks);
+    });
+}
+
+// Run two independent jobs, the second one on the calling thread while
+// the first one waits to be picked up by a worker
+template <class F1, class F2>
+void parallel_invoke(F1 f1, F2 f2)
+{
+    task_scheduler& scheduler = task_scheduler::shared();
+    task_counter counter;
+    scheduler.spawn([&f1]() { f1(); }, counter);
+    std::exception_ptr error;
+    try
+    {
+        f2();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    scheduler.wait(counter);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_PARALLEL_H */
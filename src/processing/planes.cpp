@@ -0,0 +1,391 @@
+/**
+ * planes.cpp
+ */
+
+#include "planes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "parallel.hpp"
+#include "utils/stopwatch.hpp"
+
+using namespace std;
+
+namespace
+{
+    const size_t score_block = 1024;   // sample points scored between early termination checks
+    const size_t round_size = 64;      // hypotheses per round, scored in parallel
+    const size_t pass_blocks = 64;     // parallel passes over the whole cloud
+
+    inline uint32_t hash32(uint32_t x)
+    {
+        x ^= x >> 16; x *= 0x7feb352du;
+        x ^= x >> 15; x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    inline float3 cross(const float3& a, const float3& b)
+    {
+        return{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    // Sample of the cloud in columns, padded to a multiple of 4 with NaN,
+    // which is never within the threshold of a plane
+    struct sample_set
+    {
+        vector<float> x, y, z;
+        size_t count = 0;
+
+        void push(const float3& p) { x.push_back(p.x); y.push_back(p.y); z.push_back(p.z); count++; }
+
+        void pad()
+        {
+            size_t padded = (count + 3) & ~size_t(3);
+            float nan = numeric_limits<float>::quiet_NaN();
+            x.resize(padded, nan);
+            y.resize(padded, nan);
+            z.resize(padded, nan);
+        }
+
+        float3 at(size_t i) const { return{ x[i], y[i], z[i] }; }
+    };
+
+    struct hypothesis
+    {
+        float3 normal;
+        float d;
+        size_t score;
+    };
+
+    // Sample points within `t` of the plane among [b, e), b and e multiples of 4
+    size_t count_inliers(const sample_set& s, size_t b, size_t e, float3 n, float d, float t)
+    {
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128 nx = _mm_set1_ps(n.x), ny = _mm_set1_ps(n.y), nz = _mm_set1_ps(n.z);
+        const __m128 vd = _mm_set1_ps(d), vt = _mm_set1_ps(t), sign = _mm_set1_ps(-0.f);
+        __m128i acc = _mm_setzero_si128();
+        for (size_t i = b; i < e; i += 4)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&s.x[i])), _mm_mul_ps(ny, _mm_loadu_ps(&s.y[i]))),
+                                     _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(&s.z[i])), vd));
+            // all ones lanes are -1: subtracting the mask counts them
+            acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmplt_ps(_mm_andnot_ps(sign, dist), vt)));
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        return size_t(lanes[0]) + size_t(lanes[1]) + size_t(lanes[2]) + size_t(lanes[3]);
+#else
+        size_t count = 0;
+        for (size_t i = b; i < e; i++)
+            count += fabs(n.x * s.x[i] + n.y * s.y[i] + n.z * s.z[i] + d) < t;
+        return count;
+#endif
+    }
+
+    // Plane through three sample points picked from `seed`, score 0 when degenerate
+    hypothesis make_hypothesis(const sample_set& s, uint32_t seed)
+    {
+        hypothesis h = {};
+        uint32_t r = hash32(seed);
+        size_t i0 = r % s.count;
+        r = hash32(r + 1);
+        size_t i1 = r % s.count;
+        r = hash32(r + 1);
+        size_t i2 = r % s.count;
+        if (i0 == i1 || i1 == i2 || i0 == i2)
+            return h;
+
+        float3 a = s.at(i0);
+        float3 n = cross(s.at(i1) - a, s.at(i2) - a);
+        float len = sqrt(dot(n, n));
+        if (!(len > 1e-9f))
+            return h;
+        h.normal = n * (1.f / len);
+        h.d = -dot(h.normal, a);
+        h.score = 1;
+        return h;
+    }
+
+    // Score `h` on the sample, giving up once it can no longer reach `beat`
+    void score(const sample_set& s, hypothesis& h, float t, size_t beat)
+    {
+        size_t count = 0;
+        size_t padded = s.x.size();
+        for (size_t b = 0; b < padded; b += score_block)
+        {
+            size_t e = min(b + score_block, padded);
+            count += count_inliers(s, b, e, h.normal, h.d, t);
+            if (count + (padded - e) < beat)
+                break;
+        }
+        h.score = count;
+    }
+
+    // Eigenvector of the smallest eigenvalue of the symmetric matrix `a`, by Jacobi rotations
+    float3 smallest_eigenvector(double a[3][3])
+    {
+        double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+        for (int sweep = 0; sweep < 16; sweep++)
+        {
+            double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+            if (off < 1e-30)
+                break;
+            for (int p = 0; p < 2; p++)
+                for (int q = p + 1; q < 3; q++)
+                {
+                    if (a[p][q] == 0.0)
+                        continue;
+                    double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                    double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                    double c = 1.0 / sqrt(t * t + 1.0), sn = t * c;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        double akp = a[k][p], akq = a[k][q];
+                        a[k][p] = c * akp - sn * akq;
+                        a[k][q] = sn * akp + c * akq;
+                    }
+                    for (int k = 0; k < 3; k++)
+                    {
+                        double apk = a[p][k], aqk = a[q][k];
+                        a[p][k] = c * apk - sn * aqk;
+                        a[q][k] = sn * apk + c * aqk;
+                    }
+                    for (int k = 0; k < 3; k++)
+                    {
+                        double vkp = v[k][p], vkq = v[k][q];
+                        v[k][p] = c * vkp - sn * vkq;
+                        v[k][q] = sn * vkp + c * vkq;
+                    }
+                }
+        }
+        int m = 0;
+        for (int i = 1; i < 3; i++)
+            if (a[i][i] < a[m][m])
+                m = i;
+        return{ float(v[0][m]), float(v[1][m]), float(v[2][m]) };
+    }
+
+    // Sums over the unlabelled points near a plane, relative to `origin`
+    struct moments
+    {
+        double s[3];
+        double ss[6];   // xx, xy, xz, yy, yz, zz
+        size_t count;
+    };
+
+    // Whether a point without a label yet, with depth, lies within `t` of the
+    // plane. Evaluated without branches: inliers are scattered through a frame.
+    inline bool on_plane(const float3& p, uint8_t label, float3 n, float d, float t)
+    {
+        return (label == 0) & (p.z != 0.f) & (fabs(dot(n, p) + d) < t);
+    }
+
+    // Sums in float over runs of 256 points, which vectorizes, added up in double
+    moments gather(const float3* points, const uint8_t* labels, size_t b, size_t e,
+                   float3 n, float d, float t, float3 origin)
+    {
+        moments m = {};
+        for (size_t r = b; r < e; r += 256)
+        {
+            float s[3] = {}, ss[6] = {};
+            size_t count = 0;
+            for (size_t i = r, re = min(r + 256, e); i < re; i++)
+            {
+                bool in = on_plane(points[i], labels[i], n, d, t);
+                float3 q = (points[i] - origin) * (in ? 1.f : 0.f);
+                s[0] += q.x; s[1] += q.y; s[2] += q.z;
+                ss[0] += q.x * q.x; ss[1] += q.x * q.y; ss[2] += q.x * q.z;
+                ss[3] += q.y * q.y; ss[4] += q.y * q.z; ss[5] += q.z * q.z;
+                count += in;
+            }
+            for (int c = 0; c < 3; c++)
+                m.s[c] += s[c];
+            for (int c = 0; c < 6; c++)
+                m.ss[c] += ss[c];
+            m.count += count;
+        }
+        return m;
+    }
+
+    size_t label_points(const float3* points, uint8_t* labels, size_t b, size_t e,
+                        float3 n, float d, float t, uint8_t label)
+    {
+        size_t count = 0;
+        for (size_t i = b; i < e; i++)
+        {
+            bool in = on_plane(points[i], labels[i], n, d, t);
+            labels[i] = in ? label : labels[i];
+            count += in;
+        }
+        return count;
+    }
+}
+
+size_t segment_planes(const float3* points, size_t n, const plane_options& opt,
+                      vector<plane>& planes, vector<uint8_t>& labels, plane_stats* stats)
+{
+    stopwatch timer;
+    plane_stats st = {};
+    planes.clear();
+    labels.assign(n, 0);
+    float t = opt.threshold;
+
+    size_t valid_in[pass_blocks];
+    parallel_blocks(n, pass_blocks, [&](size_t k, size_t b, size_t e)
+    {
+        size_t c = 0;
+        for (size_t i = b; i < e; i++)
+            c += points[i].z != 0.f;
+        valid_in[k] = c;
+    });
+    size_t valid = 0;
+    for (size_t c : valid_in)
+        valid += c;
+    size_t min_inliers = max<size_t>(size_t(double(opt.min_fraction) * valid), 3);
+
+    // a random sample of the points with depth: one draw per stratum of the
+    // cloud, moving on to the next points of the stratum where there is no depth
+    sample_set sample;
+    if (valid >= 3)
+    {
+        size_t want = min(opt.sample_points, valid);
+        vector<float3> drawn[pass_blocks];
+        parallel_blocks(want, pass_blocks, [&](size_t blk, size_t b, size_t e)
+        {
+            for (size_t j = b; j < e; j++)
+            {
+                size_t sb = n * j / want, se = n * (j + 1) / want;
+                uint32_t r = hash32(opt.seed + uint32_t(j) * 0x9e3779b9u);
+                size_t i = sb + size_t((uint64_t(r) * (se - sb)) >> 32);
+                for (size_t tries = 0; tries < se - sb && tries < 64; tries++, i = i + 1 < se ? i + 1 : sb)
+                    if (points[i].z != 0.f)
+                    {
+                        drawn[blk].push_back(points[i]);
+                        break;
+                    }
+            }
+        });
+        for (const vector<float3>& part : drawn)
+            for (const float3& p : part)
+                sample.push(p);
+    }
+    sample.pad();
+    st.sample_ms = timer.lap_ms();
+
+    for (size_t k = 0; k < opt.max_planes && k < 255 && sample.count >= 3; k++)
+    {
+        // RANSAC: rounds of hypotheses scored in parallel, until the best one
+        // found is unlikely to be beaten
+        stopwatch ransac_timer;
+        hypothesis best = {};
+        size_t needed = opt.max_hypotheses;
+        uint32_t plane_seed = hash32(opt.seed ^ hash32(uint32_t(k) + 1));
+        hypothesis round[round_size];
+        size_t done = 0;
+        while (done < needed)
+        {
+            size_t count = min(round_size, needed - done);
+            size_t beat = best.score;
+            parallel_for(0, count, 8, [&](size_t b, size_t e)
+            {
+                for (size_t h = b; h < e; h++)
+                {
+                    round[h] = make_hypothesis(sample, plane_seed + uint32_t(done + h) * 0x85ebca6bu);
+                    if (round[h].score)
+                        score(sample, round[h], t, beat);
+                }
+            });
+            // first best in hypothesis order, so threads do not change the result
+            for (size_t h = 0; h < count; h++)
+                if (round[h].score > best.score)
+                    best = round[h];
+            done += count;
+
+            double w = double(best.score) / sample.count;
+            if (w > 0)
+            {
+                double miss = 1.0 - w * w * w;
+                double iterations = miss > 0 ? log(1.0 - opt.confidence) / log(miss) : 1.0;
+                needed = min(opt.max_hypotheses, size_t(max(1.0, ceil(iterations))));
+            }
+        }
+        st.hypotheses += done;
+        st.ransac_ms += ransac_timer.elapsed_ms();
+        if (!best.score)
+            break;
+
+        // refinement: least squares plane through the inliers among all the
+        // points, then label the points near the refined plane
+        stopwatch refine_timer;
+        float3 origin = best.normal * -best.d;
+        moments parts[pass_blocks];
+        parallel_blocks(n, pass_blocks, [&](size_t blk, size_t b, size_t e)
+        {
+            parts[blk] = gather(points, labels.data(), b, e, best.normal, best.d, t, origin);
+        });
+        moments all = {};
+        for (const moments& m : parts)
+        {
+            for (int c = 0; c < 3; c++)
+                all.s[c] += m.s[c];
+            for (int c = 0; c < 6; c++)
+                all.ss[c] += m.ss[c];
+            all.count += m.count;
+        }
+        if (all.count < min_inliers)
+        {
+            st.refine_ms += refine_timer.elapsed_ms();
+            break;
+        }
+
+        double c = double(all.count);
+        double mean[3] = { all.s[0] / c, all.s[1] / c, all.s[2] / c };
+        double cov[3][3] = {
+            { all.ss[0] / c - mean[0] * mean[0], all.ss[1] / c - mean[0] * mean[1], all.ss[2] / c - mean[0] * mean[2] },
+            { 0, all.ss[3] / c - mean[1] * mean[1], all.ss[4] / c - mean[1] * mean[2] },
+            { 0, 0, all.ss[5] / c - mean[2] * mean[2] },
+        };
+        cov[1][0] = cov[0][1];
+        cov[2][0] = cov[0][2];
+        cov[2][1] = cov[1][2];
+        plane pl = {};
+        pl.normal = smallest_eigenvector(cov);
+        float len = sqrt(dot(pl.normal, pl.normal));
+        pl.normal = len > 0.f ? pl.normal * (1.f / len) : best.normal;
+        float3 centroid = origin + float3{ float(mean[0]), float(mean[1]), float(mean[2]) };
+        pl.d = -dot(pl.normal, centroid);
+
+        uint8_t label = uint8_t(k + 1);
+        size_t labelled[pass_blocks];
+        parallel_blocks(n, pass_blocks, [&](size_t blk, size_t b, size_t e)
+        {
+            labelled[blk] = label_points(points, labels.data(), b, e, pl.normal, pl.d, t, label);
+        });
+        for (size_t count : labelled)
+            pl.inliers += count;
+        planes.push_back(pl);
+        st.refine_ms += refine_timer.elapsed_ms();
+
+        // the next plane is searched among what is left of the sample
+        sample_set rest;
+        for (size_t i = 0; i < sample.count; i++)
+        {
+            float3 p = sample.at(i);
+            if (!(fabs(dot(pl.normal, p) + pl.d) < t))
+                rest.push(p);
+        }
+        rest.pad();
+        sample = std::move(rest);
+    }
+
+    if (stats)
+        *stats = st;
+    return planes.size();
+}
@@ -0,0 +1,54 @@
+/**
+ * planes.hpp
+ * RANSAC segmentation of the dominant planes (floor, table top) of a point cloud.
+ */
+
+#ifndef RSSCANNER_PROCESSING_PLANES_H
+#define RSSCANNER_PROCESSING_PLANES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+// A plane dot(normal, p) + d = 0, normal of unit length
+struct plane
+{
+    float3 normal;
+    float d;
+    size_t inliers;   // points labelled with this plane
+};
+
+struct plane_options
+{
+    float threshold = 0.01f;        // max distance of an inlier to its plane, meters
+    size_t max_planes = 2;
+    float min_fraction = 0.1f;      // smallest plane kept, as a fraction of the points with depth
+    float confidence = 0.99f;       // stop once a better plane is less likely than this
+    size_t max_hypotheses = 2048;   // per plane
+    size_t sample_points = 16384;   // hypotheses are scored on a random sample of this size
+    uint32_t seed = 1;
+};
+
+// Time spent in each stage of the last segment_planes() call
+struct plane_stats
+{
+    double sample_ms;
+    double ransac_ms;
+    double refine_ms;    // least squares fit and labelling over the whole cloud
+    size_t hypotheses;   // scored, over all planes
+};
+
+/// Find up to `opt.max_planes` planes, largest first. Each is the best of a
+/// batch of RANSAC hypotheses scored in parallel on a sample of the cloud,
+/// then refitted by least squares to its inliers among all the points.
+/// `labels` gets one entry per point: 0 for points on no plane or without
+/// depth (z == 0), k for points on planes[k - 1]. Returns the number of
+/// planes found. The result only depends on the input and `opt.seed`, not
+/// on the number of threads.
+size_t segment_planes(const float3* points, size_t n, const plane_options& opt,
+                      std::vector<plane>& planes, std::vector<uint8_t>& labels,
+                      plane_stats* stats = nullptr);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_PLANES_H */
@@ -0,0 +1,91 @@
+/**
+ * ply.cpp
+ */
+
+#include "ply.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+ply_writer::ply_writer(const string& path, uint64_t points) :
+    path(path), expected(points)
+{
+    out = fopen(path.c_str(), "wb");
+    if (!out)
+        throw runtime_error("cannot create " + path);
+
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+                       "ply\nformat binary_little_endian 1.0\nelement vertex %llu\n"
+                       "property float x\nproperty float y\nproperty float z\n"
+                       "property uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n",
+                       (unsigned long long)points);
+    if (fwrite(header, 1, size_t(len), out) != size_t(len))
+        fail("cannot write ");
+}
+
+ply_writer::~ply_writer()
+{
+    if (!out)
+        return;
+    try
+    {
+        finish();
+    }
+    catch (const runtime_error&)
+    {
+        // the file stays short of the count in its header, readers reject it
+    }
+}
+
+void ply_writer::fail(const char* what)
+{
+    fclose(out);
+    out = nullptr;
+    throw runtime_error(what + path);
+}
+
+void ply_writer::append(const float3* positions, const uint32_t* colors, size_t n)
+{
+    if (!out)
+        throw runtime_error("cannot write " + path + ", already closed");
+
+    // 15 bytes per vertex, packed in chunks to keep the writes large
+    const size_t chunk = 65536;
+    buffer.resize(chunk * 15);
+    for (size_t b = 0; b < n; b += chunk)
+    {
+        size_t count = n - b < chunk ? n - b : chunk;
+        uint8_t* dst = buffer.data();
+        for (size_t i = b; i < b + count; i++, dst += 15)
+        {
+            memcpy(dst, &positions[i], 12);
+            uint32_t c = colors ? colors[i] : 0xffccccccu;
+            memcpy(dst + 12, &c, 3);
+        }
+        if (fwrite(buffer.data(), 15, count, out) != count)
+            fail("cannot write ");
+    }
+    total += n;
+}
+
+void ply_writer::finish()
+{
+    if (!out)
+        return;
+    if (total != expected)
+        fail("point count differs from the header of ");
+    bool ok = fclose(out) == 0;
+    out = nullptr;
+    if (!ok)
+        throw runtime_error("cannot write " + path);
+}
+
+void write_ply(const string& path, const float3* positions, const uint32_t* colors, size_t n)
+{
+    ply_writer writer(path, n);
+    writer.append(positions, colors, n);
+    writer.finish();
+}
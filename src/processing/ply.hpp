@@ -0,0 +1,53 @@
+/**
+ * ply.hpp
+ * Binary PLY output of colored point clouds.
+ */
+
+#ifndef RSSCANNER_PROCESSING_PLY_H
+#define RSSCANNER_PROCESSING_PLY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+/// \class ply_writer
+/// Streams points out to a binary little endian PLY file with float x, y, z
+/// and uchar red, green, blue. The header holds the point count, which has
+/// to be known up front.
+class ply_writer
+{
+    public:
+        // Writes the header for `points` points. Throws std::runtime_error on
+        // I/O errors, here and in every call below.
+        ply_writer(const std::string& path, uint64_t points);
+        ~ply_writer();
+
+        // Append `n` points; `colors` (RGBA8, bytes in r, g, b, a order) may
+        // be null, for light gray
+        void append(const float3* positions, const uint32_t* colors, size_t n);
+
+        // Close the file, which must hold the points the header announced.
+        // Called by the destructor if needed, where errors can't be reported.
+        void finish();
+
+    private:
+        ply_writer(const ply_writer&);
+        ply_writer& operator=(const ply_writer&);
+
+        std::string path;
+        FILE* out = nullptr;
+        uint64_t expected;
+        uint64_t total = 0;
+        std::vector<uint8_t> buffer;   // packed vertices, kept for its storage
+
+        void fail(const char* what);
+};
+
+// Write `n` points in one go, see ply_writer
+void write_ply(const std::string& path, const float3* positions, const uint32_t* colors, size_t n);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_PLY_H */
@@ -0,0 +1,93 @@
+/**
+ * quality.cpp
+ */
+
+#include "quality.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+namespace
+{
+    const size_t max_log = 8;
+    const double smoothing = 0.1;  // weight of the newest frame in the moving average
+}
+
+quality_controller::quality_controller()
+{
+    // best first; every step cuts roughly half of the cost of the previous one
+    levels.push_back(quality_level{ 1, 0, 1.f, 0 });
+    levels.push_back(quality_level{ 1, 300000, 1.f, 0 });
+    levels.push_back(quality_level{ 2, 150000, 2.f, 0 });
+    levels.push_back(quality_level{ 2, 100000, 2.f, 1 });
+    levels.push_back(quality_level{ 4, 50000, 3.f, 1 });
+    levels.push_back(quality_level{ 4, 25000, 4.f, 2 });
+}
+
+void quality_controller::set_level(int level, const char* reason)
+{
+    level = max(0, min(level, level_count() - 1));
+    char line[128];
+    snprintf(line, sizeof(line), "#%llu: level %d -> %d (%s)", frame, current, level, reason);
+    log.push_back(line);
+    if (log.size() > max_log)
+        log.erase(log.begin());
+
+    current = level;
+    over = under = 0;
+    cooldown = cooldown_frames;
+}
+
+void quality_controller::skip_profile(int profile)
+{
+    if (find(skipped.begin(), skipped.end(), profile) == skipped.end())
+        skipped.push_back(profile);
+}
+
+bool quality_controller::available(int level) const
+{
+    return level >= 0 && level < level_count() &&
+           find(skipped.begin(), skipped.end(), levels[level].stream_profile) == skipped.end();
+}
+
+bool quality_controller::update(const frame_timing& timing)
+{
+    frame++;
+    double cost = timing.process_ms + timing.draw_ms;
+    smoothed = frame == 1 ? cost : smoothed + (cost - smoothed) * smoothing;
+
+    if (!enabled)
+        return false;
+    if (cooldown > 0)
+    {
+        cooldown--;
+        return false;
+    }
+
+    over = smoothed > target_ms ? over + 1 : 0;
+    under = smoothed < target_ms * improve_ratio ? under + 1 : 0;
+
+    // the nearest levels that can be applied, either way
+    int worse = current + 1, better = current - 1;
+    while (worse < level_count() && !available(worse))
+        worse++;
+    while (better >= 0 && !available(better))
+        better--;
+
+    char reason[64];
+    if (over >= degrade_frames && worse < level_count())
+    {
+        snprintf(reason, sizeof(reason), "%.1f ms over %.1f ms target", smoothed, target_ms);
+        set_level(worse, reason);
+        return true;
+    }
+    if (under >= improve_frames && better >= 0)
+    {
+        snprintf(reason, sizeof(reason), "%.1f ms, headroom under %.1f ms", smoothed, target_ms);
+        set_level(better, reason);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,82 @@
+/**
+ * quality.hpp
+ * Closed-loop controller trading point cloud quality for frame time.
+ */
+
+#ifndef RSSCANNER_PROCESSING_QUALITY_H
+#define RSSCANNER_PROCESSING_QUALITY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Time spent in each stage of one frame
+struct frame_timing
+{
+    double capture_ms;   // waiting for the camera
+    double process_ms;   // filtering, deprojection and texture upload
+    double draw_ms;      // submitting the cloud to GL
+};
+
+// One rung of the quality ladder
+struct quality_level
+{
+    int decimation;       // depth decimation factor, 1 = full resolution
+    size_t point_budget;  // max points drawn, 0 = all
+    float point_size;     // in pixels at a 640 wide view
+    int stream_profile;   // index into the camera profiles, 0 = highest
+};
+
+/// \class quality_controller
+/// Tracks a smoothed frame cost (processing + draw; the time blocked on the
+/// camera is not load and is left out) and walks a ladder of quality levels
+/// to hold it under `target_ms`. Hysteresis: it steps down only after the
+/// cost stays above the target for `degrade_frames` frames, steps up only
+/// after it stays well below for `improve_frames`, and waits `cooldown_frames`
+/// after any change so the effect of a step is measured before the next.
+/// Levels on a stream profile the camera turned out not to support are
+/// stepped over.
+class quality_controller
+{
+    public:
+        quality_controller();
+
+        bool enabled = true;
+        float target_ms = 20.f;
+        float improve_ratio = 0.6f;   // step up when cost < target * ratio
+        int degrade_frames = 10;
+        int improve_frames = 90;
+        int cooldown_frames = 30;
+
+        // Feed the timing of the last frame, returns true if the level changed
+        bool update(const frame_timing& timing);
+
+        int level() const { return current; }
+        int level_count() const { return int(levels.size()); }
+        const quality_level& settings() const { return levels[current]; }
+        double smoothed_ms() const { return smoothed; }
+
+        // most recent decisions, oldest first
+        const std::vector<std::string>& decisions() const { return log; }
+
+        // Pin a level (also used when a change could not be applied)
+        void set_level(int level, const char* reason);
+
+        // Skip the levels on stream profile `profile` from now on; the
+        // current level is left as it is
+        void skip_profile(int profile);
+        bool available(int level) const;
+
+    private:
+        std::vector<quality_level> levels;
+        std::vector<std::string> log;
+        std::vector<int> skipped;   // stream profiles
+        int current = 0;
+        double smoothed = 0.0;
+        int over = 0;       // consecutive frames above target
+        int under = 0;      // consecutive frames well below target
+        int cooldown = 0;
+        unsigned long long frame = 0;
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_QUALITY_H */
@@ -0,0 +1,364 @@
+/**
+ * scheduler.cpp
+ */
+
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace
+{
+    // The scheduler and worker index of this thread, -1 outside the workers
+    thread_local task_scheduler* current_scheduler = nullptr;
+    thread_local int current_worker = -1;
+
+    // Tasks running on this thread: a worker waiting inside a task runs
+    // others, whose time is already counted as busy
+    thread_local int running = 0;
+}
+
+task_scheduler::task_scheduler(unsigned workers) : queued(0), steals(0)
+{
+    last_stats = chrono::steady_clock::now();
+    for (unsigned i = 0; i < max(workers, 1u); i++)
+        pool.emplace_back(new worker());
+    for (size_t i = 0; i < pool.size(); i++)
+        pool[i]->thread = thread(&task_scheduler::work, this, int(i));
+}
+
+task_scheduler::~task_scheduler()
+{
+    {
+        lock_guard<mutex> guard(sleep_lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& w : pool)
+        w->thread.join();
+}
+
+task_scheduler& task_scheduler::shared()
+{
+    static task_scheduler scheduler(max(hardware_threads(), 2u) - 1);
+    return scheduler;
+}
+
+void task_scheduler::task_queue::push_back(task& t)
+{
+    size_t size = ring.size(), count = (tail - head) & (size - 1);
+    if (size == 0 || count + 1 == size)
+    {
+        // twice as long, the tasks from the start of it
+        vector<task> grown(max<size_t>(size * 2, 16));
+        for (size_t i = 0; i < count; i++)
+            grown[i] = std::move(ring[(head + i) & (size - 1)]);
+        ring.swap(grown);
+        head = 0;
+        tail = count;
+        size = ring.size();
+    }
+    ring[tail] = std::move(t);
+    tail = (tail + 1) & (size - 1);
+}
+
+void task_scheduler::task_queue::pop_back(task& t)
+{
+    tail = (tail - 1) & (ring.size() - 1);
+    t = std::move(ring[tail]);
+}
+
+void task_scheduler::task_queue::pop_front(task& t)
+{
+    t = std::move(ring[head]);
+    head = (head + 1) & (ring.size() - 1);
+}
+
+void task_scheduler::spawn(function<void()> fn, task_counter& counter, task_priority priority)
+{
+    counter.pending.fetch_add(1, memory_order_relaxed);
+    task t = { std::move(fn), &counter, nullptr, 0, 0, 0 };
+    push(t, priority);
+}
+
+void task_scheduler::push(task& t, task_priority priority)
+{
+    if (current_scheduler == this && priority == task_normal)
+    {
+        worker& w = *pool[current_worker];
+        lock_guard<mutex> guard(w.lock);
+        w.tasks.push_back(t);
+    }
+    else
+    {
+        lock_guard<mutex> guard(lanes_lock);
+        lanes[priority].push_back(t);
+    }
+    queued.fetch_add(1);
+    {
+        // a worker going to sleep either sees the task or gets the signal
+        lock_guard<mutex> guard(sleep_lock);
+    }
+    wake.notify_one();
+}
+
+bool task_scheduler::take(int self, bool background, task& t)
+{
+    if (queued.load() == 0)
+        return false;
+
+    // the newest task of our own deque, its data is still in cache
+    if (self >= 0)
+    {
+        worker& w = *pool[self];
+        lock_guard<mutex> guard(w.lock);
+        if (!w.tasks.empty())
+        {
+            w.tasks.pop_back(t);
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    {
+        lock_guard<mutex> guard(lanes_lock);
+        for (int lane = task_high; lane <= task_normal; lane++)
+            if (!lanes[lane].empty())
+            {
+                lanes[lane].pop_front(t);
+                queued.fetch_sub(1);
+                return true;
+            }
+    }
+    // the oldest task of another deque, the largest piece of its split
+    size_t n = pool.size();
+    for (size_t k = 1; k <= n; k++)
+    {
+        size_t victim = (size_t(self + 1) + k) % n;
+        if (int(victim) == self)
+            continue;
+        worker& w = *pool[victim];
+        lock_guard<mutex> guard(w.lock);
+        if (!w.tasks.empty())
+        {
+            w.tasks.pop_front(t);
+            queued.fetch_sub(1);
+            steals.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    if (background)
+    {
+        lock_guard<mutex> guard(lanes_lock);
+        if (!lanes[task_low].empty())
+        {
+            lanes[task_low].pop_front(t);
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void task_scheduler::run(int self, task& t)
+{
+    chrono::steady_clock::time_point start;
+    bool timed = self >= 0 && running == 0;
+    if (timed)
+        start = chrono::steady_clock::now();
+    running++;
+    try
+    {
+        if (t.range)
+            split(t.b, t.e, t.piece, *t.range, *t.counter);
+        else
+            t.fn();
+    }
+    catch (...)
+    {
+        lock_guard<mutex> guard(t.counter->lock);
+        if (!t.counter->error)
+            t.counter->error = current_exception();
+    }
+    running--;
+    // what the task holds goes before its waiter may return
+    t.fn = nullptr;
+    if (timed)
+    {
+        worker& w = *pool[self];
+        w.busy_ns += uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        w.ran++;
+    }
+    t.counter->pending.fetch_sub(1, memory_order_release);
+}
+
+void task_scheduler::work(int self)
+{
+    current_scheduler = this;
+    current_worker = self;
+    for (;;)
+    {
+        task t;
+        if (take(self, true, t))
+        {
+            run(self, t);
+            continue;
+        }
+        unique_lock<mutex> guard(sleep_lock);
+        wake.wait(guard, [&]() { return stop || queued.load() > 0; });
+        if (stop)
+            return;
+    }
+}
+
+void task_scheduler::wait(task_counter& counter)
+{
+    // workers may block on background tasks, other threads only help with
+    // the urgent ones
+    int self = current_scheduler == this ? current_worker : -1;
+    while (!counter.done())
+    {
+        task t;
+        if (take(self, self >= 0, t))
+            run(self, t);
+        else
+            this_thread::yield();
+    }
+    lock_guard<mutex> guard(counter.lock);
+    if (counter.error)
+    {
+        exception_ptr error = counter.error;
+        counter.error = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+void task_scheduler::split(size_t b, size_t e, size_t piece, const function<void(size_t, size_t)>& fn,
+                           task_counter& counter)
+{
+    // the upper halves go to the deque, where thieves take the largest first;
+    // they are plain tasks, not closures, which would not fit in a function
+    // without allocating
+    while (e - b >= 2 * piece)
+    {
+        size_t m = b + (e - b) / 2;
+        counter.pending.fetch_add(1, memory_order_relaxed);
+        task t = { nullptr, &counter, &fn, m, e, piece };
+        push(t, task_normal);
+        e = m;
+    }
+    fn(b, e);
+}
+
+void task_scheduler::parallel_for(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& fn)
+{
+    if (end <= begin)
+        return;
+    // about four pieces per thread, so that the threads done first take
+    // over the rest of the others
+    size_t count = end - begin;
+    size_t piece = max(max<size_t>(grain, 1), count / (4 * (pool.size() + 1)));
+    if (count < 2 * piece)
+    {
+        fn(begin, end);
+        return;
+    }
+    task_counter counter;
+    exception_ptr error;
+    try
+    {
+        split(begin, end, piece, fn, counter);
+    }
+    catch (...)
+    {
+        error = current_exception();
+    }
+    wait(counter);
+    if (error)
+        rethrow_exception(error);
+}
+
+scheduler_stats task_scheduler::stats()
+{
+    scheduler_stats s;
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double wall_ns = double(chrono::duration_cast<chrono::nanoseconds>(now - last_stats).count());
+    last_stats = now;
+    s.workers = workers();
+    s.steals = steals.load(memory_order_relaxed);
+    for (auto& w : pool)
+    {
+        uint64_t busy = w->busy_ns.load();
+        s.utilization.push_back(wall_ns > 0.0 ? min(1.0, double(busy - w->last_busy_ns) / wall_ns) : 0.0);
+        w->last_busy_ns = busy;
+        s.tasks += w->ran.load();
+    }
+    return s;
+}
+
+task_graph::~task_graph()
+{
+    try
+    {
+        scheduler.wait(counter);
+    }
+    catch (...)
+    {
+    }
+}
+
+size_t task_graph::add(function<void()> fn, task_priority priority)
+{
+    if (used == nodes.size())
+        nodes.emplace_back(new node());
+    node& n = *nodes[used];
+    n.fn = std::move(fn);
+    n.priority = priority;
+    n.next.clear();
+    n.before = 0;
+    return used++;
+}
+
+void task_graph::clear()
+{
+    wait();
+    // what the tasks hold goes now, not when they are overwritten
+    for (size_t i = 0; i < used; i++)
+        nodes[i]->fn = nullptr;
+    used = 0;
+}
+
+void task_graph::precede(size_t before, size_t after)
+{
+    nodes[before]->next.push_back(after);
+    nodes[after]->before++;
+}
+
+void task_graph::launch(size_t i)
+{
+    node* n = nodes[i].get();
+    scheduler.spawn([this, n]()
+    {
+        n->fn();
+        // spawned before this task is counted done, the graph stays busy
+        for (size_t k : n->next)
+            if (nodes[k]->waiting.fetch_sub(1) == 1)
+                launch(k);
+    }, counter, n->priority);
+}
+
+void task_graph::start()
+{
+    for (size_t i = 0; i < used; i++)
+        nodes[i]->waiting = nodes[i]->before;
+    for (size_t i = 0; i < used; i++)
+        if (!nodes[i]->before)
+            launch(i);
+}
+
+void task_graph::wait()
+{
+    scheduler.wait(counter);
+}
@@ -0,0 +1,196 @@
+/**
+ * scheduler.hpp
+ * Work-stealing task scheduler shared by the processing stages.
+ */
+
+#ifndef RSSCANNER_PROCESSING_SCHEDULER_H
+#define RSSCANNER_PROCESSING_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lanes of the tasks handed to the scheduler from outside its workers
+enum task_priority
+{
+    task_high = 0,     // the frame the UI thread is waiting for
+    task_normal,
+    task_low,          // background work, run only when nothing else is queued
+    task_priority_count
+};
+
+/// \class task_counter
+/// Tasks of one fork/join not finished yet, and the first exception one of
+/// them threw, rethrown by task_scheduler::wait().
+class task_counter
+{
+public:
+    task_counter() : pending(0) {}
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class task_scheduler;
+    task_counter(const task_counter&);
+    task_counter& operator=(const task_counter&);
+
+    std::atomic<size_t> pending;
+    std::mutex lock;
+    std::exception_ptr error;
+};
+
+struct scheduler_stats
+{
+    unsigned workers = 0;
+    uint64_t tasks = 0;                // run by the workers, since the start
+    uint64_t steals = 0;               // taken from another worker's deque
+    std::vector<double> utilization;   // per worker, busy share since the previous stats()
+};
+
+/// \class task_scheduler
+/// A fixed set of worker threads, each with its own deque: tasks a worker
+/// spawns go to the back of its deque and it takes them back from there,
+/// while idle workers steal from the front of the others' deques, where the
+/// largest pieces of a recursive split wait. Tasks spawned from other
+/// threads go to one of three shared lanes by priority. A worker looks at
+/// its own deque, then the high and normal lanes, then steals, and only
+/// then takes low priority tasks. A thread waiting for tasks runs queued
+/// ones instead of blocking, except low priority ones: the UI thread never
+/// picks up background work.
+///
+/// The shared scheduler has one worker less than the hardware has threads
+/// (at least one), the thread waiting on a fork/join being the last one.
+class task_scheduler
+{
+public:
+    explicit task_scheduler(unsigned workers);
+    ~task_scheduler();
+
+    // The scheduler of the processing stages
+    static task_scheduler& shared();
+
+    // Queue fn(), counted in `counter` until it returns
+    void spawn(std::function<void()> fn, task_counter& counter, task_priority priority = task_normal);
+
+    // Run queued tasks until those of `counter` are done, then rethrow the
+    // first exception they threw
+    void wait(task_counter& counter);
+
+    // fn(b, e) over [begin, end), split in halves down to pieces of at least
+    // `grain` indices and of a few per thread; the calling thread takes part
+    void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    unsigned workers() const { return unsigned(pool.size()); }
+
+    // Not thread safe: the utilization is measured between two calls
+    scheduler_stats stats();
+
+private:
+    task_scheduler(const task_scheduler&);
+    task_scheduler& operator=(const task_scheduler&);
+
+    // fn(), or a piece of a parallel_for: split() of [b, e) over `range`
+    struct task
+    {
+        std::function<void()> fn;
+        task_counter* counter;
+        const std::function<void(size_t, size_t)>* range;
+        size_t b, e, piece;
+    };
+
+    // Double ended queue in a ring that only grows: once it has held the
+    // most tasks a frame queues, pushing and taking tasks never allocate
+    class task_queue
+    {
+    public:
+        bool empty() const { return head == tail; }
+        void push_back(task& t);
+        void pop_back(task& t);
+        void pop_front(task& t);
+
+    private:
+        std::vector<task> ring;   // a power of two long
+        size_t head = 0, tail = 0;   // of the tasks in it, kept modulo the length
+    };
+
+    struct worker
+    {
+        std::mutex lock;
+        task_queue tasks;
+        std::thread thread;
+        std::atomic<uint64_t> busy_ns{ 0 }, ran{ 0 };
+        uint64_t last_busy_ns = 0;
+    };
+
+    std::vector<std::unique_ptr<worker>> pool;
+    std::mutex lanes_lock;
+    task_queue lanes[task_priority_count];
+    std::atomic<size_t> queued;   // in the lanes and the deques
+    std::atomic<uint64_t> steals;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    bool stop = false;
+    std::chrono::steady_clock::time_point last_stats;
+
+    void push(task& t, task_priority priority);
+    bool take(int self, bool background, task& t);
+    void run(int self, task& t);
+    void work(int self);
+    void split(size_t b, size_t e, size_t piece, const std::function<void(size_t, size_t)>& fn,
+               task_counter& counter);
+};
+
+/// \class task_graph
+/// Tasks with dependencies, such as the stages of one frame: a task is
+/// spawned when all those before it are done. A task that throws stops the
+/// tasks after it, and wait() rethrows. A graph cleared and refilled, every
+/// frame, reuses the storage of its tasks.
+class task_graph
+{
+public:
+    explicit task_graph(task_scheduler& scheduler = task_scheduler::shared()) : scheduler(scheduler) {}
+    // Waits for the tasks started, ignoring their exceptions
+    ~task_graph();
+
+    // Index of the new task
+    size_t add(std::function<void()> fn, task_priority priority = task_normal);
+    // `after` starts once `before` is done
+    void precede(size_t before, size_t after);
+
+    // Spawn the tasks depending on none, then wait for all
+    void start();
+    void wait();
+    void run() { start(); wait(); }
+
+    // Drop the tasks, once they are done, keeping their storage
+    void clear();
+
+private:
+    task_graph(const task_graph&);
+    task_graph& operator=(const task_graph&);
+
+    struct node
+    {
+        std::function<void()> fn;
+        task_priority priority;
+        std::vector<size_t> next;
+        size_t before = 0;
+        std::atomic<size_t> waiting{ 0 };
+    };
+
+    task_scheduler& scheduler;
+    std::vector<std::unique_ptr<node>> nodes;   // the first `used` ones are tasks
+    size_t used = 0;
+    task_counter counter;
+
+    void launch(size_t i);
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_SCHEDULER_H */
@@ -0,0 +1,108 @@
+/**
+ * simd.cpp
+ */
+
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RS_SIMD_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+using namespace std;
+
+namespace
+{
+    const char* const names[simd_level_count] = { "scalar", "SSE2", "SSE4.2", "AVX2", "AVX-512" };
+    const char* const env_names[simd_level_count] = { "scalar", "sse2", "sse4.2", "avx2", "avx512" };
+
+    // RSSCANNER_SIMD, or no cap
+    simd_level env_level()
+    {
+        const char* value = getenv("RSSCANNER_SIMD");
+        if (value)
+            for (int level = 0; level < simd_level_count; level++)
+                if (strcmp(value, env_names[level]) == 0)
+                    return simd_level(level);
+        return simd_avx512;
+    }
+
+    const simd_level env_cap = env_level();
+    simd_level forced = env_cap;
+
+    simd_level probe()
+    {
+#if defined(RS_SIMD_X86) && defined(__GNUC__)
+        // __builtin_cpu_supports also checks that the OS saves the wide registers
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt"))
+            return simd_avx512;
+        if (__builtin_cpu_supports("avx2"))
+            return simd_avx2;
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3"))
+            return simd_sse42;
+        if (__builtin_cpu_supports("sse2"))
+            return simd_sse2;
+#elif defined(RS_SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int max_leaf = info[0];
+        __cpuid(info, 1);
+        bool sse2 = (info[3] & (1 << 26)) != 0;
+        bool ssse3 = (info[2] & (1 << 9)) != 0;
+        bool sse42 = (info[2] & (1 << 20)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        bool popcnt = (info[2] & (1 << 23)) != 0;
+        if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(info, 7, 0);
+            const unsigned avx512 = (1u << 8) | (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);   // BMI2, F, DQ, BW, VL
+            if ((unsigned(info[1]) & avx512) == avx512 && popcnt && (_xgetbv(0) & 0xe6) == 0xe6)
+                return simd_avx512;
+            if (info[1] & (1 << 5))
+                return simd_avx2;
+        }
+        if (sse42 && ssse3)
+            return simd_sse42;
+        if (sse2)
+            return simd_sse2;
+#endif
+        return simd_scalar;
+    }
+}
+
+simd_level simd_detect()
+{
+    static const simd_level detected = probe();
+    return detected;
+}
+
+simd_level simd_active()
+{
+    return min(simd_detect(), forced);
+}
+
+const char* simd_name(simd_level level)
+{
+    return level >= 0 && level < simd_level_count ? names[level] : "scalar";
+}
+
+bool simd_overridden()
+{
+    return env_cap < simd_detect();
+}
+
+void simd_force(simd_level level)
+{
+    forced = min(level, env_cap);
+}
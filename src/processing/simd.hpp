@@ -0,0 +1,39 @@
+/**
+ * simd.hpp
+ * Instruction set levels, detected once at run time.
+ *
+ * Binaries are built for the baseline of the architecture; code for the
+ * wider instruction sets is compiled separately (see kernels.hpp and the
+ * converters) and only called when the CPU supports it. The environment
+ * variable RSSCANNER_SIMD (scalar, sse2, sse4.2, avx2, avx512) caps the
+ * level, to test the narrower paths on a recent machine.
+ */
+
+#ifndef RSSCANNER_PROCESSING_SIMD_H
+#define RSSCANNER_PROCESSING_SIMD_H
+
+// Ordered: each level implies the ones below it
+enum simd_level
+{
+    simd_scalar = 0,
+    simd_sse2,
+    simd_sse42,     // with SSSE3
+    simd_avx2,
+    simd_avx512,    // F, BW, DQ and VL, with BMI2 and POPCNT
+    simd_level_count
+};
+
+// Best level supported by this CPU and OS, probed on the first call
+simd_level simd_detect();
+
+// Level in use: the detected one, capped by RSSCANNER_SIMD or simd_force()
+simd_level simd_active();
+const char* simd_name(simd_level level);
+
+// Whether RSSCANNER_SIMD capped the level
+bool simd_overridden();
+
+// Use at most `level` (clamped to what the CPU supports), for tests and benchmarks
+void simd_force(simd_level level);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_SIMD_H */
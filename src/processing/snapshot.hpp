@@ -0,0 +1,95 @@
+/**
+ * snapshot.hpp
+ * Lock-free hand over of immutable versions from one thread to another.
+ */
+
+#ifndef RSSCANNER_PROCESSING_SNAPSHOT_H
+#define RSSCANNER_PROCESSING_SNAPSHOT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// Time each side spent in the buffer, updated by that side only
+struct snapshot_stats
+{
+    std::atomic<uint64_t> published{ 0 };      // versions handed over by the writer
+    std::atomic<uint64_t> taken{ 0 };          // versions picked up by the reader
+    std::atomic<uint64_t> reads{ 0 };          // calls to latest()
+    std::atomic<uint64_t> publish_ns{ 0 };     // writer total, includes freeing old versions
+    std::atomic<uint64_t> publish_max_ns{ 0 };
+    std::atomic<uint64_t> latest_ns{ 0 };      // reader total
+    std::atomic<uint64_t> latest_max_ns{ 0 };
+};
+
+/// \class snapshot
+/// Triple buffer of reference counted, immutable versions of a T, between
+/// one writer thread and one reader thread. Both sides only do an atomic
+/// exchange of a slot index: neither ever waits for the other, and the
+/// reader always gets the most recent complete version. Versions the reader
+/// never picked up, and the ones it moved past, are released by the writer
+/// when it reuses their slot, so freeing memory never lands on the reader;
+/// a version the reader still holds a copy of lives on through its count.
+template <class T>
+class snapshot
+{
+    public:
+        snapshot() : state(1), back(2), front(0) {}
+
+        // Writer: make `version` the latest one
+        void publish(std::shared_ptr<const T> version)
+        {
+            auto start = std::chrono::steady_clock::now();
+            slots[back] = std::move(version);
+            back = state.exchange(uint8_t(back | fresh), std::memory_order_acq_rel) & index;
+            account(stats.publish_ns, stats.publish_max_ns, start);
+            stats.published.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Reader: the latest published version, null before the first one.
+        // The reference stays valid until the next call.
+        const std::shared_ptr<const T>& latest()
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (state.load(std::memory_order_relaxed) & fresh)
+            {
+                front = state.exchange(front, std::memory_order_acq_rel) & index;
+                stats.taken.fetch_add(1, std::memory_order_relaxed);
+            }
+            account(stats.latest_ns, stats.latest_max_ns, start);
+            stats.reads.fetch_add(1, std::memory_order_relaxed);
+            return slots[front];
+        }
+
+        // Reader: whether latest() would return a newer version
+        bool has_new() const { return (state.load(std::memory_order_acquire) & fresh) != 0; }
+
+        const snapshot_stats& get_stats() const { return stats; }
+
+    private:
+        snapshot(const snapshot&);
+        snapshot& operator=(const snapshot&);
+
+        static const uint8_t index = 3;
+        static const uint8_t fresh = 4;
+
+        static void account(std::atomic<uint64_t>& total, std::atomic<uint64_t>& worst,
+                            std::chrono::steady_clock::time_point start)
+        {
+            uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            total.fetch_add(ns, std::memory_order_relaxed);
+            if (ns > worst.load(std::memory_order_relaxed))
+                worst.store(ns, std::memory_order_relaxed);
+        }
+
+        std::shared_ptr<const T> slots[3];
+        // middle slot index, and whether it holds a version the reader has not taken
+        alignas(64) std::atomic<uint8_t> state;
+        alignas(64) uint8_t back;    // writer only
+        alignas(64) uint8_t front;   // reader only
+        snapshot_stats stats;
+};
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_SNAPSHOT_H */
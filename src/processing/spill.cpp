@@ -0,0 +1,210 @@
+/**
+ * spill.cpp
+ */
+
+#include "spill.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    int seek(FILE* f, uint64_t offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(f, int64_t(offset), SEEK_SET);
+#else
+        return fseeko(f, off_t(offset), SEEK_SET);
+#endif
+    }
+
+    // 7 bits per byte, the high bit set on all but the last
+    inline void put_varint(uint32_t v, vector<uint8_t>& out)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(uint8_t(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(uint8_t(v));
+    }
+
+    inline uint32_t get_varint(const uint8_t*& p, const uint8_t* end)
+    {
+        uint32_t v = 0;
+        for (int shift = 0; p < end && shift < 32; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= uint32_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        throw runtime_error("corrupt spilled voxels");
+    }
+
+    // Bytes 1 to 4 needed by `v`, minus one: the 2 bit code of a value
+    inline unsigned code_of(uint32_t v)
+    {
+        return v >> 8 == 0 ? 0 : v >> 16 == 0 ? 1 : v >> 24 == 0 ? 2 : 3;
+    }
+
+    // zigzag: small differences of either sign become small values
+    inline uint32_t zigzag(uint32_t d) { return (d << 1) ^ uint32_t(-int32_t(d >> 31)); }
+    inline uint32_t unzigzag(uint32_t z) { return (z >> 1) ^ uint32_t(-int32_t(z & 1)); }
+
+    inline uint32_t bits_of(float f)
+    {
+        uint32_t b;
+        memcpy(&b, &f, 4);
+        return b;
+    }
+
+    inline float float_of(uint32_t b)
+    {
+        float f;
+        memcpy(&f, &b, 4);
+        return f;
+    }
+}
+
+spill_file::spill_file(const string& path) : path(path)
+{
+    file = path.empty() ? tmpfile() : fopen(path.c_str(), "w+b");
+    if (!file)
+        throw runtime_error("cannot create the scratch file " + (path.empty() ? string("(temporary)") : path));
+}
+
+spill_file::~spill_file()
+{
+    fclose(file);
+    if (!path.empty())
+        remove(path.c_str());
+}
+
+uint64_t spill_file::append(const vector<uint8_t>& record, size_t reserve)
+{
+    lock_guard<mutex> guard(lock);
+    uint64_t offset = end;
+    if (seek(file, offset) != 0 || fwrite(record.data(), 1, record.size(), file) != record.size())
+        throw runtime_error("cannot write the scratch file, is the disk full?");
+    // the room left is written by the next append, or a rewrite
+    end += max(record.size(), reserve);
+    return offset;
+}
+
+void spill_file::rewrite(uint64_t offset, const vector<uint8_t>& record)
+{
+    lock_guard<mutex> guard(lock);
+    if (offset + record.size() > end || seek(file, offset) != 0 ||
+        fwrite(record.data(), 1, record.size(), file) != record.size())
+        throw runtime_error("cannot write the scratch file, is the disk full?");
+}
+
+void spill_file::read(uint64_t offset, size_t bytes, vector<uint8_t>& record)
+{
+    lock_guard<mutex> guard(lock);
+    record.resize(bytes);
+    // reads after writes need a positioning call in between, which seek() is
+    if (offset + bytes > end || seek(file, offset) != 0 || fread(record.data(), 1, bytes, file) != bytes)
+        throw runtime_error("cannot read back the scratch file");
+}
+
+void encode_voxels(const uint64_t* bits, size_t words, vector<uint8_t>& out)
+{
+    out.clear();
+    out.push_back(0);   // gaps
+    uint32_t last = 0;
+    for (size_t w = 0; w < words; w++)
+        for (int i = 0; i < 64; i++)
+            if (bits[w] >> i & 1)
+            {
+                uint32_t bit = uint32_t(w * 64 + i);
+                put_varint(bit - last, out);
+                last = bit;
+            }
+    if (out.size() > words * 8)
+    {
+        out.assign(1, 1);   // as it is
+        out.insert(out.end(), reinterpret_cast<const uint8_t*>(bits),
+                   reinterpret_cast<const uint8_t*>(bits + words));
+    }
+}
+
+void decode_voxels(const uint8_t* data, size_t bytes, uint64_t* bits, size_t words)
+{
+    if (!bytes)
+        throw runtime_error("corrupt spilled voxels");
+    const uint8_t* end = data + bytes;
+    if (data[0] == 1)
+    {
+        if (bytes != 1 + words * 8)
+            throw runtime_error("corrupt spilled voxels");
+        memcpy(bits, data + 1, words * 8);
+        return;
+    }
+    memset(bits, 0, words * 8);
+    uint32_t bit = 0;
+    for (const uint8_t* p = data + 1; p < end;)
+    {
+        bit += get_varint(p, end);
+        if (bit >= words * 64)
+            throw runtime_error("corrupt spilled voxels");
+        bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+    }
+}
+
+void encode_points(const float3* positions, const uint32_t* colors, size_t n, vector<uint8_t>& out)
+{
+    out.clear();
+    out.reserve(n * 13);
+    uint32_t prev[4] = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < n; i++)
+    {
+        // coordinates by difference of their bits, colors (whose channels
+        // are separate bytes) by XOR
+        uint32_t v[4] = { bits_of(positions[i].x), bits_of(positions[i].y), bits_of(positions[i].z), colors[i] };
+        uint32_t e[4];
+        for (int k = 0; k < 3; k++)
+            e[k] = zigzag(v[k] - prev[k]);
+        e[3] = v[3] ^ prev[3];
+        uint8_t codes = 0;
+        for (int k = 0; k < 4; k++)
+            codes |= uint8_t(code_of(e[k]) << (2 * k));
+        out.push_back(codes);
+        for (int k = 0; k < 4; k++)
+            for (unsigned b = 0; b <= code_of(e[k]); b++)
+                out.push_back(uint8_t(e[k] >> (8 * b)));
+        memcpy(prev, v, sizeof(prev));
+    }
+}
+
+void decode_points(const uint8_t* data, size_t bytes, size_t n, float3* positions, uint32_t* colors)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + bytes;
+    uint32_t prev[4] = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < n; i++)
+    {
+        if (p >= end)
+            throw runtime_error("corrupt spilled points");
+        uint8_t codes = *p++;
+        uint32_t e[4];
+        for (int k = 0; k < 4; k++)
+        {
+            unsigned len = ((codes >> (2 * k)) & 3) + 1;
+            if (size_t(end - p) < len)
+                throw runtime_error("corrupt spilled points");
+            e[k] = 0;
+            for (unsigned b = 0; b < len; b++)
+                e[k] |= uint32_t(*p++) << (8 * b);
+        }
+        for (int k = 0; k < 3; k++)
+            prev[k] += unzigzag(e[k]);
+        prev[3] ^= e[3];
+        positions[i] = float3{ float_of(prev[0]), float_of(prev[1]), float_of(prev[2]) };
+        colors[i] = prev[3];
+    }
+}
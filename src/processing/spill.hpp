@@ -0,0 +1,64 @@
+/**
+ * spill.hpp
+ * Scratch file for data paged out of memory, and the codecs of what goes
+ * into it.
+ */
+
+#ifndef RSSCANNER_PROCESSING_SPILL_H
+#define RSSCANNER_PROCESSING_SPILL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+/// \class spill_file
+/// Scratch file: records are written at the end, possibly with room to be
+/// rewritten in place later, and read back by offset, from any thread. The
+/// file is removed when closed.
+/// Throws std::runtime_error on I/O errors.
+class spill_file
+{
+    public:
+        // A file at `path`, or an anonymous temporary file when empty
+        explicit spill_file(const std::string& path = std::string());
+        ~spill_file();
+
+        // Offset of the record, which takes up `reserve` bytes of the file
+        // if that is more than its size
+        uint64_t append(const std::vector<uint8_t>& record, size_t reserve = 0);
+        // Over a record appended with room for this one
+        void rewrite(uint64_t offset, const std::vector<uint8_t>& record);
+        void read(uint64_t offset, size_t bytes, std::vector<uint8_t>& record);
+
+        uint64_t size() const { return end; }
+
+    private:
+        spill_file(const spill_file&);
+        spill_file& operator=(const spill_file&);
+
+        std::mutex lock;
+        FILE* file = nullptr;
+        std::string path;
+        uint64_t end = 0;
+};
+
+// Set bits of a voxel occupancy bitmap of `words` 64 bit words, as the gaps
+// between them, one to three bytes each. Sparse bitmaps (surfaces) shrink
+// several times; dense ones are stored as they are.
+void encode_voxels(const uint64_t* bits, size_t words, std::vector<uint8_t>& out);
+void decode_voxels(const uint8_t* data, size_t bytes, uint64_t* bits, size_t words);
+
+// Points and colors, each 32 bit value stored in 1 to 4 bytes as its
+// difference (coordinates) or XOR (colors) with the same one of the previous
+// point: consecutive points of a depth frame are close, and so are the bits
+// of their values. Lossless.
+void encode_points(const float3* positions, const uint32_t* colors, size_t n, std::vector<uint8_t>& out);
+// `n` as given to encode_points()
+void decode_points(const uint8_t* data, size_t bytes, size_t n, float3* positions, uint32_t* colors);
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_SPILL_H */
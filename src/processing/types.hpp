@@ -0,0 +1,21 @@
+/**
+ * types.hpp
+ * Basic data types shared by the processing stages and the preview code.
+ */
+
+#ifndef RSSCANNER_PROCESSING_TYPES_H
+#define RSSCANNER_PROCESSING_TYPES_H
+
+//////////////////////////////
+// Basic Data Types         //
+//////////////////////////////
+
+struct float3 { float x, y, z; };
+struct float2 { float x, y; };
+
+inline float3 operator+(const float3& a, const float3& b) { return{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline float3 operator-(const float3& a, const float3& b) { return{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline float3 operator*(const float3& a, float s) { return{ a.x * s, a.y * s, a.z * s }; }
+inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+#endif /* end of include guard: RSSCANNER_PROCESSING_TYPES_H */
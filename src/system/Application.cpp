@@ -1,13 +1,21 @@
 /**
  * Application.hpp
  */
+#include <future>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "Application.hpp"
+#include "FontCache.hpp"
+#include "graphic/GLState.hpp"
+#include "utils/allocStats.hpp"
+#include "utils/glDebug.hpp"
+#include "utils/frameArena.hpp"
+#include "utils/stopwatch.hpp"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -22,6 +30,9 @@ static void glfw_error_callback(int error, const char* description)
 
 Application* currentApplication = NULL;
 
+// set while the statics are initialized, before main()
+static const double processStart = system_time_ms();
+
 Application& Application::getInstance()
 {
     if (currentApplication)
@@ -34,10 +45,22 @@ Application::Application():
     state(stateReady),
     width(800),
     height(600),
+    frameIndex(0),
+    fonts(nullptr),
     title("Application")
 {
     currentApplication=this;
 
+    // the font atlas needs neither the window nor the GL context: it is
+    // read from the cache or rasterized while they are created
+    stopwatch timer;
+    unique_ptr<ImFontAtlas> atlas(new ImFontAtlas());
+    ImFontAtlas* building = atlas.get();
+    future<FontCacheResult> fontsReady = async(launch::async, [building]()
+    {
+        return loadFontAtlas(*building, "assets/fonts/Roboto-Medium.ttf", 16.0f);
+    });
+
     cout<<"[Info] GLFW initialisation"<<endl;
 
     glfwSetErrorCallback(glfw_error_callback);
@@ -56,6 +79,9 @@ Application::Application():
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, gl_minor);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if RSSCANNER_GL_DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
     // create the window
     window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
@@ -74,10 +100,30 @@ Application::Application():
         fprintf(stderr, "Failed to initialize OpenGL loader!\n");
         return;
     }
+    gl_debug_init();
+    startup.windowMs = timer.lap_ms();
+
+    FontCacheResult font;
+    try
+    {
+        font = fontsReady.get();
+    }
+    catch (const std::exception& e)
+    {
+        // as AddFontFromFileTTF() failing: imgui falls back to its own font
+        fprintf(stderr, "Failed to load the font: %s\n", e.what());
+        atlas->Clear();
+    }
+    if (!font.error.empty())
+        fprintf(stderr, "Font cache unusable: %s\n", font.error.c_str());
+    startup.fontWaitMs = timer.elapsed_ms();
+    startup.fontMs = font.ms;
+    startup.fontCached = font.cached;
+    fonts = atlas.release();
 
     // Setup Dear ImGui binding
     IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
+    ImGui::CreateContext(fonts);
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;  // Enable Keyboard Controls
     // io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;   // Enable Gamepad Controls
@@ -91,21 +137,6 @@ Application::Application():
     // Setup style
     ImGui::StyleColorsDark();
     //ImGui::StyleColorsClassic();
-
-    // Load Fonts
-    // - If no fonts are loaded, dear imgui will use the default font. You can also load multiple fonts and use ImGui::PushFont()/PopFont() to select them.
-    // - AddFontFromFileTTF() will return the ImFont* so you can store it if you need to select the font among multiple.
-    // - If the file cannot be loaded, the function will return NULL. Please handle those errors in your application (e.g. use an assertion, or display an error and quit).
-    // - The fonts will be rasterized at a given size (w/ oversampling) and stored into a texture when calling ImFontAtlas::Build()/GetTexDataAsXXXX(), which ImGui_ImplXXXX_NewFrame below will call.
-    // - Read 'misc/fonts/README.txt' for more instructions and details.
-    // - Remember that in C/C++ if you want to include a backslash \ in a string literal you need to write a double backslash \\ !
-    // io.Fonts->AddFontDefault();
-    io.Fonts->AddFontFromFileTTF("assets/fonts/Roboto-Medium.ttf", 16.0f);
-    // io.Fonts->AddFontFromFileTTF("assets/fonts/Cousine-Regular.ttf", 15.0f);
-    // io.Fonts->AddFontFromFileTTF("assets/fonts/DroidSans.ttf", 16.0f);
-    // io.Fonts->AddFontFromFileTTF("assets/fonts/ProggyTiny.ttf", 10.0f);
-    // ImFont* font = io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\ArialUni.ttf", 18.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
-    // IM_ASSERT(font != NULL);
 }
 
 GLFWwindow* Application::getWindow() const
@@ -165,12 +196,36 @@ void Application::run()
 
         glfwMakeContextCurrent(window);
         glfwSwapBuffers(window);
+        if (frameIndex == 0)
+        {
+            startup.firstFrameMs = system_time_ms() - processStart;
+            printf("[Info] First frame %.0f ms after start, %s: window %.0f ms, fonts %.1f ms (%.1f ms waited)\n",
+                   startup.firstFrameMs, startup.fontCached ? "warm" : "cold", startup.windowMs,
+                   startup.fontMs, startup.fontWaitMs);
+        }
+
+        // mark the end of this frame's GPU work, and report frames already done
+        PendingFrame pending = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frameIndex, system_time_ms() };
+        pendingFrames.push_back(pending);
+        pollPendingFrames();
+        frameIndex++;
+
+        // per-frame scratch memory, allocation and GL call counters start over
+        frame_arena::frame().reset();
+        alloc_end_frame();
+        GLState::endFrame();
+        gl_end_frame();
     }
     
     // Cleanup
+    for (auto& p : pendingFrames)
+        glDeleteSync((GLsync)p.fence);
+    pendingFrames.clear();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
+    delete fonts;
+    fonts = nullptr;
 
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -189,11 +244,35 @@ void Application::detectWindowDimensionChange()
     }
 }
 
+void Application::pollPendingFrames()
+{
+    // fences signal in order, stop at the first one still pending
+    const size_t maxPending = 4;
+    size_t done = 0;
+    for (; done < pendingFrames.size(); done++)
+    {
+        PendingFrame& p = pendingFrames[done];
+        GLsync fence = (GLsync)p.fence;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        bool signaled = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+        if (!signaled && pendingFrames.size() - done <= maxPending)
+            break;
+        glDeleteSync(fence);
+        if (signaled)
+            frameCompleted(p.frame, p.swapTime, system_time_ms());
+    }
+    pendingFrames.erase(pendingFrames.begin(), pendingFrames.begin() + done);
+}
+
 void Application::loop()
 {
     cout<<"[INFO] : loop"<<endl;
 }
 
+void Application::frameCompleted(unsigned long long, double, double)
+{
+}
+
 int Application::getWidth()
 {
     return width;
@@ -213,3 +292,13 @@ bool Application::windowDimensionChange()
 {
     return dimensionChange;
 }
+
+unsigned long long Application::getFrameIndex() const
+{
+    return frameIndex;
+}
+
+const Application::StartupTimes& Application::getStartupTimes() const
+{
+    return startup;
+}
@@ -12,8 +12,10 @@
 #define GLM_ENABLE_EXPERIMENTAL
 
 #include <string>
+#include <vector>
 
 struct ImGuiIO;
+struct ImFontAtlas;
 struct GLFWwindow;
 
 /// \class Application
@@ -54,6 +56,21 @@ class Application
         float getWindowRatio();
         bool windowDimensionChange();
 
+        // index of the frame being built, incremented after every buffer swap
+        unsigned long long getFrameIndex() const;
+
+        // What the first frame waited for, in milliseconds. The font atlas is
+        // built on another thread while the window opens.
+        struct StartupTimes
+        {
+            double windowMs = 0;      // GLFW, the window and the GL loader
+            double fontMs = 0;        // font atlas, read from the cache or rasterized
+            double fontWaitMs = 0;    // of it, left once the window was up
+            double firstFrameMs = 0;  // from the process start to the first buffer swap
+            bool fontCached = false;  // warm start
+        };
+        const StartupTimes& getStartupTimes() const;
+
     private:
 
         enum State {
@@ -73,6 +90,20 @@ class Application
         bool dimensionChange;
         void detectWindowDimensionChange();
 
+        // fences inserted after each swap, polled without blocking
+        struct PendingFrame
+        {
+            void* fence;  // GLsync
+            unsigned long long frame;
+            double swapTime;
+        };
+        std::vector<PendingFrame> pendingFrames;
+        unsigned long long frameIndex;
+        void pollPendingFrames();
+
+        ImFontAtlas* fonts;  // given to the imgui context, deleted after it
+        StartupTimes startup;
+
     protected:
 
         Application(const Application&) {};
@@ -81,6 +112,10 @@ class Application
 
         virtual void loop();
 
+        // The GPU finished frame `frame`: swapTime is when glfwSwapBuffers
+        // returned, doneTime when its fence signaled (system clock, ms)
+        virtual void frameCompleted(unsigned long long frame, double swapTime, double doneTime);
+
 };
 
 #endif /* end of include guard: APPLICATION_JX8NA5Y9 */
@@ -0,0 +1,281 @@
+/**
+ * FontCache.cpp
+ */
+
+#include "FontCache.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "processing/mapped_file.hpp"
+#include "utils/stopwatch.hpp"
+
+using namespace std;
+
+namespace
+{
+    const char magic[8] = { 'R', 'S', 'F', 'O', 'N', 'T', 0, 0 };
+    const uint32_t formatVersion = 1;
+
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;        // formatVersion
+        uint32_t imguiVersion;   // IMGUI_VERSION_NUM
+        uint64_t key;
+        float fontSize, ascent, descent;
+        uint32_t fallbackChar;
+        uint32_t glyphCount;
+        int32_t width, height;   // alpha texture
+        float whiteU, whiteV;    // TexUvWhitePixel
+    };
+
+    struct CachedGlyph
+    {
+        uint32_t codepoint;
+        float advanceX;
+        float x0, y0, x1, y1;
+        float u0, v0, u1, v1;
+    };
+
+    // FNV-1a, 64 bits
+    uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    uint64_t cacheKey(const mapped_file& font, float size, const ImWchar* ranges)
+    {
+        uint64_t key = hashBytes(font.data(), font.size());
+        key = hashBytes(&size, sizeof(size), key);
+        for (const ImWchar* r = ranges; r[0]; r += 2)
+            key = hashBytes(r, 2 * sizeof(ImWchar), key);
+        uint32_t versions[2] = { formatVersion, IMGUI_VERSION_NUM };
+        return hashBytes(versions, sizeof(versions), key);
+    }
+
+    void makeDirectories(const string& dir)
+    {
+        for (size_t i = 1; i <= dir.size(); i++)
+            if (i == dir.size() || dir[i] == '/' || dir[i] == '\\')
+            {
+                string prefix = dir.substr(0, i);
+#ifdef _WIN32
+                _mkdir(prefix.c_str());
+#else
+                mkdir(prefix.c_str(), 0755);
+#endif
+            }
+    }
+
+    // Fill `atlas` from the cache file, false if it is missing or stale
+    bool readCache(ImFontAtlas& atlas, const string& file, uint64_t key, float size)
+    {
+        FILE* probe = fopen(file.c_str(), "rb");
+        if (!probe)
+            return false;
+        fclose(probe);
+
+        mapped_file cache(file);
+        CacheHeader header;
+        if (cache.size() < sizeof(header))
+            return false;
+        memcpy(&header, cache.data(), sizeof(header));
+        size_t pixels = size_t(header.width) * size_t(header.height);
+        size_t expected = sizeof(header) + size_t(header.glyphCount) * sizeof(CachedGlyph) + pixels;
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != formatVersion ||
+            header.imguiVersion != IMGUI_VERSION_NUM || header.key != key || header.fontSize != size ||
+            header.width <= 0 || header.height <= 0 || cache.size() != expected)
+            return false;
+
+        // what ImFontAtlas::Build() would have set up, without the font data
+        ImFontConfig config;
+        config.FontData = nullptr;
+        config.FontDataOwnedByAtlas = false;
+        config.SizePixels = size;
+        atlas.ConfigData.push_back(config);
+        ImFont* font = IM_NEW(ImFont)();
+        atlas.Fonts.push_back(font);
+        atlas.ConfigData.back().DstFont = font;
+        font->FontSize = header.fontSize;
+        font->ConfigData = &atlas.ConfigData.back();
+        font->ConfigDataCount = 1;
+        font->ContainerAtlas = &atlas;
+        font->Ascent = header.ascent;
+        font->Descent = header.descent;
+        font->FallbackChar = ImWchar(header.fallbackChar);
+
+        const CachedGlyph* glyphs = reinterpret_cast<const CachedGlyph*>(cache.data() + sizeof(header));
+        font->Glyphs.reserve(int(header.glyphCount));
+        for (uint32_t i = 0; i < header.glyphCount; i++)
+        {
+            const CachedGlyph& c = glyphs[i];
+            ImFontGlyph g;
+            g.Codepoint = ImWchar(c.codepoint);
+            g.AdvanceX = c.advanceX;
+            g.X0 = c.x0;
+            g.Y0 = c.y0;
+            g.X1 = c.x1;
+            g.Y1 = c.y1;
+            g.U0 = c.u0;
+            g.V0 = c.v0;
+            g.U1 = c.u1;
+            g.V1 = c.v1;
+            font->Glyphs.push_back(g);
+            font->MetricsTotalSurface += int((c.u1 - c.u0) * header.width + 1.99f) *
+                                         int((c.v1 - c.v0) * header.height + 1.99f);
+        }
+        font->BuildLookupTable();
+
+        // the atlas frees its texture with ImGui::MemFree()
+        atlas.TexWidth = header.width;
+        atlas.TexHeight = header.height;
+        atlas.TexUvScale = ImVec2(1.f / header.width, 1.f / header.height);
+        atlas.TexUvWhitePixel = ImVec2(header.whiteU, header.whiteV);
+        atlas.TexPixelsAlpha8 = static_cast<unsigned char*>(ImGui::MemAlloc(pixels));
+        memcpy(atlas.TexPixelsAlpha8, cache.data() + expected - pixels, pixels);
+        return true;
+    }
+
+    // Write the built atlas next to the cache file, then move it in place:
+    // a run killed meanwhile leaves no truncated cache behind
+    void writeCache(ImFontAtlas& atlas, const string& file, uint64_t key, float size)
+    {
+        const ImFont* font = atlas.Fonts[0];
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0;
+        atlas.GetTexDataAsAlpha8(&pixels, &width, &height);
+
+        CacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = formatVersion;
+        header.imguiVersion = IMGUI_VERSION_NUM;
+        header.key = key;
+        header.fontSize = size;
+        header.ascent = font->Ascent;
+        header.descent = font->Descent;
+        header.fallbackChar = font->FallbackChar;
+        header.glyphCount = uint32_t(font->Glyphs.Size);
+        header.width = width;
+        header.height = height;
+        header.whiteU = atlas.TexUvWhitePixel.x;
+        header.whiteV = atlas.TexUvWhitePixel.y;
+
+        vector<CachedGlyph> glyphs(font->Glyphs.Size);
+        for (int i = 0; i < font->Glyphs.Size; i++)
+        {
+            const ImFontGlyph& g = font->Glyphs[i];
+            CachedGlyph c = { uint32_t(g.Codepoint), g.AdvanceX, g.X0, g.Y0, g.X1, g.Y1, g.U0, g.V0, g.U1, g.V1 };
+            glyphs[i] = c;
+        }
+
+        string temporary = file + "." +
+                           to_string(chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "wb");
+        if (!out)
+            throw runtime_error("cannot write " + temporary);
+        size_t bytes = size_t(width) * size_t(height);
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  fwrite(glyphs.data(), sizeof(CachedGlyph), glyphs.size(), out) == glyphs.size() &&
+                  fwrite(pixels, 1, bytes, out) == bytes;
+        ok = fclose(out) == 0 && ok;
+#ifdef _WIN32
+        if (ok)
+            remove(file.c_str());
+#endif
+        if (!ok || rename(temporary.c_str(), file.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            throw runtime_error("cannot write " + file);
+        }
+    }
+}
+
+string fontCacheDirectory()
+{
+    if (const char* dir = getenv("RSSCANNER_CACHE"))
+        return dir;
+#ifdef _WIN32
+    if (const char* local = getenv("LOCALAPPDATA"))
+        return string(local) + "\\RSScanner";
+#else
+    if (const char* xdg = getenv("XDG_CACHE_HOME"))
+        return string(xdg) + "/rsscanner";
+    if (const char* home = getenv("HOME"))
+        return string(home) + "/.cache/rsscanner";
+#endif
+    return string();
+}
+
+FontCacheResult loadFontAtlas(ImFontAtlas& atlas, const string& path, float size, const ImWchar* ranges)
+{
+    stopwatch timer;
+    FontCacheResult result;
+    if (!ranges)
+        ranges = atlas.GetGlyphRangesDefault();
+    // the software cursors are not drawn, and not cached
+    atlas.Flags |= ImFontAtlasFlags_NoMouseCursors;
+
+    mapped_file font(path);
+    uint64_t key = cacheKey(font, size, ranges);
+    string dir = fontCacheDirectory();
+    if (!dir.empty())
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/font-%016llx.bin", (unsigned long long)key);
+        result.file = dir + name;
+        try
+        {
+            result.cached = readCache(atlas, result.file, key, size);
+        }
+        catch (const runtime_error& e)
+        {
+            result.error = e.what();
+        }
+        if (result.cached)
+        {
+            result.ms = timer.elapsed_ms();
+            return result;
+        }
+    }
+
+    // the font data goes to the atlas, which frees it with ImGui::MemFree()
+    void* data = ImGui::MemAlloc(font.size());
+    memcpy(data, font.data(), font.size());
+    ImFontConfig config;
+    size_t slash = path.find_last_of("/\\");
+    snprintf(config.Name, sizeof(config.Name), "%s, %.0fpx",
+             path.c_str() + (slash == string::npos ? 0 : slash + 1), size);
+    if (!atlas.AddFontFromMemoryTTF(data, int(font.size()), size, &config, ranges) || !atlas.Build())
+        throw runtime_error("cannot rasterize " + path);
+
+    if (!result.file.empty())
+    {
+        try
+        {
+            makeDirectories(dir);
+            writeCache(atlas, result.file, key, size);
+        }
+        catch (const runtime_error& e)
+        {
+            result.error = e.what();
+        }
+    }
+    result.ms = timer.elapsed_ms();
+    return result;
+}
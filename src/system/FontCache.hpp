@@ -0,0 +1,39 @@
+/**
+ * FontCache.hpp
+ * Baked font atlases kept on disk between runs.
+ */
+
+#ifndef FONTCACHE_Q7M2XK4D
+#define FONTCACHE_Q7M2XK4D
+
+#include <string>
+
+#include "imgui.h"
+
+struct FontCacheResult
+{
+    bool cached = false;   // read from the cache, nothing rasterized
+    double ms = 0;         // to fill the atlas, cache file written included
+    std::string file;      // cache file, empty without a cache directory
+    std::string error;     // why the cache could not be read or written
+};
+
+/// Add the font `path` at `size` pixels to `atlas` and build it. The glyphs,
+/// their metrics and the alpha texture are read from one mapping of a file
+/// of the cache directory, keyed by a hash of the font file, the size, the
+/// glyph ranges and the imgui version. When there is none, the atlas is
+/// rasterized as usual and the file written for the next run.
+///
+/// Does not touch the imgui context or GL: it may run on another thread
+/// while the window is created, on an atlas no context uses yet. `ranges`
+/// are those of AddFontFromFileTTF(), the default ones when null. Throws
+/// std::runtime_error if the font file can't be read; a cache that can't be
+/// used is only reported in the result.
+FontCacheResult loadFontAtlas(ImFontAtlas& atlas, const std::string& path, float size,
+                              const ImWchar* ranges = nullptr);
+
+// $RSSCANNER_CACHE, else rsscanner/ under the user cache directory; empty
+// when there is neither
+std::string fontCacheDirectory();
+
+#endif /* end of include guard: FONTCACHE_Q7M2XK4D */
@@ -0,0 +1,109 @@
+/**
+ * allocStats.cpp
+ */
+
+#include "allocStats.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace
+{
+    atomic<size_t> frame_count(0);
+    atomic<size_t> frame_bytes(0);
+    atomic<alloc_hook> hook(nullptr);
+    alloc_frame_stats last = { 0, 0 };
+
+    // counted once, however many times the new handler is called: as the
+    // default operator new, it runs until it frees memory or throws
+    void* counted_alloc(size_t bytes)
+    {
+        frame_count.fetch_add(1, memory_order_relaxed);
+        frame_bytes.fetch_add(bytes, memory_order_relaxed);
+        alloc_hook h = hook.load(memory_order_relaxed);
+        if (h)
+            h(bytes);
+        for (;;)
+        {
+            if (void* p = malloc(bytes ? bytes : 1))
+                return p;
+            new_handler handler = get_new_handler();
+            if (!handler)
+                throw bad_alloc();
+            handler();
+        }
+    }
+
+    void* counted_alloc(size_t bytes, const nothrow_t&) noexcept
+    {
+        try
+        {
+            return counted_alloc(bytes);
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+}
+
+void alloc_end_frame()
+{
+    last.count = frame_count.exchange(0, memory_order_relaxed);
+    last.bytes = frame_bytes.exchange(0, memory_order_relaxed);
+}
+
+alloc_frame_stats alloc_last_frame()
+{
+    return last;
+}
+
+void alloc_set_hook(alloc_hook h)
+{
+    hook.store(h);
+}
+
+// Replacements of the global allocation functions
+
+void* operator new(size_t bytes)
+{
+    return counted_alloc(bytes);
+}
+
+void* operator new[](size_t bytes)
+{
+    return counted_alloc(bytes);
+}
+
+void* operator new(size_t bytes, const nothrow_t&) noexcept
+{
+    return counted_alloc(bytes, nothrow);
+}
+
+void* operator new[](size_t bytes, const nothrow_t&) noexcept
+{
+    return counted_alloc(bytes, nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept
+{
+    free(p);
+}
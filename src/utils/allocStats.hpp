@@ -0,0 +1,28 @@
+/**
+ * allocStats.hpp
+ * Counts heap allocations made through the global operator new.
+ */
+
+#ifndef ALLOCSTATS_P7W2C9RX
+#define ALLOCSTATS_P7W2C9RX
+
+#include <cstddef>
+
+struct alloc_frame_stats
+{
+    size_t count;  // number of operator new calls
+    size_t bytes;  // bytes requested by those calls
+};
+
+// Close the current frame: its counters become the value of alloc_last_frame()
+void alloc_end_frame();
+
+// Allocations made during the last completed frame
+alloc_frame_stats alloc_last_frame();
+
+// Optional callback run on every allocation (e.g. to break on allocations
+// in a path that should be allocation free). Pass nullptr to remove it.
+typedef void (*alloc_hook)(size_t bytes);
+void alloc_set_hook(alloc_hook hook);
+
+#endif /* end of include guard: ALLOCSTATS_P7W2C9RX */
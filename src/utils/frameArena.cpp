@@ -0,0 +1,74 @@
+/**
+ * frameArena.cpp
+ */
+
+#include "frameArena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+
+frame_arena::frame_arena(size_t capacity):
+    block(static_cast<char*>(malloc(capacity))),
+    block_size(capacity)
+{
+    if (!block)
+        throw bad_alloc();
+}
+
+frame_arena::~frame_arena()
+{
+    reset();
+    free(block);
+}
+
+frame_arena& frame_arena::frame()
+{
+    static frame_arena arena;
+    return arena;
+}
+
+void* frame_arena::allocate(size_t bytes, size_t align)
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>(block);
+    size_t aligned = ((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    used_bytes += bytes;
+    if (aligned + bytes <= block_size)
+    {
+        offset = aligned + bytes;
+        return block + aligned;
+    }
+
+    // block exhausted for this frame, serve from the heap until the next reset
+    char* extra = static_cast<char*>(malloc(bytes + align));
+    if (!extra)
+        throw bad_alloc();
+    overflow.push_back(extra);
+    uintptr_t p = (reinterpret_cast<uintptr_t>(extra) + align - 1) & ~(uintptr_t)(align - 1);
+    return reinterpret_cast<void*>(p);
+}
+
+void frame_arena::reset()
+{
+    peak_bytes = max(peak_bytes, used_bytes);
+    if (!overflow.empty())
+    {
+        for (char* p : overflow)
+            free(p);
+        overflow.clear();
+
+        // grow to the high-water mark (plus alignment slack) so the next frame fits
+        size_t grown = peak_bytes + peak_bytes / 4;
+        char* bigger = static_cast<char*>(malloc(grown));
+        if (bigger)
+        {
+            free(block);
+            block = bigger;
+            block_size = grown;
+        }
+    }
+    offset = 0;
+    used_bytes = 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * frameArena.hpp
+ * Bump allocator for memory that only lives until the end of the frame.
+ */
+
+#ifndef FRAMEARENA_K3M8Q2ZD
+#define FRAMEARENA_K3M8Q2ZD
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/// \class frame_arena
+/// Allocations bump a pointer inside one block and are all released at once
+/// by reset(). When a frame needs more than the block holds, the overflow
+/// goes to extra heap blocks and the main block grows to the high-water mark
+/// on the next reset, so a steady workload settles to zero heap allocations.
+/// Not thread safe: each arena belongs to one thread. Meant for scratch of
+/// the render thread that dies with the frame, like the tiles of
+/// stream_grid; what outlives the frame or is filled by the frame stages on
+/// the worker threads is kept in members that are reused instead.
+class frame_arena
+{
+    public:
+        explicit frame_arena(size_t capacity = 1 << 20);
+        ~frame_arena();
+
+        // arena used by the render loop, reset by Application at the end of every frame
+        static frame_arena& frame();
+
+        void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+        // release everything allocated since the last reset
+        void reset();
+
+        size_t used() const { return used_bytes; }
+        size_t capacity() const { return block_size; }
+        size_t high_water() const { return peak_bytes; }
+
+    private:
+        frame_arena(const frame_arena&);
+        frame_arena& operator=(const frame_arena&);
+
+        char* block;
+        size_t block_size;
+        size_t offset = 0;
+        size_t used_bytes = 0;
+        size_t peak_bytes = 0;
+        std::vector<char*> overflow;
+};
+
+/// \class arena_allocator
+/// STL allocator handing out memory from a frame_arena. deallocate() is a
+/// no-op, containers must not outlive the arena's next reset().
+template <class T>
+class arena_allocator
+{
+    public:
+        typedef T value_type;
+
+        arena_allocator() : arena(&frame_arena::frame()) {}
+        explicit arena_allocator(frame_arena& a) : arena(&a) {}
+        template <class U>
+        arena_allocator(const arena_allocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t n)
+        {
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, size_t) {}
+
+        template <class U>
+        bool operator==(const arena_allocator<U>& other) const { return arena == other.arena; }
+        template <class U>
+        bool operator!=(const arena_allocator<U>& other) const { return arena != other.arena; }
+
+    private:
+        frame_arena* arena;
+
+        template <class U> friend class arena_allocator;
+};
+
+// vector whose storage lives in the frame arena
+template <class T>
+using frame_vector = std::vector<T, arena_allocator<T> >;
+
+#endif /* end of include guard: FRAMEARENA_K3M8Q2ZD */
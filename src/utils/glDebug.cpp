@@ -0,0 +1,138 @@
+/**
+ * glDebug.cpp
+ */
+
+#include "glDebug.hpp"
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <set>
+
+using namespace std;
+
+namespace
+{
+    bool debug_active = false;
+    bool counting = false;
+    unsigned draws = 0;
+    size_t upload_bytes = 0;
+    // the driver may call back from its own threads
+    atomic<unsigned> errors(0);
+    atomic<unsigned> warnings(0);
+    gl_frame_stats last = { 0, 0, 0, 0 };
+
+#if RSSCANNER_GL_DEBUG
+    const char* source_name(GLenum source)
+    {
+        switch (source)
+        {
+        case GL_DEBUG_SOURCE_API: return "api";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        default: return "other";
+        }
+    }
+
+    const char* type_name(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_DEBUG_TYPE_ERROR: return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+        case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+        default: return "other";
+        }
+    }
+
+    void GLAPIENTRY on_message(GLenum source, GLenum type, GLuint id, GLenum severity,
+                               GLsizei, const GLchar* message, const void*)
+    {
+        if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+            return;
+        if (type == GL_DEBUG_TYPE_ERROR)
+            errors.fetch_add(1, memory_order_relaxed);
+        else if (severity != GL_DEBUG_SEVERITY_LOW)
+            warnings.fetch_add(1, memory_order_relaxed);
+        else
+            return;
+
+        // a faulty call repeats every frame, print it once
+        static mutex lock;
+        static set<pair<GLenum, GLuint>> printed;
+        {
+            lock_guard<mutex> guard(lock);
+            if (!printed.insert(make_pair(source, id)).second)
+                return;
+        }
+        fprintf(stderr, "[GL %s, %s] %s\n", type_name(type), source_name(source), message);
+    }
+#endif
+}
+
+bool gl_debug_init()
+{
+#if RSSCANNER_GL_DEBUG
+    if (GLEW_VERSION_4_3 || GLEW_KHR_debug)
+    {
+        glEnable(GL_DEBUG_OUTPUT);
+        glDebugMessageCallback(on_message, nullptr);
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+        debug_active = true;
+    }
+    else if (GLEW_ARB_debug_output)
+    {
+        glDebugMessageCallbackARB(on_message, nullptr);
+        debug_active = true;
+    }
+#endif
+    return debug_active;
+}
+
+bool gl_debug_active()
+{
+    return debug_active;
+}
+
+void gl_set_counting(bool on)
+{
+    counting = on;
+}
+
+bool gl_counting()
+{
+    return counting;
+}
+
+void gl_count_draw(unsigned calls)
+{
+    if (counting)
+        draws += calls;
+}
+
+void gl_count_upload(size_t bytes)
+{
+    if (counting)
+        upload_bytes += bytes;
+}
+
+void gl_end_frame()
+{
+    last.draws = draws;
+    last.upload_bytes = upload_bytes;
+    last.errors = errors.exchange(0, memory_order_relaxed);
+    last.warnings = warnings.exchange(0, memory_order_relaxed);
+    draws = 0;
+    upload_bytes = 0;
+}
+
+gl_frame_stats gl_last_frame()
+{
+    return last;
+}
@@ -0,0 +1,55 @@
+/**
+ * glDebug.hpp
+ * GL error reporting through debug output callbacks, and per frame GL
+ * counters.
+ */
+
+#ifndef GLDEBUG_M6K2X8QD
+#define GLDEBUG_M6K2X8QD
+
+#include <cstddef>
+
+// Debug output is compiled in debug builds, and in release builds configured
+// with RSSCANNER_GL_DEBUG=ON; otherwise gl_debug_init() compiles to nothing
+#ifndef RSSCANNER_GL_DEBUG
+#ifdef NDEBUG
+#define RSSCANNER_GL_DEBUG 0
+#else
+#define RSSCANNER_GL_DEBUG 1
+#endif
+#endif
+
+// Have the driver report errors and warnings to a KHR_debug (or
+// ARB_debug_output) callback instead of polling glGetError(), which waits
+// for the GPU. Messages are asynchronous, the first of each kind is printed
+// on the standard error and all of them are counted. Needs a current context,
+// created with the debug flag for most drivers. Returns whether the callback
+// is installed.
+bool gl_debug_init();
+
+// Whether gl_debug_init() installed the callback
+bool gl_debug_active();
+
+struct gl_frame_stats
+{
+    unsigned draws;        // draw calls
+    size_t upload_bytes;   // buffer and texture data sent
+    unsigned errors;       // debug messages of type error
+    unsigned warnings;     // other debug messages of high or medium severity
+};
+
+// Counting of draws and uploads, off by default: while off the counting
+// calls below only test a flag. Debug messages are always counted.
+void gl_set_counting(bool on);
+bool gl_counting();
+
+void gl_count_draw(unsigned calls = 1);
+void gl_count_upload(size_t bytes);
+
+// Close the current frame: its counters become the value of gl_last_frame()
+void gl_end_frame();
+
+// Counters of the last completed frame
+gl_frame_stats gl_last_frame();
+
+#endif /* end of include guard: GLDEBUG_M6K2X8QD */
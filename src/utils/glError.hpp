@@ -1,19 +0,0 @@
-/**
- * glError.hpp
- * Contributors:
- *      * Arthur Sonzogni (author)
- * Licence:
- *      * MIT
- */
-
-#ifndef GLERROR_J4YD6FVF
-#define GLERROR_J4YD6FVF
-
-// Ask Opengl for errors:
-// Result is printed on the standard output
-// usage :
-//      glCheckError(__FILE__,__LINE__);
-void glCheckError(const char* file, unsigned int line);
-
-#endif /* end of include guard: GLERROR_J4YD6FVF */
-
@@ -0,0 +1,60 @@
+/**
+ * latency.cpp
+ */
+
+#include "latency.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+latency_histogram::latency_histogram(size_t window, float bin, size_t bin_count):
+    samples(window, 0.0),
+    bin_values(bin_count, 0.f),
+    bin_ms(bin)
+{
+    sorted.reserve(window);
+}
+
+size_t latency_histogram::bin_of(double ms) const
+{
+    if (ms < 0.0)
+        return 0;
+    return min(bin_values.size() - 1, size_t(ms / bin_ms));
+}
+
+void latency_histogram::add(double ms)
+{
+    if (filled == samples.size())
+        bin_values[bin_of(samples[next])] -= 1.f;  // evict the oldest sample
+    else
+        filled++;
+
+    samples[next] = ms;
+    next = (next + 1) % samples.size();
+    bin_values[bin_of(ms)] += 1.f;
+    last_sample = ms;
+}
+
+void latency_histogram::clear()
+{
+    fill(bin_values.begin(), bin_values.end(), 0.f);
+    next = filled = 0;
+}
+
+double latency_histogram::percentile(double p) const
+{
+    if (filled == 0)
+        return 0.0;
+    sorted.assign(samples.begin(), samples.begin() + filled);
+    size_t k = min(filled - 1, size_t(p * (filled - 1) + 0.5));
+    nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+double latency_histogram::max() const
+{
+    if (filled == 0)
+        return 0.0;
+    return *max_element(samples.begin(), samples.begin() + filled);
+}
@@ -0,0 +1,45 @@
+/**
+ * latency.hpp
+ * Rolling distribution of latency samples.
+ */
+
+#ifndef LATENCY_Q2V7M4JD
+#define LATENCY_Q2V7M4JD
+
+#include <cstddef>
+#include <vector>
+
+/// \class latency_histogram
+/// Keeps the last `window` samples (ms) and reports percentiles over them,
+/// plus fixed-width bins for plotting.
+class latency_histogram
+{
+    public:
+        explicit latency_histogram(size_t window = 512, float bin_ms = 5.f, size_t bin_count = 40);
+
+        void add(double ms);
+        void clear();
+
+        size_t count() const { return filled; }
+        double percentile(double p) const;   // p in [0, 1]
+        double max() const;
+        double last() const { return last_sample; }
+
+        // sample count per bin of width bin_ms; the last bin also holds everything above
+        const float* bins() const { return bin_values.data(); }
+        size_t bin_count() const { return bin_values.size(); }
+        float bin_width() const { return bin_ms; }
+
+    private:
+        std::vector<double> samples;   // ring buffer
+        mutable std::vector<double> sorted;
+        std::vector<float> bin_values;
+        size_t next = 0;
+        size_t filled = 0;
+        float bin_ms;
+        double last_sample = 0.0;
+
+        size_t bin_of(double ms) const;
+};
+
+#endif /* end of include guard: LATENCY_Q2V7M4JD */
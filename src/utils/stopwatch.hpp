@@ -0,0 +1,44 @@
+/**
+ * stopwatch.hpp
+ */
+
+#ifndef STOPWATCH_B4Y6H1LS
+#define STOPWATCH_B4Y6H1LS
+
+#include <chrono>
+
+/// \class stopwatch
+/// Wall clock timing of the stages of a frame, in milliseconds.
+class stopwatch
+{
+    public:
+        stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+        // time since construction or the last lap
+        double elapsed_ms() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // elapsed_ms(), then restart
+        double lap_ms()
+        {
+            auto now = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(now - start).count();
+            start = now;
+            return ms;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start;
+};
+
+// Milliseconds since the epoch on the system clock, the time base of
+// RealSense frame timestamps in the system and global time domains
+inline double system_time_ms()
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+#endif /* end of include guard: STOPWATCH_B4Y6H1LS */
@@ -0,0 +1,135 @@
+/**
+ * main.cpp regression test entry point
+ *
+ * usage: RealSenseScannerTests [--budget-scale X] [test...]
+ * Runs every test group, or only the named ones, and exits with 1 if any
+ * check failed. Timing budgets are multiplied by X, 0 disables them.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test.hpp"
+#include "processing/parallel.hpp"
+#include "processing/simd.hpp"
+
+double budget_scale = 1.0;
+
+namespace
+{
+    int failures = 0;
+
+    struct test_group
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const test_group groups[] = {
+        { "deproject", test_deproject },
+        { "compact", test_compact },
+        { "planes", test_planes },
+        { "outliers", test_outliers },
+        { "export", test_export },
+        { "align", test_align },
+        { "accumulate", test_accumulate },
+        { "keyframe", test_keyframe },
+        { "scheduler", test_scheduler },
+        { "change", test_change },
+        { "kdtree", test_kdtree },
+        { "convert", test_convert },
+    };
+
+    // Streams over a 4 MB buffer with a dependent multiply-add per element:
+    // memory and arithmetic bound like the stages, on one thread
+    double reference_loop()
+    {
+        std::vector<float> data(1 << 20);
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = float(i & 1023) * 0.001f;
+        auto start = std::chrono::steady_clock::now();
+        float acc = 0.f;
+        for (int pass = 0; pass < 16; pass++)
+            for (size_t i = 0; i < data.size(); i++)
+            {
+                acc = acc * 0.999f + data[i];
+                data[i] = acc * 0.5f;
+            }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (acc < 0.f)   // keep the loop alive
+            printf("%f\n", acc);
+        return ms;
+    }
+}
+
+bool test_check(bool ok, const char* what, const char* file, int line)
+{
+    if (!ok)
+    {
+        printf("%s:%d: check failed: %s\n", file, line, what);
+        failures++;
+    }
+    return ok;
+}
+
+double calibration_ms()
+{
+    static double ms = 0.0;
+    if (ms == 0.0)
+    {
+        ms = 1e30;
+        for (int i = 0; i < 5; i++)
+            ms = std::min(ms, reference_loop());
+    }
+    return ms;
+}
+
+double parallel_budget(double units)
+{
+    unsigned threads = std::min(hardware_threads(), 8u);
+    return units / (1.0 + (threads - 1) / 4.0);
+}
+
+void check_budget(const char* stage, double ms, double budget)
+{
+    double units = ms / calibration_ms();
+    bool over = budget_scale > 0.0 && units > budget * budget_scale;
+    printf("  %-36s %9.3f ms %7.2f units (budget %.2f)%s\n", stage, ms, units, budget * budget_scale,
+           over ? "  OVER BUDGET" : "");
+    if (over)
+        failures++;
+}
+
+int main(int argc, const char *argv[])
+{
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--budget-scale") == 0 && i + 1 < argc)
+            budget_scale = atof(argv[++i]);
+        else
+            names.push_back(argv[i]);
+    }
+
+    printf("simd: %s of %s%s\n", simd_name(simd_active()), simd_name(simd_detect()),
+           simd_overridden() ? " (RSSCANNER_SIMD)" : "");
+    if (budget_scale > 0.0)
+        printf("calibration: %.3f ms per unit, parallel budgets for %u threads\n", calibration_ms(),
+               hardware_threads());
+    for (const test_group& g : groups)
+    {
+        bool selected = names.empty();
+        for (const char* name : names)
+            selected = selected || strcmp(name, g.name) == 0;
+        if (!selected)
+            continue;
+
+        printf("== %s\n", g.name);
+        g.run();
+    }
+    if (failures)
+        printf("%d failure%s\n", failures, failures > 1 ? "s" : "");
+    return failures ? 1 : 0;
+}
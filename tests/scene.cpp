@@ -0,0 +1,54 @@
+/**
+ * scene.cpp
+ */
+#include "scene.hpp"
+
+#include <cmath>
+
+depth_scene make_room(int width, int height, float holes, float flying, uint32_t seed)
+{
+    depth_scene s;
+    s.intrin = depth_intrinsics{ width, height, width * 0.94f, width * 0.94f, width * 0.5f - 0.5f, height * 0.5f + 0.5f };
+    s.depth_scale = 0.001f;
+    s.depth.assign(size_t(width) * height, 0);
+    s.surface.assign(s.depth.size(), surface_none);
+
+    test_random rnd(seed);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            // z of the hit along the ray through (x, y), the nearest surface
+            float u = (x - s.intrin.ppx) / s.intrin.fx, v = (y - s.intrin.ppy) / s.intrin.fy;
+            float z = 3.f;
+            uint8_t what = surface_wall;
+            if (v > 0.f && 0.8f / v < z)
+            {
+                z = 0.8f / v;
+                what = surface_floor;
+            }
+            if (std::fabs(u * 1.8f) < 0.3f && v * 1.8f > 0.3f && v * 1.8f < 0.8f)
+            {
+                z = 1.8f;
+                what = surface_box;
+            }
+
+            float kind = rnd.next(), noise = rnd.next();
+            if (kind < holes)
+            {
+                z = 0.f;
+                what = surface_none;
+            }
+            else if (kind < holes + flying)
+            {
+                z += 0.2f + noise * 0.5f;
+                what = surface_flying;
+            }
+            else
+                z += (noise - 0.5f) * 2.f * s.depth_scale;
+
+            size_t i = size_t(y) * width + x;
+            s.depth[i] = uint16_t(std::lround(z / s.depth_scale));
+            s.surface[i] = what;
+        }
+    return s;
+}
@@ -0,0 +1,51 @@
+/**
+ * scene.hpp
+ * Deterministic synthetic depth frames with a known ground truth.
+ */
+
+#ifndef RSSCANNER_TEST_SCENE_H
+#define RSSCANNER_TEST_SCENE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "processing/deproject.hpp"
+
+// What each pixel of a synthetic frame sees
+enum scene_surface
+{
+    surface_none = 0,   // no depth
+    surface_floor,
+    surface_wall,
+    surface_box,
+    surface_flying      // flying pixel, pushed back along its ray
+};
+
+struct depth_scene
+{
+    depth_intrinsics intrin;
+    float depth_scale;              // meters per depth unit
+    std::vector<uint16_t> depth;
+    std::vector<uint8_t> surface;   // scene_surface of each pixel
+};
+
+/// A camera 0.8 m above a floor (y = 0.8, y points down), facing a wall at
+/// z = 3 m, with a 0.6 m wide box whose front face is at z = 1.8 m. One
+/// depth unit of noise, `holes` of the pixels without depth and `flying`
+/// of them pushed 0.2 to 0.7 m back. The frame only depends on the seed.
+depth_scene make_room(int width, int height, float holes, float flying, uint32_t seed);
+
+/// xorshift32, the noise of the synthetic scenes
+struct test_random
+{
+    uint32_t r;
+    explicit test_random(uint32_t seed) : r(seed ? seed : 1) {}
+
+    float next()
+    {
+        r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+        return float(r) / 4294967296.f;
+    }
+};
+
+#endif /* end of include guard: RSSCANNER_TEST_SCENE_H */
@@ -0,0 +1,71 @@
+/**
+ * test.hpp
+ * Checks and timing budgets of the regression tests.
+ *
+ * Budgets are given in calibration units: multiples of the time this
+ * machine takes to run a fixed single threaded reference loop, so that the
+ * same budget holds on a fast workstation and on a slow CI runner. Stages
+ * running on the processing threads have their budget for one thread,
+ * scaled by parallel_budget() to the threads of the machine.
+ */
+
+#ifndef RSSCANNER_TEST_H
+#define RSSCANNER_TEST_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Record a failed check, returns `ok`
+bool test_check(bool ok, const char* what, const char* file, int line);
+
+#define CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tol) test_check(std::fabs(double(a) - double(b)) <= (tol), #a " ~ " #b, __FILE__, __LINE__)
+
+// Milliseconds the reference loop takes on this machine, measured once
+double calibration_ms();
+
+// Multiplier of every budget, from the command line; 0 turns them off
+extern double budget_scale;
+
+// A budget of `units` on one thread, for a stage split over the processing
+// threads: a quarter of the ideal speedup per added thread, up to eight,
+// leaves room for memory bound stages and the fork/join overhead
+double parallel_budget(double units);
+
+// Fail when `ms` is over `budget` calibration units
+void check_budget(const char* stage, double ms, double budget);
+
+// Best wall time in milliseconds of `reps` runs of fn(), checked against
+// `budget` calibration units
+template <class F>
+double timed(const char* stage, int reps, double budget, F fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < reps; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    check_budget(stage, best, budget);
+    return best;
+}
+
+// Test groups, one per processing stage
+void test_deproject();
+void test_compact();
+void test_planes();
+void test_outliers();
+void test_export();
+void test_align();
+void test_accumulate();
+void test_keyframe();
+void test_scheduler();
+void test_change();
+void test_kdtree();
+void test_convert();
+
+#endif /* end of include guard: RSSCANNER_TEST_H */
@@ -0,0 +1,165 @@
+/**
+ * test_accumulate.cpp
+ * Accumulation under a memory budget: the scratch file and its codecs, a sweep
+ * along a wall and back that has to give the same model as an unbounded
+ * accumulator while staying within the budget, and a scratch file that
+ * stays the size of what is spilled.
+ */
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/accumulator.hpp"
+#include "processing/spill.hpp"
+
+namespace
+{
+    // A 2 x 1 m patch of a wall 3 m away, `offset` meters to the right;
+    // the same seed gives the same points
+    void wall_patch(float offset, uint32_t seed, std::vector<float3>& positions, std::vector<uint32_t>& colors)
+    {
+        test_random random(seed);
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            positions[i] = float3{ offset + 2.f * random.next() - 1.f, random.next() - 0.5f,
+                                   3.f + 0.01f * random.next() };
+            colors[i] = 0xff000000u | uint32_t(random.next() * 16777215.f);
+        }
+    }
+
+    // Sweep 40 patches to the right, then back over them with new points
+    // mixed in, passing every frame to add(); `after` is called after each
+    void sweep(accumulator& a, void (*after)(const accumulator&))
+    {
+        std::vector<float3> positions(20000);
+        std::vector<uint32_t> colors(positions.size());
+        for (int i = 0; i < 80; i++)
+        {
+            int step = i < 40 ? i : 79 - i;
+            wall_patch(0.25f * step, uint32_t(step + 1 + (i >= 40 && i % 2 ? 1000 : 0)), positions, colors);
+            a.add(positions.data(), colors.data(), positions.size());
+            if (after)
+                after(a);
+        }
+    }
+
+    size_t over_budget = 0;
+
+    void check_resident(const accumulator& a)
+    {
+        // the blocks and the open chunk of the last frame stay resident
+        accumulator_memory m = a.memory();
+        over_budget += m.resident_bytes > m.budget + 1024 * 1024;
+    }
+}
+
+void test_accumulate()
+{
+    // voxel bitmaps: sparse ones as gaps, dense ones as they are
+    std::vector<uint64_t> bits(512, 0), back(512);
+    std::vector<uint8_t> record;
+    for (size_t i = 0; i < bits.size() * 64; i += 37)
+        bits[i / 64] |= uint64_t(1) << (i % 64);
+    encode_voxels(bits.data(), bits.size(), record);
+    CHECK(record.size() < bits.size() * 8 / 2);
+    decode_voxels(record.data(), record.size(), back.data(), back.size());
+    CHECK(back == bits);
+    for (size_t i = 0; i < bits.size(); i++)
+        bits[i] = 0x5555555555555555ull * (i + 1);
+    encode_voxels(bits.data(), bits.size(), record);
+    CHECK(record.size() == 1 + bits.size() * 8);
+    decode_voxels(record.data(), record.size(), back.data(), back.size());
+    CHECK(back == bits);
+
+    // points: lossless, and smaller than as they are
+    std::vector<float3> positions(5000), decoded(positions.size());
+    std::vector<uint32_t> colors(positions.size()), decoded_colors(positions.size());
+    wall_patch(-0.3f, 9, positions, colors);
+    encode_points(positions.data(), colors.data(), positions.size(), record);
+    CHECK(record.size() < positions.size() * 16);
+    decode_points(record.data(), record.size(), positions.size(), decoded.data(), decoded_colors.data());
+    size_t wrong = 0;
+    for (size_t i = 0; i < positions.size(); i++)
+        wrong += decoded[i].x != positions[i].x || decoded[i].y != positions[i].y ||
+                 decoded[i].z != positions[i].z || decoded_colors[i] != colors[i];
+    CHECK(wrong == 0);
+
+    // the scratch file gives back what went in, at any offset
+    spill_file file;
+    std::vector<uint8_t> a(100, 1), b(3000, 2);
+    uint64_t at_a = file.append(a), at_b = file.append(b);
+    file.read(at_b, b.size(), record);
+    CHECK(record == b);
+    file.read(at_a, a.size(), record);
+    CHECK(record == a);
+    CHECK(file.size() == a.size() + b.size());
+    // a record with room is rewritten in place
+    uint64_t at_c = file.append(a, 400);
+    CHECK(file.size() == at_c + 400);
+    std::vector<uint8_t> c(300, 3);
+    file.rewrite(at_c, c);
+    file.read(at_c, c.size(), record);
+    CHECK(record == c && file.size() == at_c + 400);
+    file.read(at_b, b.size(), record);
+    CHECK(record == b);
+
+    // the same model with and without a budget
+    accumulator unbounded(0.005f);
+    sweep(unbounded, nullptr);
+    accumulator bounded(0.005f);
+    bounded.set_memory_budget(4 * 1024 * 1024);
+    sweep(bounded, check_resident);
+    if (!CHECK(over_budget == 0))
+        printf("  %zu frames over the budget\n", over_budget);
+
+    std::shared_ptr<const scene> all = unbounded.take_version(0.0), some = bounded.take_version(0.0);
+    CHECK(all->points == some->points);
+    CHECK(all->chunks.size() == some->chunks.size());
+    const accumulator_memory& m = some->memory;
+    CHECK(m.spilled_chunks > 0);
+    CHECK(m.spilled_blocks > 0);
+    // going back over the wall reads its index blocks back
+    CHECK(m.page_ins > 0);
+    size_t differ = 0;
+    for (size_t i = 0; i < all->chunks.size() && i < some->chunks.size(); i++)
+    {
+        std::shared_ptr<const scene_chunk> x = all->chunks[i], y = page_in(some->chunks[i]);
+        CHECK(y->positions.size() == some->chunks[i]->size());
+        if (x->positions.size() != y->positions.size())
+        {
+            differ++;
+            continue;
+        }
+        for (size_t k = 0; k < x->positions.size(); k++)
+            differ += x->positions[k].x != y->positions[k].x || x->positions[k].y != y->positions[k].y ||
+                      x->positions[k].z != y->positions[k].z || x->colors[k] != y->colors[k];
+    }
+    if (!CHECK(differ == 0))
+        printf("  %zu points differ\n", differ);
+    printf("  %.2f M points, %.1f MB resident, %.1f MB spilled in %.1f MB, %llu page-ins of %.3f ms\n",
+           some->points / 1e6, m.resident_bytes / 1048576.0, m.spilled_bytes / 1048576.0,
+           m.scratch_bytes / 1048576.0, (unsigned long long)m.page_ins, m.page_in_ms);
+
+    // two walls 20 m apart in turn, with new points each time: the blocks of
+    // one are spilled while filling up, mostly over their old copies
+    accumulator turns(0.005f);
+    turns.set_memory_budget(1024 * 1024);
+    for (int i = 0; i < 60; i++)
+    {
+        wall_patch(i % 2 ? 20.f : 0.f, uint32_t(i + 1), positions, colors);
+        turns.add(positions.data(), colors.data(), positions.size());
+    }
+    accumulator_memory t = turns.memory();
+    if (!CHECK(t.scratch_bytes >= t.spilled_bytes && t.scratch_bytes < t.spilled_bytes * 3 / 2))
+        printf("  %.1f MB spilled in a %.1f MB file\n", t.spilled_bytes / 1048576.0, t.scratch_bytes / 1048576.0);
+
+    timed("accumulate 80 frames, 4 MB budget", 3, 5.0, [&]()
+    {
+        accumulator timed_model(0.005f);
+        timed_model.set_memory_budget(4 * 1024 * 1024);
+        sweep(timed_model, nullptr);
+    });
+}
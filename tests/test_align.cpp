@@ -0,0 +1,159 @@
+/**
+ * test_align.cpp
+ * Depth to color registration of a synthetic room against a double
+ * precision reference with the same footprint rule, for a color camera at
+ * the depth resolution and at a higher one.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/align.hpp"
+
+namespace
+{
+    // Color pixels whose centers each depth pixel footprint, grown by a quarter
+    // pixel, covers; nearest wins
+    std::vector<double> reference_align(const depth_scene& s, const depth_intrinsics& c, const camera_extrinsics& e)
+    {
+        std::vector<double> z(size_t(c.width) * c.height, 0.0);
+        const depth_intrinsics& d = s.intrin;
+        const float* r = e.rotation;
+        for (int y = 0; y < d.height; y++)
+            for (int x = 0; x < d.width; x++)
+            {
+                double depth = s.depth[size_t(y) * d.width + x] * double(s.depth_scale);
+                if (depth <= 0.0)
+                    continue;
+                double u[2], v[2], zc = 0.0;
+                for (int k = 0; k < 2; k++)
+                {
+                    double px = (x - 0.5 + k - d.ppx) / d.fx * depth, py = (y - 0.5 + k - d.ppy) / d.fy * depth;
+                    double qx = r[0] * px + r[3] * py + r[6] * depth + e.translation[0];
+                    double qy = r[1] * px + r[4] * py + r[7] * depth + e.translation[1];
+                    double qz = r[2] * px + r[5] * py + r[8] * depth + e.translation[2];
+                    u[k] = qx / qz * c.fx + c.ppx;
+                    v[k] = qy / qz * c.fy + c.ppy;
+                    zc += qz * 0.5;
+                }
+                int u0 = std::max(0, int(std::ceil(std::min(u[0], u[1]) - 0.25)));
+                int u1 = std::min(c.width, int(std::ceil(std::max(u[0], u[1]) + 0.25))) - 1;
+                int v0 = std::max(0, int(std::ceil(std::min(v[0], v[1]) - 0.25)));
+                int v1 = std::min(c.height, int(std::ceil(std::max(v[0], v[1]) + 0.25))) - 1;
+                for (int j = v0; j <= v1; j++)
+                    for (int i = u0; i <= u1; i++)
+                    {
+                        double& o = z[size_t(j) * c.width + i];
+                        if (o == 0.0 || zc < o)
+                            o = zc;
+                    }
+            }
+        return z;
+    }
+
+    // Pixels whose depth differs from the reference by more than 1 mm
+    size_t differing(const rgbd_frame& f, const std::vector<double>& reference)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < reference.size(); i++)
+            n += std::fabs(f.pixels[i].z - reference[i]) > 0.001;
+        return n;
+    }
+
+    std::vector<uint8_t> gradient(int width, int height)
+    {
+        std::vector<uint8_t> rgb(size_t(width) * height * 3);
+        for (size_t i = 0; i < rgb.size() / 3; i++)
+        {
+            rgb[3 * i] = uint8_t(i % width);
+            rgb[3 * i + 1] = uint8_t(i / width);
+            rgb[3 * i + 2] = 7;
+        }
+        return rgb;
+    }
+}
+
+void test_align()
+{
+    const int w = 1280, h = 720;
+    depth_scene s = make_room(w, h, 0.02f, 0.f, 5);
+
+    // color camera 5 cm to the side, turned by half a degree: the box hides
+    // a strip of the wall the depth camera sees
+    const float a = 0.5f * 3.14159265f / 180.f;
+    camera_extrinsics e = { { std::cos(a), 0.f, -std::sin(a), 0.f, 1.f, 0.f, std::sin(a), 0.f, std::cos(a) },
+                            { -0.05f, 0.f, 0.f } };
+    depth_intrinsics c = { w, h, 1100.f, 1100.f, 642.f, 355.f };
+    std::vector<uint8_t> color = gradient(w, h);
+
+    rgbd_aligner aligner;
+    rgbd_frame frame;
+    timed("align 1280x720 to 1280x720", 20, parallel_budget(1.0), [&]()
+    {
+        aligner.align(s.depth.data(), w * 2, s.intrin, s.depth_scale, color.data(), w * 3, 3, c, e, frame);
+    });
+    CHECK(frame.width == w && frame.height == h);
+    std::vector<double> reference = reference_align(s, c, e);
+    size_t covered = 0;
+    for (double z : reference)
+        covered += z > 0.0;
+    CHECK(covered > reference.size() / 2);
+    // float rounding moves a few footprint edges across pixel centers
+    size_t differ = differing(frame, reference);
+    if (!CHECK(differ < reference.size() / 1000))
+        printf("  %zu of %zu pixels differ\n", differ, reference.size());
+
+    // colors pass through, RGB8 to RGBA8
+    size_t wrong_colors = 0;
+    for (size_t i = 0; i < frame.pixels.size(); i++)
+        wrong_colors += frame.pixels[i].color != (0xff070000u | uint32_t(uint8_t(i / w)) << 8 | uint8_t(i % w));
+    CHECK(wrong_colors == 0);
+
+    // the same for each instruction set, but for the few footprint edges
+    // that contracted multiply-adds move across a pixel center
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        rgbd_frame other;
+        aligner.align(s.depth.data(), w * 2, s.intrin, s.depth_scale, color.data(), w * 3, 3, c, e, other);
+        size_t changed = 0;
+        for (size_t i = 0; i < other.pixels.size(); i++)
+            changed += other.pixels[i].z != frame.pixels[i].z;
+        if (!CHECK(changed < frame.pixels.size() / 10000))
+            printf("  with the %s kernels\n", simd_name(simd_level(active_kernels().align_level)));
+    }
+    simd_force(simd_avx512);
+
+    // a larger color image: footprints cover several pixels, no holes open
+    depth_intrinsics big = { 1920, 1080, 1650.f, 1650.f, 963.f, 532.f };
+    std::vector<uint8_t> big_color = gradient(big.width, big.height);
+    depth_scene full = make_room(w, h, 0.f, 0.f, 6);
+    aligner.align(full.depth.data(), w * 2, full.intrin, full.depth_scale, big_color.data(), big.width * 3, 3,
+                  big, e, frame);
+    reference = reference_align(full, big, e);
+    differ = differing(frame, reference);
+    if (!CHECK(differ < reference.size() / 1000))
+        printf("  %zu of %zu pixels differ\n", differ, reference.size());
+    // inside the depth camera view only the wall strip behind the box, which
+    // the depth camera does not see, stays empty
+    size_t opened = 0, hidden = 0;
+    for (int y = 120; y < big.height - 120; y++)
+        for (int x = 120; x < big.width - 120; x++)
+        {
+            size_t i = size_t(y) * big.width + x;
+            opened += reference[i] > 0.0 && frame.pixels[i].z == 0.f;
+            hidden += reference[i] == 0.0;
+        }
+    CHECK(opened == 0);
+    CHECK(hidden > 0);
+
+    // back to points: the box face is 1.8 m away from the depth camera
+    std::vector<float3> points(frame.pixels.size());
+    rgbd_points(frame, big, points.data(), nullptr);
+    const float3& center = points[size_t(big.height / 2 + 400) * big.width + big.width / 2];
+    CHECK_NEAR(center.z, 1.8, 0.03);
+}
@@ -0,0 +1,127 @@
+/**
+ * test_change.cpp
+ * Tile change detection on depth and color images: noise, an object
+ * moving in, a slow drift, and the change kernels at every instruction set.
+ */
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/change.hpp"
+#include "processing/kernels.hpp"
+
+namespace
+{
+    const int width = 848, height = 480;   // 27 x 15 tiles, the last column 16 pixels wide
+
+    // A flat wall 2 m away with up to a unit of noise
+    std::vector<uint16_t> wall(uint32_t seed)
+    {
+        std::vector<uint16_t> depth(size_t(width) * height);
+        test_random random(seed);
+        for (auto& d : depth)
+            d = uint16_t(2000 + int(random.next() * 3.f) - 1);
+        return depth;
+    }
+
+    // [x0, x1) x [y0, y1) `closer` units nearer
+    void move_in(std::vector<uint16_t>& depth, int x0, int y0, int x1, int y1, int closer)
+    {
+        for (int y = y0; y < y1; y++)
+            for (int x = x0; x < x1; x++)
+                depth[size_t(y) * width + x] = uint16_t(depth[size_t(y) * width + x] - closer);
+    }
+}
+
+void test_change()
+{
+    tile_changes depth;
+    std::vector<uint16_t> frame = wall(1);
+    CHECK(depth.update_depth(frame.data(), width * 2, width, height, 4.f) == 27 * 15);
+    CHECK(depth.cols() == 27 && depth.rows() == 15 && depth.row_end(14) == height);
+
+    // noise alone: every tile reused
+    for (uint32_t seed = 2; seed < 6; seed++)
+    {
+        frame = wall(seed);
+        CHECK(depth.update_depth(frame.data(), width * 2, width, height, 4.f) == 0);
+    }
+
+    // an object moving in: the tiles it overlaps, even by a few rows
+    move_in(frame, 100, 200, 180, 260, 300);
+    CHECK(depth.update_depth(frame.data(), width * 2, width, height, 4.f) == 9);
+    size_t wrong = 0;
+    for (int r = 0; r < depth.rows(); r++)
+        for (int c = 0; c < depth.cols(); c++)
+            wrong += depth.changed(c, r) != (c >= 3 && c <= 5 && r >= 6 && r <= 8);
+    CHECK(wrong == 0);
+    // ...which is the reference from now on
+    CHECK(depth.update_depth(frame.data(), width * 2, width, height, 4.f) == 0);
+
+    // in the narrow last column
+    move_in(frame, 840, 0, 848, 32, 500);
+    CHECK(depth.update_depth(frame.data(), width * 2, width, height, 4.f) == 1);
+    CHECK(depth.changed(26, 0));
+    CHECK_NEAR(depth.reused(), 1.0 - (27.0 * 15 + 9 + 1) / (27.0 * 15 * 8), 1e-9);
+
+    // a slow drift adds up against the reference
+    std::vector<uint16_t> still(size_t(width) * height, 1500);
+    depth.reset();
+    depth.update_depth(still.data(), width * 2, width, height, 4.5f);
+    size_t first = 0;
+    for (int step = 1; step <= 6 && !first; step++)
+    {
+        for (auto& d : still)
+            d++;
+        if (depth.update_depth(still.data(), width * 2, width, height, 4.5f))
+            first = size_t(step);
+    }
+    CHECK(first == 5 && depth.changed_count() == depth.count());
+
+    // color: a spot below the threshold, a patch above, then a new size
+    tile_changes color;
+    std::vector<uint8_t> rgb(size_t(640) * 480 * 3, 90);
+    CHECK(color.update(rgb.data(), 640 * 3, 640, 480, 3, 2.f) == 20 * 15);
+    rgb[(size_t(100) * 640 + 100) * 3] = 255;
+    CHECK(color.update(rgb.data(), 640 * 3, 640, 480, 3, 2.f) == 0);
+    for (int y = 36; y < 52; y++)
+        for (int x = 36; x < 52; x++)
+            for (int k = 0; k < 3; k++)
+                rgb[(size_t(y) * 640 + x) * 3 + k] = 200;
+    CHECK(color.update(rgb.data(), 640 * 3, 640, 480, 3, 2.f) == 1);
+    CHECK(color.changed(1, 1));
+    CHECK(color.update(rgb.data(), 320 * 3, 320, 240, 3, 2.f) == 10 * 8);
+
+    // integer kernels: the same tiles at every instruction set
+    std::vector<uint16_t> before = wall(10), after = wall(11);
+    move_in(after, 300, 100, 420, 150, 3);
+    std::vector<uint8_t> reference;
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        tile_changes other;
+        other.update_depth(before.data(), width * 2, width, height, 1.2f);
+        other.update_depth(after.data(), width * 2, width, height, 1.2f);
+        std::vector<uint8_t> flags;
+        for (int r = 0; r < other.rows(); r++)
+            for (int c = 0; c < other.cols(); c++)
+                flags.push_back(other.changed(c, r));
+        if (level == simd_scalar)
+            reference = flags;
+        else if (!CHECK(flags == reference))
+            printf("  with the %s kernels\n", simd_name(simd_level(active_kernels().change_level)));
+    }
+    simd_force(simd_avx512);
+
+    std::vector<uint8_t> hd(size_t(1280) * 720 * 3, 90);
+    tile_changes depth_tiles, color_tiles;
+    depth_tiles.update_depth(before.data(), width * 2, width, height, 4.f);
+    color_tiles.update(hd.data(), 1280 * 3, 1280, 720, 3, 2.f);
+    timed("tile changes 848x480 Z16 + 1280x720 RGB", 20, parallel_budget(0.25), [&]()
+    {
+        depth_tiles.update_depth(after.data(), width * 2, width, height, 4.f);
+        color_tiles.update(hd.data(), 1280 * 3, 1280, 720, 3, 2.f);
+    });
+}
@@ -0,0 +1,162 @@
+/**
+ * test_convert.cpp
+ * The pixel format converters and the depth colorizer at every instruction
+ * set against their scalar paths, on odd widths and the tails the vector
+ * loops leave, without writing past the end of the output.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/colorizer.hpp"
+#include "processing/convert.hpp"
+
+namespace
+{
+    const uint8_t canary = 0xa5;
+    const size_t guard = 64;   // output bytes past the end that must stay untouched
+
+    std::vector<uint8_t> noise(size_t bytes, uint32_t seed)
+    {
+        std::vector<uint8_t> data(bytes);
+        test_random random(seed);
+        for (auto& b : data)
+            b = uint8_t(random.next() * 256.f);
+        return data;
+    }
+
+    // `pixels` converted by fn() at the level in use, from one byte past an
+    // aligned start, followed by the guard bytes
+    std::vector<uint8_t> convert(void (*fn)(const uint8_t*, uint8_t*, size_t), const std::vector<uint8_t>& src,
+                                 size_t pixels)
+    {
+        std::vector<uint8_t> dst(pixels * 4 + guard, canary);
+        fn(src.data() + 1, dst.data(), pixels);
+        return dst;
+    }
+
+    // A depth image `width` wide with rows `stride` bytes apart: a ramp
+    // across the range with noise, holes and far values
+    std::vector<uint16_t> depth_image(int width, int height, int stride, uint32_t seed)
+    {
+        std::vector<uint16_t> depth(size_t(stride / 2) * height, 0);
+        test_random random(seed);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+            {
+                float r = random.next();
+                uint16_t d = uint16_t(200 + x * 7 + y * 13 + int(r * 40.f));
+                depth[size_t(y) * (stride / 2) + x] = r < 0.05f ? 0 : r > 0.97f ? uint16_t(60000) : d;
+            }
+        return depth;
+    }
+}
+
+void test_convert()
+{
+    struct converter
+    {
+        const char* name;
+        void (*fn)(const uint8_t*, uint8_t*, size_t);
+        bool even;   // packed YUV, two pixels at a time
+    };
+    const converter converters[] = {
+        { "yuyv", yuyv_to_rgba8, true },
+        { "uyvy", uyvy_to_rgba8, true },
+        { "bgr8", bgr8_to_rgba8, false },
+        { "bgra8", bgra8_to_rgba8, false },
+        { "rgb8", rgb8_to_rgba8, false },
+    };
+    // around the 16 and 32 byte steps of the vector loops, and odd widths
+    const size_t sizes[] = { 1, 2, 3, 5, 7, 8, 15, 16, 17, 31, 32, 33, 63, 65, 97, 641, 847, 1281 };
+    const std::vector<uint8_t> src = noise(1281 * 4 + 1, 1);
+
+    for (const converter& c : converters)
+        for (size_t pixels : sizes)
+        {
+            size_t n = c.even ? pixels & ~size_t(1) : pixels;
+            if (!n)
+                continue;
+            simd_force(simd_scalar);
+            const std::vector<uint8_t> reference = convert(c.fn, src, n);
+            size_t overrun = 0;
+            for (size_t i = n * 4; i < reference.size(); i++)
+                overrun += reference[i] != canary;
+            CHECK(overrun == 0);
+            for (int level = simd_sse2; level <= simd_detect(); level++)
+            {
+                simd_force(simd_level(level));
+                if (!CHECK(convert(c.fn, src, n) == reference))
+                    printf("  %s, %d pixels, at %s\n", c.name, int(n), simd_name(simd_active()));
+            }
+        }
+    simd_force(simd_avx512);
+
+    // the depth palette lookup, directly and through the colorizer on
+    // images with tightly packed and with padded rows, equalized and linear
+    std::vector<uint32_t> lut(65536);
+    for (size_t i = 0; i < lut.size(); i++)
+        lut[i] = uint32_t(i * 2654435761u) | 0xff000000u;
+    const std::vector<uint8_t> depth_bytes = noise(1281 * 2 + 2, 2);
+    const uint16_t* raw = reinterpret_cast<const uint16_t*>(depth_bytes.data());
+    for (size_t pixels : sizes)
+    {
+        std::vector<uint8_t> reference;
+        for (int level = simd_scalar; level <= simd_detect(); level++)
+        {
+            simd_force(simd_level(level));
+            std::vector<uint8_t> dst(pixels * 4 + guard, canary);
+            z16_to_rgba8(raw, dst.data(), pixels, lut.data());
+            if (level == simd_scalar)
+                reference = dst;
+            else if (!CHECK(dst == reference))
+                printf("  z16, %d pixels, at %s\n", int(pixels), simd_name(simd_active()));
+        }
+        size_t overrun = 0;
+        for (size_t i = pixels * 4; i < reference.size(); i++)
+            overrun += reference[i] != canary;
+        CHECK(overrun == 0);
+    }
+
+    const int widths[] = { 1, 17, 33, 641 };
+    for (int width : widths)
+        for (int padding = 0; padding <= 6; padding += 6)
+            for (int equalize = 0; equalize < 2; equalize++)
+            {
+                const int height = 23, stride = width * 2 + padding;
+                const std::vector<uint16_t> depth = depth_image(width, height, stride, uint32_t(width));
+                std::vector<uint8_t> reference;
+                for (int level = simd_scalar; level <= simd_detect(); level++)
+                {
+                    simd_force(simd_level(level));
+                    depth_colorizer colorizer;
+                    colorizer.equalize = equalize != 0;
+                    std::vector<uint8_t> rgba(size_t(width) * height * 4 + guard, canary);
+                    colorizer.colorize(depth.data(), width, height, stride, rgba.data());
+                    if (level == simd_scalar)
+                        reference = rgba;
+                    else if (!CHECK(rgba == reference))
+                        printf("  colorizer, %d x %d, stride %d, %s, at %s\n", width, height, stride,
+                               equalize ? "equalized" : "linear", simd_name(simd_active()));
+                }
+                size_t overrun = 0;
+                for (size_t i = size_t(width) * height * 4; i < reference.size(); i++)
+                    overrun += reference[i] != canary;
+                CHECK(overrun == 0);
+            }
+    simd_force(simd_avx512);
+
+    const size_t hd = 1280 * 720;
+    const std::vector<uint8_t> frame = noise(hd * 3, 3);
+    std::vector<uint8_t> rgba(hd * 4);
+    timed("yuyv to rgba8, 1280 x 720", 10, 0.25, [&]() { yuyv_to_rgba8(frame.data(), rgba.data(), hd); });
+    timed("bgr8 to rgba8, 1280 x 720", 10, 0.25, [&]() { bgr8_to_rgba8(frame.data(), rgba.data(), hd); });
+    const std::vector<uint16_t> depth = depth_image(1280, 720, 1280 * 2, 4);
+    depth_colorizer colorizer;
+    timed("colorize equalized, 1280 x 720", 10, parallel_budget(0.3), [&]()
+    {
+        colorizer.colorize(depth.data(), 1280, 720, 1280 * 2, rgba.data());
+    });
+}
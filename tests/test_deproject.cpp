@@ -0,0 +1,135 @@
+/**
+ * test_deproject.cpp
+ * Deprojection of a 1280x720 synthetic frame against a double precision
+ * reference, and compaction against a sequential copy, with the kernels of
+ * every instruction set the CPU has.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/deproject.hpp"
+#include "processing/kernels.hpp"
+
+void test_deproject()
+{
+    const int w = 1280, h = 720;
+    depth_scene s = make_room(w, h, 0.05f, 0.f, 1);
+    std::vector<float3> points(s.depth.size());
+    timed("deproject 1280x720", 20, parallel_budget(0.25), [&]()
+    {
+        deproject_depth(s.depth.data(), w * 2, s.intrin, s.depth_scale, points.data());
+    });
+
+    size_t wrong = 0, floor = 0, floor_off = 0;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            size_t i = size_t(y) * w + x;
+            double z = s.depth[i] * double(s.depth_scale);
+            double rx = (x - double(s.intrin.ppx)) / s.intrin.fx * z;
+            double ry = (y - double(s.intrin.ppy)) / s.intrin.fy * z;
+            const float3& p = points[i];
+            wrong += std::fabs(p.x - rx) > 1e-5 * (1.0 + z) || std::fabs(p.y - ry) > 1e-5 * (1.0 + z) ||
+                     std::fabs(p.z - z) > 1e-6 * (1.0 + z);
+            if (s.surface[i] == surface_floor)
+            {
+                floor++;
+                // the floor is 0.8 m down, within the noise pushed along the ray
+                floor_off += std::fabs(p.y - 0.8) > 0.8 * 0.0025 / p.z + 1e-4;
+            }
+        }
+    CHECK(wrong == 0);
+    CHECK(floor > 0);
+    CHECK(floor_off == 0);
+
+    // rows padded to a larger stride
+    std::vector<uint16_t> padded(size_t(w + 16) * h, 0xffff);
+    for (int y = 0; y < h; y++)
+        std::copy(&s.depth[size_t(y) * w], &s.depth[size_t(y) * w] + w, &padded[size_t(y) * (w + 16)]);
+    std::vector<float3> strided(points.size());
+    deproject_depth(padded.data(), (w + 16) * 2, s.intrin, s.depth_scale, strided.data());
+    size_t differ = 0;
+    for (size_t i = 0; i < points.size(); i++)
+        differ += strided[i].x != points[i].x || strided[i].y != points[i].y || strided[i].z != points[i].z;
+    CHECK(differ == 0);
+
+    // the same for each instruction set
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        deproject_depth(s.depth.data(), w * 2, s.intrin, s.depth_scale, strided.data());
+        differ = 0;
+        for (size_t i = 0; i < points.size(); i++)
+            differ += strided[i].x != points[i].x || strided[i].y != points[i].y || strided[i].z != points[i].z;
+        if (!CHECK(differ == 0))
+            printf("  with the %s kernels\n", simd_name(simd_level(active_kernels().deproject_level)));
+    }
+    simd_force(simd_avx512);
+}
+
+void test_compact()
+{
+    const int w = 1280, h = 720;
+    depth_scene s = make_room(w, h, 0.1f, 0.f, 2);
+    std::vector<float3> points(s.depth.size());
+    deproject_depth(s.depth.data(), w * 2, s.intrin, s.depth_scale, points.data());
+
+    std::vector<uint32_t> colors(points.size());
+    std::vector<uint8_t> removed(points.size());
+    test_random rnd(3);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        colors[i] = uint32_t(i * 2654435761u);
+        removed[i] = rnd.next() < 0.2f;
+    }
+    // a removed run over a whole block and the last points, edge cases of the split
+    std::fill(removed.begin() + 100000, removed.begin() + 140000, 1);
+    std::fill(removed.end() - 1000, removed.end(), 1);
+
+    std::vector<float3> reference;
+    std::vector<uint32_t> reference_colors;
+    for (size_t i = 0; i < points.size(); i++)
+        if (points[i].z != 0.f && !removed[i])
+        {
+            reference.push_back(points[i]);
+            reference_colors.push_back(colors[i]);
+        }
+
+    std::vector<float3> out(points.size());
+    std::vector<uint32_t> out_colors(points.size());
+    size_t n = 0;
+    timed("compact 1280x720 with colors", 20, parallel_budget(0.4), [&]()
+    {
+        n = compact_points(points.data(), colors.data(), removed.data(), points.size(), out.data(), out_colors.data());
+    });
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        std::fill(out.begin(), out.end(), float3{ 0.f, 0.f, 0.f });
+        n = compact_points(points.data(), colors.data(), removed.data(), points.size(), out.data(), out_colors.data());
+        size_t differ = 0;
+        for (size_t i = 0; i < n && i < reference.size(); i++)
+            differ += out[i].x != reference[i].x || out[i].y != reference[i].y || out[i].z != reference[i].z ||
+                      out_colors[i] != reference_colors[i];
+        if (!CHECK(n == reference.size()) || !CHECK(differ == 0))
+            printf("  with the %s kernels\n", simd_name(simd_level(active_kernels().compact_level)));
+    }
+    simd_force(simd_avx512);
+
+    // the output is sized for the points kept only
+    std::vector<float3> exact(reference.size());
+    CHECK(compact_points(points.data(), nullptr, removed.data(), points.size(), exact.data(), nullptr) == reference.size());
+    CHECK(exact.empty() || (exact.back().x == reference.back().x && exact.back().z == reference.back().z));
+
+    // without a mask: every point with depth
+    size_t with_depth = 0;
+    for (const float3& p : points)
+        with_depth += p.z != 0.f;
+    CHECK(compact_points(points.data(), nullptr, nullptr, points.size(), out.data(), nullptr) == with_depth);
+    CHECK(compact_points(points.data(), nullptr, nullptr, 0, out.data(), nullptr) == 0);
+}
@@ -0,0 +1,155 @@
+/**
+ * test_export.cpp
+ * PLY and point cloud file output of a 1M point cloud, read back and
+ * compared to what was written.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/cloud_file.hpp"
+#include "processing/ply.hpp"
+
+namespace
+{
+    std::vector<char> read_file(const char* path)
+    {
+        std::vector<char> file;
+        if (FILE* in = fopen(path, "rb"))
+        {
+            char buffer[65536];
+            size_t got;
+            while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0)
+                file.insert(file.end(), buffer, buffer + got);
+            fclose(in);
+        }
+        return file;
+    }
+}
+
+void test_export()
+{
+    const size_t n = 1000003;
+    std::vector<float3> points(n);
+    std::vector<uint32_t> colors(n);
+    test_random rnd(6);
+    for (size_t i = 0; i < n; i++)
+    {
+        points[i] = float3{ rnd.next() * 4.f - 2.f, rnd.next() * 2.f - 1.f, rnd.next() * 3.f + 0.3f };
+        colors[i] = uint32_t(i * 2654435761u) | 0xff000000u;
+    }
+
+    const char* ply_path = "test_export.ply";
+    timed("ply, 1M points", 3, 1.0, [&]() { write_ply(ply_path, points.data(), colors.data(), n); });
+    {
+        std::vector<char> file = read_file(ply_path);
+        const std::string end = "end_header\n";
+        std::string head(file.begin(), file.begin() + std::min<size_t>(file.size(), 512));
+        size_t body = head.find(end);
+        CHECK(head.compare(0, 4, "ply\n") == 0);
+        CHECK(head.find("format binary_little_endian 1.0\n") != std::string::npos);
+        CHECK(head.find("element vertex 1000003\n") != std::string::npos);
+        if (CHECK(body != std::string::npos) && CHECK(file.size() == body + end.size() + n * 15))
+        {
+            const char* v = file.data() + body + end.size();
+            size_t differ = 0;
+            for (size_t i = 0; i < n; i++, v += 15)
+                differ += memcmp(v, &points[i], 12) != 0 || memcmp(v + 12, &colors[i], 3) != 0;
+            CHECK(differ == 0);
+        }
+
+        // streamed in uneven pieces, as models are saved chunk by chunk: the
+        // same bytes. Fewer points than the header announced is an error.
+        {
+            ply_writer writer(ply_path, n);
+            for (size_t b = 0; b < n; b += 300007)
+                writer.append(points.data() + b, colors.data() + b, std::min<size_t>(300007, n - b));
+            writer.finish();
+        }
+        CHECK(read_file(ply_path) == file);
+        bool thrown = false;
+        try
+        {
+            ply_writer writer(ply_path, n);
+            writer.append(points.data(), colors.data(), 1000);
+            writer.finish();
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        remove(ply_path);
+    }
+
+    const char* rsc_path = "test_export.rsc";
+    timed("cloud file, 1M points", 3, 1.0, [&]()
+    {
+        cloud_file_writer writer(rsc_path, cloud_colors);
+        writer.append(points.data(), colors.data(), nullptr, n);
+        writer.finish();
+    });
+    {
+        cloud_file file(rsc_path);
+        CHECK(file.points() == n);
+        CHECK(file.columns() == (cloud_positions | cloud_colors));
+        CHECK(file.block_count() == (n + 65535) / 65536);
+        size_t read = 0, differ = 0;
+        for (size_t b = 0; b < file.block_count(); b++)
+        {
+            const cloud_block& block = file.block(b);
+            const float3* p = file.positions(b);
+            const uint32_t* c = file.colors(b);
+            for (uint32_t i = 0; i < block.count && read + i < n; i++)
+                differ += memcmp(&p[i], &points[read + i], sizeof(float3)) != 0 || c[i] != colors[read + i];
+            read += block.count;
+        }
+        CHECK(read == n);
+        CHECK(differ == 0);
+    }
+
+    // damaged copies are turned down: a column offset that wraps around
+    // past the index, and a file without positions
+    {
+        const std::vector<char> file = read_file(rsc_path);
+        uint64_t index_offset;
+        memcpy(&index_offset, file.data() + file.size() - 64, sizeof(index_offset));
+        const char* bad_path = "test_export_bad.rsc";
+        for (int damage = 0; damage < 2; damage++)
+        {
+            std::vector<char> bad = file;
+            if (damage == 0)
+            {
+                uint64_t wraps = ~uint64_t(0) - 63;
+                memcpy(bad.data() + index_offset, &wraps, sizeof(wraps));
+            }
+            else
+            {
+                uint32_t columns = cloud_colors;
+                memcpy(bad.data() + bad.size() - 16, &columns, sizeof(columns));
+            }
+            if (FILE* out = fopen(bad_path, "wb"))
+            {
+                fwrite(bad.data(), 1, bad.size(), out);
+                fclose(out);
+            }
+            bool thrown = false;
+            try
+            {
+                cloud_file opened(bad_path);
+            }
+            catch (const std::runtime_error&)
+            {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+        remove(bad_path);
+    }
+    remove(rsc_path);
+}
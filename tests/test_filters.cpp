@@ -0,0 +1,128 @@
+/**
+ * test_filters.cpp
+ * Plane segmentation and outlier removal on a synthetic room, checked
+ * against the surface each pixel was generated from.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/deproject.hpp"
+#include "processing/outliers.hpp"
+#include "processing/planes.hpp"
+
+namespace
+{
+    std::vector<float3> room_points(const depth_scene& s)
+    {
+        std::vector<float3> points(s.depth.size());
+        deproject_depth(s.depth.data(), s.intrin.width * 2, s.intrin, s.depth_scale, points.data());
+        return points;
+    }
+
+    // Share of the pixels of `surface` whose flag is set
+    double flagged(const depth_scene& s, const std::vector<uint8_t>& flags, int surface, bool is)
+    {
+        size_t total = 0, set = 0;
+        for (size_t i = 0; i < flags.size(); i++)
+            if ((s.surface[i] == surface) == is && s.surface[i] != surface_none)
+            {
+                total++;
+                set += flags[i] != 0;
+            }
+        return total ? double(set) / total : 0.0;
+    }
+}
+
+void test_planes()
+{
+    depth_scene s = make_room(640, 480, 0.1f, 0.f, 4);
+    std::vector<float3> points = room_points(s);
+
+    plane_options opt;
+    std::vector<plane> planes;
+    std::vector<uint8_t> labels;
+    size_t found = 0;
+    timed("segment 640x480, 2 planes", 10, parallel_budget(0.6), [&]()
+    {
+        found = segment_planes(points.data(), points.size(), opt, planes, labels);
+    });
+    if (!CHECK(found == 2) || !CHECK(planes.size() == 2))
+        return;
+
+    // the floor and the wall, whichever is larger first
+    int floor = std::fabs(planes[0].normal.y) > std::fabs(planes[1].normal.y) ? 0 : 1;
+    const plane& f = planes[floor];
+    const plane& w = planes[1 - floor];
+    CHECK(std::fabs(f.normal.y) > 0.999f);
+    CHECK_NEAR(std::fabs(f.d), 0.8, 0.005);
+    CHECK(std::fabs(w.normal.z) > 0.999f);
+    CHECK_NEAR(std::fabs(w.d), 3.0, 0.01);
+
+    // pixels labelled with the plane they were generated on
+    std::vector<uint8_t> on_floor(labels.size()), on_wall(labels.size());
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        on_floor[i] = labels[i] == floor + 1;
+        on_wall[i] = labels[i] == 2 - floor;
+    }
+    // floor pixels within the threshold of the wall may go to either plane
+    CHECK(flagged(s, on_floor, surface_floor, true) > 0.98);
+    CHECK(flagged(s, labels, surface_floor, true) > 0.99);
+    CHECK(flagged(s, on_wall, surface_wall, true) > 0.99);
+    CHECK(flagged(s, labels, surface_box, true) < 0.01);
+
+    // reproducible
+    std::vector<uint8_t> again;
+    std::vector<plane> planes_again;
+    segment_planes(points.data(), points.size(), opt, planes_again, again);
+    CHECK(again == labels);
+}
+
+void test_outliers()
+{
+    depth_scene s = make_room(640, 480, 0.1f, 0.03f, 5);
+    std::vector<float3> points = room_points(s);
+    std::vector<uint8_t> removed(points.size());
+
+    outlier_options opt;
+    opt.filter = outlier_radius;
+    timed("radius, organized 640x480", 10, parallel_budget(0.6), [&]()
+    {
+        std::fill(removed.begin(), removed.end(), 0);
+        remove_outliers_organized(points.data(), s.intrin.width, s.intrin.height, opt, removed.data());
+    });
+    CHECK(flagged(s, removed, surface_flying, true) > 0.95);
+    CHECK(flagged(s, removed, surface_flying, false) < 0.02);
+
+    opt.filter = outlier_statistical;
+    timed("statistical, organized 640x480", 3, parallel_budget(8.0), [&]()
+    {
+        std::fill(removed.begin(), removed.end(), 0);
+        remove_outliers_organized(points.data(), s.intrin.width, s.intrin.height, opt, removed.data());
+    });
+    CHECK(flagged(s, removed, surface_flying, true) > 0.9);
+    CHECK(flagged(s, removed, surface_flying, false) < 0.05);
+
+    // the same frame without its image layout
+    std::vector<float3> cloud(points.size());
+    cloud.resize(compact_points(points.data(), nullptr, nullptr, points.size(), cloud.data(), nullptr));
+    depth_scene compacted = s;
+    compacted.surface.clear();
+    for (size_t i = 0; i < points.size(); i++)
+        if (points[i].z != 0.f)
+            compacted.surface.push_back(s.surface[i]);
+    removed.assign(cloud.size(), 0);
+
+    opt.filter = outlier_radius;
+    timed("radius, unorganized", 5, parallel_budget(3.0), [&]()
+    {
+        std::fill(removed.begin(), removed.end(), 0);
+        remove_outliers(cloud.data(), cloud.size(), opt, removed.data());
+    });
+    CHECK(flagged(compacted, removed, surface_flying, true) > 0.9);
+    CHECK(flagged(compacted, removed, surface_flying, false) < 0.02);
+}
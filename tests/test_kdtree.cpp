@@ -0,0 +1,144 @@
+/**
+ * test_kdtree.cpp
+ * The kd-tree queries against brute force over the same cloud: the picking
+ * ray, the k nearest neighbours and the radius search.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/kdtree.hpp"
+
+namespace
+{
+    // A wavy surface 2 m away, 4 x 3 m, with a tenth of the points
+    // scattered in front of it
+    std::vector<float3> cloud(size_t n, uint32_t seed)
+    {
+        std::vector<float3> points(n);
+        test_random random(seed);
+        for (auto& p : points)
+        {
+            float x = 4.f * random.next() - 2.f, y = 3.f * random.next() - 1.5f;
+            float z = 2.f + 0.1f * std::sin(3.f * x) * std::cos(2.f * y);
+            if (random.next() < 0.1f)
+                z -= 1.5f * random.next();
+            p = float3{ x, y, z };
+        }
+        return points;
+    }
+
+    float distance2(const float3& a, const float3& b)
+    {
+        float3 d = a - b;
+        return dot(d, d);
+    }
+
+    // What ray_nearest() looks for, over every point
+    bool brute_ray(const std::vector<float3>& points, float3 origin, float3 dir, float radius, float slope,
+                   float& best_t)
+    {
+        best_t = std::numeric_limits<float>::max();
+        for (const float3& p : points)
+        {
+            float3 v = p - origin;
+            float t = dot(v, dir);
+            float allow = radius + slope * t;
+            if (t >= 0.f && t < best_t && dot(v, v) - t * t <= allow * allow)
+                best_t = t;
+        }
+        return best_t != std::numeric_limits<float>::max();
+    }
+}
+
+void test_kdtree()
+{
+    kdtree empty;
+    kdtree::ray_hit hit;
+    std::vector<size_t> found;
+    size_t indices[8];
+    CHECK(!empty.ray_nearest(float3{ 0, 0, 0 }, float3{ 0, 0, 1 }, 0.01f, 0.f, hit));
+    CHECK(empty.knn(float3{ 0, 0, 0 }, 8, indices, nullptr) == 0);
+    empty.radius_search(float3{ 0, 0, 0 }, 1.f, found);
+    CHECK(found.empty());
+
+    const std::vector<float3> points = cloud(20000, 1);
+    kdtree tree;
+    tree.build(points.data(), points.size());
+    CHECK(tree.size() == points.size());
+
+    // rays from the camera through the cloud, thin and widening
+    test_random random(2);
+    size_t ray_wrong = 0, hits = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        float3 dir = { 1.6f * random.next() - 0.8f, 1.2f * random.next() - 0.6f, 1.f };
+        dir = dir * (1.f / std::sqrt(dot(dir, dir)));
+        float radius = i % 2 ? 0.002f : 0.01f, slope = i % 4 < 2 ? 0.f : 0.005f;
+        float t;
+        bool expected = brute_ray(points, float3{ 0, 0, 0 }, dir, radius, slope, t);
+        bool got = tree.ray_nearest(float3{ 0, 0, 0 }, dir, radius, slope, hit);
+        hits += got;
+        ray_wrong += got != expected || (got && (hit.t != t || hit.index >= points.size() ||
+                                                 distance2(points[hit.index], hit.point) != 0.f));
+    }
+    CHECK(ray_wrong == 0);
+    CHECK(hits > 50);
+
+    // knn: the same distances as the k smallest of all, sorted, with and
+    // without them asked for; fewer than k when the cloud is smaller
+    size_t knn_wrong = 0;
+    std::vector<float> all(points.size());
+    for (int i = 0; i < 100; i++)
+    {
+        float3 q = points[size_t(random.next() * points.size())];
+        if (i % 2)
+            q = q + float3{ 0.05f, -0.02f, 0.1f };
+        size_t k = i % 3 ? 8 : 1;
+        float dist2[8];
+        size_t got = tree.knn(q, k, indices, dist2);
+        for (size_t j = 0; j < points.size(); j++)
+            all[j] = distance2(points[j], q);
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        knn_wrong += got != k;
+        for (size_t j = 0; j < got && j < k; j++)
+            knn_wrong += dist2[j] != all[j] || distance2(points[indices[j]], q) != dist2[j];
+        size_t again[8];
+        knn_wrong += tree.knn(q, k, again, nullptr) != got || !std::equal(indices, indices + got, again);
+    }
+    CHECK(knn_wrong == 0);
+    kdtree small;
+    small.build(points.data(), 5);
+    CHECK(small.knn(float3{ 0, 0, 2 }, 8, indices, nullptr) == 5);
+
+    // radius search: exactly the points within r, once each
+    size_t radius_wrong = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        float3 q = points[size_t(random.next() * points.size())];
+        float r = i % 2 ? 0.02f : 0.1f;
+        tree.radius_search(q, r, found);
+        std::sort(found.begin(), found.end());
+        std::vector<size_t> expected;
+        for (size_t j = 0; j < points.size(); j++)
+            if (distance2(points[j], q) <= r * r)
+                expected.push_back(j);
+        radius_wrong += found != expected;
+    }
+    CHECK(radius_wrong == 0);
+
+    const std::vector<float3> large = cloud(1 << 20, 3);
+    timed("kdtree build, 1M points", 3, parallel_budget(12.0), [&]() { tree.build(large.data(), large.size()); });
+    timed("ray pick 1000 rays, 1M points", 5, 0.5, [&]()
+    {
+        test_random rays(4);
+        for (int i = 0; i < 1000; i++)
+        {
+            float3 dir = { 1.6f * rays.next() - 0.8f, 1.2f * rays.next() - 0.6f, 1.f };
+            tree.ray_nearest(float3{ 0, 0, 0 }, dir * (1.f / std::sqrt(dot(dir, dir))), 0.005f, 0.002f, hit);
+        }
+    });
+}
@@ -0,0 +1,110 @@
+/**
+ * test_keyframe.cpp
+ * Keyframe gating of a camera held still, panned and moved toward the
+ * scene, over a synthetic bumpy surface.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+#include "test.hpp"
+#include "processing/keyframe.hpp"
+#include "processing/kernels.hpp"
+
+namespace
+{
+    const int width = 848, height = 480;
+
+    // Bumps 2 m away, seen `pan` pixels to the right and `closer` meters
+    // nearer, with a millimeter of noise and a few holes
+    std::vector<uint16_t> bumps(int pan, float closer, uint32_t seed)
+    {
+        std::vector<uint16_t> depth(size_t(width) * height);
+        test_random random(seed);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+            {
+                float u = float(x + pan), v = float(y);
+                float z = 2.f + 0.3f * std::sin(u / 37.f) * std::cos(v / 23.f) + 0.1f * std::sin(u / 11.f) - closer;
+                float noise = random.next() - 0.5f;
+                depth[size_t(y) * width + x] = random.next() < 0.03f ? 0 : uint16_t(z * 1000.f + noise * 2.f);
+            }
+        return depth;
+    }
+}
+
+void test_keyframe()
+{
+    depth_intrinsics intrin = { width, height, 797.f, 797.f, 423.5f, 240.5f };
+    const float scale = 0.001f;
+    keyframe_gate gate;
+    std::vector<uint16_t> still = bumps(0, 0.f, 1);
+    CHECK(gate.update(still.data(), width * 2, intrin, scale).keyframe);
+
+    // held still: only the noise changes
+    size_t kept = 0;
+    for (uint32_t seed = 2; seed < 32; seed++)
+    {
+        std::vector<uint16_t> frame = bumps(0, 0.f, seed);
+        frame_motion m = gate.update(frame.data(), width * 2, intrin, scale);
+        kept += m.keyframe;
+        CHECK(m.rotation == 0.f);
+        CHECK(m.overlap > 0.95f);
+    }
+    CHECK(kept == 0);
+    CHECK(gate.frames() == 31);
+    CHECK_NEAR(gate.skipped(), 30.0 / 31.0, 1e-9);
+
+    // panned by 0.7 degrees, under the threshold, then by 2.9
+    std::vector<uint16_t> frame = bumps(10, 0.f, 40);
+    frame_motion m = gate.update(frame.data(), width * 2, intrin, scale);
+    CHECK(!m.keyframe);
+    CHECK(m.rotation < 2.f);
+    frame = bumps(40, 0.f, 41);
+    m = gate.update(frame.data(), width * 2, intrin, scale);
+    CHECK(m.keyframe);
+    // to within a cell, 9 pixels here
+    if (!CHECK_NEAR(m.rotation, std::atan(40.f / 797.f) * 180.f / 3.14159265f, 0.7))
+        printf("  rotation %.2f degrees\n", m.rotation);
+
+    // 5 cm closer: a keyframe from the translation
+    frame = bumps(40, 0.05f, 42);
+    m = gate.update(frame.data(), width * 2, intrin, scale);
+    CHECK(m.keyframe);
+    CHECK_NEAR(m.translation, -0.05, 0.005);
+    CHECK(m.rotation == 0.f);
+
+    // a new view altogether
+    gate.update(still.data(), width * 2, intrin, scale);
+    frame = bumps(400, 0.f, 43);
+    m = gate.update(frame.data(), width * 2, intrin, scale);
+    CHECK(m.keyframe);
+    CHECK(m.overlap < 0.85f);
+
+    // integer kernels: the same motion at every instruction set
+    frame = bumps(25, 0.02f, 44);
+    frame_motion reference;
+    for (int level = simd_scalar; level <= simd_detect(); level++)
+    {
+        simd_force(simd_level(level));
+        keyframe_gate other;
+        other.update(still.data(), width * 2, intrin, scale);
+        frame_motion o = other.update(frame.data(), width * 2, intrin, scale);
+        if (level == simd_scalar)
+            reference = o;
+        else if (!CHECK(o.rotation == reference.rotation && o.translation == reference.translation &&
+                        o.overlap == reference.overlap))
+            printf("  with the %s kernels\n", simd_name(simd_level(active_kernels().motion_level)));
+    }
+    simd_force(simd_avx512);
+
+    gate.reset();
+    CHECK(gate.frames() == 0);
+    CHECK(gate.update(frame.data(), width * 2, intrin, scale).keyframe);
+    timed("keyframe gate 848x480", 20, 0.05, [&]()
+    {
+        gate.update(still.data(), width * 2, intrin, scale);
+    });
+}
@@ -0,0 +1,158 @@
+/**
+ * test_scheduler.cpp
+ * The work-stealing scheduler: every index of a parallel_for exactly once,
+ * nested loops, exceptions, task graph order and priority lanes, on a
+ * scheduler with more workers than this machine may have cores.
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "test.hpp"
+#include "processing/parallel.hpp"
+#include "processing/scheduler.hpp"
+
+void test_scheduler()
+{
+    task_scheduler scheduler(3);
+    CHECK(scheduler.workers() == 3);
+
+    // each index once, whatever the grain, pieces no smaller than it
+    const size_t grains[] = { 1, 7, 64, 1000, 100000 };
+    for (size_t grain : grains)
+    {
+        std::vector<std::atomic<int>> hits(10007);
+        for (auto& h : hits)
+            h = 0;
+        std::atomic<size_t> small{ 0 };
+        scheduler.parallel_for(3, hits.size(), grain, [&](size_t b, size_t e)
+        {
+            small += e - b < grain && e != hits.size();
+            for (size_t i = b; i < e; i++)
+                hits[i]++;
+        });
+        size_t wrong = 0;
+        for (size_t i = 0; i < hits.size(); i++)
+            wrong += hits[i] != (i >= 3 ? 1 : 0);
+        if (!CHECK(wrong == 0) || !CHECK(small == 0))
+            printf("  grain %zu\n", grain);
+    }
+
+    // nested loops, the outer pieces waiting on the inner ones
+    std::atomic<uint64_t> sum{ 0 };
+    scheduler.parallel_for(0, 64, 1, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+            scheduler.parallel_for(0, 1000, 10, [&](size_t ib, size_t ie)
+            {
+                uint64_t s = 0;
+                for (size_t k = ib; k < ie; k++)
+                    s += k;
+                sum += s;
+            });
+    });
+    CHECK(sum == 64ull * 999 * 1000 / 2);
+
+    // the first exception reaches the caller, after every piece is done
+    std::atomic<int> ran{ 0 };
+    bool thrown = false;
+    try
+    {
+        scheduler.parallel_for(0, 100, 1, [&](size_t b, size_t e)
+        {
+            ran += int(e - b);
+            if (b <= 50 && 50 < e)
+                throw std::runtime_error("piece failed");
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(ran == 100);
+
+    // a diamond: a before b and c, both before d
+    std::atomic<int> order{ 0 };
+    int a = -1, b = -1, c = -1, d = -1;
+    task_graph graph(scheduler);
+    size_t ta = graph.add([&]() { a = order++; }, task_high);
+    size_t tb = graph.add([&]() { b = order++; });
+    size_t tc = graph.add([&]() { c = order++; }, task_low);
+    size_t td = graph.add([&]() { d = order++; });
+    graph.precede(ta, tb);
+    graph.precede(ta, tc);
+    graph.precede(tb, td);
+    graph.precede(tc, td);
+    graph.run();
+    CHECK(a == 0 && d == 3 && b > a && c > a && b != c);
+
+    // cleared and refilled, as every frame: only the new tasks and edges
+    graph.clear();
+    order = 0;
+    a = b = c = d = -1;
+    size_t first = graph.add([&]() { c = order++; });
+    graph.precede(first, graph.add([&]() { d = order++; }, task_high));
+    graph.run();
+    CHECK(c == 0 && d == 1 && a == -1 && b == -1);
+
+    // a failed task stops those after it
+    task_graph failing(scheduler);
+    bool after = false;
+    size_t tf = failing.add([]() { throw std::runtime_error("stage failed"); });
+    failing.precede(tf, failing.add([&]() { after = true; }));
+    thrown = false;
+    try
+    {
+        failing.run();
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && !after);
+
+    // background tasks are left to the workers: this thread, waiting on
+    // urgent ones, does not run them
+    task_counter urgent, background;
+    std::atomic<int> on_caller{ 0 };
+    std::thread::id caller = std::this_thread::get_id();
+    for (int i = 0; i < 200; i++)
+        scheduler.spawn([&]() { on_caller += std::this_thread::get_id() == caller; }, background, task_low);
+    for (int i = 0; i < 200; i++)
+        scheduler.spawn([]() {}, urgent, task_high);
+    scheduler.wait(urgent);
+    scheduler.wait(background);
+    CHECK(on_caller == 0);
+
+    scheduler_stats stats = scheduler.stats();
+    CHECK(stats.workers == 3);
+    CHECK(stats.utilization.size() == 3);
+    CHECK(stats.tasks > 0);
+    printf("  %llu tasks, %llu steals\n", (unsigned long long)stats.tasks, (unsigned long long)stats.steals);
+
+    // the helpers run on the shared scheduler
+    std::vector<int> squares(100000);
+    parallel_for(0, squares.size(), 256, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+            squares[i] = int(i % 1000) * int(i % 1000);
+    });
+    int left = 0, right = 0;
+    parallel_invoke([&]() { left = 1; }, [&]() { right = 2; });
+    CHECK(squares[99999] == 999 * 999 && left == 1 && right == 2);
+
+    // the cost of splitting a million indices
+    std::vector<float> values(1 << 20, 1.f);
+    timed("parallel_for 1M, grain 64", 20, parallel_budget(0.05), [&]()
+    {
+        scheduler.parallel_for(0, values.size(), 64, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+                values[i] = values[i] * 0.5f + 1.f;
+        });
+    });
+}
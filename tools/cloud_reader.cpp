@@ -0,0 +1,90 @@
+/**
+ * cloud_reader.cpp sample consumer of the shared memory point cloud
+ *
+ * usage: CloudReader [segment name]
+ * Prints one line per frame RSScanner publishes: number of points with
+ * depth and their bounding box.
+ */
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "ipc/cloud_ring.hpp"
+
+using namespace std;
+
+static double now_ms()
+{
+    return chrono::duration<double, milli>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, const char *argv[])
+{
+    const char* name = argc > 1 ? argv[1] : cloud_ring_default_name;
+    unique_ptr<cloud_reader> reader;
+    uint64_t next = 0;
+    double last_frame = now_ms();
+
+    for (;;)
+    {
+        if (!reader)
+        {
+            try
+            {
+                reader.reset(new cloud_reader(name));
+                next = 0;
+                last_frame = now_ms();
+                printf("connected to %s\n", name);
+            }
+            catch (const runtime_error& e)
+            {
+                printf("%s, retrying\n", e.what());
+                this_thread::sleep_for(chrono::seconds(1));
+                continue;
+            }
+        }
+
+        cloud_view view;
+        if (!reader->acquire(view, next))
+        {
+            // the publisher recreates the segment when its streams grow
+            if (now_ms() - last_frame > 2000.0)
+                reader.reset();
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+
+        // work on the frame in place; the publisher may lap us meanwhile
+        const slot_header& slot = *view.slot;
+        uint64_t frame_number = slot.frame_number;
+        double timestamp = slot.timestamp;
+        uint32_t count = slot.point_count;
+        uint32_t valid = 0;
+        float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const float* p = view.xyz + 3 * i;
+            if (p[2] == 0.f)
+                continue;
+            valid++;
+            for (int d = 0; d < 3; d++)
+            {
+                lo[d] = p[d] < lo[d] ? p[d] : lo[d];
+                hi[d] = p[d] > hi[d] ? p[d] : hi[d];
+            }
+        }
+        next = view.generation + 1;
+        last_frame = now_ms();
+        if (!reader->still_valid(view))
+        {
+            printf("frame %llu overwritten while reading, dropped\n", (unsigned long long)frame_number);
+            continue;
+        }
+
+        printf("frame %llu @ %.1f ms: %u/%u points, x [%.2f %.2f] y [%.2f %.2f] z [%.2f %.2f] m\n",
+               (unsigned long long)frame_number, timestamp, valid, count,
+               lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+    }
+}
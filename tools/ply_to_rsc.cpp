@@ -0,0 +1,183 @@
+/**
+ * ply_to_rsc.cpp converts PLY point clouds to the block file format
+ *
+ * usage: PlyToRsc input.ply output.rsc [points per block]
+ * Reads ascii and binary PLY vertices (x, y, z and optionally red, green,
+ * blue, nx, ny, nz) in one sequential pass.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "processing/cloud_file.hpp"
+
+using namespace std;
+
+namespace
+{
+    struct property
+    {
+        string name;
+        int size;        // bytes in binary files
+        bool is_float;
+        bool is_signed;
+    };
+
+    int type_size(const string& t, bool& is_float, bool& is_signed)
+    {
+        is_float = t == "float" || t == "float32" || t == "double" || t == "float64";
+        is_signed = is_float || t == "char" || t == "int8" || t == "short" || t == "int16" || t == "int" || t == "int32";
+        if (t == "char" || t == "uchar" || t == "int8" || t == "uint8") return 1;
+        if (t == "short" || t == "ushort" || t == "int16" || t == "uint16") return 2;
+        if (t == "int" || t == "uint" || t == "int32" || t == "uint32" || t == "float" || t == "float32") return 4;
+        if (t == "double" || t == "float64") return 8;
+        throw runtime_error("unsupported PLY property type " + t);
+    }
+
+    double read_binary(const uint8_t* p, const property& prop, bool swap)
+    {
+        uint8_t b[8];
+        for (int i = 0; i < prop.size; i++)
+            b[i] = swap ? p[prop.size - 1 - i] : p[i];
+        switch (prop.size)
+        {
+        case 1: return prop.is_signed ? double(int8_t(b[0])) : double(b[0]);
+        case 2: { uint16_t v; memcpy(&v, b, 2); return prop.is_signed ? double(int16_t(v)) : double(v); }
+        case 4:
+            if (prop.is_float) { float v; memcpy(&v, b, 4); return v; }
+            else { uint32_t v; memcpy(&v, b, 4); return prop.is_signed ? double(int32_t(v)) : double(v); }
+        default: { double v; memcpy(&v, b, 8); return v; }
+        }
+    }
+
+    inline uint8_t to_byte(double v)
+    {
+        return v < 0 ? 0 : (v > 255 ? 255 : uint8_t(v));
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("usage: %s input.ply output.rsc [points per block]\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        FILE* in = fopen(argv[1], "rb");
+        if (!in)
+            throw runtime_error(string("cannot open ") + argv[1]);
+
+        // header
+        char line[1024];
+        string format;
+        size_t count = 0;
+        bool in_vertex = false;
+        vector<property> props;
+        if (!fgets(line, sizeof(line), in) || strncmp(line, "ply", 3) != 0)
+            throw runtime_error(string(argv[1]) + " is not a PLY file");
+        while (fgets(line, sizeof(line), in))
+        {
+            char a[64] = {}, b[64] = {}, c[64] = {};
+            int n = sscanf(line, "%63s %63s %63s", a, b, c);
+            string key = n > 0 ? a : "";
+            if (key == "end_header")
+                break;
+            if (key == "format")
+                format = b;
+            else if (key == "element")
+            {
+                in_vertex = string(b) == "vertex";
+                if (in_vertex)
+                    count = strtoull(c, nullptr, 10);
+            }
+            else if (key == "property" && in_vertex)
+            {
+                if (string(b) == "list")
+                    throw runtime_error("list properties on vertices are not supported");
+                property p;
+                p.name = c;
+                p.size = type_size(b, p.is_float, p.is_signed);
+                props.push_back(p);
+            }
+        }
+        bool ascii = format == "ascii";
+        bool swap = format == "binary_big_endian";
+        if (!ascii && !swap && format != "binary_little_endian")
+            throw runtime_error("unknown PLY format " + format);
+
+        // where each of x y z, red green blue, nx ny nz comes from
+        const char* wanted[9] = { "x", "y", "z", "red", "green", "blue", "nx", "ny", "nz" };
+        int source[9];
+        for (int w = 0; w < 9; w++)
+        {
+            source[w] = -1;
+            for (size_t i = 0; i < props.size(); i++)
+                if (props[i].name == wanted[w] || (w >= 3 && w < 6 && props[i].name == string("diffuse_") + wanted[w]))
+                    source[w] = int(i);
+        }
+        if (source[0] < 0 || source[1] < 0 || source[2] < 0)
+            throw runtime_error("PLY vertices have no x, y, z");
+        uint32_t columns = cloud_positions;
+        if (source[3] >= 0 && source[4] >= 0 && source[5] >= 0)
+            columns |= cloud_colors;
+        if (source[6] >= 0 && source[7] >= 0 && source[8] >= 0)
+            columns |= cloud_normals;
+
+        size_t row = 0;
+        vector<size_t> offsets;
+        for (const property& p : props)
+        {
+            offsets.push_back(row);
+            row += p.size;
+        }
+
+        uint32_t block_points = argc > 3 ? uint32_t(atoi(argv[3])) : 65536;
+        cloud_file_writer writer(argv[2], columns, block_points);
+        const size_t batch = 65536;
+        vector<uint8_t> raw(batch * row);
+        vector<double> values(props.size());
+        vector<float3> positions(batch), normals(batch);
+        vector<uint32_t> colors(batch);
+        for (size_t done = 0; done < count;)
+        {
+            size_t n = min(batch, count - done);
+            if (!ascii && fread(raw.data(), row, n, in) != n)
+                throw runtime_error("unexpected end of PLY file");
+            for (size_t i = 0; i < n; i++)
+            {
+                for (size_t k = 0; k < props.size(); k++)
+                {
+                    if (ascii && fscanf(in, "%lf", &values[k]) != 1)
+                        throw runtime_error("unexpected end of PLY file");
+                    if (!ascii)
+                        values[k] = read_binary(raw.data() + i * row + offsets[k], props[k], swap);
+                }
+                positions[i] = float3{ float(values[source[0]]), float(values[source[1]]), float(values[source[2]]) };
+                if (columns & cloud_colors)
+                {
+                    const uint8_t px[4] = { to_byte(values[source[3]]), to_byte(values[source[4]]), to_byte(values[source[5]]), 255 };
+                    memcpy(&colors[i], px, 4);
+                }
+                if (columns & cloud_normals)
+                    normals[i] = float3{ float(values[source[6]]), float(values[source[7]]), float(values[source[8]]) };
+            }
+            writer.append(positions.data(), colors.data(), normals.data(), n);
+            done += n;
+        }
+        writer.finish();
+        fclose(in);
+        printf("%llu points written to %s\n", (unsigned long long)writer.points(), argv[2]);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * rsc_partition.cpp partitions a point cloud file for out of core viewing
+ *
+ * usage: RscPartition input.rsc output.rsc [points per node] [memory MB]
+ * Rewrites a file from PlyToRsc (or saved by the app) as an octree of
+ * blocks, which the Scan window streams in by level of detail.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "processing/cloud_partition.hpp"
+
+using namespace std;
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("usage: %s input.rsc output.rsc [points per node] [memory MB]\n", argv[0]);
+        return 1;
+    }
+
+    partition_options options;
+    if (argc > 3)
+        options.node_points = uint32_t(atoi(argv[3]));
+    if (argc > 4)
+        options.memory_budget = size_t(atoi(argv[4])) << 20;
+
+    try
+    {
+        auto start = chrono::steady_clock::now();
+        cloud_file in(argv[1]);
+        size_t nodes = partition_cloud(in, argv[2], options);
+        printf("%llu points in %d nodes written to %s in %.1f s\n",
+               (unsigned long long)in.points(), int(nodes), argv[2],
+               chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}